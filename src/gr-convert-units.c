@@ -125,299 +125,164 @@ gr_convert_temp (int *num, int *unit, int user_unit)
         *num = num1;
 }
 
-void
-gr_convert_volume (double *amount, GrUnit *unit, GrPreferredUnit user_volume_unit)
-{
-        double amount1 = *amount;
-        GrUnit unit1 = *unit;
-
-        if (user_volume_unit == GR_PREFERRED_UNIT_IMPERIAL) {
-                switch (unit1) {
-                case GR_UNIT_MILLILITER:
-                        amount1 = amount1 / 4.92892;
-                        unit1 = GR_UNIT_TEASPOON;
-                        break;
-
-                case GR_UNIT_DECILITER:
-                        amount1 = amount1 * 20.2884;
-                        unit1 = GR_UNIT_TEASPOON;
-                        break;
-
-                case GR_UNIT_LITER:
-                        amount1 = amount1 * 202.884;
-                        unit1 = GR_UNIT_TEASPOON;
-                        break;
-
-                case GR_UNIT_TEASPOON:
-                        amount1 = amount1;
-                        unit1 = GR_UNIT_TEASPOON;
-                        break;
-
-                case GR_UNIT_TABLESPOON:
-                        amount1 = amount1 * 3;
-                        unit1 = GR_UNIT_TEASPOON;
-                        break;
-
-                case GR_UNIT_CUP:
-                        amount1 = amount1 * 48;
-                        unit1 = GR_UNIT_TEASPOON;
-                        break;
-
-                case GR_UNIT_PINT:
-                        amount1 = amount1 * 96;
-                        unit1 = GR_UNIT_TEASPOON;
-                        break;
-
-                case GR_UNIT_QUART:
-                        amount1 = amount1 * 192;
-                        unit1 = GR_UNIT_TEASPOON;
-                        break;
-
-                case GR_UNIT_GALLON:
-                        amount1 = amount1 * 768;
-                        unit1 = GR_UNIT_TEASPOON;
-                        break;
-
-                case GR_UNIT_FLUID_OUNCE:
-                        amount1 = amount1 * 6;
-                        unit1 = GR_UNIT_TEASPOON;
-                        break;
-
-                default: ;
-                }
+/* Conversions to the base unit of the metric and imperial systems,
+ * indexed by GrPreferredUnit and GrUnit. A target of GR_UNIT_UNKNOWN
+ * means that the unit is left alone.
+ */
+typedef struct {
+        GrUnit unit;
+        double factor;
+} Conversion;
+
+static const Conversion volume_conversions[2][GR_LAST_UNIT + 1] = {
+        [GR_PREFERRED_UNIT_METRIC] = {
+                [GR_UNIT_TEASPOON]     = { GR_UNIT_MILLILITER, 4.92892 },
+                [GR_UNIT_TABLESPOON]   = { GR_UNIT_MILLILITER, 14.79 },
+                [GR_UNIT_CUP]          = { GR_UNIT_MILLILITER, 236.59 },
+                [GR_UNIT_PINT]         = { GR_UNIT_MILLILITER, 473.176 },
+                [GR_UNIT_QUART]        = { GR_UNIT_MILLILITER, 946.353 },
+                [GR_UNIT_GALLON]       = { GR_UNIT_MILLILITER, 3785.41 },
+                [GR_UNIT_FLUID_OUNCE]  = { GR_UNIT_MILLILITER, 29.5735 },
+                [GR_UNIT_MILLILITER]   = { GR_UNIT_MILLILITER, 1 },
+                [GR_UNIT_DECILITER]    = { GR_UNIT_MILLILITER, 100 },
+                [GR_UNIT_LITER]        = { GR_UNIT_MILLILITER, 1000 },
+        },
+        [GR_PREFERRED_UNIT_IMPERIAL] = {
+                [GR_UNIT_MILLILITER]   = { GR_UNIT_TEASPOON, 1 / 4.92892 },
+                [GR_UNIT_DECILITER]    = { GR_UNIT_TEASPOON, 20.2884 },
+                [GR_UNIT_LITER]        = { GR_UNIT_TEASPOON, 202.884 },
+                [GR_UNIT_TEASPOON]     = { GR_UNIT_TEASPOON, 1 },
+                [GR_UNIT_TABLESPOON]   = { GR_UNIT_TEASPOON, 3 },
+                [GR_UNIT_CUP]          = { GR_UNIT_TEASPOON, 48 },
+                [GR_UNIT_PINT]         = { GR_UNIT_TEASPOON, 96 },
+                [GR_UNIT_QUART]        = { GR_UNIT_TEASPOON, 192 },
+                [GR_UNIT_GALLON]       = { GR_UNIT_TEASPOON, 768 },
+                [GR_UNIT_FLUID_OUNCE]  = { GR_UNIT_TEASPOON, 6 },
         }
-        if (user_volume_unit == GR_PREFERRED_UNIT_METRIC) {
-                switch (unit1) {
-                case GR_UNIT_TEASPOON:
-                        amount1 = amount1 * 4.92892;
-                        unit1 = GR_UNIT_MILLILITER;
-                        break;
-
-                case GR_UNIT_TABLESPOON:
-                        amount1 = amount1 * 14.79;
-                        unit1 = GR_UNIT_MILLILITER;
-                        break;
-
-                case GR_UNIT_CUP:
-                        amount1 = amount1 * 236.59;
-                        unit1 = GR_UNIT_MILLILITER;
-                        break;
-
-                case GR_UNIT_PINT:
-                        amount1 = amount1 * 473.176;
-                        unit1 = GR_UNIT_MILLILITER;
-                        break;
-
-                case GR_UNIT_QUART:
-                        amount1 = amount1 * 946.353;
-                        unit1 = GR_UNIT_MILLILITER;
-                        break;
-
-                case GR_UNIT_GALLON:
-                        amount1 = amount1 * 3785.41;
-                        unit1 = GR_UNIT_MILLILITER;
-                        break;
+};
+
+static const Conversion weight_conversions[2][GR_LAST_UNIT + 1] = {
+        [GR_PREFERRED_UNIT_METRIC] = {
+                [GR_UNIT_OUNCE]        = { GR_UNIT_GRAM, 28.3495 },
+                [GR_UNIT_POUND]        = { GR_UNIT_GRAM, 453.592 },
+                [GR_UNIT_STONE]        = { GR_UNIT_GRAM, 6350.29 },
+                [GR_UNIT_GRAM]         = { GR_UNIT_GRAM, 1 },
+                [GR_UNIT_KILOGRAM]     = { GR_UNIT_GRAM, 1000 },
+        },
+        [GR_PREFERRED_UNIT_IMPERIAL] = {
+                [GR_UNIT_GRAM]         = { GR_UNIT_OUNCE, 0.035274 },
+                [GR_UNIT_KILOGRAM]     = { GR_UNIT_OUNCE, 35.274 },
+                [GR_UNIT_OUNCE]        = { GR_UNIT_OUNCE, 1 },
+                [GR_UNIT_POUND]        = { GR_UNIT_OUNCE, 16 },
+                [GR_UNIT_STONE]        = { GR_UNIT_OUNCE, 224 },
+        }
+};
 
-                case GR_UNIT_FLUID_OUNCE:
-                        amount1 = amount1 * 29.5735;
-                        unit1 = GR_UNIT_MILLILITER;
-                        break;
+static void
+convert (const Conversion  table[2][GR_LAST_UNIT + 1],
+         double           *amount,
+         GrUnit           *unit,
+         GrPreferredUnit   preferred)
+{
+        const Conversion *c;
 
-                case GR_UNIT_MILLILITER:
-                        amount1 = amount1;
-                        unit1 = GR_UNIT_MILLILITER;
-                        break;
+        if (preferred != GR_PREFERRED_UNIT_METRIC &&
+            preferred != GR_PREFERRED_UNIT_IMPERIAL)
+                return;
 
-                case GR_UNIT_DECILITER:
-                        amount1 = amount1 * 100;
-                        unit1 = GR_UNIT_MILLILITER;
-                        break;
+        if (*unit < 0 || *unit > GR_LAST_UNIT)
+                return;
 
-                case GR_UNIT_LITER:
-                        amount1 = amount1 * 1000;
-                        unit1 = GR_UNIT_MILLILITER;
-                        break;
+        c = &table[preferred][*unit];
+        if (c->unit == GR_UNIT_UNKNOWN)
+                return;
 
-                default: ;
-                }
-        }
+        *amount = *amount * c->factor;
+        *unit = c->unit;
+}
 
-        *amount = amount1;
-        *unit = unit1;
+void
+gr_convert_volume (double *amount, GrUnit *unit, GrPreferredUnit user_volume_unit)
+{
+        convert (volume_conversions, amount, unit, user_volume_unit);
 }
 
 void
 gr_convert_weight (double *amount, GrUnit *unit, GrPreferredUnit user_weight_unit)
 {
-        double amount1 = *amount;
-        GrUnit unit1 = *unit;
-
-        if (user_weight_unit == GR_PREFERRED_UNIT_IMPERIAL) {
-                switch (unit1) {
-                case GR_UNIT_GRAM:
-                        amount1 = amount1 * 0.035274;
-                        unit1 = GR_UNIT_OUNCE;
-                        break;
-
-                case GR_UNIT_KILOGRAM:
-                        amount1 = amount1 * 35.274;
-                        unit1 = GR_UNIT_OUNCE;
-                        break;
-
-                case GR_UNIT_OUNCE:
-                        amount1 = amount1;
-                        unit1 = GR_UNIT_OUNCE;
-                        break;
+        convert (weight_conversions, amount, unit, user_weight_unit);
+}
 
-                case GR_UNIT_POUND:
-                        amount1 = amount1 * 16;
-                        unit1 = GR_UNIT_OUNCE;
-                        break;
+/* Converts volumes to milliliters and masses to grams, so that
+ * amounts of the same dimension can be added up directly. Other
+ * units are left alone.
+ */
+void
+gr_convert_to_base_unit (double *amount, GrUnit *unit)
+{
+        switch (gr_unit_get_dimension (*unit)) {
+        case GR_DIMENSION_VOLUME:
+                gr_convert_volume (amount, unit, GR_PREFERRED_UNIT_METRIC);
+                break;
 
-                case GR_UNIT_STONE:
-                        amount1 = amount1 * 224;
-                        unit1 = GR_UNIT_OUNCE;
-                        break;
+        case GR_DIMENSION_MASS:
+                gr_convert_weight (amount, unit, GR_PREFERRED_UNIT_METRIC);
+                break;
 
-                default: ;
-                }
+        default: ;
         }
-        if (user_weight_unit == GR_PREFERRED_UNIT_METRIC) {
-                switch (unit1) {
-                case GR_UNIT_OUNCE:
-                        amount1 = amount1 * 28.3495;
-                        unit1 = GR_UNIT_GRAM;
-                        break;
-
-                case GR_UNIT_POUND:
-                        amount1 = amount1 * 453.592;
-                        unit1 = GR_UNIT_GRAM;
-                        break;
-
-                case GR_UNIT_STONE:
-                        amount1 = amount1 * 6350.29;
-                        unit1 = GR_UNIT_GRAM;
-                        break;
-
-                case GR_UNIT_GRAM:
-                        amount1 = amount1;
-                        unit1 = GR_UNIT_GRAM;
-                        break;
-
-                case GR_UNIT_KILOGRAM:
-                        amount1 = amount1 * 1000;
-                        unit1 = GR_UNIT_GRAM;
-                        break;
-
-                default: ;
-                }
-         }
-
-         *amount = amount1;
-         *unit = unit1;
 }
 
+/* For each unit, the next larger unit to switch to once the amount
+ * reaches a given size, and the next smaller unit to switch to when
+ * the amount drops below 1. Tablespoons only switch to teaspoons for
+ * positive amounts.
+ */
+typedef struct {
+        GrUnit larger;
+        double larger_at;
+        GrUnit smaller;
+        double smaller_factor;
+        gboolean smaller_if_positive;
+} Readable;
+
+static const Readable readable[GR_LAST_UNIT + 1] = {
+        [GR_UNIT_GRAM]       = { GR_UNIT_KILOGRAM,   1000, GR_UNIT_UNKNOWN,    0,        FALSE },
+        [GR_UNIT_KILOGRAM]   = { GR_UNIT_UNKNOWN,    0,    GR_UNIT_GRAM,       1000,     FALSE },
+        [GR_UNIT_POUND]      = { GR_UNIT_UNKNOWN,    0,    GR_UNIT_OUNCE,      16,       FALSE },
+        [GR_UNIT_OUNCE]      = { GR_UNIT_POUND,      16,   GR_UNIT_UNKNOWN,    0,        FALSE },
+        [GR_UNIT_TEASPOON]   = { GR_UNIT_TABLESPOON, 3,    GR_UNIT_UNKNOWN,    0,        FALSE },
+        [GR_UNIT_TABLESPOON] = { GR_UNIT_CUP,        16,   GR_UNIT_TEASPOON,   3,        TRUE },
+        [GR_UNIT_CUP]        = { GR_UNIT_QUART,      4,    GR_UNIT_TABLESPOON, 1.0 / 16, FALSE },
+        [GR_UNIT_MILLILITER] = { GR_UNIT_LITER,      1000, GR_UNIT_UNKNOWN,    0,        FALSE },
+        [GR_UNIT_DECILITER]  = { GR_UNIT_LITER,      10,   GR_UNIT_MILLILITER, 100,      FALSE },
+        [GR_UNIT_LITER]      = { GR_UNIT_UNKNOWN,    0,    GR_UNIT_MILLILITER, 1000,     FALSE },
+};
+
 void
 gr_convert_human_readable (double *amount, GrUnit *unit)
 {
         double amount1 = *amount;
         GrUnit unit1 = *unit;
-        gboolean unit_changed = TRUE;
-
-        while (unit_changed) {
-                switch (unit1) {
-                case GR_UNIT_GRAM:
-                        if (amount1 >= 1000) {
-                                amount1 = (amount1 / 1000);
-                                unit1 = GR_UNIT_KILOGRAM;
-                        }
-                        break;
-
-                case GR_UNIT_KILOGRAM:
-                        if (amount1 < 1) {
-                                amount1 = (amount1 * 1000);
-                                unit1 = GR_UNIT_GRAM;
-                        }
-                        break;
-
-                case GR_UNIT_POUND:
-                        if (amount1 < 1) {
-                                amount1 = (amount1 * 16);
-                                unit1 = GR_UNIT_OUNCE;
-                        }
-                        break;
 
-                case GR_UNIT_OUNCE:
-                        if (amount1 >= 16) {
-                                amount1 = (amount1 / 16);
-                                unit1 = GR_UNIT_POUND;
-                        }
-                        break;
-
-                case GR_UNIT_TEASPOON:
-                        if (amount1 >= 3) {
-                                amount1 = (amount1 / 3);
-                                unit1 = GR_UNIT_TABLESPOON;
-                        }
-                        break;
-
-                case GR_UNIT_TABLESPOON:
-                        if (amount1 >= 16) {
-                                amount1 = (amount1 / 16);
-                                unit1 = GR_UNIT_CUP;
-                        }
-                        else if ((amount1 < 1) && (amount1 > 0)) {
-                                amount1 = (amount1 * 3);
-                                unit1 = GR_UNIT_TEASPOON;
-                        }
-                        break;
-
-                case GR_UNIT_CUP:
-                        if (amount1 >= 4) {
-                                amount1 = (amount1 / 4);
-                                unit1 = GR_UNIT_QUART;
-                        }
-                        else if (amount1 < 1) {
-                                amount1 = amount1 / 16;
-                                unit1 = GR_UNIT_TABLESPOON;
-                        }
-                        break;
-
-                case GR_UNIT_MILLILITER:
-                        if (amount1 >= 1000) {
-                                amount1 = amount1 / 1000;
-                                unit1 = GR_UNIT_LITER;
-                        }
-                        break;
-
-                case GR_UNIT_DECILITER:
-                        if (amount1 < 1) {
-                                amount1 = amount1 * 100;
-                                unit1 = GR_UNIT_MILLILITER;
-                        }
-                        else if (amount1 >= 10) {
-                                amount1 = amount1 / 10;
-                                unit1 = GR_UNIT_LITER;
-                        }
-                        break;
-
-                case GR_UNIT_LITER:
-                        if (amount1 < 1) {
-                                amount1 = amount1 * 1000;
-                                unit1 = GR_UNIT_MILLILITER;
-                        }
-                        break;
+        while (unit1 >= 0 && unit1 <= GR_LAST_UNIT) {
+                const Readable *r = &readable[unit1];
 
-                default: ;
+                if (r->larger != GR_UNIT_UNKNOWN && amount1 >= r->larger_at) {
+                        amount1 = amount1 / r->larger_at;
+                        unit1 = r->larger;
                 }
-
-                if (*unit == unit1) {
-                        unit_changed = FALSE;
+                else if (r->smaller != GR_UNIT_UNKNOWN && amount1 < 1 &&
+                         (amount1 > 0 || !r->smaller_if_positive)) {
+                        amount1 = amount1 * r->smaller_factor;
+                        unit1 = r->smaller;
                 }
-
-                *amount = amount1;
-                *unit = unit1;
+                else
+                        break;
         }
+
+        *amount = amount1;
+        *unit = unit1;
 }
 
 void
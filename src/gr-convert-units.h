@@ -47,6 +47,7 @@ void                gr_convert_temp                     (int *num, int *unit, in
 void                gr_convert_volume                   (double *amount, GrUnit *unit, GrPreferredUnit user_volume_unit);
 void                gr_convert_weight                   (double *amount, GrUnit *unit, GrPreferredUnit user_weight_unit);
 void                gr_convert_human_readable           (double *amount, GrUnit *unit);
+void                gr_convert_to_base_unit             (double *amount, GrUnit *unit);
 void                gr_convert_multiple_units           (double *amount1, GrUnit *unit1, double *amount2, GrUnit *unit2);
 void                gr_convert_format_for_display       (GString *s, double a1, GrUnit u1, double a2, GrUnit u2);
 void                gr_convert_format                   (GString *s, double amount, GrUnit unit);
@@ -28,7 +28,7 @@
 #include "gr-recipe-store.h"
 #include "gr-recipe.h"
 #include "gr-cuisine.h"
-#include "gr-recipe-tile.h"
+#include "gr-recipe-grid.h"
 #include "gr-utils.h"
 #include "gr-meal.h"
 #include "gr-list-page.h"
@@ -41,6 +41,7 @@ typedef struct
         GtkWidget *item;
         GtkWidget *label;
         GtkWidget *box;
+        GListStore *model;
         gboolean filled;
 } Category;
 
@@ -48,7 +49,8 @@ struct _GrCuisinePage
 {
         GtkBox     parent_instance;
 
-        char *cuisine;
+        /* Interned, like the cuisine of recipes */
+        const char *cuisine;
 
         GtkWidget *sidebar;
         GtkWidget *scrolled_window;
@@ -60,6 +62,8 @@ struct _GrCuisinePage
         int n_categories;
         Category *categories;
         Category *other;
+
+        GCompareDataFunc sort_func;
 };
 
 G_DEFINE_TYPE (GrCuisinePage, gr_cuisine_page, GTK_TYPE_BOX)
@@ -111,68 +115,47 @@ static void
 cuisine_page_finalize (GObject *object)
 {
         GrCuisinePage *self = GR_CUISINE_PAGE (object);
+        int i;
 
-        g_clear_pointer (&self->cuisine, g_free);
+        for (i = 0; i < self->n_categories; i++)
+                g_clear_object (&self->categories[i].model);
         g_clear_pointer (&self->categories, g_free);
 
         G_OBJECT_CLASS (gr_cuisine_page_parent_class)->finalize (object);
 }
 
-static int
-name_sort_func (GtkFlowBoxChild *child1,
-                GtkFlowBoxChild *child2,
-                 gpointer         data)
-{
-        GtkWidget *tile1 = gtk_bin_get_child (GTK_BIN (child1));
-        GtkWidget *tile2 = gtk_bin_get_child (GTK_BIN (child2));
-        GrRecipe *recipe1 = gr_recipe_tile_get_recipe (GR_RECIPE_TILE (tile1));
-        GrRecipe *recipe2 = gr_recipe_tile_get_recipe (GR_RECIPE_TILE (tile2));
-        const char *name1 = gr_recipe_get_name (recipe1);
-        const char *name2 = gr_recipe_get_name (recipe2);
-
-        return strcmp (name1, name2);
-}
-
-static int
-date_sort_func (GtkFlowBoxChild *child1,
-                GtkFlowBoxChild *child2,
-                gpointer         data)
-{
-        GtkWidget *tile1 = gtk_bin_get_child (GTK_BIN (child1));
-        GtkWidget *tile2 = gtk_bin_get_child (GTK_BIN (child2));
-        GrRecipe *recipe1 = gr_recipe_tile_get_recipe (GR_RECIPE_TILE (tile1));
-        GrRecipe *recipe2 = gr_recipe_tile_get_recipe (GR_RECIPE_TILE (tile2));
-        GDateTime *mtime1 = gr_recipe_get_mtime (recipe1);
-        GDateTime *mtime2 = gr_recipe_get_mtime (recipe2);
-
-        return g_date_time_compare (mtime2, mtime1);
-}
-
-static void
-set_sort (GtkFlowBox *box,
-          GrSortKey   sort)
+static GCompareDataFunc
+get_sort_func (GrSortKey sort)
 {
         switch (sort) {
         case SORT_BY_NAME:
-                gtk_flow_box_set_sort_func (box, name_sort_func, NULL, NULL);
-                break;
+                return gr_recipe_compare_by_name;
         case SORT_BY_RECENCY:
-                gtk_flow_box_set_sort_func (box, date_sort_func, NULL, NULL);
-                break;
+                return gr_recipe_compare_by_mtime;
         default:
                 g_assert_not_reached ();
         }
+
+        return gr_recipe_compare_by_name;
 }
 
 static void
-sort_key_changed (GtkFlowBox *box)
+sort_key_changed (GrCuisinePage *page)
 {
-        if (!gtk_widget_get_visible (gtk_widget_get_ancestor (GTK_WIDGET (box), GR_TYPE_CUISINE_PAGE)))
+        GCompareDataFunc sort_func;
+        int i;
+
+        if (!gtk_widget_get_visible (GTK_WIDGET (page)))
                 return;
 
-        set_sort (box, g_settings_get_enum (gr_settings_get (), "sort-key"));
-}
+        sort_func = get_sort_func (g_settings_get_enum (gr_settings_get (), "sort-key"));
+        if (sort_func == page->sort_func)
+                return;
 
+        page->sort_func = sort_func;
+        for (i = 0; i < page->n_categories; i++)
+                g_list_store_sort (page->categories[i].model, page->sort_func, NULL);
+}
 
 static void
 populate_initially (GrCuisinePage *self)
@@ -186,9 +169,11 @@ populate_initially (GrCuisinePage *self)
 
         self->n_categories = length;
         self->categories = g_new (Category, length);
+        self->sort_func = get_sort_func (g_settings_get_enum (gr_settings_get (), "sort-key"));
 
         for (i = 0; i < length; i++) {
                 GtkWidget *item, *label, *box;
+                GListStore *model;
 
                 title = gr_meal_get_title (names[i]);
 
@@ -204,27 +189,22 @@ populate_initially (GrCuisinePage *self)
                 gtk_widget_show (label);
                 gtk_container_add (GTK_CONTAINER (self->category_box), label);
 
-                box = gtk_flow_box_new ();
-                gtk_flow_box_set_homogeneous (GTK_FLOW_BOX (box), TRUE);
-                gtk_flow_box_set_row_spacing (GTK_FLOW_BOX (box), 20);
-                gtk_flow_box_set_column_spacing (GTK_FLOW_BOX (box), 20);
-                gtk_flow_box_set_min_children_per_line (GTK_FLOW_BOX (box), 3);
-                gtk_flow_box_set_max_children_per_line (GTK_FLOW_BOX (box), 3);
+                model = g_list_store_new (GR_TYPE_RECIPE);
+
+                box = gr_recipe_grid_new ();
+                gr_recipe_grid_set_model (GR_RECIPE_GRID (box), G_LIST_MODEL (model));
                 gtk_widget_show (box);
                 gtk_container_add (GTK_CONTAINER (self->category_box), box);
 
-                g_signal_connect_swapped (gr_settings_get (), "changed::sort-key", G_CALLBACK (sort_key_changed), box);
-                g_signal_connect_swapped (self, "notify::visible", G_CALLBACK (sort_key_changed), box);
-
-
-                self->categories[i].name = names[i];
+                self->categories[i].name = g_intern_static_string (names[i]);
                 self->categories[i].item = item;
                 self->categories[i].label = label;
                 self->categories[i].box = box;
+                self->categories[i].model = model;
 
                 g_object_set_data (G_OBJECT (item), "category", &self->categories[i]);
 
-                if (strcmp (names[i], "other") == 0)
+                if (self->categories[i].name == g_intern_static_string ("other"))
                         self->other = &self->categories[i];
         }
 }
@@ -253,6 +233,9 @@ gr_cuisine_page_init (GrCuisinePage *page)
         populate_initially (page);
         connect_store_signals (page);
 
+        g_signal_connect_swapped (gr_settings_get (), "changed::sort-key", G_CALLBACK (sort_key_changed), page);
+        g_signal_connect (page, "notify::visible", G_CALLBACK (sort_key_changed), NULL);
+
         gtk_list_box_set_filter_func (GTK_LIST_BOX (page->sidebar), filter_sidebar, page, NULL);
 }
 
@@ -285,6 +268,31 @@ gr_cuisine_page_new (void)
         return GTK_WIDGET (page);
 }
 
+static void
+add_recipe (GrCuisinePage *self,
+            GrRecipe      *recipe)
+{
+        const char *category;
+        Category *c;
+        int i;
+
+        category = gr_recipe_get_category (recipe);
+
+        c = self->other;
+        for (i = 0; i < self->n_categories; i++) {
+                if (self->categories[i].name == category) {
+                        c = &self->categories[i];
+                        break;
+                }
+        }
+
+        gtk_widget_show (c->label);
+        gtk_widget_show (c->box);
+        c->filled = TRUE;
+
+        g_list_store_insert_sorted (c->model, recipe, self->sort_func, NULL);
+}
+
 void
 gr_cuisine_page_set_cuisine (GrCuisinePage *self,
                              const char    *cuisine)
@@ -297,17 +305,14 @@ gr_cuisine_page_set_cuisine (GrCuisinePage *self,
         const char *description;
         GtkAdjustment *adj;
 
-        if (self->cuisine != cuisine) {
-                g_free (self->cuisine);
-                self->cuisine = g_strdup (cuisine);
-        }
+        self->cuisine = g_intern_string (cuisine);
 
         gr_cuisine_get_data (cuisine, NULL, NULL, &description);
         gtk_label_set_label (GTK_LABEL (self->cuisine_label), description);
         gtk_widget_set_visible (self->cuisine_label, description != NULL);
 
         for (i = 0; i < self->n_categories; i++) {
-                container_remove_all (GTK_CONTAINER (self->categories[i].box));
+                g_list_store_remove_all (self->categories[i].model);
                 gtk_widget_hide (self->categories[i].label);
                 gtk_widget_hide (self->categories[i].box);
                 self->categories[i].filled = FALSE;
@@ -318,34 +323,12 @@ gr_cuisine_page_set_cuisine (GrCuisinePage *self,
         keys = gr_recipe_store_get_recipe_keys (store, &length);
         for (j = 0; j < length; j++) {
                 g_autoptr(GrRecipe) recipe = NULL;
-                const char *cuisine2;
-                const char *category;
-                GtkWidget *tile;
-                Category *c;
 
                 recipe = gr_recipe_store_get_recipe (store, keys[j]);
-                cuisine2 = gr_recipe_get_cuisine (recipe);
-                category = gr_recipe_get_category (recipe);
-
-                if (g_strcmp0 (cuisine, cuisine2) != 0)
+                if (gr_recipe_get_cuisine (recipe) != self->cuisine)
                         continue;
 
-                c = self->other;
-                for (i = 0; i < self->n_categories; i++) {
-                        if (strcmp (self->categories[i].name, category) == 0) {
-                                c = &self->categories[i];
-                                break;
-                        }
-                }
-
-                gtk_widget_show (c->label);
-                gtk_widget_show (c->box);
-                c->filled = TRUE;
-
-                tile = gr_recipe_tile_new (recipe);
-                gtk_widget_show (tile);
-                gtk_container_add (GTK_CONTAINER (c->box), tile);
-
+                add_recipe (self, recipe);
                 has_recipe = TRUE;
         }
 
@@ -373,6 +356,78 @@ cuisine_page_reload (GrCuisinePage *page)
                 gr_cuisine_page_set_cuisine (page, page->cuisine);
 }
 
+static gboolean
+remove_recipe (GrCuisinePage *self,
+               GrRecipe      *recipe)
+{
+        int i;
+        guint j, n_items;
+
+        /* The category may have changed, so look everywhere */
+        for (i = 0; i < self->n_categories; i++) {
+                GListModel *model = G_LIST_MODEL (self->categories[i].model);
+
+                n_items = g_list_model_get_n_items (model);
+                for (j = 0; j < n_items; j++) {
+                        g_autoptr(GrRecipe) item = NULL;
+
+                        item = g_list_model_get_item (model, j);
+                        if (item == recipe) {
+                                g_list_store_remove (self->categories[i].model, j);
+                                return TRUE;
+                        }
+                }
+        }
+
+        return FALSE;
+}
+
+static void
+recipes_updated (GrRecipeStore *store,
+                 GPtrArray     *added,
+                 GPtrArray     *changed,
+                 GPtrArray     *removed,
+                 GrCuisinePage *page)
+{
+        gboolean has_recipe;
+        guint i;
+        int j;
+
+        if (page->cuisine == NULL)
+                return;
+
+        for (i = 0; i < removed->len; i++)
+                remove_recipe (page, g_ptr_array_index (removed, i));
+
+        for (i = 0; i < changed->len; i++) {
+                GrRecipe *recipe = g_ptr_array_index (changed, i);
+
+                remove_recipe (page, recipe);
+                if (gr_recipe_get_cuisine (recipe) == page->cuisine)
+                        add_recipe (page, recipe);
+        }
+
+        for (i = 0; i < added->len; i++) {
+                GrRecipe *recipe = g_ptr_array_index (added, i);
+
+                if (gr_recipe_get_cuisine (recipe) == page->cuisine)
+                        add_recipe (page, recipe);
+        }
+
+        has_recipe = FALSE;
+        for (j = 0; j < page->n_categories; j++) {
+                Category *c = &page->categories[j];
+
+                c->filled = g_list_model_get_n_items (G_LIST_MODEL (c->model)) > 0;
+                gtk_widget_set_visible (c->label, c->filled);
+                gtk_widget_set_visible (c->box, c->filled);
+                has_recipe |= c->filled;
+        }
+
+        gtk_stack_set_visible_child_name (GTK_STACK (page->stack), has_recipe ? "cuisine" : "empty");
+        gtk_list_box_invalidate_filter (GTK_LIST_BOX (page->sidebar));
+}
+
 static void
 connect_store_signals (GrCuisinePage *page)
 {
@@ -381,6 +436,8 @@ connect_store_signals (GrCuisinePage *page)
         store = gr_recipe_store_get ();
 
         g_signal_connect_swapped (store, "recipe-added", G_CALLBACK (cuisine_page_reload), page);
+        g_signal_connect_swapped (store, "recipes-added", G_CALLBACK (cuisine_page_reload), page);
         g_signal_connect_swapped (store, "recipe-removed", G_CALLBACK (cuisine_page_reload), page);
         g_signal_connect_swapped (store, "recipe-changed", G_CALLBACK (cuisine_page_reload), page);
+        g_signal_connect (store, "recipes-updated", G_CALLBACK (recipes_updated), page);
 }
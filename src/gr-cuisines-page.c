@@ -48,6 +48,7 @@ struct _GrCuisinesPage
         GtkWidget *seasonal_expander_image;
 
         char *featured;
+        GHashTable *shown;
 };
 
 G_DEFINE_TYPE (GrCuisinesPage, gr_cuisines_page, GTK_TYPE_BOX)
@@ -58,6 +59,7 @@ cuisines_page_finalize (GObject *object)
         GrCuisinesPage *page = GR_CUISINES_PAGE (object);
 
         g_clear_pointer (&page->featured, g_free);
+        g_clear_pointer (&page->shown, g_hash_table_unref);
 
         G_OBJECT_CLASS (gr_cuisines_page_parent_class)->finalize (object);
 }
@@ -145,14 +147,14 @@ populate_cuisines (GrCuisinesPage *page)
         int i, j;
         GrRecipeStore *store;
         int tiles;
-        g_autoptr(GHashTable) seen = NULL;
         g_autofree char **names = NULL;
         guint len;
 
         container_remove_all (GTK_CONTAINER (page->cuisines_box));
         container_remove_all (GTK_CONTAINER (page->cuisines_box2));
 
-        seen = g_hash_table_new (g_str_hash, g_str_equal);
+        g_clear_pointer (&page->shown, g_hash_table_unref);
+        page->shown = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 
         store = gr_recipe_store_get ();
 
@@ -185,7 +187,7 @@ populate_cuisines (GrCuisinesPage *page)
         gtk_widget_show (tile);
         gtk_widget_set_halign (tile, GTK_ALIGN_FILL);
         gtk_grid_attach (GTK_GRID (page->cuisines_box), tile, 0, 0, 2, 1);
-        g_hash_table_add (seen, page->featured);
+        g_hash_table_add (page->shown, g_strdup (page->featured));
 
         tiles = 0;
         for (i = 0; i < length; i++) {
@@ -209,7 +211,7 @@ populate_cuisines (GrCuisinesPage *page)
                 }
                 tiles++;
 
-                g_hash_table_add (seen, cuisines[i]);
+                g_hash_table_add (page->shown, g_strdup (cuisines[i]));
         }
 
         names = gr_recipe_store_get_all_cuisines (store, &len);
@@ -221,9 +223,11 @@ populate_cuisines (GrCuisinesPage *page)
                 if (strcmp (tmp, "") == 0)
                         continue;
 
-                if (g_hash_table_contains (seen, tmp))
+                if (g_hash_table_contains (page->shown, tmp))
                         continue;
 
+                g_hash_table_add (page->shown, g_strdup (tmp));
+
                 gr_cuisine_get_data (tmp, &title, NULL, NULL);
 
                 tile = gr_category_tile_new_with_label (tmp, title);
@@ -331,6 +335,57 @@ cuisines_page_reload (GrCuisinesPage *page)
                 gr_cuisines_page_refresh (page);
 }
 
+/* Returns TRUE if one of the recipes has a cuisine that
+ * came or went since we populated the page.
+ */
+static gboolean
+cuisines_differ (GrCuisinesPage *page,
+                 GHashTable     *checked,
+                 GPtrArray      *recipes)
+{
+        GrRecipeStore *store;
+        guint i;
+
+        store = gr_recipe_store_get ();
+
+        for (i = 0; i < recipes->len; i++) {
+                const char *cuisine;
+
+                cuisine = gr_recipe_get_cuisine (g_ptr_array_index (recipes, i));
+                if (cuisine == NULL || cuisine[0] == '\0')
+                        continue;
+
+                if (!g_hash_table_add (checked, (gpointer)cuisine))
+                        continue;
+
+                if (g_hash_table_contains (page->shown, cuisine) !=
+                    gr_recipe_store_has_cuisine (store, cuisine))
+                        return TRUE;
+        }
+
+        return FALSE;
+}
+
+static void
+recipes_updated (GrRecipeStore  *store,
+                 GPtrArray      *added,
+                 GPtrArray      *changed,
+                 GPtrArray      *removed,
+                 GrCuisinesPage *page)
+{
+        g_autoptr(GHashTable) checked = NULL;
+
+        if (page->shown == NULL)
+                return;
+
+        checked = g_hash_table_new (g_str_hash, g_str_equal);
+
+        if (cuisines_differ (page, checked, added) ||
+            cuisines_differ (page, checked, changed) ||
+            cuisines_differ (page, checked, removed))
+                gr_cuisines_page_refresh (page);
+}
+
 static void
 connect_store_signals (GrCuisinesPage *page)
 {
@@ -339,7 +394,9 @@ connect_store_signals (GrCuisinesPage *page)
         store = gr_recipe_store_get ();
 
         g_signal_connect_swapped (store, "recipe-added", G_CALLBACK (cuisines_page_reload), page);
+        g_signal_connect_swapped (store, "recipes-added", G_CALLBACK (cuisines_page_reload), page);
         g_signal_connect_swapped (store, "recipe-removed", G_CALLBACK (cuisines_page_reload), page);
         g_signal_connect_swapped (store, "recipe-changed", G_CALLBACK (cuisines_page_reload), page);
+        g_signal_connect (store, "recipes-updated", G_CALLBACK (recipes_updated), page);
         g_signal_connect_swapped (store, "reloaded", G_CALLBACK (gr_cuisines_page_refresh), page);
 }
@@ -0,0 +1,586 @@
+/* gr-data-update.c
+ *
+ * Copyright (C) 2017 Matthias Clasen <mclasen@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+
+#include "gr-data-update.h"
+#include "gr-utils.h"
+
+/* Incremental updates of the downloaded data
+ * ------------------------------------------
+ *
+ * Next to data.tar.gz, the server has a manifest listing the files of
+ * the unpacked bundle, each with its checksum and size:
+ *
+ * [Manifest]
+ * Version=1
+ *
+ * [recipes.db]
+ * Checksum=<hex SHA-256 of the contents>
+ * Size=<length in bytes>
+ *
+ * and each file is also available on its own, at its path relative to
+ * the base URL. We fetch the manifest, and then only the files whose
+ * checksum differs from what we have. Files that are no longer listed
+ * are removed. The manifest is kept next to the files, and its
+ * timestamp is used for the If-Modified-Since of the next update.
+ *
+ * Files are streamed into a staging directory next to the target,
+ * hashing them as they arrive. Only when all of them have arrived
+ * and match the manifest are they moved into place, so a failed
+ * update leaves the previous data alone.
+ *
+ * If the server has no manifest, this fails with
+ * G_IO_ERROR_NOT_SUPPORTED, and the caller should fetch the bundle.
+ */
+
+#define MANIFEST_NAME "manifest"
+#define MANIFEST_GROUP "Manifest"
+#define MANIFEST_VERSION 1
+#define FETCH_CHUNK_SIZE (64 * 1024)
+
+typedef struct {
+        SoupSession *session;
+        char *base_url;
+        char *dir;
+        char *staging;
+        GPtrArray *staged;
+        GKeyFile *old_manifest;
+        GKeyFile *manifest;
+        GBytes *manifest_data;
+        guint pending;
+        guint n_changed;
+        GError *error;
+} Update;
+
+static void
+update_free (gpointer data)
+{
+        Update *update = data;
+
+        g_object_unref (update->session);
+        g_free (update->base_url);
+        g_free (update->dir);
+        g_free (update->staging);
+        g_ptr_array_unref (update->staged);
+        g_key_file_unref (update->old_manifest);
+        g_clear_pointer (&update->manifest, g_key_file_unref);
+        g_clear_pointer (&update->manifest_data, g_bytes_unref);
+        g_clear_error (&update->error);
+        g_free (update);
+}
+
+static char *
+get_manifest_path (Update *update)
+{
+        return g_build_filename (update->dir, MANIFEST_NAME, NULL);
+}
+
+static void
+set_modified_since (SoupMessage *msg,
+                    const char  *path)
+{
+        GStatBuf buf;
+        SoupDate *date;
+        g_autofree char *value = NULL;
+
+        if (g_stat (path, &buf) != 0)
+                return;
+
+        date = soup_date_new_from_time_t (buf.st_mtime);
+        value = soup_date_to_string (date, SOUP_DATE_HTTP);
+        soup_message_headers_append (msg->request_headers, "If-Modified-Since", value);
+        soup_date_free (date);
+}
+
+static void
+remove_tree (const char *path)
+{
+        if (g_file_test (path, G_FILE_TEST_IS_DIR)) {
+                g_autoptr(GDir) dir = NULL;
+                const char *name;
+
+                dir = g_dir_open (path, 0, NULL);
+                while (dir && (name = g_dir_read_name (dir)) != NULL) {
+                        g_autofree char *child = g_build_filename (path, name, NULL);
+                        remove_tree (child);
+                }
+                g_rmdir (path);
+        }
+        else {
+                g_unlink (path);
+        }
+}
+
+static gboolean
+write_file (const char  *dir,
+            const char  *name,
+            const char  *data,
+            gsize        length,
+            GError     **error)
+{
+        g_autofree char *path = NULL;
+        g_autofree char *parent = NULL;
+
+        path = g_build_filename (dir, name, NULL);
+        parent = g_path_get_dirname (path);
+        g_mkdir_with_parents (parent, 0755);
+
+        return g_file_set_contents (path, data, length, error);
+}
+
+static gboolean
+move_file (const char  *from_dir,
+           const char  *to_dir,
+           const char  *name,
+           GError     **error)
+{
+        g_autofree char *from = NULL;
+        g_autofree char *to = NULL;
+        g_autofree char *parent = NULL;
+
+        from = g_build_filename (from_dir, name, NULL);
+        to = g_build_filename (to_dir, name, NULL);
+        parent = g_path_get_dirname (to);
+        g_mkdir_with_parents (parent, 0755);
+
+        if (g_rename (from, to) != 0) {
+                int errsv = errno;
+
+                g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                             _("Failed to move %s into place: %s"), name, g_strerror (errsv));
+                return FALSE;
+        }
+
+        return TRUE;
+}
+
+static void
+finish_update (GTask *task)
+{
+        Update *update = g_task_get_task_data (task);
+        g_auto(GStrv) old_files = NULL;
+        GError *error = NULL;
+        int i;
+
+        if (update->error) {
+                remove_tree (update->staging);
+                g_task_return_error (task, g_steal_pointer (&update->error));
+                return;
+        }
+
+        if (g_task_return_error_if_cancelled (task)) {
+                remove_tree (update->staging);
+                return;
+        }
+
+        /* Everything arrived and matches, swap it in */
+        for (i = 0; i < update->staged->len; i++) {
+                const char *name = g_ptr_array_index (update->staged, i);
+
+                if (!move_file (update->staging, update->dir, name, &error)) {
+                        remove_tree (update->staging);
+                        g_task_return_error (task, error);
+                        return;
+                }
+
+                update->n_changed++;
+        }
+
+        remove_tree (update->staging);
+
+        old_files = g_key_file_get_groups (update->old_manifest, NULL);
+        for (i = 0; old_files[i]; i++) {
+                g_autofree char *name = NULL;
+                g_autofree char *path = NULL;
+
+                if (strcmp (old_files[i], MANIFEST_GROUP) == 0 ||
+                    g_key_file_has_group (update->manifest, old_files[i]))
+                        continue;
+
+                name = sanitize_relative_path (old_files[i]);
+                if (!name)
+                        continue;
+
+                g_debug ("Removing %s", name);
+                path = g_build_filename (update->dir, name, NULL);
+                if (g_remove (path) == 0)
+                        update->n_changed++;
+        }
+
+        /* Only now, so an interrupted update is picked up again */
+        if (!write_file (update->dir, MANIFEST_NAME,
+                         g_bytes_get_data (update->manifest_data, NULL),
+                         g_bytes_get_size (update->manifest_data),
+                         &error)) {
+                g_task_return_error (task, error);
+                return;
+        }
+
+        g_task_return_boolean (task, TRUE);
+}
+
+typedef struct {
+        GTask *task;
+        char *name;
+        char *checksum;
+        guint64 size;
+        guint64 received;
+        GChecksum *hash;
+        SoupMessage *msg;
+        GInputStream *input;
+        GOutputStream *output;
+} Fetch;
+
+static void
+fetch_free (Fetch *fetch)
+{
+        g_object_unref (fetch->task);
+        g_free (fetch->name);
+        g_free (fetch->checksum);
+        g_checksum_free (fetch->hash);
+        g_object_unref (fetch->msg);
+        g_clear_object (&fetch->input);
+        g_clear_object (&fetch->output);
+        g_free (fetch);
+}
+
+/* Takes ownership of @error */
+static void
+fetch_done (Fetch  *fetch,
+            GError *error)
+{
+        Update *update = g_task_get_task_data (fetch->task);
+
+        if (fetch->output)
+                g_output_stream_close (fetch->output, NULL, NULL);
+
+        if (error) {
+                if (update->error == NULL)
+                        update->error = error;
+                else
+                        g_error_free (error);
+        }
+        else {
+                g_ptr_array_add (update->staged, g_strdup (fetch->name));
+        }
+
+        update->pending--;
+        if (update->pending == 0)
+                finish_update (fetch->task);
+
+        fetch_free (fetch);
+}
+
+static void
+file_read (GObject      *source,
+           GAsyncResult *result,
+           gpointer      data)
+{
+        Fetch *fetch = data;
+        Update *update = g_task_get_task_data (fetch->task);
+        g_autoptr(GBytes) bytes = NULL;
+        GError *error = NULL;
+        const guchar *chunk;
+        gsize length;
+
+        bytes = g_input_stream_read_bytes_finish (G_INPUT_STREAM (source), result, &error);
+        if (bytes == NULL) {
+                fetch_done (fetch, error);
+                return;
+        }
+
+        /* Another file already failed, no point in going on */
+        if (update->error) {
+                fetch_done (fetch, NULL);
+                return;
+        }
+
+        chunk = g_bytes_get_data (bytes, &length);
+        if (length == 0) {
+                if (fetch->received != fetch->size ||
+                    strcmp (g_checksum_get_string (fetch->hash), fetch->checksum) != 0)
+                        error = g_error_new (G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                                             _("Checksum mismatch for %s"), fetch->name);
+                fetch_done (fetch, error);
+                return;
+        }
+
+        fetch->received += length;
+        if (fetch->received > fetch->size) {
+                fetch_done (fetch, g_error_new (G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                                                _("Checksum mismatch for %s"), fetch->name));
+                return;
+        }
+
+        g_checksum_update (fetch->hash, chunk, length);
+        if (!g_output_stream_write_all (fetch->output, chunk, length, NULL,
+                                        g_task_get_cancellable (fetch->task), &error)) {
+                fetch_done (fetch, error);
+                return;
+        }
+
+        g_input_stream_read_bytes_async (fetch->input,
+                                         FETCH_CHUNK_SIZE,
+                                         G_PRIORITY_LOW,
+                                         g_task_get_cancellable (fetch->task),
+                                         file_read,
+                                         fetch);
+}
+
+static void
+file_sent (GObject      *source,
+           GAsyncResult *result,
+           gpointer      data)
+{
+        Fetch *fetch = data;
+        Update *update = g_task_get_task_data (fetch->task);
+        g_autofree char *path = NULL;
+        g_autofree char *parent = NULL;
+        g_autoptr(GFile) file = NULL;
+        GError *error = NULL;
+
+        fetch->input = soup_session_send_finish (SOUP_SESSION (source), result, &error);
+        if (fetch->input == NULL) {
+                fetch_done (fetch, error);
+                return;
+        }
+
+        if (!SOUP_STATUS_IS_SUCCESSFUL (fetch->msg->status_code)) {
+                fetch_done (fetch, g_error_new (G_IO_ERROR, G_IO_ERROR_FAILED,
+                                                _("Failed to load %s: %s"),
+                                                fetch->name, fetch->msg->reason_phrase));
+                return;
+        }
+
+        path = g_build_filename (update->staging, fetch->name, NULL);
+        parent = g_path_get_dirname (path);
+        g_mkdir_with_parents (parent, 0755);
+
+        file = g_file_new_for_path (path);
+        fetch->output = G_OUTPUT_STREAM (g_file_replace (file, NULL, FALSE,
+                                                         G_FILE_CREATE_REPLACE_DESTINATION,
+                                                         g_task_get_cancellable (fetch->task),
+                                                         &error));
+        if (fetch->output == NULL) {
+                fetch_done (fetch, error);
+                return;
+        }
+
+        g_input_stream_read_bytes_async (fetch->input,
+                                         FETCH_CHUNK_SIZE,
+                                         G_PRIORITY_LOW,
+                                         g_task_get_cancellable (fetch->task),
+                                         file_read,
+                                         fetch);
+}
+
+/* We trust that files listed with the same checksum in the previous
+ * manifest are unchanged. Other files are hashed, so an update that
+ * was interrupted, or data that came from the bundle, does not cause
+ * everything to be fetched again.
+ */
+static gboolean
+needs_fetch (Update     *update,
+             const char *group,
+             const char *name,
+             const char *checksum)
+{
+        g_autofree char *old_checksum = NULL;
+        g_autofree char *local_checksum = NULL;
+        g_autofree char *path = NULL;
+
+        path = g_build_filename (update->dir, name, NULL);
+        if (!g_file_test (path, G_FILE_TEST_IS_REGULAR))
+                return TRUE;
+
+        old_checksum = g_key_file_get_string (update->old_manifest, group, "Checksum", NULL);
+        if (g_strcmp0 (old_checksum, checksum) == 0)
+                return FALSE;
+
+        local_checksum = get_file_checksum (path, NULL);
+
+        return g_strcmp0 (local_checksum, checksum) != 0;
+}
+
+static void
+manifest_fetched (SoupSession *session,
+                  SoupMessage *msg,
+                  gpointer     data)
+{
+        g_autoptr(GTask) task = data;
+        Update *update = g_task_get_task_data (task);
+        g_auto(GStrv) files = NULL;
+        GError *error = NULL;
+        int i;
+
+        if (g_task_return_error_if_cancelled (task))
+                return;
+
+        if (msg->status_code == SOUP_STATUS_NOT_MODIFIED) {
+                g_autofree char *path = get_manifest_path (update);
+
+                g_debug ("Manifest not modified");
+                g_utime (path, NULL);
+                g_task_return_boolean (task, TRUE);
+                return;
+        }
+
+        if (msg->status_code == SOUP_STATUS_NOT_FOUND) {
+                g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                                         _("No manifest available"));
+                return;
+        }
+
+        if (!SOUP_STATUS_IS_SUCCESSFUL (msg->status_code)) {
+                g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_FAILED,
+                                         _("Failed to load manifest: %s"), msg->reason_phrase);
+                return;
+        }
+
+        update->manifest_data = g_bytes_new (msg->response_body->data, msg->response_body->length);
+        update->manifest = g_key_file_new ();
+        if (!g_key_file_load_from_bytes (update->manifest, update->manifest_data, G_KEY_FILE_NONE, &error)) {
+                g_task_return_error (task, error);
+                return;
+        }
+
+        if (g_key_file_get_integer (update->manifest, MANIFEST_GROUP, "Version", NULL) != MANIFEST_VERSION) {
+                g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                                         _("Unsupported manifest version"));
+                return;
+        }
+
+        /* Keeps the task alive while the files are fetched */
+        update->pending = 1;
+
+        files = g_key_file_get_groups (update->manifest, NULL);
+        for (i = 0; files[i]; i++) {
+                g_autofree char *name = NULL;
+                g_autofree char *checksum = NULL;
+                g_autofree char *url = NULL;
+                SoupMessage *file_msg;
+                Fetch *fetch;
+
+                if (strcmp (files[i], MANIFEST_GROUP) == 0)
+                        continue;
+
+                name = sanitize_relative_path (files[i]);
+                checksum = g_key_file_get_string (update->manifest, files[i], "Checksum", NULL);
+                if (name == NULL || checksum == NULL || strcmp (name, MANIFEST_NAME) == 0) {
+                        g_warning ("Ignoring manifest entry %s", files[i]);
+                        continue;
+                }
+
+                if (!needs_fetch (update, files[i], name, checksum))
+                        continue;
+
+                url = g_strconcat (update->base_url, "/", name, NULL);
+                file_msg = soup_message_new (SOUP_METHOD_GET, url);
+                if (file_msg == NULL) {
+                        g_warning ("Ignoring manifest entry %s", files[i]);
+                        continue;
+                }
+
+                g_debug ("Fetching %s", url);
+
+                fetch = g_new0 (Fetch, 1);
+                fetch->task = g_object_ref (task);
+                fetch->name = g_steal_pointer (&name);
+                fetch->checksum = g_steal_pointer (&checksum);
+                fetch->size = g_key_file_get_uint64 (update->manifest, files[i], "Size", NULL);
+                fetch->hash = g_checksum_new (G_CHECKSUM_SHA256);
+                fetch->msg = file_msg;
+
+                update->pending++;
+                soup_session_send_async (session, file_msg,
+                                         g_task_get_cancellable (task),
+                                         file_sent, fetch);
+        }
+
+        update->pending--;
+        if (update->pending == 0)
+                finish_update (task);
+}
+
+void
+gr_data_update_async (SoupSession         *session,
+                      const char          *base_url,
+                      const char          *dir,
+                      GCancellable        *cancellable,
+                      GAsyncReadyCallback  callback,
+                      gpointer             data)
+{
+        g_autoptr(GTask) task = NULL;
+        g_autofree char *url = NULL;
+        g_autofree char *path = NULL;
+        SoupMessage *msg;
+        Update *update;
+
+        task = g_task_new (NULL, cancellable, callback, data);
+
+        update = g_new0 (Update, 1);
+        update->session = g_object_ref (session);
+        update->base_url = g_strdup (base_url);
+        update->dir = g_strdup (dir);
+        update->staging = g_strconcat (dir, ".staging", NULL);
+        update->staged = g_ptr_array_new_with_free_func (g_free);
+        update->old_manifest = g_key_file_new ();
+        g_task_set_task_data (task, update, update_free);
+
+        /* Left over from an interrupted update */
+        remove_tree (update->staging);
+
+        path = get_manifest_path (update);
+        g_key_file_load_from_file (update->old_manifest, path, G_KEY_FILE_NONE, NULL);
+
+        url = g_strconcat (base_url, "/", MANIFEST_NAME, NULL);
+        msg = soup_message_new (SOUP_METHOD_GET, url);
+        if (msg == NULL) {
+                g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                                         _("Invalid URL: %s"), url);
+                return;
+        }
+
+        set_modified_since (msg, path);
+
+        g_debug ("Fetching %s", url);
+        soup_session_queue_message (session, msg, manifest_fetched, g_steal_pointer (&task));
+}
+
+gboolean
+gr_data_update_finish (GAsyncResult  *result,
+                       guint         *n_changed,
+                       GError       **error)
+{
+        GTask *task = G_TASK (result);
+        Update *update = g_task_get_task_data (task);
+
+        if (!g_task_propagate_boolean (task, error))
+                return FALSE;
+
+        *n_changed = update->n_changed;
+
+        return TRUE;
+}
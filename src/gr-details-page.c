@@ -53,7 +53,6 @@ struct _GrDetailsPage
         GrRecipe *recipe;
         GrChef *chef;
         GrIngredientsList *ingredients;
-        char *ing_text;
 
         GrRecipePrinter *printer;
         GrRecipeExporter *exporter;
@@ -178,6 +177,7 @@ gr_details_page_contribute_recipe (GrDetailsPage *page)
 }
 
 static void populate_ingredients (GrDetailsPage *page, double scale);
+static void rescale_ingredients (GrDetailsPage *page, double scale);
 
 static void
 update_yield_label (GrDetailsPage *page,
@@ -203,7 +203,7 @@ yield_spin_value_changed (GrDetailsPage *page)
         yield = gr_recipe_get_yield (page->recipe);
 
         update_yield_label (page, new_value);
-        populate_ingredients (page, new_value / yield);
+        rescale_ingredients (page, new_value / yield);
 }
 
 static int
@@ -281,7 +281,6 @@ details_page_finalize (GObject *object)
         g_clear_object (&self->ingredients);
         g_clear_object (&self->printer);
         g_clear_object (&self->exporter);
-        g_clear_pointer (&self->ing_text, g_free);
 
         G_OBJECT_CLASS (gr_details_page_parent_class)->finalize (object);
 }
@@ -501,7 +500,7 @@ populate_ingredients (GrDetailsPage *page,
                                      "editable-title", FALSE,
                                      "editable", FALSE,
                                      "scale", scale,
-                                     "ingredients", page->ing_text,
+                                     "ingredients-list", page->ingredients,
                                      NULL);
                 gtk_container_add (GTK_CONTAINER (page->ingredients_box), list);
         }
@@ -541,6 +540,21 @@ populate_ingredients (GrDetailsPage *page,
         }
 }
 
+static void
+rescale_ingredients (GrDetailsPage *page,
+                     double         scale)
+{
+        GList *children, *l;
+
+        children = gtk_container_get_children (GTK_CONTAINER (page->ingredients_box));
+        if (children == NULL)
+                populate_ingredients (page, scale);
+
+        for (l = children; l; l = l->next)
+                g_object_set (l->data, "scale", scale, NULL);
+        g_list_free (children);
+}
+
 static char *
 process_instructions (const char *instructions)
 {
@@ -611,13 +625,12 @@ gr_details_page_set_recipe (GrDetailsPage *page,
         const char *meal;
         const char *season;
         double yield;
-        const char *ingredients;
         const char *instructions;
         const char *notes;
         const char *description;
         GrRecipeStore *store;
         g_autoptr(GrChef) chef = NULL;
-        g_autoptr(GrIngredientsList) ing = NULL;
+        GrIngredientsList *ing;
         GPtrArray *images;
         gboolean favorite;
         int index;
@@ -634,7 +647,6 @@ gr_details_page_set_recipe (GrDetailsPage *page,
         cuisine = gr_recipe_get_cuisine (recipe);
         meal = gr_recipe_get_category (recipe);
         season = gr_recipe_get_season (recipe);
-        ingredients = gr_recipe_get_ingredients (recipe);
         notes = gr_recipe_get_translated_notes (recipe);
         instructions = gr_recipe_get_translated_instructions (recipe);
         description = gr_recipe_get_translated_description (recipe);
@@ -643,10 +655,8 @@ gr_details_page_set_recipe (GrDetailsPage *page,
         images = gr_recipe_get_images (recipe);
         gr_image_viewer_set_images (GR_IMAGE_VIEWER (page->recipe_image), images, index);
 
-        ing = gr_ingredients_list_new (ingredients);
+        ing = gr_recipe_get_ingredients_list (recipe);
         g_set_object (&page->ingredients, ing);
-        g_free (page->ing_text);
-        page->ing_text = g_strdup (ingredients);
 
         populate_ingredients (page, 1.0);
 
@@ -788,6 +798,19 @@ details_page_reload (GrDetailsPage *page,
                 gr_details_page_set_recipe (page, recipe);
 }
 
+static void
+recipes_updated (GrRecipeStore *store,
+                 GPtrArray     *added,
+                 GPtrArray     *changed,
+                 GPtrArray     *removed,
+                 GrDetailsPage *page)
+{
+        int i;
+
+        for (i = 0; i < changed->len; i++)
+                details_page_reload (page, g_ptr_array_index (changed, i));
+}
+
 static void
 connect_store_signals (GrDetailsPage *page)
 {
@@ -796,4 +819,5 @@ connect_store_signals (GrDetailsPage *page)
         store = gr_recipe_store_get ();
 
         g_signal_connect_swapped (store, "recipe-changed", G_CALLBACK (details_page_reload), page);
+        g_signal_connect (store, "recipes-updated", G_CALLBACK (recipes_updated), page);
 }
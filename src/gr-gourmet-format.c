@@ -17,7 +17,12 @@
  */
 
 #include "config.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 #include "gr-gourmet-format.h"
 #include "gr-recipe-store.h"
 #include "gr-recipe.h"
@@ -62,9 +67,49 @@ in_element (GMarkupParseContext *context,
         return result;
 }
 
+/* Gourmet exports can be hundreds of megabytes, mostly because of
+ * embedded images. We parse them in chunks on a thread. GMarkup hands
+ * out each text node in one piece, so image payloads are picked out of
+ * the byte stream before it sees them and decoded straight to disk,
+ * one chunk at a time. The recipes are collected and handed to the
+ * store in one go at the end, so that it saves and announces them
+ * only once.
+ */
+#define READ_CHUNK_SIZE 65536
+
 typedef struct {
-        GrRecipeStore *store;
-        GList *recipes;
+        char *title;
+        char *source;
+        char *instructions;
+        char *ingredients;
+        char *cuisine;
+        char *preptime;
+        char *cooktime;
+        char *yields;
+        char *modifications;
+        char *image_path;
+} ParsedRecipe;
+
+static void
+parsed_recipe_free (gpointer data)
+{
+        ParsedRecipe *recipe = data;
+
+        g_free (recipe->title);
+        g_free (recipe->source);
+        g_free (recipe->instructions);
+        g_free (recipe->ingredients);
+        g_free (recipe->cuisine);
+        g_free (recipe->preptime);
+        g_free (recipe->cooktime);
+        g_free (recipe->yields);
+        g_free (recipe->modifications);
+        g_free (recipe->image_path);
+        g_free (recipe);
+}
+
+typedef struct {
+        GPtrArray *recipes;
         gboolean gourmet_doc;
         gboolean collecting_text;
         GString *text;
@@ -81,14 +126,34 @@ typedef struct {
         char *cooktime;
         char *yields;
         char *modifications;
-        char *image_data;
+        char *image_path;
+        FILE *image_file;
+        int base64_state;
+        guint base64_save;
         GString *ingredients_list;
+        GString *pending;
+        gboolean in_image;
 } ParserData;
 
+/* Finished images may be shared with other recipes,
+ * so only partially written ones are removed.
+ */
+static void
+discard_image (ParserData *pd)
+{
+        if (pd->image_file) {
+                fclose (pd->image_file);
+                pd->image_file = NULL;
+                g_unlink (pd->image_path);
+        }
+        g_clear_pointer (&pd->image_path, g_free);
+}
+
 static void
 parser_data_clear (ParserData *pd)
 {
-        g_list_free (pd->recipes);
+        discard_image (pd);
+        g_clear_pointer (&pd->recipes, g_ptr_array_unref);
         g_string_free (pd->text, TRUE);
         g_free (pd->title);
         g_free (pd->source);
@@ -103,8 +168,8 @@ parser_data_clear (ParserData *pd)
         g_free (pd->cooktime);
         g_free (pd->yields);
         g_free (pd->modifications);
-        g_free (pd->image_data);
         g_string_free (pd->ingredients_list, TRUE);
+        g_string_free (pd->pending, TRUE);
 }
 
 static GrChef *
@@ -153,6 +218,8 @@ collected_text (ParserData *pd)
         return g_strdup (pd->text->str);
 }
 
+static void start_image (ParserData *pd);
+
 static void
 start_element (GMarkupParseContext  *context,
                const char           *element_name,
@@ -200,7 +267,7 @@ start_element (GMarkupParseContext  *context,
                 collect_text (pd);
         }
         else if (in_element (context, "image", "recipe", NULL)) {
-                collect_text (pd);
+                start_image (pd);
         }
         else if (in_element (context, "instructions", "recipe", NULL)) {
                 collect_text (pd);
@@ -245,34 +312,148 @@ parse_yield (const char  *text,
         return TRUE;
 }
 
-static GPtrArray *
-load_image (const char *data)
+static void
+start_image (ParserData *pd)
 {
-        GPtrArray *images;
-        GrImage *ri;
         g_autofree char *dir = NULL;
-        g_autofree char *path = NULL;
-        g_autoptr(GError) error = NULL;
-        g_autofree char *decoded = NULL;
-        gsize length;
+        int fd;
 
-        decoded = (char *)g_base64_decode (data, &length);
+        /* Only one image per recipe */
+        discard_image (pd);
 
         dir = g_build_filename (get_user_data_dir (), "images", NULL);
         g_mkdir_with_parents (dir, 0755);
 
-        path = g_build_filename (dir, "importXXXXXX.jpg", NULL);
-        if (!g_file_set_contents (path, decoded, length, &error)) {
+        pd->image_path = g_build_filename (dir, "importXXXXXX.jpg", NULL);
+        /* Unlike g_mkstemp, this lets the umask decide the mode */
+        fd = g_mkstemp_full (pd->image_path, O_WRONLY, 0666);
+        if (fd == -1) {
+                g_warning ("Failed to save image: %s", g_strerror (errno));
+                g_clear_pointer (&pd->image_path, g_free);
+                return;
+        }
+
+        pd->image_file = fdopen (fd, "wb");
+        if (pd->image_file == NULL) {
+                g_warning ("Failed to save image: %s", g_strerror (errno));
+                g_close (fd, NULL);
+                g_unlink (pd->image_path);
+                g_clear_pointer (&pd->image_path, g_free);
+                return;
+        }
+
+        pd->base64_state = 0;
+        pd->base64_save = 0;
+}
+
+static void
+write_image (ParserData *pd,
+             const char *text,
+             gsize       text_len)
+{
+        g_autofree guchar *decoded = NULL;
+        gsize length;
+
+        decoded = g_malloc ((text_len / 4) * 3 + 3);
+        length = g_base64_decode_step (text, text_len, decoded, &pd->base64_state, &pd->base64_save);
+        if (fwrite (decoded, 1, length, pd->image_file) != length) {
+                g_warning ("Failed to save image: %s", g_strerror (errno));
+                discard_image (pd);
+        }
+}
+
+/* Images are stored under the hash of their contents, like
+ * for regular imports.
+ */
+static void
+finish_image (ParserData *pd)
+{
+        g_autoptr(GError) error = NULL;
+        g_autofree char *tmp_path = NULL;
+        g_autofree char *name = NULL;
+        g_autofree char *dir = NULL;
+        g_autofree char *path = NULL;
+        int res;
+
+        if (pd->image_file == NULL)
+                return;
+
+        res = fclose (pd->image_file);
+        pd->image_file = NULL;
+        tmp_path = g_steal_pointer (&pd->image_path);
+
+        if (res != 0) {
+                g_warning ("Failed to save image: %s", g_strerror (errno));
+                g_unlink (tmp_path);
+                return;
+        }
+
+        name = get_content_addressed_name (tmp_path, &error);
+        if (name == NULL) {
                 g_warning ("Failed to save image: %s", error->message);
-                return NULL;
+                g_unlink (tmp_path);
+                return;
         }
 
-        images = gr_image_array_new ();
+        dir = g_path_get_dirname (tmp_path);
+        path = g_build_filename (dir, name, NULL);
+        if (g_file_test (path, G_FILE_TEST_EXISTS)) {
+                g_unlink (tmp_path);
+                /* Keep the sweep away from it until the recipe is saved */
+                update_file_timestamp (path);
+        }
+        else if (g_rename (tmp_path, path) != 0) {
+                g_warning ("Failed to save image: %s", g_strerror (errno));
+                g_unlink (tmp_path);
+                return;
+        }
+
+        pd->image_path = g_steal_pointer (&path);
+}
+
+static GrRecipe *
+create_recipe (GrRecipeStore *store,
+               ParsedRecipe  *parsed)
+{
+        g_autoptr(GrChef) chef = NULL;
+        g_autofree char *id = NULL;
+        double yield;
+        g_autofree char *yield_unit = NULL;
+        g_autoptr(GPtrArray) images = NULL;
+
+        if (!parse_yield (parsed->yields, &yield, &yield_unit)) {
+                yield = 1.0;
+                yield_unit = g_strdup ("serving");
+        }
+
+        if (parsed->source == NULL)
+                parsed->source = g_strdup ("anonymous");
 
-        ri = gr_image_new (gr_app_get_soup_session (GR_APP (g_application_get_default ())), "local", path);
-        g_ptr_array_add (images, ri);
+        id = generate_id ("R_", parsed->title, "_by_", parsed->source, NULL);
+        chef = ensure_chef (store, parsed->source);
 
-        return images;
+        images = gr_image_array_new ();
+        if (parsed->image_path)
+                g_ptr_array_add (images, gr_image_new (gr_app_get_soup_session (GR_APP (g_application_get_default ())), "local", parsed->image_path));
+
+        g_message ("Importing recipe %s", id);
+
+        return g_object_new (GR_TYPE_RECIPE,
+                             "id", id,
+                             "author", gr_chef_get_id (chef),
+                             "name", parsed->title,
+                             "instructions", parsed->instructions,
+                             "ingredients", parsed->ingredients,
+                             "cuisine", parsed->cuisine,
+                             "prep-time", parsed->preptime,
+                             "cook-time", parsed->cooktime,
+                             "notes", parsed->modifications,
+                             "season", "",
+                             "category", "",
+                             "yield", yield,
+                             "yield-unit", yield_unit,
+                             "images", images,
+                             NULL);
 }
 
 static void
@@ -308,7 +489,7 @@ end_element (GMarkupParseContext *context,
                 pd->modifications = collected_text (pd);
         }
         else if (in_element (context, "image", "recipe", NULL)) {
-                pd->image_data = collected_text (pd);
+                finish_image (pd);
         }
         else if (in_element (context, "instructions", "recipe", NULL)) {
                 pd->instructions = collected_text (pd);
@@ -338,54 +519,22 @@ end_element (GMarkupParseContext *context,
                 g_string_set_size (pd->ingredients_list, 0);
         }
         else if (strcmp (element_name, "recipe") == 0) {
-                g_autoptr(GrRecipe) recipe = NULL;
-                g_autoptr(GrChef) chef = NULL;
-                g_autofree char *id = NULL;
-                double yield;
-                g_autofree char *yield_unit = NULL;
-                g_autoptr(GPtrArray) images = NULL;
-
-                if (!parse_yield (pd->yields, &yield, &yield_unit)) {
-                        yield = 1.0;
-                        yield_unit = g_strdup ("serving");
-                }
+                ParsedRecipe *recipe;
+
+                recipe = g_new0 (ParsedRecipe, 1);
+                recipe->title = g_steal_pointer (&pd->title);
+                recipe->source = g_steal_pointer (&pd->source);
+                recipe->instructions = g_steal_pointer (&pd->instructions);
+                recipe->ingredients = g_steal_pointer (&pd->ingredients);
+                recipe->cuisine = g_steal_pointer (&pd->cuisine);
+                recipe->preptime = g_steal_pointer (&pd->preptime);
+                recipe->cooktime = g_steal_pointer (&pd->cooktime);
+                recipe->yields = g_steal_pointer (&pd->yields);
+                recipe->modifications = g_steal_pointer (&pd->modifications);
+                recipe->image_path = g_steal_pointer (&pd->image_path);
+                g_ptr_array_add (pd->recipes, recipe);
 
-                if (pd->source == NULL)
-                        pd->source = g_strdup ("anonymous");
-
-                id = generate_id ("R_", pd->title, "_by_", pd->source, NULL);
-                chef = ensure_chef (pd->store, pd->source);
-                images = load_image (pd->image_data);
-                recipe = g_object_new (GR_TYPE_RECIPE,
-                                       "id", id,
-                                       "author", gr_chef_get_id (chef),
-                                       "name", pd->title,
-                                       "instructions", pd->instructions,
-                                       "ingredients", pd->ingredients,
-                                       "cuisine", pd->cuisine,
-                                       "prep-time", pd->preptime,
-                                       "cook-time", pd->cooktime,
-                                       "notes", pd->modifications,
-                                       "season", "",
-                                       "category", "",
-                                       "yield", yield,
-                                       "yield-unit", yield_unit,
-                                       "images", images,
-                                       NULL);
-                g_message ("Importing recipe %s", id);
-                gr_recipe_store_add_recipe (pd->store, recipe, error);
-                pd->recipes = g_list_prepend (pd->recipes, recipe);
-
-                g_clear_pointer (&pd->title, g_free);
-                g_clear_pointer (&pd->source, g_free);
                 g_clear_pointer (&pd->category, g_free);
-                g_clear_pointer (&pd->cuisine, g_free);
-                g_clear_pointer (&pd->preptime, g_free);
-                g_clear_pointer (&pd->cooktime, g_free);
-                g_clear_pointer (&pd->modifications, g_free);
-                g_clear_pointer (&pd->image_data, g_free);
-                g_clear_pointer (&pd->instructions, g_free);
-                g_clear_pointer (&pd->ingredients, g_free);
         }
 }
 
@@ -402,9 +551,135 @@ text (GMarkupParseContext  *context,
                 g_string_append_len (pd->text, text, text_len);
 }
 
-GList *
-gr_gourmet_format_import (GFile   *file,
-                          GError **error)
+/* Hands the base64 between <image> and </image> to the image
+ * writer. Returns where the scan stopped: at the end tag, or at
+ * a '<' near the end of the chunk that needs more bytes to tell
+ * what it is.
+ */
+static const char *
+scan_image_payload (ParserData *pd,
+                    const char *p,
+                    const char *end)
+{
+        const char *run = p;
+
+        while (p < end) {
+                if (*p != '<') {
+                        p++;
+                        continue;
+                }
+
+                if (p > run && pd->image_file)
+                        write_image (pd, run, p - run);
+
+                if (end - p < 9)
+                        return p;
+
+                if (p[1] == '/') {
+                        pd->in_image = FALSE;
+                        return p;
+                }
+
+                /* The decoder skips the closing ]]> by itself */
+                if (strncmp (p, "<![CDATA[", 9) == 0)
+                        p += 9;
+                else
+                        p++;
+                run = p;
+        }
+
+        if (p > run && pd->image_file)
+                write_image (pd, run, p - run);
+
+        return p;
+}
+
+/* Feeds GMarkup everything up to and including the next <image> start
+ * tag. Returns where the feeding stopped, or NULL on error.
+ */
+static const char *
+scan_markup (GMarkupParseContext  *context,
+             ParserData           *pd,
+             const char           *p,
+             const char           *end,
+             GError              **error)
+{
+        const char *q = p;
+        const char *gt;
+
+        while ((q = memchr (q, '<', end - q)) != NULL) {
+                if (end - q < 7)
+                        break;
+
+                if (strncmp (q, "<image", 6) == 0 &&
+                    (q[6] == '>' || q[6] == '/' || g_ascii_isspace (q[6]))) {
+                        gt = memchr (q, '>', end - q);
+                        if (gt == NULL)
+                                break;
+
+                        if (!g_markup_parse_context_parse (context, p, gt + 1 - p, error))
+                                return NULL;
+
+                        pd->in_image = gt[-1] != '/';
+
+                        return gt + 1;
+                }
+
+                q++;
+        }
+
+        if (q == NULL)
+                q = end;
+
+        if (!g_markup_parse_context_parse (context, p, q - p, error))
+                return NULL;
+
+        return q;
+}
+
+static gboolean
+feed_chunk (GMarkupParseContext  *context,
+            ParserData           *pd,
+            const char           *chunk,
+            gsize                 length,
+            GError              **error)
+{
+        const char *start;
+        const char *p;
+        const char *end;
+        const char *next;
+        gboolean in_image;
+
+        g_string_append_len (pd->pending, chunk, length);
+
+        start = pd->pending->str;
+        end = start + pd->pending->len;
+
+        for (p = start; p < end; p = next) {
+                in_image = pd->in_image;
+                if (in_image)
+                        next = scan_image_payload (pd, p, end);
+                else
+                        next = scan_markup (context, pd, p, end, error);
+
+                if (next == NULL)
+                        return FALSE;
+
+                /* Waiting for more bytes */
+                if (next == p && pd->in_image == in_image)
+                        break;
+        }
+
+        g_string_erase (pd->pending, 0, p - start);
+
+        return TRUE;
+}
+
+static void
+import_thread (GTask        *task,
+               gpointer      source,
+               gpointer      task_data,
+               GCancellable *cancellable)
 {
         GMarkupParser parser = {
                 start_element,
@@ -415,30 +690,114 @@ gr_gourmet_format_import (GFile   *file,
         };
         ParserData data;
         g_autoptr(GMarkupParseContext) context = NULL;
-        g_autofree char *contents = NULL;
-        gsize length;
-        GList *recipes;
-
-        if (!g_file_load_contents (file, NULL, &contents, &length, NULL, error))
-                return NULL;
+        g_autoptr(GFileInputStream) stream = NULL;
+        g_autofree char *buffer = NULL;
+        GError *error = NULL;
+        gssize n;
+
+        stream = g_file_read (G_FILE (source), cancellable, &error);
+        if (!stream) {
+                g_task_return_error (task, error);
+                return;
+        }
 
         memset (&data, 0, sizeof(ParserData));
-        data.store = gr_recipe_store_get ();
+        data.recipes = g_ptr_array_new_with_free_func (parsed_recipe_free);
         data.gourmet_doc = FALSE;
         data.text = g_string_new ("");
         data.collecting_text = FALSE;
         data.ingredients_list = g_string_new ("");
+        data.pending = g_string_new ("");
 
         context = g_markup_parse_context_new (&parser, G_MARKUP_TREAT_CDATA_AS_TEXT, &data, NULL);
 
-        if (!g_markup_parse_context_parse (context, contents, length, error)) {
+        buffer = g_malloc (READ_CHUNK_SIZE);
+        while ((n = g_input_stream_read (G_INPUT_STREAM (stream), buffer, READ_CHUNK_SIZE, cancellable, &error)) > 0) {
+                if (!feed_chunk (context, &data, buffer, n, &error))
+                        break;
+        }
+
+        /* Whatever was held back can't be an image tag anymore */
+        if (error == NULL &&
+            g_markup_parse_context_parse (context, data.pending->str, data.pending->len, &error))
+                g_markup_parse_context_end_parse (context, &error);
+
+        if (error) {
                 parser_data_clear (&data);
-                return NULL;
+                g_task_return_error (task, error);
+                return;
         }
 
-        recipes = data.recipes;
-        data.recipes = NULL;
+        g_task_return_pointer (task, g_steal_pointer (&data.recipes), (GDestroyNotify)g_ptr_array_unref);
         parser_data_clear (&data);
+}
+
+/* Runs on the main thread, once the whole file is parsed */
+static void
+import_parsed (GObject      *source,
+               GAsyncResult *result,
+               gpointer      data)
+{
+        g_autoptr(GTask) task = data;
+        g_autoptr(GPtrArray) parsed = NULL;
+        g_autoptr(GPtrArray) recipes = NULL;
+        GrRecipeStore *store;
+        GList *list;
+        GError *error = NULL;
+        gboolean ret;
+        guint i;
+
+        parsed = g_task_propagate_pointer (G_TASK (result), &error);
+        if (parsed == NULL) {
+                g_task_return_error (task, error);
+                return;
+        }
+
+        store = gr_recipe_store_get ();
+
+        recipes = g_ptr_array_new_with_free_func (g_object_unref);
+
+        /* Chefs are added along the way, this saves them once, too */
+        gr_recipe_store_begin_batch (store);
+        for (i = 0; i < parsed->len; i++)
+                g_ptr_array_add (recipes, create_recipe (store, g_ptr_array_index (parsed, i)));
+        ret = gr_recipe_store_add_recipes (store, recipes, &error);
+        gr_recipe_store_commit_batch (store);
+
+        if (!ret) {
+                g_task_return_error (task, error);
+                return;
+        }
+
+        list = NULL;
+        for (i = recipes->len; i > 0; i--)
+                list = g_list_prepend (list, g_ptr_array_index (recipes, i - 1));
 
-        return recipes;
+        g_task_return_pointer (task, list, (GDestroyNotify)g_list_free);
+}
+
+/* The file is parsed in a thread, and the recipes are then added
+ * to the store. gr_gourmet_format_import_finish() returns the list
+ * of them.
+ */
+void
+gr_gourmet_format_import_async (GFile               *file,
+                                GCancellable        *cancellable,
+                                GAsyncReadyCallback  callback,
+                                gpointer             data)
+{
+        g_autoptr(GTask) task = NULL;
+        g_autoptr(GTask) parse_task = NULL;
+
+        task = g_task_new (file, cancellable, callback, data);
+
+        parse_task = g_task_new (file, cancellable, import_parsed, g_object_ref (task));
+        g_task_run_in_thread (parse_task, import_thread);
+}
+
+GList *
+gr_gourmet_format_import_finish (GAsyncResult  *result,
+                                 GError       **error)
+{
+        return g_task_propagate_pointer (G_TASK (result), error);
 }
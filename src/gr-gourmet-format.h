@@ -22,7 +22,11 @@
 
 G_BEGIN_DECLS
 
-GList *gr_gourmet_format_import (GFile   *file,
-                                 GError **error);
+void   gr_gourmet_format_import_async  (GFile                *file,
+                                       GCancellable         *cancellable,
+                                       GAsyncReadyCallback   callback,
+                                       gpointer              data);
+GList *gr_gourmet_format_import_finish (GAsyncResult         *result,
+                                       GError              **error);
 
 G_END_DECLS
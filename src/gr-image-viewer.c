@@ -158,11 +158,11 @@ set_current_image (GrImageViewer *viewer)
 
                 vis = gtk_stack_get_visible_child_name (GTK_STACK (viewer->stack));
                 if (strcmp (vis, "image1") == 0) {
-                        gr_image_load (ri, 360, 240, FALSE, viewer->cancellable, gr_image_set_pixbuf, viewer->image2);
+                        gr_image_load (ri, GR_IMAGE_VIEWER_WIDTH, GR_IMAGE_VIEWER_HEIGHT, FALSE, viewer->cancellable, gr_image_set_pixbuf, viewer->image2);
                         gtk_stack_set_visible_child_name (GTK_STACK (viewer->stack), "image2");
                 }
                 else {
-                        gr_image_load (ri, 360, 240, FALSE, viewer->cancellable, gr_image_set_pixbuf, viewer->image1);
+                        gr_image_load (ri, GR_IMAGE_VIEWER_WIDTH, GR_IMAGE_VIEWER_HEIGHT, FALSE, viewer->cancellable, gr_image_set_pixbuf, viewer->image1);
                         gtk_stack_set_visible_child_name (GTK_STACK (viewer->stack), "image1");
                 }
         }
@@ -193,7 +193,7 @@ populate_preview (GrImageViewer *viewer)
                 gtk_widget_show (image);
                 gtk_container_add (GTK_CONTAINER (viewer->preview_list), image);
 
-                gr_image_load (ri, 60, 40, FALSE, viewer->preview_cancellable, gr_image_set_pixbuf, image);
+                gr_image_load (ri, GR_IMAGE_VIEWER_PREVIEW_WIDTH, GR_IMAGE_VIEWER_PREVIEW_HEIGHT, FALSE, viewer->preview_cancellable, gr_image_set_pixbuf, image);
         }
 }
 
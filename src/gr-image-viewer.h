@@ -26,6 +26,11 @@ G_BEGIN_DECLS
 
 #define GR_TYPE_IMAGE_VIEWER (gr_image_viewer_get_type())
 
+#define GR_IMAGE_VIEWER_WIDTH 360
+#define GR_IMAGE_VIEWER_HEIGHT 240
+#define GR_IMAGE_VIEWER_PREVIEW_WIDTH 60
+#define GR_IMAGE_VIEWER_PREVIEW_HEIGHT 40
+
 G_DECLARE_FINAL_TYPE (GrImageViewer, gr_image_viewer, GR, IMAGE_VIEWER, GtkBox)
 
 GrImageViewer *gr_image_viewer_new          (void);
@@ -20,9 +20,12 @@
 
 #include "config.h"
 
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
 #include <libsoup/soup.h>
 
 #include "gr-image.h"
+#include "gr-settings.h"
 #include "gr-utils.h"
 
 
@@ -31,6 +34,7 @@ typedef struct {
         int width;
         int height;
         gboolean fit;
+        gboolean preview;
         GCancellable *cancellable;
         GrImageCallback callback;
         gpointer data;
@@ -46,6 +50,58 @@ task_data_free (gpointer data)
         g_free (td);
 }
 
+/* A download in progress. The response body is streamed into
+ * a replacement for the cache file, which only takes the place
+ * of the old file once the whole body has arrived. Full-size
+ * images are fed to a pixbuf loader along the way, so we can
+ * show a partial image before the download is done.
+ */
+typedef struct {
+        GrImage *ri;
+        SoupMessage *msg;
+        GCancellable *cancellable;
+        GInputStream *input;
+        GOutputStream *output;
+        GdkPixbufLoader *loader;
+        char *cache_path;
+        int rows;
+        gint64 last_preview;
+} Download;
+
+#define DOWNLOAD_CHUNK_SIZE (64 * 1024)
+
+static void
+download_free (Download *d)
+{
+        g_clear_object (&d->msg);
+        g_clear_object (&d->cancellable);
+        g_clear_object (&d->input);
+        g_clear_object (&d->output);
+        if (d->loader) {
+                g_signal_handlers_disconnect_by_data (d->loader, d);
+                gdk_pixbuf_loader_close (d->loader, NULL);
+                g_clear_object (&d->loader);
+        }
+        g_free (d->cache_path);
+
+        g_free (d);
+}
+
+static void
+download_abort (Download *d)
+{
+        /* Closing a replace stream with a cancelled cancellable
+         * drops the temporary file and keeps the old contents.
+         */
+        if (d->output) {
+                g_autoptr(GCancellable) cancellable = g_cancellable_new ();
+
+                g_cancellable_cancel (cancellable);
+                g_output_stream_close (d->output, cancellable, NULL);
+                g_clear_object (&d->output);
+        }
+}
+
 struct _GrImage
 {
         GObject parent_instance;
@@ -53,28 +109,34 @@ struct _GrImage
         char *path;
 
         SoupSession *session;
-        SoupMessage *thumbnail_message;
-        SoupMessage *image_message;
+        Download *thumbnail_download;
+        Download *image_download;
         GList *pending;
+        GList *fetches;
 };
 
 G_DEFINE_TYPE (GrImage, gr_image, G_TYPE_OBJECT)
 
+static void
+cancel_download (Download *d)
+{
+        if (d == NULL)
+                return;
+
+        /* The download frees itself once the cancellation arrives */
+        d->ri = NULL;
+        g_cancellable_cancel (d->cancellable);
+}
+
 static void
 gr_image_finalize (GObject *object)
 {
         GrImage *ri = GR_IMAGE (object);
 
-        if (ri->thumbnail_message)
-                soup_session_cancel_message (ri->session,
-                                             ri->thumbnail_message,
-                                             SOUP_STATUS_CANCELLED);
-        g_clear_object (&ri->thumbnail_message);
-        if (ri->image_message)
-                soup_session_cancel_message (ri->session,
-                                             ri->image_message,
-                                             SOUP_STATUS_CANCELLED);
-        g_clear_object (&ri->image_message);
+        cancel_download (ri->thumbnail_download);
+        ri->thumbnail_download = NULL;
+        cancel_download (ri->image_download);
+        ri->image_download = NULL;
         g_clear_object (&ri->session);
         g_free (ri->path);
         g_free (ri->id);
@@ -141,6 +203,142 @@ gr_image_array_new (void)
         return g_ptr_array_new_with_free_func (g_object_unref);
 }
 
+/* Decoded pixbufs are kept around in a small LRU cache, bounded
+ * by the image-cache-size setting, so that images that have been
+ * prefetched (or shown recently) don't need to be decoded again.
+ */
+typedef struct {
+        char *key;
+        GdkPixbuf *pixbuf;
+        gsize size;
+} DecodedEntry;
+
+static GHashTable *decoded_index;
+static GQueue decoded_lru = G_QUEUE_INIT;
+static gsize decoded_size;
+
+static void
+decoded_entry_free (DecodedEntry *entry)
+{
+        decoded_size -= entry->size;
+        g_free (entry->key);
+        g_object_unref (entry->pixbuf);
+        g_free (entry);
+}
+
+static void
+decoded_remove_link (GList *link)
+{
+        DecodedEntry *entry = link->data;
+
+        g_hash_table_remove (decoded_index, entry->key);
+        g_queue_delete_link (&decoded_lru, link);
+        decoded_entry_free (entry);
+}
+
+static gsize
+get_decoded_budget (void)
+{
+        return (gsize)g_settings_get_uint (gr_settings_get (), "image-cache-size") * 1024 * 1024;
+}
+
+static void
+decoded_trim (gsize budget)
+{
+        while (decoded_size > budget && decoded_lru.tail)
+                decoded_remove_link (decoded_lru.tail);
+}
+
+static void
+decoded_forget_path (const char *path)
+{
+        g_autofree char *prefix = NULL;
+        GList *l, *next;
+
+        if (decoded_index == NULL)
+                return;
+
+        prefix = g_strconcat (path, ":", NULL);
+        for (l = decoded_lru.head; l; l = next) {
+                DecodedEntry *entry = l->data;
+
+                next = l->next;
+                if (g_str_has_prefix (entry->key, prefix))
+                        decoded_remove_link (l);
+        }
+}
+
+static char *
+get_decoded_key (const char *path,
+                 int         width,
+                 int         height,
+                 gboolean    fit)
+{
+        return g_strdup_printf ("%s:%dx%d:%d", path, width, height, fit);
+}
+
+static GdkPixbuf *
+decoded_lookup (const char *key)
+{
+        DecodedEntry *entry;
+        GList *link;
+
+        if (decoded_index == NULL)
+                return NULL;
+
+        link = g_hash_table_lookup (decoded_index, key);
+        if (link == NULL)
+                return NULL;
+
+        g_queue_unlink (&decoded_lru, link);
+        g_queue_push_head_link (&decoded_lru, link);
+        entry = link->data;
+
+        return g_object_ref (entry->pixbuf);
+}
+
+static void
+decoded_insert (const char *key,
+                GdkPixbuf  *pixbuf)
+{
+        DecodedEntry *entry;
+        gsize budget;
+
+        budget = get_decoded_budget ();
+        if (gdk_pixbuf_get_byte_length (pixbuf) > budget)
+                return;
+
+        if (decoded_index == NULL)
+                decoded_index = g_hash_table_new (g_str_hash, g_str_equal);
+
+        if (g_hash_table_contains (decoded_index, key))
+                return;
+
+        entry = g_new (DecodedEntry, 1);
+        entry->key = g_strdup (key);
+        entry->pixbuf = g_object_ref (pixbuf);
+        entry->size = gdk_pixbuf_get_byte_length (pixbuf);
+        decoded_size += entry->size;
+
+        g_queue_push_head (&decoded_lru, entry);
+        g_hash_table_insert (decoded_index, entry->key, decoded_lru.head);
+
+        decoded_trim (budget);
+}
+
+/* Only uses gdk-pixbuf, so this is fine to call from a thread */
+static GdkPixbuf *
+decode_pixbuf (const char *path,
+               int         width,
+               int         height,
+               gboolean    fit)
+{
+        if (fit)
+                return load_pixbuf_fit_size (path, width, height, FALSE);
+        else
+                return load_pixbuf_fill_size (path, width, height);
+}
+
 static GdkPixbuf *
 load_pixbuf (const char *path,
              int         width,
@@ -148,11 +346,16 @@ load_pixbuf (const char *path,
              gboolean    fit)
 {
         GdkPixbuf *pixbuf;
+        g_autofree char *key = NULL;
 
-        if (fit)
-                pixbuf = load_pixbuf_fit_size (path, width, height, FALSE);
-        else
-                pixbuf = load_pixbuf_fill_size (path, width, height);
+        key = get_decoded_key (path, width, height, fit);
+        pixbuf = decoded_lookup (key);
+        if (pixbuf)
+                return pixbuf;
+
+        pixbuf = decode_pixbuf (path, width, height, fit);
+        if (pixbuf)
+                decoded_insert (key, pixbuf);
 
         return pixbuf;
 }
@@ -181,13 +384,10 @@ static char *
 get_image_cache_path (GrImage *ri)
 {
         char *filename;
-        g_autofree char *cache_dir = NULL;
         g_autofree char *basename = NULL;
 
         basename = g_path_get_basename (ri->path);
         filename = g_build_filename (get_user_cache_dir (), "images", ri->id,  basename, NULL);
-        cache_dir = g_path_get_dirname (filename);
-        g_mkdir_with_parents (cache_dir, 0755);
 
         return filename;
 }
@@ -205,22 +405,225 @@ static char *
 get_thumbnail_cache_path (GrImage *ri)
 {
         char *filename;
-        g_autofree char *cache_dir = NULL;
         g_autofree char *basename = NULL;
 
         basename = g_path_get_basename (ri->path);
         filename = g_build_filename (get_user_cache_dir (), "thumbnails", ri->id, basename, NULL);
-        cache_dir = g_path_get_dirname (filename);
-        g_mkdir_with_parents (cache_dir, 0755);
 
         return filename;
 }
 
+/* We keep what we know about the files in the image cache in
+ * memory, so that deciding whether to fetch an image does not
+ * need to hit the filesystem each time a tile asks for it.
+ *
+ * The index is saved next to the cache as a GVariant of type
+ * (ua{s(bxs)}): a format version, then for each file whether it is
+ * a negative entry, its mtime and its ETag (or ""). It is loaded the
+ * first time we need it, so the ETags and timestamps survive across
+ * runs. Paths that are not in it are filled in by a single stat,
+ * and if a file turns out to be missing when we load it, the entry
+ * is dropped. Entries for files that don't exist, and negative ones
+ * that are old enough to be retried anyway, are not saved.
+ */
+typedef struct {
+        gboolean exists;
+        gboolean negative;
+        gint64 mtime;
+        char *etag;
+} CacheInfo;
+
+#define CACHE_INDEX_VERSION 1
+#define CACHE_INDEX_SAVE_DELAY 5
+
+static GHashTable *cache_index;
+static guint cache_index_save_id;
+
+static void
+cache_info_free (gpointer data)
+{
+        CacheInfo *info = data;
+
+        g_free (info->etag);
+        g_free (info);
+}
+
+static char *
+get_cache_index_path (void)
+{
+        return g_build_filename (get_user_cache_dir (), "image-index", NULL);
+}
+
+static void
+load_cache_index (void)
+{
+        g_autofree char *path = NULL;
+        g_autoptr(GMappedFile) mapped = NULL;
+        g_autoptr(GBytes) bytes = NULL;
+        g_autoptr(GVariant) variant = NULL;
+        g_autoptr(GVariant) entries = NULL;
+        g_autoptr(GError) error = NULL;
+        GVariantIter iter;
+        const char *key;
+        gboolean negative;
+        gint64 mtime;
+        const char *etag;
+        guint32 version;
+
+        path = get_cache_index_path ();
+        mapped = g_mapped_file_new (path, FALSE, &error);
+        if (!mapped) {
+                g_debug ("No image cache index: %s", error->message);
+                return;
+        }
+
+        bytes = g_mapped_file_get_bytes (mapped);
+        variant = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE ("(ua{s(bxs)})"), bytes, FALSE));
+
+        g_variant_get (variant, "(u@a{s(bxs)})", &version, &entries);
+        if (version != CACHE_INDEX_VERSION) {
+                g_debug ("Ignoring image cache index version %u", version);
+                return;
+        }
+
+        g_variant_iter_init (&iter, entries);
+        while (g_variant_iter_next (&iter, "{&s(bx&s)}", &key, &negative, &mtime, &etag)) {
+                CacheInfo *info;
+
+                info = g_new0 (CacheInfo, 1);
+                info->exists = TRUE;
+                info->negative = negative;
+                info->mtime = mtime;
+                info->etag = etag[0] ? g_strdup (etag) : NULL;
+
+                g_hash_table_insert (cache_index, g_strdup (key), info);
+        }
+
+        g_debug ("Loaded %d entries from %s", g_hash_table_size (cache_index), path);
+}
+
+static gboolean
+save_cache_index (gpointer data)
+{
+        g_autofree char *path = NULL;
+        g_autoptr(GVariant) variant = NULL;
+        g_autoptr(GError) error = NULL;
+        GVariantBuilder builder;
+        GHashTableIter iter;
+        const char *key;
+        CacheInfo *info;
+        gint64 now;
+
+        cache_index_save_id = 0;
+
+        now = g_get_real_time () / G_USEC_PER_SEC;
+
+        g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{s(bxs)}"));
+        g_hash_table_iter_init (&iter, cache_index);
+        while (g_hash_table_iter_next (&iter, (gpointer *)&key, (gpointer *)&info)) {
+                if (!info->exists)
+                        continue;
+
+                if (info->negative && now - info->mtime > 24 * 60 * 60)
+                        continue;
+
+                g_variant_builder_add (&builder, "{s(bxs)}",
+                                       key, info->negative, info->mtime,
+                                       info->etag ? info->etag : "");
+        }
+
+        variant = g_variant_ref_sink (g_variant_new ("(u@a{s(bxs)})",
+                                                     CACHE_INDEX_VERSION,
+                                                     g_variant_builder_end (&builder)));
+
+        path = get_cache_index_path ();
+        if (!g_file_set_contents (path,
+                                  g_variant_get_data (variant),
+                                  g_variant_get_size (variant),
+                                  &error))
+                g_warning ("Failed to save image cache index: %s", error->message);
+
+        return G_SOURCE_REMOVE;
+}
+
+static void
+schedule_cache_index_save (void)
+{
+        if (cache_index_save_id == 0)
+                cache_index_save_id = g_timeout_add_seconds (CACHE_INDEX_SAVE_DELAY, save_cache_index, NULL);
+}
+
+static CacheInfo *
+lookup_cache_info (const char *path)
+{
+        CacheInfo *info;
+        GStatBuf buf;
+
+        if (cache_index == NULL) {
+                cache_index = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, cache_info_free);
+                load_cache_index ();
+        }
+
+        info = g_hash_table_lookup (cache_index, path);
+        if (info)
+                return info;
+
+        info = g_new0 (CacheInfo, 1);
+        if (g_stat (path, &buf) == 0) {
+                info->exists = TRUE;
+                info->negative = buf.st_size == 6;
+                info->mtime = buf.st_mtime;
+                schedule_cache_index_save ();
+        }
+
+        g_hash_table_insert (cache_index, g_strdup (path), info);
+
+        return info;
+}
+
+/* The index can be out of date if files were removed behind our
+ * back, so when a file it lists fails to load, we check again.
+ */
+static void
+check_cache_file (const char *path)
+{
+        CacheInfo *info;
+
+        info = lookup_cache_info (path);
+        if (!info->exists || g_file_test (path, G_FILE_TEST_EXISTS))
+                return;
+
+        g_debug ("%s is gone from the image cache", path);
+        g_hash_table_remove (cache_index, path);
+        schedule_cache_index_save ();
+}
+
+static void
+update_cache_info (const char *path,
+                   gboolean    negative,
+                   const char *etag)
+{
+        CacheInfo *info;
+        g_autoptr(GDateTime) now = NULL;
+
+        now = g_date_time_new_now_utc ();
+
+        info = lookup_cache_info (path);
+        info->exists = TRUE;
+        info->negative = negative;
+        info->mtime = g_date_time_to_unix (now);
+        if (etag) {
+                g_free (info->etag);
+                info->etag = g_strdup (etag);
+        }
+
+        schedule_cache_index_save ();
+}
+
 static gboolean
 should_try_load (const char *path)
 {
-        g_autoptr(GFile) file = NULL;
-        g_autoptr(GFileInfo) info = NULL;
+        CacheInfo *info;
         gboolean result = TRUE;
 
         // We create negative cache entries as almost empty files, and we
@@ -228,31 +631,22 @@ should_try_load (const char *path)
         // And we want to retry cached images after 28 days, in case
         // they changed
 
-        file = g_file_new_for_path (path);
-        info = g_file_query_info (file,
-                                  G_FILE_ATTRIBUTE_STANDARD_SIZE ","
-                                  G_FILE_ATTRIBUTE_TIME_MODIFIED,
-                                  G_FILE_QUERY_INFO_NONE,
-                                  NULL,
-                                  NULL);
-        if (info &&
-            g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_TIME_MODIFIED)) {
-                goffset size;
+        info = lookup_cache_info (path);
+        if (info->exists) {
                 g_autoptr(GDateTime) now = NULL;
-                g_autoptr(GDateTime) mtime = NULL;
+                gint64 age;
 
-                size = g_file_info_get_size (info);
                 now = g_date_time_new_now_utc ();
-                mtime = g_file_info_get_modification_date_time (info);
+                age = (g_date_time_to_unix (now) - info->mtime) * G_TIME_SPAN_SECOND;
 
-                if (size == 6) {
-                        result = g_date_time_difference (now, mtime) > G_TIME_SPAN_DAY;
+                if (info->negative) {
+                        result = age > G_TIME_SPAN_DAY;
                 }
                 else {
-                        result = g_date_time_difference (now, mtime) > 28 * G_TIME_SPAN_DAY;
+                        result = age > 28 * G_TIME_SPAN_DAY;
                 }
                 g_debug ("Cached %s for %s is %s",
-                         size == 6 ? "failure" : "image",
+                         info->negative ? "failure" : "image",
                          path,
                          result ? "old, trying again" : "new enough");
         }
@@ -263,8 +657,12 @@ should_try_load (const char *path)
 static void
 write_negative_cache_entry (const char *path)
 {
-        if (!g_file_set_contents (path, "failed", 6, NULL))
+        if (!g_file_set_contents (path, "failed", 6, NULL)) {
                 g_warning ("Failed to write a negative cache entry for %s", path);
+                return;
+        }
+
+        update_cache_info (path, TRUE, NULL);
 }
 
 static void
@@ -280,68 +678,99 @@ update_image_timestamp (const char *path)
         file = g_file_new_for_path (path);
         g_file_set_attribute_uint64 (file, G_FILE_ATTRIBUTE_TIME_MODIFIED, mtime, 0, NULL, NULL);
         g_debug ("updating timestamp for %s", path);
+
+        update_cache_info (path, lookup_cache_info (path)->negative, NULL);
 }
 
 static void
 set_modified_request (SoupMessage *msg,
                       const char  *path)
 {
-        g_autoptr(GFile) file = NULL;
-        g_autoptr(GFileInfo) info = NULL;
+        CacheInfo *info;
 
-        file = g_file_new_for_path (path);
-        info = g_file_query_info (file,
-                                  G_FILE_ATTRIBUTE_TIME_MODIFIED,
-                                  G_FILE_QUERY_INFO_NONE,
-                                  NULL,
-                                  NULL);
-        if (info &&
-            g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_TIME_MODIFIED)) {
+        info = lookup_cache_info (path);
+        if (info->exists) {
                 g_autoptr(GDateTime) mtime = NULL;
                 g_autofree char *mod_date = NULL;
 
-                mtime = g_file_info_get_modification_date_time (info);
+                mtime = g_date_time_new_from_unix_utc (info->mtime);
                 mod_date = g_date_time_format (mtime, "%a, %d %b %Y %H:%M:%S %Z");
                 soup_message_headers_append (msg->request_headers, "If-Modified-Since", mod_date);
+                if (info->etag && !info->negative)
+                        soup_message_headers_append (msg->request_headers, "If-None-Match", info->etag);
         }
 }
 
+/* Render the rows of a partially loaded image that have been
+ * decoded so far at the size of the final image.
+ */
+static GdkPixbuf *
+scale_preview (GdkPixbuf *partial,
+               int        rows,
+               int        width,
+               int        height,
+               gboolean   fit)
+{
+        g_autoptr(GdkPixbuf) valid = NULL;
+        GdkPixbuf *pixbuf;
+        int w, h;
+        double scale;
+        int dest_width, dest_height;
+        double offset_x, offset_y;
+        int valid_height;
+
+        w = gdk_pixbuf_get_width (partial);
+        h = gdk_pixbuf_get_height (partial);
+
+        if (fit) {
+                scale = MIN ((double)width / w, (double)height / h);
+                dest_width = MAX (1, (int)(w * scale));
+                dest_height = MAX (1, (int)(h * scale));
+        }
+        else {
+                scale = MAX ((double)width / w, (double)height / h);
+                dest_width = width;
+                dest_height = height;
+        }
+
+        offset_x = (dest_width - w * scale) / 2;
+        offset_y = (dest_height - h * scale) / 2;
+
+        valid_height = MIN (dest_height, (int)(offset_y + rows * scale));
+        if (valid_height <= 0)
+                return NULL;
+
+        valid = gdk_pixbuf_new_subpixbuf (partial, 0, 0, w, MIN (rows, h));
+
+        pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, dest_width, dest_height);
+        gdk_pixbuf_fill (pixbuf, 0x00000000);
+        gdk_pixbuf_composite (valid, pixbuf,
+                              0, 0, dest_width, valid_height,
+                              offset_x, offset_y, scale, scale,
+                              GDK_INTERP_BILINEAR, 255);
+
+        return pixbuf;
+}
+
 static void
-set_image (SoupSession *session,
-           SoupMessage *msg,
-           gpointer     data)
+finish_download (Download *d,
+                 gboolean  success)
 {
-        GrImage *ri = data;
-        g_autofree char *cache_path = NULL;
+        GrImage *ri = d->ri;
+        gboolean thumbnail;
+        gboolean previewing;
         GList *l;
 
-        if (msg->status_code == SOUP_STATUS_CANCELLED || ri->session == NULL) {
-                g_debug ("Message cancelled");
-                return;
-        }
+        thumbnail = d == ri->thumbnail_download;
+        previewing = ri->image_download && ri->image_download->last_preview > 0;
 
-        if (msg == ri->thumbnail_message)
-                cache_path = get_thumbnail_cache_path (ri);
-        else
-                cache_path = get_image_cache_path (ri);
+        /* Anything we decoded from the old file is stale now, also
+         * when it was just replaced by a negative cache entry
+         */
+        decoded_forget_path (d->cache_path);
 
-        if (msg->status_code == SOUP_STATUS_NOT_MODIFIED) {
-                g_debug ("Image not modified");
-                update_image_timestamp (cache_path);
-        }
-        else if (msg->status_code == SOUP_STATUS_OK) {
-                g_debug ("Saving image to %s", cache_path);
-                if (!g_file_set_contents (cache_path, msg->response_body->data, msg->response_body->length, NULL)) {
-                        g_debug ("Saving image to %s failed", cache_path);
-                        goto out;
-                }
-        }
-        else {
-                g_autofree char *url = get_image_url (ri);
-                g_debug ("Got status %d, record failure to load %s", msg->status_code, url);
-                write_negative_cache_entry (cache_path);
+        if (!success)
                 goto out;
-        }
 
         g_debug ("Loading image for %s", ri->path);
 
@@ -355,11 +784,17 @@ set_image (SoupSession *session,
                         ri->pending = g_list_remove (ri->pending, td);
                         task_data_free (td);
                 }
-                else if (msg == ri->thumbnail_message &&
+                else if (thumbnail &&
                     (td->width > 150 || td->height > 150)) {
                         g_autoptr(GdkPixbuf) tmp = NULL;
                         int w, h;
 
+                        /* Don't cover up a partially loaded image */
+                        if (previewing) {
+                                l = next;
+                                continue;
+                        }
+
                         if (td->width < td->height) {
                                 h = 150;
                                 w = 150 * td->width / td->height;
@@ -369,13 +804,13 @@ set_image (SoupSession *session,
                                 h = 150 * td->height / td->width;
                         }
 
-                        tmp = load_pixbuf (cache_path, w, h, td->fit);
+                        tmp = load_pixbuf (d->cache_path, w, h, td->fit);
                         pixbuf = gdk_pixbuf_scale_simple (tmp, td->width, td->height, GDK_INTERP_BILINEAR);
                         pixbuf_blur (pixbuf, 5, 3);
                         td->callback (ri, pixbuf, td->data);
                 }
                 else {
-                        pixbuf = load_pixbuf (cache_path, td->width, td->height, td->fit);
+                        pixbuf = load_pixbuf (d->cache_path, td->width, td->height, td->fit);
                         td->callback (ri, pixbuf, td->data);
 
                         ri->pending = g_list_remove (ri->pending, td);
@@ -386,18 +821,252 @@ set_image (SoupSession *session,
         }
 
 out:
-        if (msg == ri->thumbnail_message)
-                g_clear_object (&ri->thumbnail_message);
-        else
-                g_clear_object (&ri->image_message);
+        if (thumbnail) {
+                ri->thumbnail_download = NULL;
+        }
+        else {
+                GList *fetches;
 
-        if (ri->thumbnail_message || ri->image_message)
+                ri->image_download = NULL;
+
+                fetches = g_steal_pointer (&ri->fetches);
+                for (l = fetches; l; l = l->next) {
+                        GTask *task = l->data;
+
+                        if (success)
+                                g_task_return_pointer (task, g_strdup (d->cache_path), g_free);
+                        else
+                                g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_FAILED,
+                                                         _("Failed to download image %s"), ri->path);
+                }
+                g_list_free_full (fetches, g_object_unref);
+        }
+
+        download_free (d);
+
+        if (ri->thumbnail_download || ri->image_download)
                 return;
 
         g_list_free_full (ri->pending, task_data_free);
         ri->pending = NULL;
 }
 
+static void
+download_area_updated (GdkPixbufLoader *loader,
+                       int              x,
+                       int              y,
+                       int              width,
+                       int              height,
+                       gpointer         data)
+{
+        Download *d = data;
+        GrImage *ri = d->ri;
+        GdkPixbuf *partial;
+        gint64 now;
+        GList *l;
+
+        if (ri == NULL)
+                return;
+
+        d->rows = MAX (d->rows, y + height);
+
+        /* Don't update the preview more often than a few times per second */
+        now = g_get_monotonic_time ();
+        if (now - d->last_preview < 200 * G_TIME_SPAN_MILLISECOND)
+                return;
+
+        partial = gdk_pixbuf_loader_get_pixbuf (loader);
+        if (partial == NULL)
+                return;
+
+        d->last_preview = now;
+
+        for (l = ri->pending; l; l = l->next) {
+                TaskData *td = l->data;
+                g_autoptr(GdkPixbuf) pixbuf = NULL;
+
+                if (g_cancellable_is_cancelled (td->cancellable))
+                        continue;
+
+                if (!td->preview || (td->width <= 150 && td->height <= 150))
+                        continue;
+
+                pixbuf = scale_preview (partial, d->rows, td->width, td->height, td->fit);
+                if (pixbuf)
+                        td->callback (ri, pixbuf, td->data);
+        }
+}
+
+static void
+download_read (GObject      *source,
+               GAsyncResult *result,
+               gpointer      data)
+{
+        Download *d = data;
+        g_autoptr(GBytes) bytes = NULL;
+        g_autoptr(GError) error = NULL;
+
+        bytes = g_input_stream_read_bytes_finish (G_INPUT_STREAM (source), result, &error);
+
+        if (d->ri == NULL || g_cancellable_is_cancelled (d->cancellable)) {
+                g_debug ("Download cancelled");
+                download_abort (d);
+                download_free (d);
+                return;
+        }
+
+        if (bytes == NULL) {
+                g_debug ("Downloading to %s failed: %s", d->cache_path, error->message);
+                download_abort (d);
+                finish_download (d, FALSE);
+                return;
+        }
+
+        if (g_bytes_get_size (bytes) == 0) {
+                gboolean saved;
+
+                saved = g_output_stream_close (d->output, NULL, &error);
+                g_clear_object (&d->output);
+                if (saved)
+                        update_cache_info (d->cache_path,
+                                           FALSE,
+                                           soup_message_headers_get_one (d->msg->response_headers, "ETag"));
+                else
+                        g_debug ("Saving image to %s failed: %s", d->cache_path, error->message);
+
+                finish_download (d, saved);
+                return;
+        }
+
+        if (!g_output_stream_write_all (d->output,
+                                        g_bytes_get_data (bytes, NULL),
+                                        g_bytes_get_size (bytes),
+                                        NULL,
+                                        NULL,
+                                        &error)) {
+                g_debug ("Saving image to %s failed: %s", d->cache_path, error->message);
+                download_abort (d);
+                finish_download (d, FALSE);
+                return;
+        }
+
+        if (d->loader && !gdk_pixbuf_loader_write_bytes (d->loader, bytes, NULL)) {
+                /* Can't decode it progressively, just save it */
+                g_signal_handlers_disconnect_by_data (d->loader, d);
+                gdk_pixbuf_loader_close (d->loader, NULL);
+                g_clear_object (&d->loader);
+        }
+
+        g_input_stream_read_bytes_async (d->input,
+                                         DOWNLOAD_CHUNK_SIZE,
+                                         G_PRIORITY_LOW,
+                                         d->cancellable,
+                                         download_read,
+                                         d);
+}
+
+static void
+download_sent (GObject      *source,
+               GAsyncResult *result,
+               gpointer      data)
+{
+        Download *d = data;
+        g_autoptr(GFile) file = NULL;
+        g_autoptr(GError) error = NULL;
+
+        d->input = soup_session_send_finish (SOUP_SESSION (source), result, &error);
+
+        if (d->ri == NULL || g_cancellable_is_cancelled (d->cancellable)) {
+                g_debug ("Message cancelled");
+                download_free (d);
+                return;
+        }
+
+        if (d->input == NULL) {
+                g_debug ("Got error %s, record failure to load %s", error->message, d->cache_path);
+                write_negative_cache_entry (d->cache_path);
+                finish_download (d, FALSE);
+                return;
+        }
+
+        if (d->msg->status_code == SOUP_STATUS_NOT_MODIFIED) {
+                g_debug ("Image not modified");
+                update_image_timestamp (d->cache_path);
+                finish_download (d, TRUE);
+                return;
+        }
+        else if (d->msg->status_code != SOUP_STATUS_OK) {
+                g_debug ("Got status %d, record failure to load %s", d->msg->status_code, d->cache_path);
+                write_negative_cache_entry (d->cache_path);
+                finish_download (d, FALSE);
+                return;
+        }
+
+        g_debug ("Saving image to %s", d->cache_path);
+
+        file = g_file_new_for_path (d->cache_path);
+        d->output = G_OUTPUT_STREAM (g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE, d->cancellable, &error));
+        if (d->output == NULL) {
+                g_debug ("Saving image to %s failed: %s", d->cache_path, error->message);
+                finish_download (d, FALSE);
+                return;
+        }
+
+        if (d != d->ri->thumbnail_download) {
+                d->loader = gdk_pixbuf_loader_new ();
+                g_signal_connect (d->loader, "area-updated", G_CALLBACK (download_area_updated), d);
+        }
+
+        g_input_stream_read_bytes_async (d->input,
+                                         DOWNLOAD_CHUNK_SIZE,
+                                         G_PRIORITY_LOW,
+                                         d->cancellable,
+                                         download_read,
+                                         d);
+}
+
+static Download *
+start_download (GrImage    *ri,
+                const char *url,
+                const char *cache_path)
+{
+        Download *d;
+        g_autoptr(SoupURI) base_uri = NULL;
+        g_autofree char *cache_dir = NULL;
+
+        /* The cache directory is only needed once we write to it */
+        cache_dir = g_path_get_dirname (cache_path);
+        g_mkdir_with_parents (cache_dir, 0755);
+
+        d = g_new0 (Download, 1);
+        d->ri = ri;
+        d->cache_path = g_strdup (cache_path);
+        d->cancellable = g_cancellable_new ();
+
+        base_uri = soup_uri_new (url);
+        d->msg = soup_message_new_from_uri (SOUP_METHOD_GET, base_uri);
+        set_modified_request (d->msg, cache_path);
+
+        soup_session_send_async (ri->session, d->msg, d->cancellable, download_sent, d);
+
+        return d;
+}
+
+/* We store images in local recipes with an absolute path nowadays.
+ * We used to store them as a relative path starting with images/,
+ * so try that case as well.
+ */
+static char *
+get_local_path (GrImage *ri)
+{
+        if (ri->path[0] == '/')
+                return g_strdup (ri->path);
+        else if (g_str_has_prefix (ri->path, "images/"))
+                return g_build_filename (get_user_data_dir (), ri->path, NULL);
+
+        return NULL;
+}
+
 static void
 gr_image_load_full (GrImage         *ri,
                     int              width,
@@ -414,22 +1083,15 @@ gr_image_load_full (GrImage         *ri,
         g_autoptr(GdkPixbuf) pixbuf = NULL;
         gboolean need_image;
         gboolean need_thumbnail;
+        gboolean small;
         g_autofree char *local_path = NULL;
 
-        /* We store images in local recipes with an absolute path nowadays.
-         * We used to store them as a relative path starting with images/,
-         * so try that case as well.
-         */
         if (ri->path == NULL) {
                 g_warning ("No image path");
                 return;
         }
 
-        if (ri->path[0] == '/')
-                local_path = g_strdup (ri->path);
-        else if (g_str_has_prefix (ri->path, "images/"))
-                local_path = g_build_filename (get_user_data_dir (), ri->path, NULL);
-
+        local_path = get_local_path (ri);
         if (local_path) {
                 pixbuf = load_pixbuf (local_path, width, height, fit);
                 if (pixbuf) {
@@ -442,20 +1104,18 @@ gr_image_load_full (GrImage         *ri,
         image_cache_path = get_image_cache_path (ri);
         thumbnail_cache_path = get_thumbnail_cache_path (ri);
 
-        need_thumbnail = do_thumbnail && should_try_load (thumbnail_cache_path);
-        need_image = should_try_load (image_cache_path);
+        small = width <= 150 && height <= 150;
 
-        if (width <= 150 && height <= 150) {
-                pixbuf = load_pixbuf (thumbnail_cache_path, width, height, fit);
-                need_image = FALSE;
-        }
-        else {
-                pixbuf = load_pixbuf (image_cache_path, width, height, fit);
-        }
+        pixbuf = load_pixbuf (small ? thumbnail_cache_path : image_cache_path, width, height, fit);
+        if (pixbuf == NULL)
+                check_cache_file (small ? thumbnail_cache_path : image_cache_path);
+
+        need_thumbnail = do_thumbnail && should_try_load (thumbnail_cache_path);
+        need_image = !small && should_try_load (image_cache_path);
 
         if (pixbuf) {
                  g_debug ("Use cached %s for %s",
-                          width <= 150 && height <= 150 ? "thumbnail" : "image",
+                          small ? "thumbnail" : "image",
                           ri->path);
                 callback (ri, pixbuf, data);
         }
@@ -486,36 +1146,29 @@ gr_image_load_full (GrImage         *ri,
         td->width = width;
         td->height = height;
         td->fit = fit;
+        td->preview = do_thumbnail;
         td->cancellable = cancellable ? g_object_ref (cancellable) : NULL;
         td->callback = callback;
         td->data = data;
 
         ri->pending = g_list_prepend (ri->pending, td);
 
-        if (need_thumbnail && ri->thumbnail_message == NULL) {
+        if (need_thumbnail && ri->thumbnail_download == NULL) {
                 g_autofree char *url = NULL;
-                g_autoptr(SoupURI) base_uri = NULL;
 
                 url = get_thumbnail_url (ri);
-                base_uri = soup_uri_new (url);
-                ri->thumbnail_message = soup_message_new_from_uri (SOUP_METHOD_GET, base_uri);
-                set_modified_request (ri->thumbnail_message, thumbnail_cache_path);
                 g_debug ("Load thumbnail for %s from %s", ri->path, url);
-                soup_session_queue_message (ri->session, g_object_ref (ri->thumbnail_message), set_image, ri);
+                ri->thumbnail_download = start_download (ri, url, thumbnail_cache_path);
                 if (width > 150 || height > 150)
                         need_image = TRUE;
         }
 
-        if (need_image && ri->image_message == NULL) {
+        if (need_image && ri->image_download == NULL) {
                 g_autofree char *url = NULL;
-                g_autoptr(SoupURI) base_uri = NULL;
 
                 url = get_image_url (ri);
-                base_uri = soup_uri_new (url);
-                ri->image_message = soup_message_new_from_uri (SOUP_METHOD_GET, base_uri);
-                set_modified_request (ri->image_message, image_cache_path);
                 g_debug ("Load image for %s from %s", ri->path, url);
-                soup_session_queue_message (ri->session, g_object_ref (ri->image_message), set_image, ri);
+                ri->image_download = start_download (ri, url, image_cache_path);
         }
 }
 
@@ -531,6 +1184,300 @@ gr_image_load (GrImage         *ri,
         gr_image_load_full (ri, width, height, fit, TRUE, cancellable, callback, data);
 }
 
+/* Prefetching
+ *
+ * Tiles ask us to warm the sizes that the details page will need
+ * as soon as they are shown, and with priority when they are hovered.
+ * Prefetching only decodes: it never starts a download of its own, so
+ * showing a tile only ever fetches the image at the size the tile
+ * needs. An image that is still being downloaded for display is
+ * decoded when that download is done; one that isn't available and
+ * isn't coming is skipped.
+ *
+ * Requests are worked through newest-first, one at a time, and the
+ * decoding happens in a thread, so this never competes with visible
+ * loads. Urgent requests go ahead of all others, and while there are
+ * any, the next one is started at default idle priority instead of a
+ * low one.
+ */
+typedef struct {
+        GrImage *ri;
+        int width;
+        int height;
+        gboolean fit;
+        gboolean urgent;
+        char *path;
+} PrefetchData;
+
+#define PREFETCH_QUEUE_LENGTH 24
+
+static GQueue prefetch_queue = G_QUEUE_INIT;
+static guint prefetch_n_urgent;
+static guint prefetch_idle;
+static int prefetch_priority;
+static gboolean prefetch_busy;
+
+static void
+prefetch_data_free (gpointer data)
+{
+        PrefetchData *pd = data;
+
+        if (pd->urgent)
+                prefetch_n_urgent--;
+        g_object_unref (pd->ri);
+        g_free (pd->path);
+        g_free (pd);
+}
+
+static gboolean prefetch_one (gpointer data);
+
+static void
+schedule_prefetch (void)
+{
+        int priority;
+
+        if (prefetch_busy || prefetch_queue.length == 0)
+                return;
+
+        priority = prefetch_n_urgent > 0 ? G_PRIORITY_DEFAULT_IDLE : G_PRIORITY_LOW;
+
+        if (prefetch_idle != 0 && prefetch_priority == priority)
+                return;
+
+        if (prefetch_idle != 0)
+                g_source_remove (prefetch_idle);
+
+        prefetch_priority = priority;
+        prefetch_idle = g_idle_add_full (priority, prefetch_one, NULL, NULL);
+}
+
+static void
+prefetch_finish (void)
+{
+        prefetch_busy = FALSE;
+        schedule_prefetch ();
+}
+
+static void
+decode_thread (GTask        *task,
+               gpointer      source,
+               gpointer      task_data,
+               GCancellable *cancellable)
+{
+        PrefetchData *pd = task_data;
+        GdkPixbuf *pixbuf;
+
+        pixbuf = decode_pixbuf (pd->path, pd->width, pd->height, pd->fit);
+        if (pixbuf)
+                g_task_return_pointer (task, pixbuf, g_object_unref);
+        else
+                g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_FAILED,
+                                         _("Failed to load image %s"), pd->path);
+}
+
+static void
+prefetch_decoded (GObject      *source,
+                  GAsyncResult *result,
+                  gpointer      data)
+{
+        GrImage *ri = GR_IMAGE (source);
+        PrefetchData *pd = g_task_get_task_data (G_TASK (result));
+        g_autoptr(GdkPixbuf) pixbuf = NULL;
+        g_autoptr(GError) error = NULL;
+
+        pixbuf = g_task_propagate_pointer (G_TASK (result), &error);
+        if (pixbuf == NULL)
+                g_debug ("Prefetching %s failed: %s", pd->path, error->message);
+        else if (ri->image_download != NULL)
+                g_debug ("Not keeping prefetched %s, it is being replaced", pd->path);
+        else {
+                g_autofree char *key = NULL;
+
+                key = get_decoded_key (pd->path, pd->width, pd->height, pd->fit);
+                decoded_insert (key, pixbuf);
+        }
+
+        prefetch_finish ();
+}
+
+static void
+start_decode (PrefetchData *pd)
+{
+        g_autoptr(GTask) task = NULL;
+
+        task = g_task_new (pd->ri, NULL, prefetch_decoded, NULL);
+        g_task_set_task_data (task, pd, prefetch_data_free);
+        g_task_run_in_thread (task, decode_thread);
+}
+
+static void
+prefetch_fetched (GObject      *source,
+                  GAsyncResult *result,
+                  gpointer      data)
+{
+        PrefetchData *pd = data;
+        g_autoptr(GError) error = NULL;
+
+        pd->path = gr_image_fetch_finish (GR_IMAGE (source), result, &error);
+        if (pd->path == NULL) {
+                g_debug ("Not prefetching %s: %s", pd->ri->path, error->message);
+                prefetch_data_free (pd);
+                prefetch_finish ();
+                return;
+        }
+
+        start_decode (pd);
+}
+
+static gboolean
+prefetch_one (gpointer data)
+{
+        PrefetchData *pd;
+        g_autoptr(GdkPixbuf) pixbuf = NULL;
+        g_autofree char *key = NULL;
+        GrImage *ri;
+        CacheInfo *info;
+
+        prefetch_idle = 0;
+
+        pd = g_queue_pop_head (&prefetch_queue);
+        if (pd == NULL)
+                return G_SOURCE_REMOVE;
+
+        ri = pd->ri;
+
+        pd->path = get_local_path (ri);
+        if (pd->path == NULL)
+                pd->path = get_image_cache_path (ri);
+
+        key = get_decoded_key (pd->path, pd->width, pd->height, pd->fit);
+        pixbuf = decoded_lookup (key);
+        if (pixbuf) {
+                prefetch_data_free (pd);
+                schedule_prefetch ();
+                return G_SOURCE_REMOVE;
+        }
+
+        g_debug ("Prefetch %dx%d for %s", pd->width, pd->height, ri->path);
+
+        prefetch_busy = TRUE;
+
+        if (ri->path[0] == '/' || g_str_has_prefix (ri->path, "images/")) {
+                start_decode (pd);
+                return G_SOURCE_REMOVE;
+        }
+
+        /* Piggyback on a download for display, but don't start one */
+        if (ri->image_download != NULL) {
+                g_clear_pointer (&pd->path, g_free);
+                gr_image_fetch (ri, NULL, prefetch_fetched, pd);
+                return G_SOURCE_REMOVE;
+        }
+
+        check_cache_file (pd->path);
+        info = lookup_cache_info (pd->path);
+        if (info->exists && !info->negative) {
+                start_decode (pd);
+                return G_SOURCE_REMOVE;
+        }
+
+        g_debug ("Not prefetching %s, it is not downloaded", ri->path);
+        prefetch_data_free (pd);
+        prefetch_finish ();
+
+        return G_SOURCE_REMOVE;
+}
+
+void
+gr_image_prefetch (GrImage  *ri,
+                   int       width,
+                   int       height,
+                   gboolean  fit,
+                   gboolean  urgent)
+{
+        PrefetchData *pd;
+
+        if (ri->path == NULL || get_decoded_budget () == 0)
+                return;
+
+        pd = g_new0 (PrefetchData, 1);
+        pd->ri = g_object_ref (ri);
+        pd->width = width;
+        pd->height = height;
+        pd->fit = fit;
+        pd->urgent = urgent;
+
+        if (urgent) {
+                g_queue_push_head (&prefetch_queue, pd);
+                prefetch_n_urgent++;
+        }
+        else {
+                g_queue_push_nth (&prefetch_queue, pd, prefetch_n_urgent);
+        }
+
+        /* Old requests are for tiles that have likely scrolled by */
+        while (g_queue_get_length (&prefetch_queue) > PREFETCH_QUEUE_LENGTH)
+                prefetch_data_free (g_queue_pop_tail (&prefetch_queue));
+
+        schedule_prefetch ();
+}
+
+/* Makes sure that the full-size image is available as a file,
+ * downloading it into the cache if needed, without decoding it.
+ * The result is the path of the file.
+ */
+void
+gr_image_fetch (GrImage             *ri,
+                GCancellable        *cancellable,
+                GAsyncReadyCallback  callback,
+                gpointer             data)
+{
+        g_autoptr(GTask) task = NULL;
+        g_autofree char *path = NULL;
+        CacheInfo *info;
+
+        task = g_task_new (ri, cancellable, callback, data);
+        g_task_set_check_cancellable (task, TRUE);
+
+        path = gr_image_get_cache_path (ri);
+        if (ri->path[0] == '/') {
+                g_task_return_pointer (task, g_steal_pointer (&path), g_free);
+                return;
+        }
+
+        check_cache_file (path);
+
+        info = lookup_cache_info (path);
+        if (info->exists && !info->negative) {
+                g_task_return_pointer (task, g_steal_pointer (&path), g_free);
+                return;
+        }
+
+        if (!should_try_load (path)) {
+                g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                                         _("Image %s is not available"), ri->path);
+                return;
+        }
+
+        ri->fetches = g_list_prepend (ri->fetches, g_steal_pointer (&task));
+
+        if (ri->image_download == NULL) {
+                g_autofree char *url = NULL;
+
+                url = get_image_url (ri);
+                g_debug ("Fetch image for %s from %s", ri->path, url);
+                ri->image_download = start_download (ri, url, path);
+        }
+}
+
+char *
+gr_image_fetch_finish (GrImage       *ri,
+                       GAsyncResult  *result,
+                       GError       **error)
+{
+        return g_task_propagate_pointer (G_TASK (result), error);
+}
+
 void
 gr_image_set_pixbuf (GrImage   *ri,
                      GdkPixbuf *pixbuf,
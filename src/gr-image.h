@@ -43,6 +43,14 @@ GdkPixbuf  *gr_image_load_sync   (GrImage           *image,
                                   int                 height,
                                   gboolean            fit);
 
+void        gr_image_fetch        (GrImage             *image,
+                                   GCancellable        *cancellable,
+                                   GAsyncReadyCallback  callback,
+                                   gpointer             data);
+char       *gr_image_fetch_finish (GrImage             *image,
+                                   GAsyncResult        *result,
+                                   GError             **error);
+
 typedef void (*GrImageCallback) (GrImage   *ri,
                                  GdkPixbuf *pixbuf,
                                  gpointer   data);
@@ -55,6 +63,12 @@ void        gr_image_load        (GrImage            *ri,
                                   GrImageCallback     callback,
                                   gpointer            data);
 
+void        gr_image_prefetch    (GrImage            *ri,
+                                  int                 width,
+                                  int                 height,
+                                  gboolean            fit,
+                                  gboolean            urgent);
+
 void        gr_image_set_pixbuf  (GrImage   *ri,
                                   GdkPixbuf *pixbuf,
                                   gpointer   data);
@@ -36,7 +36,6 @@ struct _GrIngredientRow
 
         char *id;
         char *ingredient;
-        char *cf_ingredient;
 
         gboolean include;
         gboolean exclude;
@@ -63,7 +62,6 @@ gr_ingredient_row_finalize (GObject *object)
         g_clear_object (&self->tag);
         g_free (self->id);
         g_free (self->ingredient);
-        g_free (self->cf_ingredient);
 
         G_OBJECT_CLASS (gr_ingredient_row_parent_class)->finalize (object);
 }
@@ -184,9 +182,6 @@ gr_ingredient_row_set_property (GObject      *object,
                                 term = self->ingredient;
                         g_free (self->id);
                         self->id = g_strdup (term);
-
-                        g_free (self->cf_ingredient);
-                        self->cf_ingredient = g_utf8_casefold (self->ingredient, -1);
                   }
                   break;
           case PROP_INCLUDE:
@@ -271,12 +266,6 @@ gr_ingredient_row_get_search_term (GrIngredientRow *row)
 }
 
 
-const char *
-gr_ingredient_row_get_filter_term (GrIngredientRow *row)
-{
-        return row->cf_ingredient;
-}
-
 char *
 gr_ingredient_row_get_label (GrIngredientRow *row)
 {
@@ -20,6 +20,8 @@
 
 #include "config.h"
 
+#include <stdlib.h>
+#include <string.h>
 #include <glib.h>
 #include <glib/gi18n.h>
 
@@ -38,8 +40,43 @@ static const char *negations[] = {
 };
 
 static char **names;
-static char **cf_names;
-static char **cf_en_names;
+
+/* Casefolded names, translated and English, mapped to their index
+ * (plus one, so that 0 means not found). Used for exact lookups.
+ */
+static GHashTable *cf_index;
+
+/* The casefolded translated names in sorted order, for completion */
+typedef struct {
+        char *cf_name;
+        int index;
+} Completion;
+
+static Completion *completions;
+static int n_completions;
+
+static int
+compare_completions (gconstpointer a,
+                     gconstpointer b)
+{
+        const Completion *ca = a;
+        const Completion *cb = b;
+
+        return strcmp (ca->cf_name, cb->cf_name);
+}
+
+static void
+add_to_index (char *cf_name,
+              int   index)
+{
+        /* Keep the first match, like a linear search would */
+        if (g_hash_table_contains (cf_index, cf_name)) {
+                g_free (cf_name);
+                return;
+        }
+
+        g_hash_table_insert (cf_index, cf_name, GINT_TO_POINTER (index + 1));
+}
 
 static void
 translate_names (void)
@@ -50,14 +87,33 @@ translate_names (void)
                 return;
 
         names = g_new0 (char *, G_N_ELEMENTS (names_));
-        cf_names = g_new0 (char *, G_N_ELEMENTS (names_));
-        cf_en_names = g_new0 (char *, G_N_ELEMENTS (names_));
+        cf_index = g_hash_table_new (g_str_hash, g_str_equal);
+        completions = g_new0 (Completion, G_N_ELEMENTS (names_));
 
         for (i = 0; names_[i]; i++) {
                 names[i] = _(names_[i]);
-                cf_names[i] = g_utf8_casefold (names[i], -1);
-                cf_en_names[i] = g_utf8_casefold (names_[i], -1);
+
+                completions[i].cf_name = g_utf8_casefold (names[i], -1);
+                completions[i].index = i;
+
+                add_to_index (g_strdup (completions[i].cf_name), i);
+                add_to_index (g_utf8_casefold (names_[i], -1), i);
         }
+
+        n_completions = i;
+        qsort (completions, n_completions, sizeof (Completion), compare_completions);
+}
+
+static int
+find_index (const char *text)
+{
+        g_autofree char *cf_text = NULL;
+
+        translate_names ();
+
+        cf_text = g_utf8_casefold (text, -1);
+
+        return GPOINTER_TO_INT (g_hash_table_lookup (cf_index, cf_text)) - 1;
 }
 
 const char **
@@ -75,38 +131,59 @@ const char *
 gr_ingredient_find (const char *text)
 {
         int i;
-        g_autofree char *cf_text = NULL;
-
-        translate_names ();
-
-        cf_text = g_utf8_casefold (text, -1);
 
-        for (i = 0; names[i]; i++) {
-                if (strcmp (cf_text, cf_names[i]) == 0 ||
-                    strcmp (cf_text, cf_en_names[i]) == 0)
-                        return names[i];
-        }
+        i = find_index (text);
 
-        return NULL;
+        return i < 0 ? NULL : names[i];
 }
 
 const char *
 gr_ingredient_get_id (const char *name)
 {
         int i;
-        g_autofree char *cf_text = NULL;
+
+        i = find_index (name);
+
+        return i < 0 ? NULL : names_[i];
+}
+
+/* Returns the translated names that start with @prefix, ignoring
+ * case, in sorted order. Free the returned array with g_free().
+ */
+const char **
+gr_ingredient_complete (const char *prefix)
+{
+        g_autofree char *cf_prefix = NULL;
+        const char **ret;
+        int low, high;
+        int i, n;
 
         translate_names ();
 
-        cf_text = g_utf8_casefold (name, -1);
+        cf_prefix = g_utf8_casefold (prefix, -1);
 
-        for (i = 0; names[i]; i++) {
-                if (strcmp (cf_text, cf_names[i]) == 0 ||
-                    strcmp (cf_text, cf_en_names[i]) == 0)
-                        return names_[i];
+        /* Find the first entry that is not smaller than the prefix */
+        low = 0;
+        high = n_completions;
+        while (low < high) {
+                int mid = low + (high - low) / 2;
+
+                if (strcmp (completions[mid].cf_name, cf_prefix) < 0)
+                        low = mid + 1;
+                else
+                        high = mid;
         }
 
-        return NULL;
+        for (i = low; i < n_completions; i++) {
+                if (!g_str_has_prefix (completions[i].cf_name, cf_prefix))
+                        break;
+        }
+
+        ret = g_new0 (const char *, i - low + 1);
+        for (n = 0; low + n < i; n++)
+                ret[n] = names[completions[low + n].index];
+
+        return ret;
 }
 
 const char *
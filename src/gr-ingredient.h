@@ -28,5 +28,6 @@ const char    **gr_ingredient_get_names    (int        *length);
 const char     *gr_ingredient_find         (const char *text);
 const char     *gr_ingredient_get_id       (const char *name);
 const char     *gr_ingredient_get_negation (const char *name);
+const char    **gr_ingredient_complete     (const char *prefix);
 
 G_END_DECLS
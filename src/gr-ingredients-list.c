@@ -20,6 +20,7 @@
 
 #include "config.h"
 
+#include <string.h>
 #include <glib.h>
 #include <glib/gi18n.h>
 
@@ -30,51 +31,73 @@
 #include "gr-utils.h"
 
 
-typedef struct
-{
-        double amount;
-        GrUnit unit;
-        gchar *name;
-        gchar *segment;
-} Ingredient;
-
-static void
-ingredient_free (Ingredient *ing)
-{
-        g_free (ing->name);
-        g_free (ing->segment);
-        g_free (ing);
-}
-
+/* The parsed ingredients are kept as parallel arrays, one entry per
+ * line. Names of known ingredients are interned; everything else the
+ * user typed is kept in a string chunk that belongs to the list, with
+ * one copy of each distinct string, so segments can be compared by
+ * pointer. Once built, the list is never modified and can be shared.
+ */
 struct _GrIngredientsList
 {
         GObject parent_instance;
 
-        GList *ingredients;
-        GHashTable *segments;
+        guint n_items;
+        double *amounts;
+        GrUnit *units;
+        const char **names;
+        guint *segments;
+
+        GPtrArray *segment_names;
+        GStringChunk *strings;
 };
 
 G_DEFINE_TYPE (GrIngredientsList, gr_ingredients_list, G_TYPE_OBJECT)
 
+static guint
+find_segment (GrIngredientsList *ingredients,
+              const char        *segment)
+{
+        guint i;
+
+        for (i = 0; i < ingredients->segment_names->len; i++) {
+                if (g_ptr_array_index (ingredients->segment_names, i) == segment)
+                        return i;
+        }
+
+        g_ptr_array_add (ingredients->segment_names, (gpointer)segment);
+
+        return i;
+}
+
 static gboolean
 gr_ingredients_list_populate (GrIngredientsList  *ingredients,
                               const char         *text,
                               GError            **error)
 {
         g_auto(GStrv) lines = NULL;
+        g_autoptr(GArray) amounts = NULL;
+        g_autoptr(GArray) units = NULL;
+        g_autoptr(GArray) names = NULL;
+        g_autoptr(GArray) segments = NULL;
         int i;
 
         lines = g_strsplit (text, "\n", 0);
 
+        amounts = g_array_new (FALSE, FALSE, sizeof (double));
+        units = g_array_new (FALSE, FALSE, sizeof (GrUnit));
+        names = g_array_new (FALSE, FALSE, sizeof (const char *));
+        segments = g_array_new (FALSE, FALSE, sizeof (guint));
+
         for (i = 0; lines[i]; i++) {
                 g_auto(GStrv) fields = NULL;
                 char *amount;
                 char *unit;
                 char *ingredient;
                 char *segment;
+                double a;
                 GrUnit u;
                 const char *s;
-                Ingredient *ing;
+                guint seg;
                 g_autoptr(GError) local_error = NULL;
 
                 if (lines[i][0] == '\0')
@@ -91,12 +114,10 @@ gr_ingredients_list_populate (GrIngredientsList  *ingredients,
                 ingredient = fields[2];
                 segment = fields[3];
 
-                ing = g_new0 (Ingredient, 1);
-                ing->amount = 1.0;
+                a = 1.0;
                 if (amount[0] != '\0' &&
-                    !gr_number_parse (&ing->amount, &amount, &local_error)) {
+                    !gr_number_parse (&a, &amount, &local_error)) {
                         g_message ("failed to parse amount '%s': %s", amount, local_error->message);
-                        g_free (ing);
                         continue;
                 }
 
@@ -106,19 +127,25 @@ gr_ingredients_list_populate (GrIngredientsList  *ingredients,
                         g_message ("%s; using %s as-is", local_error->message, unit);
                 }
 
-                ing->unit = u;
-                ing->segment = g_strdup (segment);
-
                 s = gr_ingredient_find (ingredient);
                 if (s)
-                        ing->name = g_strdup (s);
+                        s = g_intern_string (s);
                 else
-                        ing->name = g_strdup (ingredient);
+                        s = g_string_chunk_insert_const (ingredients->strings, ingredient);
+                seg = find_segment (ingredients, g_string_chunk_insert_const (ingredients->strings, segment));
 
-                g_hash_table_add (ingredients->segments, g_strdup (segment));
-                ingredients->ingredients = g_list_append (ingredients->ingredients, ing);
+                g_array_append_val (amounts, a);
+                g_array_append_val (units, u);
+                g_array_append_val (names, s);
+                g_array_append_val (segments, seg);
         }
 
+        ingredients->n_items = amounts->len;
+        ingredients->amounts = (double *)g_array_free (g_steal_pointer (&amounts), FALSE);
+        ingredients->units = (GrUnit *)g_array_free (g_steal_pointer (&units), FALSE);
+        ingredients->names = (const char **)g_array_free (g_steal_pointer (&names), FALSE);
+        ingredients->segments = (guint *)g_array_free (g_steal_pointer (&segments), FALSE);
+
         return TRUE;
 }
 
@@ -127,8 +154,12 @@ ingredients_list_finalize (GObject *object)
 {
         GrIngredientsList *self = GR_INGREDIENTS_LIST (object);
 
-        g_list_free_full (self->ingredients, (GDestroyNotify)ingredient_free);
-        g_hash_table_unref (self->segments);
+        g_free (self->amounts);
+        g_free (self->units);
+        g_free (self->names);
+        g_free (self->segments);
+        g_ptr_array_unref (self->segment_names);
+        g_string_chunk_free (self->strings);
 
         G_OBJECT_CLASS (gr_ingredients_list_parent_class)->finalize (object);
 }
@@ -136,7 +167,8 @@ ingredients_list_finalize (GObject *object)
 static void
 gr_ingredients_list_init (GrIngredientsList *ingredients)
 {
-        ingredients->segments = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+        ingredients->segment_names = g_ptr_array_new ();
+        ingredients->strings = g_string_chunk_new (256);
 }
 
 static void
@@ -169,27 +201,39 @@ gr_ingredients_list_validate (const char  *text,
         return gr_ingredients_list_populate (ingredients, text, error);
 }
 
-static void
-ingredient_scale_unit (Ingredient *ing, double scale, GString *s)
+static int
+find_ingredient (GrIngredientsList *ingredients,
+                 const char        *segment,
+                 const char        *name)
 {
-        g_autofree char *scaled = NULL;
+        guint i;
 
-        scaled = gr_number_format (scale * ing->amount);
+        for (i = 0; i < ingredients->n_items; i++) {
+                const char *seg = g_ptr_array_index (ingredients->segment_names, ingredients->segments[i]);
 
-        g_string_append (s, scaled);
-        if (ing->unit) {
-                g_string_append (s, " ");
-                g_string_append (s, gr_unit_get_abbreviation (ing->unit));
+                if (g_strcmp0 (segment, seg) == 0 &&
+                    g_strcmp0 (name, ingredients->names[i]) == 0)
+                        return i;
         }
+
+        return -1;
 }
 
 static void
-ingredient_scale (Ingredient *ing, int num, int denom, GString *s)
+ingredient_scale_unit (GrIngredientsList *ingredients,
+                       guint              i,
+                       double             scale,
+                       GString           *s)
 {
-        ingredient_scale_unit (ing, (double)num / (double)denom, s);
-        g_string_append (s, " ");
-        g_string_append (s, ing->name);
-        g_string_append (s, "\n");
+        g_autofree char *scaled = NULL;
+
+        scaled = gr_number_format (scale * ingredients->amounts[i]);
+
+        g_string_append (s, scaled);
+        if (ingredients->units[i]) {
+                g_string_append (s, " ");
+                g_string_append (s, gr_unit_get_abbreviation (ingredients->units[i]));
+        }
 }
 
 char *
@@ -198,14 +242,15 @@ gr_ingredients_list_scale (GrIngredientsList *ingredients,
                            int                denom)
 {
         GString *s;
-        GList *l;
+        guint i;
 
         s = g_string_new ("");
 
-        for (l = ingredients->ingredients; l; l = l->next) {
-                Ingredient *ing = (Ingredient *)l->data;
-
-                ingredient_scale (ing, num, denom, s);
+        for (i = 0; i < ingredients->n_items; i++) {
+                ingredient_scale_unit (ingredients, i, (double)num / (double)denom, s);
+                g_string_append (s, " ");
+                g_string_append (s, ingredients->names[i]);
+                g_string_append (s, "\n");
         }
 
         return g_string_free (s, FALSE);
@@ -214,7 +259,14 @@ gr_ingredients_list_scale (GrIngredientsList *ingredients,
 char **
 gr_ingredients_list_get_segments (GrIngredientsList *ingredients)
 {
-        return (char **)g_hash_table_get_keys_as_array (ingredients->segments, NULL);
+        char **ret;
+        guint i;
+
+        ret = g_new0 (char *, ingredients->segment_names->len + 1);
+        for (i = 0; i < ingredients->segment_names->len; i++)
+                ret[i] = g_ptr_array_index (ingredients->segment_names, i);
+
+        return ret;
 }
 
 char **
@@ -222,14 +274,14 @@ gr_ingredients_list_get_ingredients (GrIngredientsList *ingredients,
                                      const char        *segment)
 {
         char **ret;
-        int i;
-        GList *l;
+        guint i, j;
+
+        ret = g_new0 (char *, ingredients->n_items + 1);
+        for (i = 0, j = 0; i < ingredients->n_items; i++) {
+                const char *seg = g_ptr_array_index (ingredients->segment_names, ingredients->segments[i]);
 
-        ret = g_new0 (char *, g_list_length (ingredients->ingredients) + 1);
-        for (i = 0, l = ingredients->ingredients; l; l = l->next) {
-                Ingredient *ing = (Ingredient *)l->data;
-                if (g_strcmp0 (segment, ing->segment) == 0)
-                        ret[i++] = g_strdup (ing->name);
+                if (g_strcmp0 (segment, seg) == 0)
+                        ret[j++] = g_strdup (ingredients->names[i]);
         }
 
         return ret;
@@ -241,23 +293,17 @@ gr_ingredients_list_scale_unit (GrIngredientsList *ingredients,
                                 const char        *name,
                                 double             scale)
 {
-        GList *l;
-
-        for (l = ingredients->ingredients; l; l = l->next) {
-                Ingredient *ing = (Ingredient *)l->data;
-
-                if (g_strcmp0 (segment, ing->segment) == 0 &&
-                    g_strcmp0 (name, ing->name) == 0) {
-                        GString *s;
+        GString *s;
+        int i;
 
-                        s = g_string_new ("");
-                        ingredient_scale_unit (ing, scale, s);
+        i = find_ingredient (ingredients, segment, name);
+        if (i < 0)
+                return NULL;
 
-                        return g_string_free (s, FALSE);
-                }
-        }
+        s = g_string_new ("");
+        ingredient_scale_unit (ingredients, i, scale, s);
 
-        return NULL;
+        return g_string_free (s, FALSE);
 }
 
 GrUnit
@@ -265,18 +311,13 @@ gr_ingredients_list_get_unit (GrIngredientsList *ingredients,
                               const char        *segment,
                               const char        *name)
 {
-        GList *l;
-
-        for (l = ingredients->ingredients; l; l = l->next) {
-                Ingredient *ing = (Ingredient *)l->data;
+        int i;
 
-                if (g_strcmp0 (segment, ing->segment) == 0 &&
-                    g_strcmp0 (name, ing->name) == 0) {
-                        return ing->unit;
-                }
-        }
+        i = find_ingredient (ingredients, segment, name);
+        if (i < 0)
+                return GR_UNIT_UNKNOWN;
 
-        return GR_UNIT_UNKNOWN;
+        return ingredients->units[i];
 }
 
 double
@@ -284,18 +325,102 @@ gr_ingredients_list_get_amount (GrIngredientsList *ingredients,
                                 const char        *segment,
                                 const char        *name)
 {
-        GList *l;
+        int i;
+
+        i = find_ingredient (ingredients, segment, name);
+        if (i < 0)
+                return 0.0;
+
+        return ingredients->amounts[i];
+}
+
+guint
+gr_ingredients_list_get_n_items (GrIngredientsList *ingredients)
+{
+        return ingredients->n_items;
+}
 
-        for (l = ingredients->ingredients; l; l = l->next) {
-                Ingredient *ing = (Ingredient *)l->data;
+/* Stores the amounts of all ingredients, multiplied by @scale, in
+ * @amounts, which must have room for gr_ingredients_list_get_n_items()
+ * values. The amounts are indexed like the items visited by
+ * GrIngredientsListIter, see gr_ingredients_list_iter_get_index().
+ */
+void
+gr_ingredients_list_scale_amounts (GrIngredientsList *ingredients,
+                                   double             scale,
+                                   double            *amounts)
+{
+        const double *in = ingredients->amounts;
+        guint n = ingredients->n_items;
+        guint i;
 
-                if (g_strcmp0 (segment, ing->segment) == 0 &&
-                    g_strcmp0 (name, ing->name) == 0) {
-                        return ing->amount;
+        for (i = 0; i < n; i++)
+                amounts[i] = in[i] * scale;
+}
+
+/* Walks the ingredients of @list, or only those in @segment, in
+ * the order they appear in the recipe, visiting each one once.
+ */
+void
+gr_ingredients_list_iter_init (GrIngredientsListIter *iter,
+                               GrIngredientsList     *list,
+                               const char            *segment)
+{
+        guint i;
+
+        iter->list = list;
+        iter->index = 0;
+        iter->segment = -1;
+
+        if (segment == NULL)
+                return;
+
+        for (i = 0; i < list->segment_names->len; i++) {
+                if (strcmp (segment, g_ptr_array_index (list->segment_names, i)) == 0) {
+                        iter->segment = i;
+                        return;
                 }
         }
 
-        return 0.0;
+        /* No such segment, nothing to iterate */
+        iter->index = list->n_items;
 }
 
+gboolean
+gr_ingredients_list_iter_next (GrIngredientsListIter  *iter,
+                               const char            **segment,
+                               const char            **ingredient,
+                               double                 *amount,
+                               GrUnit                 *unit)
+{
+        GrIngredientsList *list = iter->list;
 
+        while (iter->index < list->n_items) {
+                guint i = iter->index++;
+
+                if (iter->segment >= 0 && list->segments[i] != (guint)iter->segment)
+                        continue;
+
+                if (segment)
+                        *segment = g_ptr_array_index (list->segment_names, list->segments[i]);
+                if (ingredient)
+                        *ingredient = list->names[i];
+                if (amount)
+                        *amount = list->amounts[i];
+                if (unit)
+                        *unit = list->units[i];
+
+                return TRUE;
+        }
+
+        return FALSE;
+}
+
+/* Returns the position of the item that was returned by the last
+ * call to gr_ingredients_list_iter_next() in the whole list.
+ */
+guint
+gr_ingredients_list_iter_get_index (GrIngredientsListIter *iter)
+{
+        return iter->index - 1;
+}
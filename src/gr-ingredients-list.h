@@ -50,5 +50,25 @@ GrUnit             gr_ingredients_list_get_unit        (GrIngredientsList  *list
 double             gr_ingredients_list_get_amount      (GrIngredientsList  *list,
                                                         const char         *segment,
                                                         const char         *ingredient);
+guint              gr_ingredients_list_get_n_items     (GrIngredientsList  *list);
+void               gr_ingredients_list_scale_amounts   (GrIngredientsList  *list,
+                                                        double              scale,
+                                                        double             *amounts);
+
+typedef struct {
+        GrIngredientsList *list;
+        int segment;
+        guint index;
+} GrIngredientsListIter;
+
+void               gr_ingredients_list_iter_init       (GrIngredientsListIter  *iter,
+                                                        GrIngredientsList      *list,
+                                                        const char             *segment);
+gboolean           gr_ingredients_list_iter_next       (GrIngredientsListIter  *iter,
+                                                        const char            **segment,
+                                                        const char            **ingredient,
+                                                        double                 *amount,
+                                                        GrUnit                 *unit);
+guint              gr_ingredients_list_iter_get_index  (GrIngredientsListIter  *iter);
 
 G_END_DECLS
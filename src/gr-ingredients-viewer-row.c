@@ -681,7 +681,9 @@ get_ingredients_model (void)
 
         if (!signal_connected) {
                 g_signal_connect (store, "recipe-added", G_CALLBACK (clear_ingredients_model), NULL);
+                g_signal_connect (store, "recipes-added", G_CALLBACK (clear_ingredients_model), NULL);
                 g_signal_connect (store, "recipe-changed", G_CALLBACK (clear_ingredients_model), NULL);
+                g_signal_connect (store, "recipes-updated", G_CALLBACK (clear_ingredients_model), NULL);
 
                 signal_connected = TRUE;
         }
@@ -57,6 +57,7 @@ struct _GrIngredientsViewer
         GtkWidget *row_after;
 
         double scale;
+        GrIngredientsList *ingredients;
 };
 
 
@@ -71,7 +72,8 @@ enum {
         PROP_INGREDIENTS,
         PROP_SCALE_NUM,
         PROP_SCALE_DENOM,
-        PROP_SCALE
+        PROP_SCALE,
+        PROP_INGREDIENTS_LIST
 };
 
 enum {
@@ -89,6 +91,7 @@ gr_ingredients_viewer_finalize (GObject *object)
         g_free (viewer->title);
 
         g_clear_object (&viewer->group);
+        g_clear_object (&viewer->ingredients);
 
         G_OBJECT_CLASS (gr_ingredients_viewer_parent_class)->finalize (object);
 }
@@ -309,32 +312,29 @@ remove_list (GtkButton           *button,
 }
 
 static void
-gr_ingredients_viewer_set_ingredients (GrIngredientsViewer *viewer,
-                                       const char          *text)
+gr_ingredients_viewer_set_ingredients_list (GrIngredientsViewer *viewer,
+                                            GrIngredientsList   *ingredients)
 {
-        g_autoptr(GrIngredientsList) ingredients = NULL;
-        g_auto(GStrv) ings = NULL;
-        int i;
+        GrIngredientsListIter iter;
+        const char *name;
+        double amount;
+        GrUnit unit;
 
         container_remove_all (GTK_CONTAINER (viewer->list));
 
-        ingredients = gr_ingredients_list_new (text);
-        ings = gr_ingredients_list_get_ingredients (ingredients, viewer->title);
-        for (i = 0; ings && ings[i]; i++) {
-                double amount;
-                GrUnit unit;
-                GtkWidget *row;
-                g_autoptr(GString) s = NULL;
-                s = g_string_new ("");
-                double scale = viewer->scale;
+        g_set_object (&viewer->ingredients, ingredients);
 
-                unit = gr_ingredients_list_get_unit (ingredients, viewer->title, ings[i]);
-                amount = gr_ingredients_list_get_amount (ingredients, viewer->title, ings[i]) * scale;
+        if (ingredients == NULL || viewer->title == NULL)
+                return;
+
+        gr_ingredients_list_iter_init (&iter, ingredients, viewer->title);
+        while (gr_ingredients_list_iter_next (&iter, NULL, &name, &amount, &unit)) {
+                GtkWidget *row;
 
                 row = g_object_new (GR_TYPE_INGREDIENTS_VIEWER_ROW,
                                     "unit", unit,
-                                    "value", amount,
-                                    "ingredient", ings[i],
+                                    "value", amount * viewer->scale,
+                                    "ingredient", name,
                                     "size-group", viewer->group,
                                     "editable", viewer->editable,
                                     NULL);
@@ -343,10 +343,62 @@ gr_ingredients_viewer_set_ingredients (GrIngredientsViewer *viewer,
                 g_signal_connect (row, "move", G_CALLBACK (move_row), viewer);
                 g_signal_connect (row, "edit", G_CALLBACK (edit_ingredient_row), viewer);
 
+                /* Remember where the amount came from, for rescaling.
+                 * Rows that the user adds have no item.
+                 */
+                g_object_set_data (G_OBJECT (row), "item",
+                                   GUINT_TO_POINTER (gr_ingredients_list_iter_get_index (&iter) + 1));
+
                 gtk_container_add (GTK_CONTAINER (viewer->list), row);
         }
 }
 
+/* Updates the amounts of the existing rows in place, instead
+ * of recreating them from the ingredients list.
+ */
+static void
+gr_ingredients_viewer_set_scale (GrIngredientsViewer *viewer,
+                                 double               scale)
+{
+        g_autofree double *amounts = NULL;
+        GList *children, *l;
+        guint n_items;
+
+        if (viewer->scale == scale)
+                return;
+
+        viewer->scale = scale;
+
+        if (viewer->ingredients == NULL)
+                return;
+
+        n_items = gr_ingredients_list_get_n_items (viewer->ingredients);
+        amounts = g_new (double, n_items);
+        gr_ingredients_list_scale_amounts (viewer->ingredients, scale, amounts);
+
+        children = gtk_container_get_children (GTK_CONTAINER (viewer->list));
+        for (l = children; l; l = l->next) {
+                guint item;
+
+                item = GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (l->data), "item"));
+                if (item == 0 || item > n_items)
+                        continue;
+
+                g_object_set (l->data, "value", amounts[item - 1], NULL);
+        }
+        g_list_free (children);
+}
+
+static void
+gr_ingredients_viewer_set_ingredients (GrIngredientsViewer *viewer,
+                                       const char          *text)
+{
+        g_autoptr(GrIngredientsList) ingredients = NULL;
+
+        ingredients = gr_ingredients_list_new (text);
+        gr_ingredients_viewer_set_ingredients_list (viewer, ingredients);
+}
+
 static void
 gr_ingredients_viewer_set_title (GrIngredientsViewer *viewer,
                                  const char          *title)
@@ -618,13 +670,17 @@ gr_ingredients_viewer_set_property (GObject      *object,
                 break;
 
           case PROP_SCALE:
-                self->scale = g_value_get_double (value);
+                gr_ingredients_viewer_set_scale (self, g_value_get_double (value));
                 break;
 
           case PROP_INGREDIENTS:
                 gr_ingredients_viewer_set_ingredients (self, g_value_get_string (value));
                 break;
 
+          case PROP_INGREDIENTS_LIST:
+                gr_ingredients_viewer_set_ingredients_list (self, g_value_get_object (value));
+                break;
+
           default:
                 G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
           }
@@ -685,6 +741,11 @@ gr_ingredients_viewer_class_init (GrIngredientsViewerClass *klass)
                                      G_PARAM_READWRITE);
         g_object_class_install_property (object_class, PROP_INGREDIENTS, pspec);
 
+        pspec = g_param_spec_object ("ingredients-list", NULL, NULL,
+                                     GR_TYPE_INGREDIENTS_LIST,
+                                     G_PARAM_WRITABLE);
+        g_object_class_install_property (object_class, PROP_INGREDIENTS_LIST, pspec);
+
         pspec = g_param_spec_int ("scale-num", NULL, NULL,
                                   1, G_MAXINT, 1,
                                   G_PARAM_READWRITE);
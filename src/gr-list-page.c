@@ -26,7 +26,7 @@
 #include "gr-list-page.h"
 #include "gr-recipe-store.h"
 #include "gr-recipe.h"
-#include "gr-recipe-tile.h"
+#include "gr-recipe-grid.h"
 #include "gr-utils.h"
 #include "gr-season.h"
 #include "gr-category-tile.h"
@@ -51,6 +51,8 @@ struct _GrListPage
         GtkWidget *top_box;
         GtkWidget *list_stack;
         GtkWidget *flow_box;
+        GListStore *list_model;
+        GCompareDataFunc sort_func;
         GtkWidget *empty_title;
         GtkWidget *empty_subtitle;
 
@@ -105,6 +107,7 @@ list_page_finalize (GObject *object)
         g_clear_pointer (&self->season, g_free);
         g_list_free_full (self->recipes, g_object_unref);
         g_clear_object (&self->search);
+        g_clear_object (&self->list_model);
 
         G_OBJECT_CLASS (gr_list_page_parent_class)->finalize (object);
 }
@@ -134,7 +137,8 @@ static void
 search_started (GrRecipeSearch *search,
                 GrListPage     *page)
 {
-        container_remove_all (GTK_CONTAINER (page->flow_box));
+        gr_recipe_grid_set_model (GR_RECIPE_GRID (page->flow_box), G_LIST_MODEL (page->search));
+        gr_recipe_grid_set_show_shared (GR_RECIPE_GRID (page->flow_box), page->show_shared);
         hide_heading (page);
         page->count = 0;
 }
@@ -144,20 +148,9 @@ search_hits_added (GrRecipeSearch *search,
                    GList          *hits,
                    GrListPage     *page)
 {
-        GList *l;
         int count = page->count;
 
-        for (l = hits; l; l = l->next) {
-                GrRecipe *recipe = l->data;
-                GtkWidget *tile;
-
-                tile = gr_recipe_tile_new (recipe);
-                gr_recipe_tile_set_show_shared (GR_RECIPE_TILE (tile), page->show_shared);
-                gtk_widget_show (tile);
-                gtk_container_add (GTK_CONTAINER (page->flow_box), tile);
-
-                page->count++;
-        }
+        page->count += g_list_length (hits);
 
         if (count == 0 && page->count > 0)
                 show_heading (page);
@@ -168,21 +161,7 @@ search_hits_removed (GrRecipeSearch *search,
                      GList          *hits,
                      GrListPage     *page)
 {
-        GList *children, *l;
-
-        children = gtk_container_get_children (GTK_CONTAINER (page->flow_box));
-        for (l = children; l; l = l->next) {
-                GtkWidget *item = l->data;
-                GtkWidget *tile;
-                GrRecipe *recipe;
-
-                tile = gtk_bin_get_child (GTK_BIN (item));
-                recipe = gr_recipe_tile_get_recipe (GR_RECIPE_TILE (tile));
-                if (g_list_find (hits, recipe)) {
-                        gtk_container_remove (GTK_CONTAINER (page->flow_box), item);
-                        page->count--;
-                }
-        }
+        page->count -= g_list_length (hits);
 }
 
 static void
@@ -194,50 +173,34 @@ search_finished (GrRecipeSearch *search,
                                           page->count > 0 ? "list" : "empty");
 }
 
-static int
-name_sort_func (GtkFlowBoxChild *child1,
-                GtkFlowBoxChild *child2,
-                gpointer         data)
+static GCompareDataFunc
+get_sort_func (GrSortKey sort)
 {
-        GtkWidget *tile1 = gtk_bin_get_child (GTK_BIN (child1));
-        GtkWidget *tile2 = gtk_bin_get_child (GTK_BIN (child2));
-        GrRecipe *recipe1 = gr_recipe_tile_get_recipe (GR_RECIPE_TILE (tile1));
-        GrRecipe *recipe2 = gr_recipe_tile_get_recipe (GR_RECIPE_TILE (tile2));
-        const char *name1 = gr_recipe_get_name (recipe1);
-        const char *name2 = gr_recipe_get_name (recipe2);
-
-        return strcmp (name1, name2);
-}
+        switch (sort) {
+        case SORT_BY_NAME:
+                return gr_recipe_compare_by_name;
+        case SORT_BY_RECENCY:
+                return gr_recipe_compare_by_mtime;
+        default:
+                g_assert_not_reached ();
+        }
 
-static int
-date_sort_func (GtkFlowBoxChild *child1,
-                GtkFlowBoxChild *child2,
-                gpointer         data)
-{
-        GtkWidget *tile1 = gtk_bin_get_child (GTK_BIN (child1));
-        GtkWidget *tile2 = gtk_bin_get_child (GTK_BIN (child2));
-        GrRecipe *recipe1 = gr_recipe_tile_get_recipe (GR_RECIPE_TILE (tile1));
-        GrRecipe *recipe2 = gr_recipe_tile_get_recipe (GR_RECIPE_TILE (tile2));
-        GDateTime *mtime1 = gr_recipe_get_mtime (recipe1);
-        GDateTime *mtime2 = gr_recipe_get_mtime (recipe2);
-
-        return g_date_time_compare (mtime2, mtime1);
+        return gr_recipe_compare_by_name;
 }
 
 static void
 gr_list_page_set_sort (GrListPage *page,
                        GrSortKey   sort)
 {
-        switch (sort) {
-        case SORT_BY_NAME:
-                gtk_flow_box_set_sort_func (GTK_FLOW_BOX (page->flow_box), name_sort_func, page, NULL);
-                break;
-        case SORT_BY_RECENCY:
-                gtk_flow_box_set_sort_func (GTK_FLOW_BOX (page->flow_box), date_sort_func, page, NULL);
-                break;
-        default:
-                g_assert_not_reached ();
-        }
+        GCompareDataFunc sort_func;
+
+        sort_func = get_sort_func (sort);
+        if (sort_func == page->sort_func)
+                return;
+
+        page->sort_func = sort_func;
+        gr_recipe_search_set_sort_func (page->search, page->sort_func);
+        g_list_store_sort (page->list_model, page->sort_func, NULL);
 }
 
 static void
@@ -259,7 +222,12 @@ gr_list_page_init (GrListPage *page)
         gtk_widget_init_template (GTK_WIDGET (page));
         connect_store_signals (page);
 
+        page->list_model = g_list_store_new (GR_TYPE_RECIPE);
+        page->sort_func = get_sort_func (g_settings_get_enum (gr_settings_get (), "sort-key"));
+
         page->search = gr_recipe_search_new ();
+        gr_recipe_search_set_sort_func (page->search, page->sort_func);
+        gr_recipe_grid_set_model (GR_RECIPE_GRID (page->flow_box), G_LIST_MODEL (page->search));
         g_signal_connect (page->search, "started", G_CALLBACK (search_started), page);
         g_signal_connect (page->search, "hits-added", G_CALLBACK (search_hits_added), page);
         g_signal_connect (page->search, "hits-removed", G_CALLBACK (search_hits_removed), page);
@@ -363,7 +331,6 @@ gr_list_page_populate_from_diet (GrListPage *self,
         gtk_label_set_label (GTK_LABEL (self->heading), gr_diet_get_label (diet));
         gtk_label_set_markup (GTK_LABEL (self->diet_description), gr_diet_get_description (diet));
 
-        container_remove_all (GTK_CONTAINER (self->flow_box));
         tmp = g_strdup_printf (_("No %s found"), get_category_title (diet));
         gtk_label_set_label (GTK_LABEL (self->empty_title), tmp);
         g_free (tmp);
@@ -431,7 +398,6 @@ gr_list_page_populate_from_chef (GrListPage *self,
 
         store = gr_recipe_store_get ();
 
-        container_remove_all (GTK_CONTAINER (self->flow_box));
         tmp = g_strdup_printf (_("No recipes by chef %s found"), name);
         gtk_label_set_label (GTK_LABEL (self->empty_title), tmp);
         g_free (tmp);
@@ -465,7 +431,6 @@ gr_list_page_populate_from_season (GrListPage *self,
         gtk_widget_hide (self->heading);
         gtk_widget_hide (self->diet_description);
 
-        container_remove_all (GTK_CONTAINER (self->flow_box));
         tmp = g_strdup_printf (_("No recipes for %s found"), gr_season_get_title (self->season));
         gtk_label_set_label (GTK_LABEL (self->empty_title), tmp);
         g_free (tmp);
@@ -489,7 +454,6 @@ gr_list_page_populate_from_favorites (GrListPage *self)
         gtk_widget_hide (self->heading);
         gtk_widget_hide (self->diet_description);
 
-        container_remove_all (GTK_CONTAINER (self->flow_box));
         gtk_label_set_label (GTK_LABEL (self->empty_title), _("No favorite recipes found"));
         gtk_label_set_label (GTK_LABEL (self->empty_subtitle), _("Use the ♥ button to mark recipes as favorites."));
 
@@ -510,7 +474,6 @@ gr_list_page_populate_from_all (GrListPage *self)
         gtk_widget_hide (self->heading);
         gtk_widget_hide (self->diet_description);
 
-        container_remove_all (GTK_CONTAINER (self->flow_box));
         gtk_label_set_label (GTK_LABEL (self->empty_title), _("No recipes found"));
         gtk_label_set_label (GTK_LABEL (self->empty_subtitle), _("Sorry about this."));
 
@@ -537,7 +500,6 @@ gr_list_page_populate_from_new (GrListPage *self)
         gtk_widget_hide (self->heading);
         gtk_widget_hide (self->diet_description);
 
-        container_remove_all (GTK_CONTAINER (self->flow_box));
         gtk_label_set_label (GTK_LABEL (self->empty_title), _("No new recipes"));
         gtk_label_set_label (GTK_LABEL (self->empty_subtitle), _("Sorry about this."));
 
@@ -572,7 +534,10 @@ gr_list_page_populate_from_list (GrListPage *self,
         gtk_widget_hide (self->heading);
         gtk_widget_hide (self->diet_description);
 
-        container_remove_all (GTK_CONTAINER (self->flow_box));
+        gr_recipe_search_stop (self->search);
+        g_list_store_remove_all (self->list_model);
+        gr_recipe_grid_set_model (GR_RECIPE_GRID (self->flow_box), G_LIST_MODEL (self->list_model));
+        gr_recipe_grid_set_show_shared (GR_RECIPE_GRID (self->flow_box), FALSE);
         gtk_label_set_label (GTK_LABEL (self->empty_title), _("No imported recipes found"));
         gtk_label_set_label (GTK_LABEL (self->empty_subtitle), _("Sorry about this."));
         gtk_stack_set_visible_child_name (GTK_STACK (self->list_stack), "empty");
@@ -585,9 +550,7 @@ gr_list_page_populate_from_list (GrListPage *self,
 
                 r2 = gr_recipe_store_get_recipe (store, gr_recipe_get_id (recipe));
                 if (r2 == recipe) {
-                        GtkWidget *tile = gr_recipe_tile_new (recipe);
-                        gtk_widget_show (tile);
-                        gtk_container_add (GTK_CONTAINER (self->flow_box), tile);
+                        g_list_store_insert_sorted (self->list_model, recipe, self->sort_func, NULL);
                         empty = FALSE;
                 }
         }
@@ -623,6 +586,56 @@ repopulate (GrListPage *page)
                 gr_list_page_repopulate (page);
 }
 
+static gboolean
+remove_from_list_model (GrListPage *page,
+                        GrRecipe   *recipe)
+{
+        guint i, n_items;
+
+        n_items = g_list_model_get_n_items (G_LIST_MODEL (page->list_model));
+        for (i = 0; i < n_items; i++) {
+                g_autoptr(GrRecipe) item = NULL;
+
+                item = g_list_model_get_item (G_LIST_MODEL (page->list_model), i);
+                if (item == recipe) {
+                        g_list_store_remove (page->list_model, i);
+                        return TRUE;
+                }
+        }
+
+        return FALSE;
+}
+
+/* The searches follow reloads on their own, only the list
+ * of imported recipes needs to be brought up to date here.
+ */
+static void
+recipes_updated (GrRecipeStore *store,
+                 GPtrArray     *added,
+                 GPtrArray     *changed,
+                 GPtrArray     *removed,
+                 GrListPage    *page)
+{
+        guint i;
+
+        if (page->recipes == NULL)
+                return;
+
+        for (i = 0; i < removed->len; i++)
+                remove_from_list_model (page, g_ptr_array_index (removed, i));
+
+        for (i = 0; i < changed->len; i++) {
+                GrRecipe *recipe = g_ptr_array_index (changed, i);
+
+                /* Put it back where the new sort key says */
+                if (remove_from_list_model (page, recipe))
+                        g_list_store_insert_sorted (page->list_model, recipe, page->sort_func, NULL);
+        }
+
+        gtk_stack_set_visible_child_name (GTK_STACK (page->list_stack),
+                                          g_list_model_get_n_items (G_LIST_MODEL (page->list_model)) > 0 ? "list" : "empty");
+}
+
 static void
 connect_store_signals (GrListPage *page)
 {
@@ -631,13 +644,15 @@ connect_store_signals (GrListPage *page)
         store = gr_recipe_store_get ();
 
         g_signal_connect_swapped (store, "recipe-added", G_CALLBACK (repopulate), page);
+        g_signal_connect_swapped (store, "recipes-added", G_CALLBACK (repopulate), page);
         g_signal_connect_swapped (store, "recipe-removed", G_CALLBACK (repopulate), page);
         g_signal_connect_swapped (store, "recipe-changed", G_CALLBACK (repopulate), page);
+        g_signal_connect (store, "recipes-updated", G_CALLBACK (recipes_updated), page);
 }
 
 void
 gr_list_page_clear (GrListPage *self)
 {
         gr_recipe_search_stop (self->search);
-        container_remove_all (GTK_CONTAINER (self->flow_box));
+        g_list_store_remove_all (self->list_model);
 }
@@ -80,10 +80,9 @@ static Approximation approx[] = {
   {  1,  1, 1.0/1.0 }
 };
 
-static void
-rational_approximation (double  input,
-                        int    *num,
-                        int    *denom)
+/* Returns the index of the closest candidate in approx[] */
+static int
+rational_approximation (double input)
 {
         int i;
 
@@ -94,8 +93,8 @@ rational_approximation (double  input,
                         break;
                 }
         }
-        *num = approx[i].num;
-        *denom = approx[i].denom;
+
+        return MIN (i, G_N_ELEMENTS (approx) - 1);
 }
 
 typedef struct {
@@ -279,6 +278,115 @@ parse_as_float (double    *number,
         return TRUE;
 }
 
+/* Up to 15 digits fit exactly into a double, and so do the powers
+ * of ten below, so the decimal case below is correctly rounded.
+ */
+#define MAX_DIGITS 15
+
+static const double powers_of_ten[MAX_DIGITS + 1] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+        1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15
+};
+
+static int
+scan_digits (const char **p,
+             guint64     *value)
+{
+        int n = 0;
+
+        while (g_ascii_isdigit (**p)) {
+                if (n < MAX_DIGITS)
+                        *value = 10 * *value + (**p - '0');
+                n++;
+                (*p)++;
+        }
+
+        return n;
+}
+
+/* Handles the plain ASCII amounts that almost all recipes use:
+ * "2", "1.5", "1/2" and "1 1/2", in a single pass. Anything else,
+ * including signs, exponents and Unicode fractions, makes it return
+ * FALSE without touching *input, and is left to the parsers above.
+ * The results match what those parsers produce for the same input.
+ */
+static gboolean
+parse_as_plain_ascii (double  *number,
+                      char   **input)
+{
+        const char *p = *input;
+        const char *end_of_int;
+        guint64 integral = 0;
+        guint64 mantissa;
+        guint64 num = 0;
+        guint64 denom = 0;
+        int n, m;
+
+        n = scan_digits (&p, &integral);
+        if (n == 0 || n > MAX_DIGITS)
+                return FALSE;
+
+        if (*p == '.') {
+                p++;
+                mantissa = integral;
+                m = scan_digits (&p, &mantissa);
+                if (m == 0 || n + m > MAX_DIGITS || !space_or_nul (*p))
+                        return FALSE;
+
+                *number = (double)mantissa / powers_of_ten[m];
+                *input = (char *)p;
+                return TRUE;
+        }
+
+        if (*p == '/') {
+                p++;
+                m = scan_digits (&p, &denom);
+                if (m == 0 || m > MAX_DIGITS || !space_or_nul (*p))
+                        return FALSE;
+
+                *number = (double)integral / (double)MAX (denom, 1);
+                *input = (char *)p;
+                return TRUE;
+        }
+
+        end_of_int = p;
+        while (*p == ' ' || *p == '\t')
+                p++;
+
+        /* A plain integer, possibly followed by a unit */
+        if (*p == '\0' || (p != end_of_int && g_ascii_isalpha (*p))) {
+                *number = (double)integral;
+                *input = (char *)end_of_int;
+                return TRUE;
+        }
+
+        if (p == end_of_int || !g_ascii_isdigit (*p))
+                return FALSE;
+
+        m = scan_digits (&p, &num);
+        if (m > MAX_DIGITS)
+                return FALSE;
+
+        /* Two integers in a row, the second one is not ours */
+        if (space_or_nul (*p)) {
+                *number = (double)integral;
+                *input = (char *)end_of_int;
+                return TRUE;
+        }
+
+        if (*p != '/')
+                return FALSE;
+
+        p++;
+        m = scan_digits (&p, &denom);
+        if (m == 0 || m > MAX_DIGITS || !space_or_nul (*p))
+                return FALSE;
+
+        *number = (double)integral + (double)num / (double)MAX (denom, 1);
+        *input = (char *)p;
+        return TRUE;
+}
+
 gboolean
 gr_number_parse (double    *number,
                  char     **input,
@@ -286,6 +394,9 @@ gr_number_parse (double    *number,
 {
         char *orig = *input;
 
+        if (parse_as_plain_ascii (number, input))
+                return TRUE;
+
         if (parse_as_vulgar_fraction (number, input, NULL) ||
             parse_as_fancy_fraction (number, input, NULL) ||
             parse_as_ascii_fraction (number, input, NULL)) {
@@ -370,21 +481,50 @@ out:
         return g_string_free (s, FALSE);
 }
 
+/* Amounts in recipes are almost always small, so we format every
+ * combination of a small integral part and one of the fractions in
+ * approx[] once, and just copy the result afterwards.
+ */
+#define N_CACHED_INTEGRALS 100
+
+static char *formatted[N_CACHED_INTEGRALS][G_N_ELEMENTS (approx)];
+
+static void
+ensure_formatted (void)
+{
+        static gsize initialized = 0;
+
+        if (g_once_init_enter (&initialized)) {
+                int i, j;
+
+                for (i = 0; i < N_CACHED_INTEGRALS; i++)
+                        for (j = 0; j < G_N_ELEMENTS (approx); j++)
+                                formatted[i][j] = format_fraction (i, approx[j].num, approx[j].denom);
+
+                g_once_init_leave (&initialized, 1);
+        }
+}
+
 char *
 gr_number_format (double number)
 {
         double integral;
-        int num, denom;
+        int i;
 
         integral = floor (number);
         number -= integral;
 
-        rational_approximation (number, &num, &denom);
+        i = rational_approximation (number);
 
-        if (num == 1 && denom == 1) {
+        if (approx[i].num == 1 && approx[i].denom == 1) {
                 integral += 1;
-                num = denom = 0;
+                i = 0;
+        }
+
+        if (integral >= 0 && integral < N_CACHED_INTEGRALS) {
+                ensure_formatted ();
+                return g_strdup (formatted[(int)integral][i]);
         }
 
-        return format_fraction ((int)integral, num, denom);
+        return format_fraction ((int)integral, approx[i].num, approx[i].denom);
 }
@@ -0,0 +1,516 @@
+/* gr-print-document.c
+ *
+ * Copyright (C) 2017 Matthias Clasen <mclasen@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <cairo-pdf.h>
+
+#include "gr-print-document.h"
+
+/* The printed form of a recipe: a centered title, a summary next to
+ * the image, and a body that flows over as many pages as it needs.
+ *
+ * The text is collected up front, by code that may need the recipe
+ * store. Laying it out and drawing it only touches the document
+ * itself, so PDFs can be produced without a GtkPrintOperation, and
+ * for many documents at once on a pool of threads.
+ */
+
+struct _GrPrintDocument
+{
+        GString *title;
+        GString *summary;
+        GString *amounts;
+        GString *body;
+        PangoAttrList *body_attrs;
+        GdkPixbuf *image;
+
+        PangoLayout *title_layout;
+        PangoLayout *left_layout;
+        PangoLayout *bottom_layout;
+        GList *page_breaks;
+};
+
+static PangoFontDescription *title_font;
+static PangoFontDescription *body_font;
+
+static void
+init_fonts (void)
+{
+        static gsize initialized = 0;
+
+        if (g_once_init_enter (&initialized)) {
+                title_font = pango_font_description_from_string ("Cantarell Bold 18");
+                body_font = pango_font_description_from_string ("Cantarell 12");
+                g_once_init_leave (&initialized, 1);
+        }
+}
+
+GrPrintDocument *
+gr_print_document_new (void)
+{
+        GrPrintDocument *doc;
+
+        init_fonts ();
+
+        doc = g_new0 (GrPrintDocument, 1);
+        doc->title = g_string_new ("");
+        doc->summary = g_string_new ("");
+        doc->amounts = g_string_new ("");
+        doc->body = g_string_new ("");
+        doc->body_attrs = pango_attr_list_new ();
+
+        return doc;
+}
+
+static void
+clear_layout (GrPrintDocument *doc)
+{
+        g_clear_object (&doc->title_layout);
+        g_clear_object (&doc->left_layout);
+        g_clear_object (&doc->bottom_layout);
+        g_list_free (doc->page_breaks);
+        doc->page_breaks = NULL;
+}
+
+void
+gr_print_document_free (GrPrintDocument *doc)
+{
+        clear_layout (doc);
+
+        g_string_free (doc->title, TRUE);
+        g_string_free (doc->summary, TRUE);
+        g_string_free (doc->amounts, TRUE);
+        g_string_free (doc->body, TRUE);
+        pango_attr_list_unref (doc->body_attrs);
+        g_clear_object (&doc->image);
+
+        g_free (doc);
+}
+
+void
+gr_print_document_set_title (GrPrintDocument *doc,
+                             const char      *title)
+{
+        g_string_assign (doc->title, title);
+}
+
+void
+gr_print_document_set_summary (GrPrintDocument *doc,
+                               const char      *summary)
+{
+        g_string_assign (doc->summary, summary);
+}
+
+void
+gr_print_document_set_image (GrPrintDocument *doc,
+                             GdkPixbuf       *image)
+{
+        g_set_object (&doc->image, image);
+}
+
+/* The amounts are never shown, they only determine the
+ * tab stops for the ingredients in the body.
+ */
+void
+gr_print_document_set_amounts (GrPrintDocument *doc,
+                               const char      *amounts)
+{
+        g_string_assign (doc->amounts, amounts);
+}
+
+void
+gr_print_document_append_heading (GrPrintDocument *doc,
+                                  const char      *heading)
+{
+        PangoAttribute *attr;
+
+        attr = pango_attr_font_desc_new (title_font);
+        attr->start_index = doc->body->len;
+        g_string_append (doc->body, heading);
+        attr->end_index = doc->body->len + 1;
+        pango_attr_list_insert (doc->body_attrs, attr);
+}
+
+void
+gr_print_document_append_text (GrPrintDocument *doc,
+                               const char      *text)
+{
+        g_string_append (doc->body, text);
+}
+
+/* Returns the number of pages */
+int
+gr_print_document_layout (GrPrintDocument *doc,
+                          PangoContext    *context,
+                          double           width,
+                          double           height)
+{
+        PangoLayout *layout;
+        PangoTabArray *tabs;
+        PangoRectangle title_rect;
+        PangoRectangle left_rect;
+        int amount_width;
+        int num_lines;
+        int line;
+        double page_height;
+
+        init_fonts ();
+        clear_layout (doc);
+
+        doc->title_layout = pango_layout_new (context);
+        pango_layout_set_width (doc->title_layout, width * PANGO_SCALE);
+        pango_layout_set_font_description (doc->title_layout, title_font);
+        pango_layout_set_text (doc->title_layout, doc->title->str, doc->title->len);
+
+        doc->left_layout = pango_layout_new (context);
+        pango_layout_set_width (doc->left_layout, (width / 2) * PANGO_SCALE);
+        pango_layout_set_font_description (doc->left_layout, body_font);
+        pango_layout_set_text (doc->left_layout, doc->summary->str, doc->summary->len);
+
+        layout = pango_layout_new (context);
+        pango_layout_set_width (layout, width * PANGO_SCALE);
+        pango_layout_set_font_description (layout, body_font);
+        pango_layout_set_text (layout, doc->amounts->str, doc->amounts->len);
+        pango_layout_get_size (layout, &amount_width, NULL);
+        g_object_unref (layout);
+
+        doc->bottom_layout = pango_layout_new (context);
+        pango_layout_set_width (doc->bottom_layout, width * PANGO_SCALE);
+        pango_layout_set_font_description (doc->bottom_layout, body_font);
+
+        tabs = pango_tab_array_new (2, FALSE);
+        pango_tab_array_set_tab (tabs, 0, PANGO_TAB_LEFT, 0);
+        pango_tab_array_set_tab (tabs, 1, PANGO_TAB_LEFT, amount_width);
+        pango_tab_array_set_tab (tabs, 2, PANGO_TAB_LEFT, (width / 2) * PANGO_SCALE);
+        pango_tab_array_set_tab (tabs, 3, PANGO_TAB_LEFT, (width / 2) * PANGO_SCALE + amount_width);
+        pango_layout_set_tabs (doc->bottom_layout, tabs);
+        pango_tab_array_free (tabs);
+
+        pango_layout_set_text (doc->bottom_layout, doc->body->str, doc->body->len);
+        pango_layout_set_attributes (doc->bottom_layout, doc->body_attrs);
+
+        /* TODO: we assume only the bottom layout will break across pages */
+
+        num_lines = pango_layout_get_line_count (doc->bottom_layout);
+
+        pango_layout_get_extents (doc->title_layout, NULL, &title_rect);
+        pango_layout_get_extents (doc->left_layout, NULL, &left_rect);
+
+        if (doc->image)
+                page_height = title_rect.height/1024.0 + MAX (left_rect.height/1024.0, gdk_pixbuf_get_height (doc->image) + 10);
+        else
+                page_height = title_rect.height/1024.0 + left_rect.height/1024.0;
+
+        for (line = 0; line < num_lines; line++) {
+                PangoLayoutLine *layout_line;
+                PangoRectangle logical_rect;
+                double line_height;
+
+                layout_line = pango_layout_get_line (doc->bottom_layout, line);
+                pango_layout_line_get_extents (layout_line, NULL, &logical_rect);
+                line_height = logical_rect.height / 1024.0;
+                if (page_height + line_height > height) {
+                        doc->page_breaks = g_list_prepend (doc->page_breaks, GINT_TO_POINTER (line));
+                        page_height = 0;
+                }
+
+                page_height += line_height;
+        }
+
+        doc->page_breaks = g_list_reverse (doc->page_breaks);
+
+        return g_list_length (doc->page_breaks) + 1;
+}
+
+void
+gr_print_document_draw_page (GrPrintDocument *doc,
+                             cairo_t         *cr,
+                             double           width,
+                             int              page_nr)
+{
+        PangoRectangle logical_rect;
+        int baseline;
+        int start, end, i;
+        PangoLayoutIter *iter;
+        double start_pos;
+        GList *pagebreak;
+
+        if (page_nr == 0) {
+                cairo_set_source_rgb (cr, 0, 0, 0);
+
+                pango_layout_get_extents (doc->title_layout, NULL, &logical_rect);
+                baseline = pango_layout_get_baseline (doc->title_layout);
+
+                cairo_move_to (cr, logical_rect.x / 1024.0 + (width - logical_rect.width / 1024.0) / 2, baseline / 1024.0 - logical_rect.y / 1024.0);
+                pango_cairo_show_layout (cr, doc->title_layout);
+
+                start_pos = baseline / 1024.0 - logical_rect.y / 1024.0 + logical_rect.height / 1024.0;
+
+                if (doc->image) {
+                        gdk_cairo_set_source_pixbuf (cr, doc->image, width - gdk_pixbuf_get_width (doc->image), start_pos);
+                        cairo_paint (cr);
+                }
+
+                cairo_set_source_rgb (cr, 0, 0, 0);
+
+                pango_layout_get_extents (doc->left_layout, NULL, &logical_rect);
+                baseline = pango_layout_get_baseline (doc->left_layout);
+
+                cairo_move_to (cr, logical_rect.x / 1024.0, start_pos + baseline / 1024.0 - logical_rect.y / 1024.0);
+                pango_cairo_show_layout (cr, doc->left_layout);
+
+                if (doc->image)
+                        start_pos += MAX (gdk_pixbuf_get_height (doc->image) + 10, baseline / 1024.0 - logical_rect.y / 1024.0 + logical_rect.height / 1024.0);
+                else
+                        start_pos += baseline / 1024.0 - logical_rect.y / 1024.0 + logical_rect.height / 1024.0;
+
+                start = 0;
+        }
+        else {
+                pagebreak = g_list_nth (doc->page_breaks, page_nr - 1);
+                start = GPOINTER_TO_INT (pagebreak->data);
+                start_pos = 0;
+        }
+
+        pagebreak = g_list_nth (doc->page_breaks, page_nr);
+        if (pagebreak == NULL)
+                end = pango_layout_get_line_count (doc->bottom_layout);
+        else
+                end = GPOINTER_TO_INT (pagebreak->data);
+
+        i = 0;
+        iter = pango_layout_get_iter (doc->bottom_layout);
+        do {
+                PangoRectangle rect;
+                PangoLayoutLine *line;
+                int base;
+
+                if (i >= start) {
+                        line = pango_layout_iter_get_line (iter);
+                        pango_layout_iter_get_line_extents (iter, NULL, &rect);
+                        base = pango_layout_iter_get_baseline (iter);
+                        if (i == start)
+                                start_pos -= rect.y / 1024.0;
+
+                        cairo_move_to (cr, rect.x / 1024.0, base / 1024.0 + start_pos);
+                        pango_cairo_show_layout_line (cr, line);
+                }
+                i++;
+
+        } while (i < end && pango_layout_iter_next_line (iter));
+
+        pango_layout_iter_free (iter);
+}
+
+typedef struct {
+        double paper_width;
+        double paper_height;
+        double left_margin;
+        double top_margin;
+        double width;
+        double height;
+} PageSetup;
+
+/* The same page that a GtkPrintOperation uses when it is
+ * not given a page setup: the default paper size and margins.
+ */
+static void
+get_page_setup (PageSetup *page)
+{
+        GtkPaperSize *paper;
+
+        paper = gtk_paper_size_new (NULL);
+
+        page->paper_width = gtk_paper_size_get_width (paper, GTK_UNIT_POINTS);
+        page->paper_height = gtk_paper_size_get_height (paper, GTK_UNIT_POINTS);
+        page->left_margin = gtk_paper_size_get_default_left_margin (paper, GTK_UNIT_POINTS);
+        page->top_margin = gtk_paper_size_get_default_top_margin (paper, GTK_UNIT_POINTS);
+        page->width = page->paper_width - page->left_margin - gtk_paper_size_get_default_right_margin (paper, GTK_UNIT_POINTS);
+        page->height = page->paper_height - page->top_margin - gtk_paper_size_get_default_bottom_margin (paper, GTK_UNIT_POINTS);
+
+        gtk_paper_size_free (paper);
+}
+
+void
+gr_print_get_page_size (double *width,
+                        double *height)
+{
+        PageSetup page;
+
+        get_page_setup (&page);
+
+        *width = page.width;
+        *height = page.height;
+}
+
+/* Font maps are not safe to share between threads, so every thread
+ * that renders gets its own, and keeps it for all the documents it
+ * renders. Fonts and shaping results are cached in the font map.
+ */
+static PangoContext *
+get_thread_context (void)
+{
+        static GPrivate context_key = G_PRIVATE_INIT (g_object_unref);
+        PangoContext *context;
+
+        context = g_private_get (&context_key);
+        if (context == NULL) {
+                PangoFontMap *fontmap;
+                cairo_font_options_t *options;
+
+                fontmap = pango_cairo_font_map_new ();
+                context = pango_font_map_create_context (fontmap);
+                g_object_unref (fontmap);
+
+                /* Like gtk_print_context_create_pango_context () */
+                pango_cairo_context_set_resolution (context, 72);
+                options = cairo_font_options_create ();
+                cairo_font_options_set_hint_metrics (options, CAIRO_HINT_METRICS_OFF);
+                cairo_font_options_set_hint_style (options, CAIRO_HINT_STYLE_NONE);
+                pango_cairo_context_set_font_options (context, options);
+                cairo_font_options_destroy (options);
+
+                g_private_set (&context_key, context);
+        }
+
+        return context;
+}
+
+static gboolean
+render_pdf (GrPrintDocument  *doc,
+            const char       *path,
+            const PageSetup  *page,
+            GError          **error)
+{
+        cairo_surface_t *surface;
+        cairo_t *cr;
+        cairo_status_t status;
+        int n_pages;
+        int i;
+
+        n_pages = gr_print_document_layout (doc, get_thread_context (), page->width, page->height);
+
+        surface = cairo_pdf_surface_create (path, page->paper_width, page->paper_height);
+        cr = cairo_create (surface);
+
+        for (i = 0; i < n_pages; i++) {
+                cairo_save (cr);
+                cairo_translate (cr, page->left_margin, page->top_margin);
+                gr_print_document_draw_page (doc, cr, page->width, i);
+                cairo_restore (cr);
+                cairo_show_page (cr);
+        }
+
+        cairo_destroy (cr);
+        cairo_surface_finish (surface);
+        status = cairo_surface_status (surface);
+        cairo_surface_destroy (surface);
+
+        clear_layout (doc);
+
+        if (status != CAIRO_STATUS_SUCCESS) {
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                             "%s: %s", path, cairo_status_to_string (status));
+                return FALSE;
+        }
+
+        return TRUE;
+}
+
+gboolean
+gr_print_document_export_pdf (GrPrintDocument  *doc,
+                              const char       *path,
+                              GError          **error)
+{
+        PageSetup page;
+
+        get_page_setup (&page);
+
+        return render_pdf (doc, path, &page, error);
+}
+
+typedef struct {
+        GrPrintDocument **docs;
+        const char **paths;
+        gboolean *written;
+        PageSetup page;
+} ExportBatch;
+
+static void
+export_one (gpointer data,
+            gpointer user_data)
+{
+        ExportBatch *batch = user_data;
+        guint i = GPOINTER_TO_UINT (data) - 1;
+        g_autoptr(GError) error = NULL;
+
+        if (render_pdf (batch->docs[i], batch->paths[i], &batch->page, &error))
+                batch->written[i] = TRUE;
+        else
+                g_warning ("Failed to export PDF: %s", error->message);
+}
+
+/* Renders @docs to the files in @paths, using up to @max_threads
+ * threads, or one per processor if @max_threads is 0. Blocks until
+ * all the files have been written, so call this from a thread.
+ * If @written is not %NULL, it is set to tell which files were
+ * written successfully. Returns the number of those.
+ */
+guint
+gr_print_export_pdfs (GrPrintDocument **docs,
+                      const char      **paths,
+                      guint             n_docs,
+                      guint             max_threads,
+                      gboolean         *written)
+{
+        ExportBatch batch;
+        GThreadPool *pool;
+        g_autofree gboolean *ok = NULL;
+        guint i, n_written;
+
+        if (n_docs == 0)
+                return 0;
+
+        if (max_threads == 0)
+                max_threads = g_get_num_processors ();
+
+        ok = g_new0 (gboolean, n_docs);
+
+        batch.docs = docs;
+        batch.paths = paths;
+        batch.written = ok;
+        get_page_setup (&batch.page);
+
+        pool = g_thread_pool_new (export_one, &batch, MIN (max_threads, n_docs), FALSE, NULL);
+        for (i = 0; i < n_docs; i++)
+                g_thread_pool_push (pool, GUINT_TO_POINTER (i + 1), NULL);
+
+        /* Waits for all queued documents */
+        g_thread_pool_free (pool, FALSE, TRUE);
+
+        n_written = 0;
+        for (i = 0; i < n_docs; i++) {
+                if (ok[i])
+                        n_written++;
+                if (written)
+                        written[i] = ok[i];
+        }
+
+        return n_written;
+}
@@ -0,0 +1,65 @@
+/* gr-print-document.h
+ *
+ * Copyright (C) 2017 Matthias Clasen <mclasen@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GrPrintDocument GrPrintDocument;
+
+GrPrintDocument *gr_print_document_new            (void);
+void             gr_print_document_free           (GrPrintDocument *doc);
+
+void             gr_print_document_set_title      (GrPrintDocument *doc,
+                                                   const char      *title);
+void             gr_print_document_set_summary    (GrPrintDocument *doc,
+                                                   const char      *summary);
+void             gr_print_document_set_image      (GrPrintDocument *doc,
+                                                   GdkPixbuf       *image);
+void             gr_print_document_set_amounts    (GrPrintDocument *doc,
+                                                   const char      *amounts);
+void             gr_print_document_append_heading (GrPrintDocument *doc,
+                                                   const char      *heading);
+void             gr_print_document_append_text    (GrPrintDocument *doc,
+                                                   const char      *text);
+
+int              gr_print_document_layout         (GrPrintDocument *doc,
+                                                   PangoContext    *context,
+                                                   double           width,
+                                                   double           height);
+void             gr_print_document_draw_page      (GrPrintDocument *doc,
+                                                   cairo_t         *cr,
+                                                   double           width,
+                                                   int              page_nr);
+
+void             gr_print_get_page_size           (double          *width,
+                                                   double          *height);
+gboolean         gr_print_document_export_pdf     (GrPrintDocument *doc,
+                                                   const char      *path,
+                                                   GError         **error);
+guint            gr_print_export_pdfs             (GrPrintDocument **docs,
+                                                   const char      **paths,
+                                                   guint             n_docs,
+                                                   guint             max_threads,
+                                                   gboolean         *written);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GrPrintDocument, gr_print_document_free)
+
+G_END_DECLS
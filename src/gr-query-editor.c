@@ -54,7 +54,7 @@ struct _GrQueryEditor
         GtkWidget *ing_filter_entry;
         GtkWidget *ing_list;
 
-        char *ing_term;
+        GHashTable *ing_matches;
         char **terms;
 };
 
@@ -266,17 +266,15 @@ ing_filter_func (GtkListBoxRow *row,
                  gpointer       data)
 {
         GrQueryEditor *self = data;
-        const char *cf;
 
         if (!GR_IS_INGREDIENT_ROW (row))
                 return TRUE;
 
-        if (!self->ing_term)
+        if (!self->ing_matches)
                 return TRUE;
 
-        cf = gr_ingredient_row_get_filter_term (GR_INGREDIENT_ROW (row));
-
-        return g_str_has_prefix (cf, self->ing_term);
+        return g_hash_table_contains (self->ing_matches,
+                                      gr_ingredient_row_get_ingredient (GR_INGREDIENT_ROW (row)));
 }
 
 static void
@@ -284,9 +282,19 @@ ing_filter_changed (GrQueryEditor *self)
 {
         const char *term;
 
+        g_clear_pointer (&self->ing_matches, g_hash_table_unref);
+
         term = gtk_entry_get_text (GTK_ENTRY (self->ing_filter_entry));
-        g_free (self->ing_term);
-        self->ing_term = g_utf8_casefold (term, -1);
+        if (term[0] != '\0') {
+                g_autofree const char **matches = NULL;
+                int i;
+
+                matches = gr_ingredient_complete (term);
+                self->ing_matches = g_hash_table_new (g_str_hash, g_str_equal);
+                for (i = 0; matches[i]; i++)
+                        g_hash_table_add (self->ing_matches, (gpointer)matches[i]);
+        }
+
         gtk_list_box_invalidate_filter (GTK_LIST_BOX (self->ing_list));
 }
 
@@ -793,7 +801,7 @@ gr_query_editor_finalize (GObject *object)
         GrQueryEditor *self = (GrQueryEditor *)object;
 
         g_strfreev (self->terms);
-        g_free (self->ing_term);
+        g_clear_pointer (&self->ing_matches, g_hash_table_unref);
 
         G_OBJECT_CLASS (gr_query_editor_parent_class)->finalize (object);
 }
@@ -37,6 +37,7 @@
 #include "gr-utils.h"
 #include "gr-mail.h"
 #include "gr-recipe-printer.h"
+#include "gr-tar.h"
 
 
 struct _GrRecipeExporter
@@ -55,9 +56,10 @@ struct _GrRecipeExporter
         GList *pdf_sources;
         char *dir;
 
-        gboolean just_export;
         gboolean contribute;
 
+        GCancellable *cancellable; /* set while a background export runs */
+
         GtkWidget *dialog_heading;
         GtkWidget *friend_button;
         GtkWidget *contribute_button;
@@ -75,11 +77,13 @@ gr_recipe_exporter_finalize (GObject *object)
         g_list_free_full (exporter->sources, g_object_unref);
         g_list_free_full (exporter->pdf_sources, g_object_unref);
         g_free (exporter->dir);
+        g_clear_object (&exporter->cancellable);
 
         G_OBJECT_CLASS (gr_recipe_exporter_parent_class)->finalize (object);
 }
 
 static guint done_signal;
+static guint progress_signal;
 
 static void
 gr_recipe_exporter_class_init (GrRecipeExporterClass *klass)
@@ -95,6 +99,14 @@ gr_recipe_exporter_class_init (GrRecipeExporterClass *klass)
                                     NULL, NULL,
                                     NULL,
                                     G_TYPE_NONE, 1, G_TYPE_FILE);
+
+        progress_signal = g_signal_new ("progress",
+                                        G_TYPE_FROM_CLASS (klass),
+                                        G_SIGNAL_RUN_LAST,
+                                        0,
+                                        NULL, NULL,
+                                        NULL,
+                                        G_TYPE_NONE, 1, G_TYPE_DOUBLE);
 }
 
 static void
@@ -195,12 +207,6 @@ completed_cb (AutoarCompressor *compressor,
         int pdf_sources_length = g_list_length (exporter->pdf_sources);
         attachments = g_new (char*, pdf_sources_length + 2);
 
-        if (exporter->just_export) {
-                g_signal_emit (exporter, done_signal, 0, exporter->output);
-                cleanup_export (exporter);
-                return;
-        }
-
         if (exporter->contribute) {
                 address = "recipes-list@gnome.org";
                 subject = _("Recipe contribution");
@@ -251,14 +257,221 @@ completed_cb (AutoarCompressor *compressor,
 }
 #endif
 
+/* Returns the file to put into the archive for @ri, or %NULL if
+ * we don't have it. Images that are not stored locally must have
+ * been fetched into the image cache before, see fetch_images().
+ */
+static char *
+get_image_source (GrImage *ri)
+{
+        g_autofree char *path = NULL;
+
+        path = gr_image_get_cache_path (ri);
+        if (!g_file_test (path, G_FILE_TEST_EXISTS)) {
+                g_message ("Image %s is not available, not exporting it", gr_image_get_path (ri));
+                return NULL;
+        }
+
+        return g_steal_pointer (&path);
+}
+
+static GrImage *
+get_chef_image (GrChef *chef)
+{
+        const char *image_path;
+
+        image_path = gr_chef_get_image (chef);
+        if (image_path == NULL || image_path[0] == '\0')
+                return NULL;
+
+        return gr_image_new (gr_app_get_soup_session (GR_APP (g_application_get_default ())),
+                             gr_chef_get_id (chef),
+                             image_path);
+}
+
+static void
+release_fetch (GTask *task)
+{
+        int *pending = g_task_get_task_data (task);
+
+        (*pending)--;
+        if (*pending > 0)
+                return;
+
+        if (!g_task_return_error_if_cancelled (task))
+                g_task_return_boolean (task, TRUE);
+}
+
+static void
+image_fetched (GObject      *source,
+               GAsyncResult *result,
+               gpointer      data)
+{
+        g_autoptr(GTask) task = data;
+        g_autofree char *path = NULL;
+        g_autoptr(GError) error = NULL;
+
+        path = gr_image_fetch_finish (GR_IMAGE (source), result, &error);
+        if (!path && !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+                g_message ("%s", error->message);
+
+        release_fetch (task);
+}
+
+static void
+fetch_image (GTask   *task,
+             GrImage *ri)
+{
+        int *pending = g_task_get_task_data (task);
+
+        (*pending)++;
+        gr_image_fetch (ri, g_task_get_cancellable (task), image_fetched, g_object_ref (task));
+}
+
+/* Downloads the images of @recipes and their chefs that are not in
+ * the image cache yet, so that collecting the export data does not
+ * have to wait for the network.
+ */
+static void
+fetch_images (GrRecipeExporter    *exporter,
+              GList               *recipes,
+              GCancellable        *cancellable,
+              GAsyncReadyCallback  callback,
+              gpointer             data)
+{
+        g_autoptr(GTask) task = NULL;
+        g_autoptr(GHashTable) seen = NULL;
+        GrRecipeStore *store;
+        GList *l;
+        int *pending;
+
+        store = gr_recipe_store_get ();
+
+        task = g_task_new (exporter, cancellable, callback, data);
+
+        /* Held until all fetches have been started */
+        pending = g_new (int, 1);
+        *pending = 1;
+        g_task_set_task_data (task, pending, g_free);
+
+        seen = g_hash_table_new (g_str_hash, g_str_equal);
+        for (l = recipes; l; l = l->next) {
+                GrRecipe *recipe = l->data;
+                GPtrArray *images;
+                const char *author;
+                g_autoptr(GrChef) chef = NULL;
+                g_autoptr(GrImage) ri = NULL;
+                int i;
+
+                images = gr_recipe_get_images (recipe);
+                for (i = 0; i < images->len; i++)
+                        fetch_image (task, g_ptr_array_index (images, i));
+
+                author = gr_recipe_get_author (recipe);
+                if (author == NULL || g_hash_table_contains (seen, author))
+                        continue;
+
+                g_hash_table_add (seen, (gpointer)author);
+
+                chef = gr_recipe_store_get_chef (store, author);
+                if (chef)
+                        ri = get_chef_image (chef);
+                if (ri)
+                        fetch_image (task, ri);
+        }
+
+        release_fetch (task);
+}
+
 static gboolean
-#ifndef ENABLE_AUTOAR
-G_GNUC_UNUSED
-#endif
+fetch_images_finish (GrRecipeExporter  *exporter,
+                     GAsyncResult      *result,
+                     GError           **error)
+{
+        return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/* Images are stored in the archive under the hash of their contents,
+ * so an image that is used in several places is only stored once.
+ * Images that we imported before are already named that way.
+ */
+static char *
+get_archive_name (const char *source)
+{
+        g_autofree char *name = NULL;
+        g_autoptr(GError) error = NULL;
+
+        if (is_content_addressed (source))
+                name = g_path_get_basename (source);
+        else
+                name = get_content_addressed_name (source, &error);
+
+        if (name == NULL) {
+                g_message ("Failed to hash image %s: %s", source, error->message);
+                name = g_path_get_basename (source);
+        }
+
+        return g_build_filename ("images", name, NULL);
+}
+
+/* Until the images are named, the keyfiles refer to them by the
+ * files they come from. Hashing reads every image, so this is
+ * called in a thread; afterwards @images maps the files to their
+ * names in the archive.
+ */
+static void
+name_images (GKeyFile   *recipes,
+             GKeyFile   *chefs,
+             GHashTable *images)
+{
+        GHashTableIter iter;
+        const char *source;
+        g_auto(GStrv) groups = NULL;
+        gsize i, j;
+
+        g_hash_table_iter_init (&iter, images);
+        while (g_hash_table_iter_next (&iter, (gpointer *)&source, NULL))
+                g_hash_table_iter_replace (&iter, get_archive_name (source));
+
+        groups = g_key_file_get_groups (recipes, NULL);
+        for (i = 0; groups[i]; i++) {
+                g_auto(GStrv) paths = NULL;
+                gsize length;
+
+                paths = g_key_file_get_string_list (recipes, groups[i], "Images", &length, NULL);
+                if (paths == NULL)
+                        continue;
+
+                for (j = 0; j < length; j++) {
+                        char *name = g_strdup (g_hash_table_lookup (images, paths[j]));
+
+                        g_free (paths[j]);
+                        paths[j] = name;
+                }
+
+                g_key_file_set_string_list (recipes, groups[i], "Images", (const char * const *)paths, length);
+        }
+
+        g_clear_pointer (&groups, g_strfreev);
+
+        groups = g_key_file_get_groups (chefs, NULL);
+        for (i = 0; groups[i]; i++) {
+                g_autofree char *path = NULL;
+
+                path = g_key_file_get_string (chefs, groups[i], "Image", NULL);
+                if (path)
+                        g_key_file_set_string (chefs, groups[i], "Image", g_hash_table_lookup (images, path));
+        }
+}
+
+/* Adds @recipe to @keyfile, and the files for its images to @images.
+ * See name_images() for how they get their names in the archive.
+ */
+static void
 export_one_recipe (GrRecipeExporter  *exporter,
                    GrRecipe          *recipe,
                    GKeyFile          *keyfile,
-                   GError           **error)
+                   GHashTable        *images)
 {
         const char *key;
         const char *name;
@@ -280,14 +493,11 @@ export_one_recipe (GrRecipeExporter  *exporter,
         GrDiets diets;
         GDateTime *ctime;
         GDateTime *mtime;
-        GPtrArray *images;
+        GPtrArray *recipe_images;
         g_auto(GStrv) paths = NULL;
-        int i;
-        g_autofree char *imagedir = NULL;
+        int i, j;
+        int default_index;
 
-        GrRecipePrinter *printer;
-        GFile *recipe_pdf;
-        printer = gr_recipe_printer_new (exporter->window);
         key = gr_recipe_get_id (recipe);
         name = gr_recipe_get_name (recipe);
         author = gr_recipe_get_author (recipe);
@@ -305,37 +515,30 @@ export_one_recipe (GrRecipeExporter  *exporter,
         notes = gr_recipe_get_notes (recipe);
         ctime = gr_recipe_get_ctime (recipe);
         mtime = gr_recipe_get_mtime (recipe);
-        default_image = gr_recipe_get_default_image (recipe);
+        default_index = gr_recipe_get_default_image (recipe);
         spiciness = gr_recipe_get_spiciness (recipe);
 
-        images = gr_recipe_get_images (recipe);
-
-        imagedir = g_build_filename (exporter->dir, "images", NULL);
-        g_mkdir_with_parents (imagedir, 0755);
+        recipe_images = gr_recipe_get_images (recipe);
 
-        paths = g_new0 (char *, images->len + 1);
-        for (i = 0; i < images->len; i++) {
-                GrImage *ri = g_ptr_array_index (images, i);
-                g_autoptr(GdkPixbuf) pixbuf = NULL;
-                g_autoptr(GFile) source = NULL;
-                g_autoptr(GFile) dest = NULL;
+        /* Images we don't have are left out, so the default image
+         * has to be looked up again. If it is one of the missing
+         * ones, we fall back to the first.
+         */
+        default_image = 0;
+        paths = g_new0 (char *, recipe_images->len + 1);
+        for (i = 0, j = 0; i < recipe_images->len; i++) {
+                GrImage *ri = g_ptr_array_index (recipe_images, i);
                 g_autofree char *path = NULL;
-                g_autofree char *basename = NULL;
-                g_autofree char *destname = NULL;
 
-                pixbuf = gr_image_load_sync (ri, 400, 400, TRUE);
-                path = gr_image_get_cache_path (ri);
-                source = g_file_new_for_path (path);
-                basename = g_file_get_basename (source);
-                destname = g_build_filename (imagedir, basename, NULL);
+                path = get_image_source (ri);
+                if (path == NULL)
+                        continue;
 
-                dest = g_file_new_for_path (destname);
+                if (i == default_index)
+                        default_image = j;
 
-                if (!g_file_copy (source, dest, G_FILE_COPY_NONE, NULL, NULL, NULL, error)) {
-                        return FALSE;
-                }
-
-                paths[i] = g_build_filename  ("images", basename, NULL);
+                g_hash_table_insert (images, g_strdup (path), NULL);
+                paths[j++] = g_steal_pointer (&path);
         }
 
         g_key_file_set_string (keyfile, key, "Name", name ? name : "");
@@ -358,9 +561,6 @@ export_one_recipe (GrRecipeExporter  *exporter,
 
         g_key_file_set_string_list (keyfile, key, "Images", (const char * const *)paths, g_strv_length (paths));
 
-        recipe_pdf = gr_recipe_printer_get_pdf (printer, recipe);
-        exporter->pdf_sources = g_list_append (exporter->pdf_sources, recipe_pdf);
-
         if (ctime) {
                 g_autofree char *created = date_time_to_string (ctime);
                 g_key_file_set_string (keyfile, key, "Created", created);
@@ -369,147 +569,78 @@ export_one_recipe (GrRecipeExporter  *exporter,
                 g_autofree char *modified = date_time_to_string (mtime);
                 g_key_file_set_string (keyfile, key, "Modified", modified);
         }
-
-        return TRUE;
 }
 
-static gboolean
-#ifndef ENABLE_AUTOAR
-G_GNUC_UNUSED
-#endif
+static void
 export_one_chef (GrRecipeExporter  *exporter,
                  GrChef            *chef,
                  GKeyFile          *keyfile,
-                 GError           **error)
+                 GHashTable        *images)
 {
         const char *key;
         const char *name;
         const char *fullname;
         const char *description;
-        const char *image_path;
-        g_autoptr(GMainLoop) loop = NULL;
+        g_autoptr(GrImage) ri = NULL;
+        g_autofree char *source = NULL;
 
         key = gr_chef_get_id (chef);
         name = gr_chef_get_name (chef);
         fullname = gr_chef_get_fullname (chef);
         description = gr_chef_get_description (chef);
-        image_path = gr_chef_get_image (chef);
-        if (image_path && image_path[0]) {
-                g_autoptr(GFile) source = NULL;
-                g_autoptr(GFile) dest = NULL;
-                g_autoptr(GrImage) ri = NULL;
-                g_autoptr(GdkPixbuf) pixbuf = NULL;
-                g_autofree char *basename = NULL;
-                g_autofree char *destname = NULL;
-                g_autofree char *path = NULL;
-                g_autofree char *cache_path = NULL;
 
-                ri = gr_image_new (gr_app_get_soup_session (GR_APP (g_application_get_default ())), gr_chef_get_id (chef), image_path);
-                pixbuf = gr_image_load_sync (ri, 400, 400, FALSE);
-
-                cache_path = gr_image_get_cache_path (ri);
-                source = g_file_new_for_path (cache_path);
-                basename = g_file_get_basename (source);
-                path = g_build_filename ("images", basename, NULL);
-                destname = g_build_filename (exporter->dir, path, NULL);
-
-                dest = g_file_new_for_path (destname);
-
-                if (!g_file_copy (source, dest, G_FILE_COPY_NONE, NULL, NULL, NULL, error))
-                        return FALSE;
-
-                g_key_file_set_string (keyfile, key, "Image", path);
+        ri = get_chef_image (chef);
+        if (ri)
+                source = get_image_source (ri);
+        if (source) {
+                g_key_file_set_string (keyfile, key, "Image", source);
+                g_hash_table_insert (images, g_steal_pointer (&source), NULL);
         }
 
         g_key_file_set_string (keyfile, key, "Name", name ? name : "");
         g_key_file_set_string (keyfile, key, "Fullname", fullname ? fullname : "");
         g_key_file_set_string (keyfile, key, "Description", description ? description : "");
-
-        return TRUE;
 }
 
-static gboolean
-prepare_export (GrRecipeExporter  *exporter,
-                GError           **error)
+static void
+collect_export_data (GrRecipeExporter *exporter,
+                     GList            *list,
+                     GKeyFile         *recipes,
+                     GKeyFile         *chefs,
+                     GHashTable       *images)
 {
-#ifndef ENABLE_AUTOAR
-        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
-                     _("This build does not support exporting"));
-
-        return FALSE;
-#else
-        g_autofree char *path = NULL;
-        g_autoptr(GKeyFile) keyfile = NULL;
         GrRecipeStore *store;
+        g_autoptr(GHashTable) seen = NULL;
         GList *l;
-        g_autoptr(GHashTable) chefs = NULL;
-        g_autofree char *imagedir = NULL;
 
         store = gr_recipe_store_get ();
 
-        g_assert (exporter->dir == NULL);
-        g_assert (exporter->sources == NULL);
-        g_assert (exporter->pdf_sources == NULL);
-
-        exporter->dir = g_mkdtemp (g_build_filename (g_get_tmp_dir (), "recipeXXXXXX", NULL));
-
-        path = g_build_filename (exporter->dir, "recipes.db", NULL);
-        keyfile = g_key_file_new ();
-
-        imagedir = g_build_filename (exporter->dir, "images", NULL);
-        exporter->sources = g_list_append (exporter->sources, g_file_new_for_path (imagedir));
-
-        for (l = exporter->recipes; l; l = l->next) {
-                GrRecipe *recipe = l->data;
-
-                if (!export_one_recipe (exporter, recipe, keyfile, error))
-                        return FALSE;
-        }
-
-        if (!g_key_file_save_to_file (keyfile, path, error))
-                return FALSE;
-
-        exporter->sources = g_list_append (exporter->sources, g_file_new_for_path (path));
+        for (l = list; l; l = l->next)
+                export_one_recipe (exporter, GR_RECIPE (l->data), recipes, images);
 
-        g_clear_pointer (&path, g_free);
-        g_clear_pointer (&keyfile, g_key_file_unref);
-
-        path = g_build_filename (exporter->dir, "chefs.db", NULL);
-        keyfile = g_key_file_new ();
-
-        chefs = g_hash_table_new (g_str_hash, g_str_equal);
-        for (l = exporter->recipes; l; l = l->next) {
+        seen = g_hash_table_new (g_str_hash, g_str_equal);
+        for (l = list; l; l = l->next) {
                 GrRecipe *recipe = l->data;
                 const char *author;
                 g_autoptr(GrChef) chef = NULL;
 
                 author = gr_recipe_get_author (recipe);
-                if (g_hash_table_contains (chefs, author))
+                if (author == NULL || g_hash_table_contains (seen, author))
                         continue;
 
                 chef = gr_recipe_store_get_chef (store, author);
                 if (!chef)
                         continue;
 
-                if (!export_one_chef (exporter, chef, keyfile, error))
-                        return FALSE;
+                export_one_chef (exporter, chef, chefs, images);
 
-                g_hash_table_add (chefs, (gpointer)author);
+                g_hash_table_add (seen, (gpointer)author);
         }
-
-        if (!g_key_file_save_to_file (keyfile, path, error))
-                return FALSE;
-
-        exporter->sources = g_list_append (exporter->sources, g_file_new_for_path (path));
-
-        return TRUE;
-#endif
 }
 
 static void
-error_cb (gpointer          compressor,
-          GError           *error,
-          GrRecipeExporter *exporter)
+show_error (GrRecipeExporter *exporter,
+            GError           *error)
 {
         GtkWidget *dialog;
 
@@ -521,21 +652,31 @@ error_cb (gpointer          compressor,
                                          error->message);
         g_signal_connect (dialog, "response", G_CALLBACK (gtk_widget_destroy), NULL);
         gtk_widget_show (dialog);
+}
 
+static void
+error_cb (gpointer          compressor,
+          GError           *error,
+          GrRecipeExporter *exporter)
+{
+        show_error (exporter, error);
         cleanup_export (exporter);
 }
 
+#ifdef ENABLE_AUTOAR
 static void
-start_export (GrRecipeExporter *exporter)
+pdfs_written (GObject      *source,
+              GAsyncResult *result,
+              gpointer      data)
 {
+        GrRecipeExporter *exporter = data;
         g_autoptr(GError) error = NULL;
 
-        if (!prepare_export (exporter, &error)) {
-                error_cb (NULL, error, exporter);
-                return;
-        }
+        /* The PDFs are a convenience, the mail goes out without them */
+        exporter->pdf_sources = gr_recipe_printer_get_pdfs_finish (GR_RECIPE_PRINTER (source), result, &error);
+        if (error)
+                g_message ("Failed to export PDFs: %s", error->message);
 
-#ifdef ENABLE_AUTOAR
         exporter->compressor = autoar_compressor_new (exporter->sources, exporter->output, AUTOAR_FORMAT_TAR, AUTOAR_FILTER_GZIP, FALSE);
 
         autoar_compressor_set_output_is_dest (exporter->compressor, TRUE);
@@ -543,9 +684,183 @@ start_export (GrRecipeExporter *exporter)
         g_signal_connect (exporter->compressor, "error", G_CALLBACK (error_cb), exporter);
 
         autoar_compressor_start_async (exporter->compressor, NULL);
+}
+
+/* The PDFs are only attached to mails, they don't go into the archive */
+static void
+write_pdfs (GrRecipeExporter *exporter)
+{
+        g_autoptr(GrRecipePrinter) printer = NULL;
+
+        printer = gr_recipe_printer_new (exporter->window);
+        gr_recipe_printer_get_pdfs (printer, exporter->recipes, NULL, pdfs_written, exporter);
+}
+
+/* Sharing puts the files for the archive into a temporary directory
+ * and lets autoar compress that. The keyfiles are collected in the
+ * main thread, since that needs the recipe store; naming the images
+ * and copying them happens in a thread.
+ */
+typedef struct {
+        GKeyFile *recipes;
+        GKeyFile *chefs;
+        GHashTable *images;
+        char *dir;
+        GList *sources;
+} PrepareJob;
+
+static void
+prepare_job_free (gpointer data)
+{
+        PrepareJob *job = data;
+
+        g_key_file_unref (job->recipes);
+        g_key_file_unref (job->chefs);
+        g_hash_table_unref (job->images);
+        g_free (job->dir);
+        g_list_free_full (job->sources, g_object_unref);
+        g_free (job);
+}
+
+static void
+copy_export_files (GTask        *task,
+                   gpointer      source_object,
+                   gpointer      task_data,
+                   GCancellable *cancellable)
+{
+        PrepareJob *job = task_data;
+        g_autofree char *path = NULL;
+        g_autofree char *imagedir = NULL;
+        g_autoptr(GHashTable) copied = NULL;
+        GHashTableIter iter;
+        const char *name;
+        const char *source;
+        GError *error = NULL;
+
+        name_images (job->recipes, job->chefs, job->images);
+
+        job->dir = g_mkdtemp (g_build_filename (g_get_tmp_dir (), "recipeXXXXXX", NULL));
+
+        imagedir = g_build_filename (job->dir, "images", NULL);
+        g_mkdir_with_parents (imagedir, 0755);
+        job->sources = g_list_append (job->sources, g_file_new_for_path (imagedir));
+
+        /* Files with the same contents get the same name */
+        copied = g_hash_table_new (g_str_hash, g_str_equal);
+
+        g_hash_table_iter_init (&iter, job->images);
+        while (g_hash_table_iter_next (&iter, (gpointer *)&source, (gpointer *)&name)) {
+                g_autoptr(GFile) src = NULL;
+                g_autoptr(GFile) dest = NULL;
+                g_autofree char *destname = NULL;
+
+                if (!g_hash_table_add (copied, (gpointer)name))
+                        continue;
+
+                src = g_file_new_for_path (source);
+                destname = g_build_filename (job->dir, name, NULL);
+                dest = g_file_new_for_path (destname);
+
+                if (!g_file_copy (src, dest, G_FILE_COPY_NONE, cancellable, NULL, NULL, &error)) {
+                        g_task_return_error (task, error);
+                        return;
+                }
+        }
+
+        path = g_build_filename (job->dir, "recipes.db", NULL);
+        if (!g_key_file_save_to_file (job->recipes, path, &error)) {
+                g_task_return_error (task, error);
+                return;
+        }
+
+        job->sources = g_list_append (job->sources, g_file_new_for_path (path));
+
+        g_clear_pointer (&path, g_free);
+
+        path = g_build_filename (job->dir, "chefs.db", NULL);
+        if (!g_key_file_save_to_file (job->chefs, path, &error)) {
+                g_task_return_error (task, error);
+                return;
+        }
+
+        job->sources = g_list_append (job->sources, g_file_new_for_path (path));
+
+        g_task_return_boolean (task, TRUE);
+}
+
+static void
+export_prepared (GObject      *source,
+                 GAsyncResult *result,
+                 gpointer      data)
+{
+        GrRecipeExporter *exporter = GR_RECIPE_EXPORTER (source);
+        PrepareJob *job = g_task_get_task_data (G_TASK (result));
+        g_autoptr(GError) error = NULL;
+
+        exporter->dir = g_steal_pointer (&job->dir);
+        exporter->sources = g_steal_pointer (&job->sources);
+
+        if (!g_task_propagate_boolean (G_TASK (result), &error)) {
+                error_cb (NULL, error, exporter);
+                return;
+        }
+
+        write_pdfs (exporter);
+}
+#endif
+
+static void
+prepare_export (GrRecipeExporter *exporter)
+{
+#ifndef ENABLE_AUTOAR
+        g_autoptr(GError) error = NULL;
+
+        g_set_error (&error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     _("This build does not support exporting"));
+        error_cb (NULL, error, exporter);
+#else
+        g_autoptr(GTask) task = NULL;
+        PrepareJob *job;
+
+        g_assert (exporter->dir == NULL);
+        g_assert (exporter->sources == NULL);
+        g_assert (exporter->pdf_sources == NULL);
+
+        job = g_new0 (PrepareJob, 1);
+        job->recipes = g_key_file_new ();
+        job->chefs = g_key_file_new ();
+        job->images = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+        collect_export_data (exporter, exporter->recipes, job->recipes, job->chefs, job->images);
+
+        task = g_task_new (exporter, NULL, export_prepared, NULL);
+        g_task_set_task_data (task, job, prepare_job_free);
+        g_task_run_in_thread (task, copy_export_files);
 #endif
 }
 
+static void
+images_fetched (GObject      *source,
+                GAsyncResult *result,
+                gpointer      data)
+{
+        GrRecipeExporter *exporter = GR_RECIPE_EXPORTER (source);
+        g_autoptr(GError) error = NULL;
+
+        if (!fetch_images_finish (exporter, result, &error)) {
+                error_cb (NULL, error, exporter);
+                return;
+        }
+
+        prepare_export (exporter);
+}
+
+static void
+start_export (GrRecipeExporter *exporter)
+{
+        fetch_images (exporter, exporter->recipes, NULL, images_fetched, NULL);
+}
+
 static void
 do_export (GrRecipeExporter *exporter)
 {
@@ -815,12 +1130,13 @@ gr_recipe_exporter_contribute (GrRecipeExporter *exporter,
         do_export (exporter);
 }
 
-static void
-collect_all_recipes (GrRecipeExporter *exporter)
+static GList *
+collect_all_recipes (void)
 {
         GrRecipeStore *store;
         g_autofree char **keys = NULL;
         guint length;
+        GList *recipes = NULL;
         int i;
 
         store = gr_recipe_store_get ();
@@ -828,24 +1144,257 @@ collect_all_recipes (GrRecipeExporter *exporter)
         for (i = 0; keys[i]; i++) {
                 g_autoptr(GrRecipe) recipe = gr_recipe_store_get_recipe (store, keys[i]);
                 if (!gr_recipe_is_readonly (recipe))
-                        exporter->recipes = g_list_append (exporter->recipes, recipe);
+                        recipes = g_list_prepend (recipes, g_object_ref (recipe));
+        }
+
+        return g_list_reverse (recipes);
+}
+
+/* Exporting everything can take a while, so it is done in a thread
+ * that names the images and streams them and the keyfiles straight
+ * into the compressed archive. Missing images are downloaded, and the
+ * keyfiles are built in the main thread beforehand, since that needs
+ * the recipe store.
+ *
+ * A background export keeps all of its state in the job, so it does
+ * not get in the way of sharing recipes at the same time.
+ */
+typedef struct {
+        GList *recipes;
+        GFile *output;
+        GKeyFile *recipes_db;
+        GKeyFile *chefs_db;
+        GHashTable *images;
+} ExportJob;
+
+static void
+export_job_free (gpointer data)
+{
+        ExportJob *job = data;
+
+        g_list_free_full (job->recipes, g_object_unref);
+        g_object_unref (job->output);
+        g_clear_pointer (&job->recipes_db, g_key_file_unref);
+        g_clear_pointer (&job->chefs_db, g_key_file_unref);
+        g_clear_pointer (&job->images, g_hash_table_unref);
+        g_free (job);
+}
+
+typedef struct {
+        GrRecipeExporter *exporter;
+        double fraction;
+} Progress;
+
+static gboolean
+emit_progress (gpointer data)
+{
+        Progress *progress = data;
+
+        g_signal_emit (progress->exporter, progress_signal, 0, progress->fraction);
+
+        return G_SOURCE_REMOVE;
+}
+
+static void
+progress_free (gpointer data)
+{
+        Progress *progress = data;
+
+        g_object_unref (progress->exporter);
+        g_free (progress);
+}
+
+static void
+report_progress (GrRecipeExporter *exporter,
+                 guint             done,
+                 guint             total)
+{
+        Progress *progress;
+
+        progress = g_new (Progress, 1);
+        progress->exporter = g_object_ref (exporter);
+        progress->fraction = (double)done / total;
+
+        g_main_context_invoke_full (NULL, G_PRIORITY_DEFAULT, emit_progress, progress, progress_free);
+}
+
+static void
+write_archive (GTask        *task,
+               gpointer      source_object,
+               gpointer      task_data,
+               GCancellable *cancellable)
+{
+        GrRecipeExporter *exporter = source_object;
+        ExportJob *job = task_data;
+        g_autoptr(GFileOutputStream) file_out = NULL;
+        g_autoptr(GConverter) compressor = NULL;
+        g_autoptr(GOutputStream) out = NULL;
+        g_autoptr(GHashTable) written = NULL;
+        g_autofree char *recipes_db = NULL;
+        g_autofree char *chefs_db = NULL;
+        gsize recipes_db_length;
+        gsize chefs_db_length;
+        GHashTableIter iter;
+        const char *name;
+        const char *path;
+        guint done, total;
+        GError *error = NULL;
+
+        name_images (job->recipes_db, job->chefs_db, job->images);
+
+        recipes_db = g_key_file_to_data (job->recipes_db, &recipes_db_length, NULL);
+        chefs_db = g_key_file_to_data (job->chefs_db, &chefs_db_length, NULL);
+
+        file_out = g_file_replace (job->output, NULL, FALSE, G_FILE_CREATE_NONE, cancellable, &error);
+        if (!file_out) {
+                g_task_return_error (task, error);
+                return;
+        }
+
+        compressor = G_CONVERTER (g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1));
+        out = g_converter_output_stream_new (G_OUTPUT_STREAM (file_out), compressor);
+
+        done = 0;
+        total = g_hash_table_size (job->images) + 1;
+
+        if (!gr_tar_write_data (out, "recipes.db", recipes_db, recipes_db_length, cancellable, &error) ||
+            !gr_tar_write_data (out, "chefs.db", chefs_db, chefs_db_length, cancellable, &error) ||
+            !gr_tar_write_directory (out, "images", cancellable, &error))
+                goto out;
+
+        report_progress (exporter, ++done, total);
+
+        /* Files with the same contents get the same name */
+        written = g_hash_table_new (g_str_hash, g_str_equal);
+
+        g_hash_table_iter_init (&iter, job->images);
+        while (g_hash_table_iter_next (&iter, (gpointer *)&path, (gpointer *)&name)) {
+                g_autoptr(GFile) file = NULL;
+
+                if (!g_hash_table_add (written, (gpointer)name)) {
+                        report_progress (exporter, ++done, total);
+                        continue;
+                }
+
+                file = g_file_new_for_path (path);
+                if (!gr_tar_write_file (out, name, file, cancellable, &error))
+                        goto out;
+
+                report_progress (exporter, ++done, total);
+        }
+
+        if (!gr_tar_write_end (out, cancellable, &error))
+                goto out;
+
+        g_output_stream_close (out, cancellable, &error);
+
+out:
+        if (error) {
+                g_autoptr(GCancellable) abort = NULL;
+
+                /* Closing a replace stream normally moves the new file
+                 * into place. Closing it cancelled drops it instead, so
+                 * a truncated archive never replaces an existing file.
+                 */
+                abort = g_cancellable_new ();
+                g_cancellable_cancel (abort);
+                g_output_stream_close (G_OUTPUT_STREAM (file_out), abort, NULL);
+                g_task_return_error (task, error);
+                return;
+        }
+
+        g_task_return_boolean (task, TRUE);
+}
+
+static void
+export_all_done (GObject      *source,
+                 GAsyncResult *result,
+                 gpointer      data)
+{
+        GrRecipeExporter *exporter = GR_RECIPE_EXPORTER (source);
+        ExportJob *job = g_task_get_task_data (G_TASK (result));
+        g_autoptr(GError) error = NULL;
+
+        g_clear_object (&exporter->cancellable);
+
+        if (!g_task_propagate_boolean (G_TASK (result), &error)) {
+                if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+                        g_info ("Export cancelled");
+                else
+                        show_error (exporter, error);
+
+                g_signal_emit (exporter, done_signal, 0, NULL);
+                return;
         }
+
+        g_signal_emit (exporter, done_signal, 0, job->output);
+}
+
+static void
+export_all_images_fetched (GObject      *source,
+                           GAsyncResult *result,
+                           gpointer      data)
+{
+        GrRecipeExporter *exporter = GR_RECIPE_EXPORTER (source);
+        ExportJob *job = data;
+        g_autoptr(GTask) task = NULL;
+        g_autoptr(GError) error = NULL;
+
+        if (!fetch_images_finish (exporter, result, &error)) {
+                g_info ("Export cancelled");
+                export_job_free (job);
+                g_clear_object (&exporter->cancellable);
+                g_signal_emit (exporter, done_signal, 0, NULL);
+                return;
+        }
+
+        job->recipes_db = g_key_file_new ();
+        job->chefs_db = g_key_file_new ();
+        job->images = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+        collect_export_data (exporter, job->recipes, job->recipes_db, job->chefs_db, job->images);
+
+        task = g_task_new (exporter, exporter->cancellable, export_all_done, NULL);
+        g_task_set_task_data (task, job, export_job_free);
+        g_task_run_in_thread (task, write_archive);
 }
 
+/* Exports all of the user's recipes to @file. When the export is
+ * over, ::done is emitted with @file, or with %NULL if the export
+ * failed or was cancelled.
+ */
 void
 gr_recipe_exporter_export_all (GrRecipeExporter *exporter,
                                GFile            *file)
 {
-        collect_all_recipes (exporter);
+        ExportJob *job;
 
-        if (exporter->recipes == NULL)
+        if (exporter->cancellable) {
+                g_info ("An export is already running");
                 return;
+        }
 
-        g_info ("Exporting %d recipes", g_list_length (exporter->recipes));
+        job = g_new0 (ExportJob, 1);
+        job->recipes = collect_all_recipes ();
+        job->output = g_object_ref (file);
 
-        exporter->output = file;
+        if (job->recipes == NULL) {
+                g_info ("No recipes to export");
+                export_job_free (job);
+                g_signal_emit (exporter, done_signal, 0, NULL);
+                return;
+        }
 
-        exporter->just_export = TRUE;
+        g_info ("Exporting %d recipes", g_list_length (job->recipes));
 
-        start_export (exporter);
+        exporter->cancellable = g_cancellable_new ();
+
+        fetch_images (exporter, job->recipes, exporter->cancellable, export_all_images_fetched, job);
+}
+
+void
+gr_recipe_exporter_cancel (GrRecipeExporter *exporter)
+{
+        if (exporter->cancellable)
+                g_cancellable_cancel (exporter->cancellable);
 }
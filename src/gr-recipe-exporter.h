@@ -38,5 +38,6 @@ void              gr_recipe_exporter_contribute (GrRecipeExporter *exporter,
                                                  GrRecipe         *recipe);
 void              gr_recipe_exporter_export_all (GrRecipeExporter *exporter,
                                                  GFile            *file);
+void              gr_recipe_exporter_cancel     (GrRecipeExporter *exporter);
 
 G_END_DECLS
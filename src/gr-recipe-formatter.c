@@ -69,13 +69,15 @@ gr_recipe_format (GrRecipe *recipe)
         GString *s;
         g_autoptr(GrChef) chef = NULL;
         GrRecipeStore *store;
-        g_autoptr(GrIngredientsList) ingredients = NULL;
+        GrIngredientsList *ingredients;
         g_autofree char **segs = NULL;
-        g_auto(GStrv) ings = NULL;
         g_autofree char *amount = NULL;
         g_autofree char *yield_str = NULL;
+        GrIngredientsListIter iter;
+        const char *name;
+        double value;
+        GrUnit unit;
         int i, j;
-        int length;
         g_autoptr(GPtrArray) steps = NULL;
 
         store = gr_recipe_store_get ();
@@ -94,7 +96,7 @@ gr_recipe_format (GrRecipe *recipe)
         g_string_append (s, "\n");
         g_string_append_printf (s, "%s\n", gr_recipe_get_translated_description (recipe));
 
-        ingredients = gr_ingredients_list_new (gr_recipe_get_ingredients (recipe));
+        ingredients = gr_recipe_get_ingredients_list (recipe);
         segs = gr_ingredients_list_get_segments (ingredients);
         for (j = 0; segs[j]; j++) {
                 g_string_append (s, "\n");
@@ -103,17 +105,19 @@ gr_recipe_format (GrRecipe *recipe)
                 else
                         g_string_append_printf (s, "* %s *\n", _("Ingredients"));
 
-                ings = gr_ingredients_list_get_ingredients (ingredients, segs[j]);
-                length = g_strv_length (ings);
-                for (i = 0; i < length; i++) {
-                        char *unit;
+                gr_ingredients_list_iter_init (&iter, ingredients, segs[j]);
+                while (gr_ingredients_list_iter_next (&iter, NULL, &name, &value, &unit)) {
+                        g_autofree char *number = NULL;
 
                         g_string_append (s, "\n");
-                        unit = gr_ingredients_list_scale_unit (ingredients, segs[j], ings[i], 1.0);
-                        g_string_append (s, unit);
-                        g_free (unit);
+                        number = gr_number_format (value);
+                        g_string_append (s, number);
+                        if (unit) {
+                                g_string_append (s, " ");
+                                g_string_append (s, gr_unit_get_abbreviation (unit));
+                        }
                         g_string_append (s, " ");
-                        g_string_append (s, ings[i]);
+                        g_string_append (s, name);
                 }
 
                 g_string_append (s, "\n");
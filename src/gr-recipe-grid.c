@@ -0,0 +1,463 @@
+/* gr-recipe-grid.c:
+ *
+ * Copyright (C) 2016 Matthias Clasen <mclasen@redhat.com>
+ *
+ * Licensed under the GNU General Public License Version 3
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gtk/gtk.h>
+
+#include "gr-recipe-grid.h"
+#include "gr-recipe-tile.h"
+#include "gr-recipe.h"
+
+/* GrRecipeGrid shows the recipes in a GListModel as tiles, in a
+ * fixed number of columns.
+ *
+ * Creating a tile is not cheap, so the grid only owns a small pool of
+ * them: enough rows to cover the visible area of the surrounding
+ * scrolled window, plus one row above and below. The grid asks for the
+ * height that all the rows would take, and when it is scrolled, works
+ * out the first row in view from the scroll offset and hands the tiles
+ * that went out of view the recipes that came into view. The pool is
+ * used as a ring, so the tile for a model position is always the one
+ * at position % pool size, and scrolling by a row only rebinds the
+ * tiles of one row.
+ */
+
+#define COLUMNS 3
+#define SPACING 20
+#define EXTRA_ROWS 2
+
+struct _GrRecipeGrid
+{
+        GtkContainer parent_instance;
+
+        GListModel *model;
+        guint n_items;
+        gboolean show_shared;
+
+        GPtrArray *tiles;
+        guint first;
+
+        GtkWidget *scrolled_window;
+        GtkAdjustment *vadjustment;
+};
+
+G_DEFINE_TYPE (GrRecipeGrid, gr_recipe_grid, GTK_TYPE_CONTAINER)
+
+static guint
+get_n_rows (GrRecipeGrid *grid)
+{
+        return (grid->n_items + COLUMNS - 1) / COLUMNS;
+}
+
+/* Tiles all have the same size, so measuring one is enough */
+static void
+get_tile_size (GrRecipeGrid *grid,
+               int          *width,
+               int          *height)
+{
+        GtkRequisition natural;
+
+        if (grid->tiles->len == 0) {
+                *width = *height = 0;
+                return;
+        }
+
+        gtk_widget_get_preferred_size (g_ptr_array_index (grid->tiles, 0), NULL, &natural);
+        *width = natural.width;
+        *height = natural.height;
+}
+
+static guint
+get_tile_position (GrRecipeGrid *grid,
+                   guint         index)
+{
+        guint len = grid->tiles->len;
+
+        return grid->first + (index + len - grid->first % len) % len;
+}
+
+static void
+bind_tile (GrRecipeGrid *grid,
+           guint         position)
+{
+        GtkWidget *tile;
+
+        tile = g_ptr_array_index (grid->tiles, position % grid->tiles->len);
+
+        if (position < grid->n_items) {
+                g_autoptr(GrRecipe) recipe = NULL;
+
+                recipe = g_list_model_get_item (grid->model, position);
+                gr_recipe_tile_set_recipe (GR_RECIPE_TILE (tile), recipe);
+                gtk_widget_set_child_visible (tile, TRUE);
+        }
+        else {
+                gr_recipe_tile_set_recipe (GR_RECIPE_TILE (tile), NULL);
+                gtk_widget_set_child_visible (tile, FALSE);
+        }
+}
+
+static void
+bind_range (GrRecipeGrid *grid,
+            guint         start,
+            guint         end)
+{
+        guint position;
+
+        for (position = start; position < end; position++)
+                bind_tile (grid, position);
+}
+
+static void
+add_tile (GrRecipeGrid *grid)
+{
+        GtkWidget *tile;
+
+        tile = gr_recipe_tile_new (NULL);
+        gr_recipe_tile_set_show_shared (GR_RECIPE_TILE (tile), grid->show_shared);
+        gtk_widget_set_parent (tile, GTK_WIDGET (grid));
+        g_ptr_array_add (grid->tiles, tile);
+}
+
+/* The pool only grows when the visible area does, not when scrolling */
+static void
+ensure_pool (GrRecipeGrid *grid,
+             guint         n_tiles)
+{
+        if (n_tiles <= grid->tiles->len)
+                return;
+
+        while (grid->tiles->len < n_tiles)
+                add_tile (grid);
+
+        /* The ring has a new size, so everything moves */
+        bind_range (grid, grid->first, grid->first + grid->tiles->len);
+}
+
+static void
+set_first (GrRecipeGrid *grid,
+           guint         first)
+{
+        guint len = grid->tiles->len;
+        guint old_first = grid->first;
+
+        if (first == old_first)
+                return;
+
+        grid->first = first;
+
+        /* Only the tiles whose position left the window need new recipes */
+        if (first > old_first && first < old_first + len)
+                bind_range (grid, old_first + len, first + len);
+        else if (first < old_first && old_first < first + len)
+                bind_range (grid, first, old_first);
+        else
+                bind_range (grid, first, first + len);
+
+        gtk_widget_queue_allocate (GTK_WIDGET (grid));
+}
+
+static void
+update_visible (GrRecipeGrid *grid)
+{
+        int tile_width, tile_height;
+        double page_size;
+        guint n_visible;
+        guint first_row;
+        int x, y;
+
+        if (grid->model == NULL || grid->n_items == 0)
+                return;
+
+        /* One row to measure with, for a start */
+        ensure_pool (grid, COLUMNS);
+
+        if (grid->vadjustment == NULL || !gtk_widget_get_mapped (GTK_WIDGET (grid)))
+                return;
+
+        get_tile_size (grid, &tile_width, &tile_height);
+        page_size = gtk_adjustment_get_page_size (grid->vadjustment);
+        if (tile_height <= 0 || page_size <= 0)
+                return;
+
+        n_visible = (guint) (page_size / (tile_height + SPACING)) + 1;
+        ensure_pool (grid, (n_visible + EXTRA_ROWS) * COLUMNS);
+
+        /* y is the top of the grid, relative to the top of the visible area */
+        if (!gtk_widget_translate_coordinates (GTK_WIDGET (grid), grid->scrolled_window,
+                                               0, 0, &x, &y))
+                return;
+
+        first_row = y < 0 ? -y / (tile_height + SPACING) : 0;
+        if (first_row > 0)
+                first_row--;
+
+        /* Don't leave tiles unused at the end */
+        first_row = MIN (first_row, MAX (get_n_rows (grid), grid->tiles->len / COLUMNS) - grid->tiles->len / COLUMNS);
+
+        set_first (grid, first_row * COLUMNS);
+}
+
+static void
+items_changed (GListModel   *model,
+               guint         position,
+               guint         removed,
+               guint         added,
+               GrRecipeGrid *grid)
+{
+        guint end;
+
+        grid->n_items = g_list_model_get_n_items (model);
+
+        /* Everything from @position on may have moved */
+        end = grid->first + grid->tiles->len;
+        if (grid->tiles->len > 0 && position < end)
+                bind_range (grid, MAX (position, grid->first), end);
+
+        gtk_widget_queue_resize (GTK_WIDGET (grid));
+
+        update_visible (grid);
+}
+
+static void
+adjustment_changed (GrRecipeGrid *grid)
+{
+        update_visible (grid);
+}
+
+static GtkSizeRequestMode
+gr_recipe_grid_get_request_mode (GtkWidget *widget)
+{
+        return GTK_SIZE_REQUEST_CONSTANT_SIZE;
+}
+
+static void
+gr_recipe_grid_get_preferred_width (GtkWidget *widget,
+                                    int       *minimum,
+                                    int       *natural)
+{
+        GrRecipeGrid *grid = GR_RECIPE_GRID (widget);
+        int tile_width, tile_height;
+
+        get_tile_size (grid, &tile_width, &tile_height);
+
+        *minimum = *natural = tile_width > 0 ? COLUMNS * tile_width + (COLUMNS - 1) * SPACING : 0;
+}
+
+static void
+gr_recipe_grid_get_preferred_height (GtkWidget *widget,
+                                     int       *minimum,
+                                     int       *natural)
+{
+        GrRecipeGrid *grid = GR_RECIPE_GRID (widget);
+        int tile_width, tile_height;
+        guint n_rows;
+
+        get_tile_size (grid, &tile_width, &tile_height);
+        n_rows = get_n_rows (grid);
+
+        *minimum = *natural = n_rows > 0 ? n_rows * tile_height + (n_rows - 1) * SPACING : 0;
+}
+
+static void
+gr_recipe_grid_size_allocate (GtkWidget     *widget,
+                              GtkAllocation *allocation)
+{
+        GrRecipeGrid *grid = GR_RECIPE_GRID (widget);
+        int tile_width, tile_height;
+        int offset;
+        guint i;
+
+        gtk_widget_set_allocation (widget, allocation);
+
+        get_tile_size (grid, &tile_width, &tile_height);
+
+        /* Center the columns if we got more width than we asked for */
+        offset = MAX (0, allocation->width - (COLUMNS * tile_width + (COLUMNS - 1) * SPACING)) / 2;
+
+        for (i = 0; i < grid->tiles->len; i++) {
+                GtkWidget *tile = g_ptr_array_index (grid->tiles, i);
+                GtkAllocation child;
+                guint position;
+
+                position = get_tile_position (grid, i);
+
+                child.x = allocation->x + offset + (position % COLUMNS) * (tile_width + SPACING);
+                child.y = allocation->y + (position / COLUMNS) * (tile_height + SPACING);
+                child.width = tile_width;
+                child.height = tile_height;
+
+                gtk_widget_size_allocate (tile, &child);
+        }
+}
+
+static void
+gr_recipe_grid_forall (GtkContainer *container,
+                       gboolean      include_internals,
+                       GtkCallback   callback,
+                       gpointer      data)
+{
+        GrRecipeGrid *grid = GR_RECIPE_GRID (container);
+        guint i;
+
+        /* The callback may remove the tile */
+        for (i = grid->tiles->len; i > 0; i--)
+                callback (g_ptr_array_index (grid->tiles, i - 1), data);
+}
+
+static void
+gr_recipe_grid_remove (GtkContainer *container,
+                       GtkWidget    *widget)
+{
+        GrRecipeGrid *grid = GR_RECIPE_GRID (container);
+
+        gtk_widget_unparent (widget);
+        g_ptr_array_remove (grid->tiles, widget);
+        grid->first = 0;
+}
+
+static void
+gr_recipe_grid_map (GtkWidget *widget)
+{
+        GrRecipeGrid *grid = GR_RECIPE_GRID (widget);
+        GtkWidget *scrolled_window;
+
+        GTK_WIDGET_CLASS (gr_recipe_grid_parent_class)->map (widget);
+
+        scrolled_window = gtk_widget_get_ancestor (widget, GTK_TYPE_SCROLLED_WINDOW);
+        if (scrolled_window != grid->scrolled_window) {
+                if (grid->vadjustment)
+                        g_signal_handlers_disconnect_by_func (grid->vadjustment, adjustment_changed, grid);
+                g_clear_object (&grid->vadjustment);
+
+                grid->scrolled_window = scrolled_window;
+                if (scrolled_window) {
+                        grid->vadjustment = g_object_ref (gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (scrolled_window)));
+                        g_signal_connect_swapped (grid->vadjustment, "value-changed", G_CALLBACK (adjustment_changed), grid);
+                        g_signal_connect_swapped (grid->vadjustment, "changed", G_CALLBACK (adjustment_changed), grid);
+                }
+        }
+
+        update_visible (grid);
+}
+
+static void
+gr_recipe_grid_dispose (GObject *object)
+{
+        GrRecipeGrid *grid = GR_RECIPE_GRID (object);
+
+        if (grid->vadjustment)
+                g_signal_handlers_disconnect_by_func (grid->vadjustment, adjustment_changed, grid);
+        g_clear_object (&grid->vadjustment);
+        grid->scrolled_window = NULL;
+
+        if (grid->model)
+                g_signal_handlers_disconnect_by_func (grid->model, items_changed, grid);
+        g_clear_object (&grid->model);
+
+        G_OBJECT_CLASS (gr_recipe_grid_parent_class)->dispose (object);
+}
+
+static void
+gr_recipe_grid_finalize (GObject *object)
+{
+        GrRecipeGrid *grid = GR_RECIPE_GRID (object);
+
+        g_ptr_array_unref (grid->tiles);
+
+        G_OBJECT_CLASS (gr_recipe_grid_parent_class)->finalize (object);
+}
+
+static void
+gr_recipe_grid_init (GrRecipeGrid *grid)
+{
+        gtk_widget_set_has_window (GTK_WIDGET (grid), FALSE);
+        grid->tiles = g_ptr_array_new ();
+}
+
+static void
+gr_recipe_grid_class_init (GrRecipeGridClass *klass)
+{
+        GObjectClass *object_class = G_OBJECT_CLASS (klass);
+        GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+        GtkContainerClass *container_class = GTK_CONTAINER_CLASS (klass);
+
+        object_class->dispose = gr_recipe_grid_dispose;
+        object_class->finalize = gr_recipe_grid_finalize;
+
+        widget_class->map = gr_recipe_grid_map;
+        widget_class->get_request_mode = gr_recipe_grid_get_request_mode;
+        widget_class->get_preferred_width = gr_recipe_grid_get_preferred_width;
+        widget_class->get_preferred_height = gr_recipe_grid_get_preferred_height;
+        widget_class->size_allocate = gr_recipe_grid_size_allocate;
+
+        container_class->forall = gr_recipe_grid_forall;
+        container_class->remove = gr_recipe_grid_remove;
+}
+
+GtkWidget *
+gr_recipe_grid_new (void)
+{
+        return GTK_WIDGET (g_object_new (GR_TYPE_RECIPE_GRID, NULL));
+}
+
+void
+gr_recipe_grid_set_model (GrRecipeGrid *grid,
+                          GListModel   *model)
+{
+        if (grid->model == model)
+                return;
+
+        if (grid->model)
+                g_signal_handlers_disconnect_by_func (grid->model, items_changed, grid);
+
+        g_set_object (&grid->model, model);
+        grid->n_items = model ? g_list_model_get_n_items (model) : 0;
+        grid->first = 0;
+
+        if (grid->model)
+                g_signal_connect (grid->model, "items-changed", G_CALLBACK (items_changed), grid);
+
+        if (grid->tiles->len > 0)
+                bind_range (grid, 0, grid->tiles->len);
+
+        gtk_widget_queue_resize (GTK_WIDGET (grid));
+
+        update_visible (grid);
+}
+
+GListModel *
+gr_recipe_grid_get_model (GrRecipeGrid *grid)
+{
+        return grid->model;
+}
+
+void
+gr_recipe_grid_set_show_shared (GrRecipeGrid *grid,
+                                gboolean      show_shared)
+{
+        guint i;
+
+        grid->show_shared = show_shared;
+
+        for (i = 0; i < grid->tiles->len; i++)
+                gr_recipe_tile_set_show_shared (GR_RECIPE_TILE (g_ptr_array_index (grid->tiles, i)), show_shared);
+}
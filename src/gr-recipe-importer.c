@@ -21,7 +21,9 @@
 #include "config.h"
 
 #include <stdlib.h>
+#include <errno.h>
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 
 #ifdef ENABLE_AUTOAR
 #include <gnome-autoar/gnome-autoar.h>
@@ -51,6 +53,8 @@ struct _GrRecipeImporter
         GFile *output;
         char *dir;
 
+        GHashTable *image_map; /* path in the archive -> imported path */
+
         GKeyFile *chefs_keyfile;
         char **chef_ids;
         int current_chef;
@@ -92,20 +96,29 @@ struct _GrRecipeImporter
         GDateTime *recipe_mtime;
 
         GList *recipes;
+
+        gboolean in_batch;
+        gint64 import_start;
+        int n_imported;
 };
 
 G_DEFINE_TYPE (GrRecipeImporter, gr_recipe_importer, G_TYPE_OBJECT)
 
+static void commit_batch (GrRecipeImporter *importer);
+
 static void
 gr_recipe_importer_finalize (GObject *object)
 {
         GrRecipeImporter *importer = GR_RECIPE_IMPORTER (object);
 
+        commit_batch (importer);
+
 #ifdef ENABLE_AUTOAR
         g_clear_object (&importer->extractor);
 #endif
         g_clear_object (&importer->output);
         g_free (importer->dir);
+        g_clear_pointer (&importer->image_map, g_hash_table_unref);
 
         g_clear_pointer (&importer->chefs_keyfile, g_key_file_unref);
         g_clear_pointer (&importer->chef_ids, g_strfreev);
@@ -164,6 +177,7 @@ gr_recipe_importer_init (GrRecipeImporter *self)
         self->current_chef = -1;
         self->current_recipe = -1;
         self->chef_id_map = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+        self->image_map = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
 }
 
 GrRecipeImporter *
@@ -178,15 +192,62 @@ gr_recipe_importer_new (GtkWindow *parent)
         return importer;
 }
 
+/* Chefs and recipes are added to the store in a batch, so it is
+ * saved once instead of once per recipe. The batch is opened when
+ * the first item is added, and committed whenever we stop to wait
+ * for the user, so the store is never left in batch mode while
+ * other parts of the application may add recipes.
+ */
+static void
+begin_batch (GrRecipeImporter *importer)
+{
+        if (importer->in_batch)
+                return;
+
+        gr_recipe_store_begin_batch (gr_recipe_store_get ());
+        importer->in_batch = TRUE;
+}
+
+static void
+commit_batch (GrRecipeImporter *importer)
+{
+        if (!importer->in_batch)
+                return;
+
+        gr_recipe_store_commit_batch (gr_recipe_store_get ());
+        importer->in_batch = FALSE;
+}
+
+static void
+start_import (GrRecipeImporter *importer)
+{
+        importer->import_start = g_get_monotonic_time ();
+        importer->n_imported = 0;
+}
+
+static void
+report_import (GrRecipeImporter *importer)
+{
+        double elapsed;
+
+        elapsed = (g_get_monotonic_time () - importer->import_start) / (double)G_USEC_PER_SEC;
+        g_info ("Imported %d recipes in %.2f s (%.1f recipes/s)",
+                importer->n_imported, elapsed,
+                elapsed > 0 ? importer->n_imported / elapsed : 0.0);
+}
+
 static void
 cleanup_import (GrRecipeImporter *importer)
 {
+        commit_batch (importer);
+
 #ifdef ENABLE_AUTOAR
         g_clear_object (&importer->extractor);
 #endif
 
         g_clear_pointer (&importer->dir, g_free);
         g_clear_object (&importer->output);
+        g_hash_table_remove_all (importer->image_map);
 
         g_clear_pointer (&importer->chefs_keyfile, g_key_file_unref);
         g_clear_pointer (&importer->chef_ids, g_strfreev);
@@ -244,6 +305,10 @@ error_cb (gpointer          extractor,
 }
 
 #ifdef ENABLE_AUTOAR
+/* Images are stored under the hash of their contents, see
+ * get_content_addressed_name(). If we already have the image,
+ * there is nothing to copy.
+ */
 static gboolean
 copy_image (GrRecipeImporter  *importer,
             const char        *path,
@@ -251,30 +316,64 @@ copy_image (GrRecipeImporter  *importer,
             GError           **error)
 {
         g_autofree char *srcpath = NULL;
+        g_autofree char *name = NULL;
+        g_autofree char *dir = NULL;
         g_autofree char *destpath = NULL;
+        g_autofree char *tmppath = NULL;
         g_autoptr(GFile) source = NULL;
-        g_autoptr(GFile) dest = NULL;
-        g_autofree char *orig_dest = NULL;
-        int i;
+        g_autoptr(GFile) tmp = NULL;
+        const char *imported;
 
-        srcpath = g_build_filename (importer->dir, path, NULL);
-        source = g_file_new_for_path (srcpath);
-        orig_dest = g_build_filename (get_user_data_dir (), path, NULL);
-
-        destpath = g_strdup (orig_dest);
-        for (i = 1; i < 10; i++) {
-                if (!g_file_test (destpath, G_FILE_TEST_EXISTS))
-                        break;
-                g_free (destpath);
-                destpath = g_strdup_printf ("%s%d", orig_dest, i);
+        imported = g_hash_table_lookup (importer->image_map, path);
+        if (imported) {
+                *new_path = g_strdup (imported);
+                return TRUE;
         }
-        dest = g_file_new_for_path (destpath);
 
-        if (!g_file_copy (source, dest, G_FILE_COPY_NONE, NULL, NULL, NULL, error)) {
+        srcpath = g_build_filename (importer->dir, path, NULL);
+
+        /* Don't trust the name in the archive */
+        name = get_content_addressed_name (srcpath, error);
+        if (!name)
                 return FALSE;
+
+        dir = g_build_filename (get_user_data_dir (), "images", NULL);
+        g_mkdir_with_parents (dir, 0755);
+        destpath = g_build_filename (dir, name, NULL);
+
+        if (g_file_test (destpath, G_FILE_TEST_EXISTS)) {
+                g_debug ("Image %s is already present as %s", path, destpath);
+                /* It may be unused and up for sweeping */
+                update_file_timestamp (destpath);
+        }
+        else {
+                /* Move into place under a temporary name, so a partially
+                 * written file never shows up under a content hash.
+                 */
+                source = g_file_new_for_path (srcpath);
+                tmppath = g_strconcat (destpath, ".tmp", NULL);
+                tmp = g_file_new_for_path (tmppath);
+
+                if (!g_file_move (source, tmp, G_FILE_COPY_OVERWRITE, NULL, NULL, NULL, error))
+                        return FALSE;
+
+                if (g_rename (tmppath, destpath) != 0) {
+                        int errsv = errno;
+
+                        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                                     _("Could not rename %s: %s"), tmppath, g_strerror (errsv));
+                        return FALSE;
+                }
+
+                /* The move kept the time from the archive, but the
+                 * sweep must see a new image as new, until the recipe
+                 * that uses it has been saved.
+                 */
+                update_file_timestamp (destpath);
         }
 
-        *new_path = g_strdup (destpath);
+        g_hash_table_insert (importer->image_map, g_strdup (path), g_strdup (destpath));
+        *new_path = g_steal_pointer (&destpath);
 
         return TRUE;
 }
@@ -336,12 +435,14 @@ import_recipe (GrRecipeImporter *importer)
                       "mtime", importer->recipe_mtime,
                       NULL);
 
+        begin_batch (importer);
         if (!gr_recipe_store_add_recipe (store, recipe, &error)) {
                 error_cb (importer->extractor, error, importer);
                 return FALSE;
         }
 
         importer->recipes = g_list_append (importer->recipes, g_object_ref (recipe));
+        importer->n_imported++;
 
         return TRUE;
 }
@@ -474,6 +575,8 @@ next:
         id = importer->recipe_ids[importer->current_recipe];
 
         if (id == NULL) {
+                commit_batch (importer);
+                report_import (importer);
                 g_signal_emit (importer, done_signal, 0, importer->recipes);
                 cleanup_import (importer);
                 return TRUE;
@@ -542,6 +645,7 @@ next:
                 goto next;
         }
 
+        commit_batch (importer);
         show_recipe_conflict_dialog (importer);
 
         return TRUE;
@@ -606,6 +710,7 @@ import_chef (GrRecipeImporter *importer)
         g_clear_pointer (&importer->chef_description, g_free);
         g_clear_pointer (&importer->chef_image_path, g_free);
 
+        begin_batch (importer);
         if (!gr_recipe_store_add_chef (store, chef, &error)) {
                 error_cb (importer->extractor, error, importer);
                 return FALSE;
@@ -778,6 +883,7 @@ next:
                 goto next;
         }
 
+        commit_batch (importer);
         show_chef_conflict_dialog (importer, chef);
 
         return TRUE;
@@ -817,6 +923,7 @@ import_chefs (GrRecipeImporter *importer)
 static void
 finish_import (GrRecipeImporter *importer)
 {
+        start_import (importer);
         import_chefs (importer);
 }
 
@@ -826,6 +933,27 @@ completed_cb (AutoarExtractor  *extractor,
 {
         finish_import (importer);
 }
+
+static void
+gourmet_import_done (GObject      *source,
+                     GAsyncResult *result,
+                     gpointer      data)
+{
+        g_autoptr(GrRecipeImporter) importer = data;
+        g_autoptr(GError) error = NULL;
+        GList *recipes;
+
+        recipes = gr_gourmet_format_import_finish (result, &error);
+
+        importer->n_imported = g_list_length (recipes);
+        report_import (importer);
+
+        if (error)
+                error_cb (NULL, error, importer);
+
+        g_signal_emit (importer, done_signal, 0, recipes);
+        g_list_free (recipes);
+}
 #endif
 
 void
@@ -843,15 +971,8 @@ gr_recipe_importer_import_from (GrRecipeImporter *importer,
 
         basename = g_file_get_basename (file);
         if (g_str_has_suffix (basename, ".xml")) {
-                g_autoptr(GError) error = NULL;
-                GList *recipes;
-
-                if (!(recipes = gr_gourmet_format_import (file, &error)))
-                        error_cb (NULL, error, importer);
-
-                g_signal_emit (importer, done_signal, 0, recipes);
-                g_list_free (recipes);
-
+                start_import (importer);
+                gr_gourmet_format_import_async (file, NULL, gourmet_import_done, g_object_ref (importer));
                 return;
         }
 
@@ -21,8 +21,10 @@
 #include "config.h"
 
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 
 #include "gr-recipe-printer.h"
+#include "gr-print-document.h"
 #include "gr-recipe-formatter.h"
 #include "gr-ingredients-list.h"
 #include "gr-image.h"
@@ -41,11 +43,7 @@ struct _GrRecipePrinter
 
         GtkWindow *window;
 
-        PangoLayout *title_layout;
-        PangoLayout *left_layout;
-        PangoLayout *bottom_layout;
-        GdkPixbuf *image;
-        GList *page_breaks;
+        GrPrintDocument *doc;
 
         GrRecipe *recipe;
 };
@@ -97,164 +95,114 @@ process_instructions (const char *instructions)
         return g_string_free (s, FALSE);
 }
 
-static void
-begin_print (GtkPrintOperation *operation,
-             GtkPrintContext   *context,
-             GrRecipePrinter   *printer)
+/* Collects everything that goes on paper for @recipe. This needs
+ * the recipe store, so it has to happen in the main thread, unlike
+ * laying out and drawing the document.
+ */
+static GrPrintDocument *
+create_document (GrRecipe *recipe,
+                 double    width,
+                 double    height)
 {
-        double width, height;
-        PangoFontDescription *title_font;
-        PangoFontDescription *body_font;
-        PangoAttrList *attrs;
-        PangoAttribute *attr;
+        GrPrintDocument *doc;
         int length;
         int i, j;
-        double page_height;
-        GList *page_breaks;
         g_autoptr(GString) s = NULL;
         GPtrArray *images;
-        PangoRectangle title_rect;
-        PangoRectangle left_rect;
-        int num_lines;
-        int line;
-        g_autoptr(GrIngredientsList) ingredients = NULL;
-        PangoTabArray *tabs;
+        GrIngredientsList *ingredients;
+        GrIngredientsListIter iter;
+        double ing_amount;
+        GrUnit ing_unit;
         g_autofree char **segs = NULL;
         g_auto(GStrv) ings = NULL;
         g_autofree char *instructions = NULL;
         g_autoptr(GrChef) chef = NULL;
         GrRecipeStore *store;
-        PangoLayout *layout;
-        int amount_width;
         const char *value;
         g_autofree char *amount = NULL;
 
         store = gr_recipe_store_get ();
-        chef = gr_recipe_store_get_chef (store, gr_recipe_get_author (printer->recipe));
+        chef = gr_recipe_store_get_chef (store, gr_recipe_get_author (recipe));
 
-        width = gtk_print_context_get_width (context);
-        height = gtk_print_context_get_height (context);
+        doc = gr_print_document_new ();
 
-        images = gr_recipe_get_images (printer->recipe);
+        images = gr_recipe_get_images (recipe);
         if (images && images->len > 0) {
-                int def_index = gr_recipe_get_default_image (printer->recipe);
+                int def_index = gr_recipe_get_default_image (recipe);
                 GrImage *ri = g_ptr_array_index (images, def_index);
-                printer->image = gr_image_load_sync (ri, width / 2, height / 4, TRUE);
-        }
-
-        title_font = pango_font_description_from_string ("Cantarell Bold 18");
-        body_font = pango_font_description_from_string ("Cantarell 12");
+                g_autoptr(GdkPixbuf) image = NULL;
 
-        printer->title_layout = gtk_print_context_create_pango_layout (context);
-        pango_layout_set_width (printer->title_layout, width * PANGO_SCALE);
-        pango_layout_set_font_description (printer->title_layout, title_font);
+                image = gr_image_load_sync (ri, width / 2, height / 4, TRUE);
+                gr_print_document_set_image (doc, image);
+        }
 
         s = g_string_new ("");
-        g_string_append (s, gr_recipe_get_translated_name (printer->recipe));
+        g_string_append (s, gr_recipe_get_translated_name (recipe));
         g_string_append (s, "\n\n");
 
-        pango_layout_set_text (printer->title_layout, s->str, s->len);
-
-        printer->left_layout = gtk_print_context_create_pango_layout (context);
-        pango_layout_set_width (printer->left_layout, (width / 2) * PANGO_SCALE);
-        pango_layout_set_font_description (printer->left_layout, body_font);
+        gr_print_document_set_title (doc, s->str);
 
         g_string_truncate (s, 0);
 
         g_string_append_printf (s, "%s %s\n", _("Author:"), gr_chef_get_fullname (chef));
-        g_string_append_printf (s, "%s %s\n", _("Preparation:"), gr_recipe_get_prep_time (printer->recipe));
-        g_string_append_printf (s, "%s %s\n", _("Cooking:"), gr_recipe_get_cook_time (printer->recipe));
-        amount = gr_number_format (gr_recipe_get_yield (printer->recipe));
-        g_string_append_printf (s, "%s %s %s\n", _("Yield:"), amount, gr_recipe_get_yield_unit (printer->recipe));
-        value = gr_recipe_get_cuisine (printer->recipe);
+        g_string_append_printf (s, "%s %s\n", _("Preparation:"), gr_recipe_get_prep_time (recipe));
+        g_string_append_printf (s, "%s %s\n", _("Cooking:"), gr_recipe_get_cook_time (recipe));
+        amount = gr_number_format (gr_recipe_get_yield (recipe));
+        g_string_append_printf (s, "%s %s %s\n", _("Yield:"), amount, gr_recipe_get_yield_unit (recipe));
+        value = gr_recipe_get_cuisine (recipe);
         if (value && *value) {
                 const char *title;
                 gr_cuisine_get_data (value, &title, NULL, NULL);
                 g_string_append_printf (s, "%s %s\n", _("Cuisine:"), title);
         }
-        value = gr_recipe_get_category (printer->recipe);
+        value = gr_recipe_get_category (recipe);
         if (value && *value) {
                 g_string_append_printf (s, "%s %s\n", _("Meal:"), gr_meal_get_title (value));
         }
-        value = gr_recipe_get_season (printer->recipe);
+        value = gr_recipe_get_season (recipe);
         if (value && *value) {
                 g_string_append_printf (s, "%s %s\n", _("Season:"), gr_season_get_title (value));
         }
 
         g_string_append (s, "\n");
 
-        pango_layout_set_text (printer->left_layout, s->str, s->len);
+        gr_print_document_set_summary (doc, s->str);
 
         g_string_truncate (s, 0);
 
-        ingredients = gr_ingredients_list_new (gr_recipe_get_ingredients (printer->recipe));
+        ingredients = gr_recipe_get_ingredients_list (recipe);
         segs = gr_ingredients_list_get_segments (ingredients);
 
-        layout = gtk_print_context_create_pango_layout (context);
-        pango_layout_set_width (layout, width * PANGO_SCALE);
-        pango_layout_set_font_description (layout, body_font);
+        gr_ingredients_list_iter_init (&iter, ingredients, NULL);
+        while (gr_ingredients_list_iter_next (&iter, NULL, NULL, &ing_amount, &ing_unit))
+                gr_convert_format (s, ing_amount, ing_unit);
 
-        for (j = 0; segs[j]; j++) {
-                ings = gr_ingredients_list_get_ingredients (ingredients, segs[j]);
-                for (i = 0; ings[i]; i++) {
-                        double amount;
-                        GrUnit unit;
-                        double scale = 1.0;
-
-                        unit = gr_ingredients_list_get_unit (ingredients, segs[j], ings[i]);
-                        amount = gr_ingredients_list_get_amount (ingredients, segs[j], ings[i]) * scale;
-                        gr_convert_format (s, amount, unit);
-                }
-        }
-
-        pango_layout_set_text (layout, s->str, s->len);
-        pango_layout_get_size (layout, &amount_width, NULL);
-        g_clear_object (&layout);
+        gr_print_document_set_amounts (doc, s->str);
 
         g_string_truncate (s, 0);
 
-        printer->bottom_layout = gtk_print_context_create_pango_layout (context);
-        pango_layout_set_width (printer->bottom_layout, width * PANGO_SCALE);
-        pango_layout_set_font_description (printer->bottom_layout, body_font);
-
-        g_string_append (s, gr_recipe_get_translated_description (printer->recipe));
+        g_string_append (s, gr_recipe_get_translated_description (recipe));
         g_string_append (s, "\n\n");
+        gr_print_document_append_text (doc, s->str);
 
-        attrs = pango_attr_list_new ();
-
-        value = gr_recipe_get_notes (printer->recipe);
+        value = gr_recipe_get_notes (recipe);
         if (value && *value) {
-                attr = pango_attr_font_desc_new (title_font);
-                attr->start_index = s->len;
-                g_string_append (s, _("Notes"));
-                attr->end_index = s->len + 1;
-                pango_attr_list_insert (attrs, attr);
+                gr_print_document_append_heading (doc, _("Notes"));
 
+                g_string_truncate (s, 0);
                 g_string_append (s, "\n");
                 g_string_append (s, value);
                 g_string_append (s, "\n\n");
+                gr_print_document_append_text (doc, s->str);
         }
 
-        tabs = pango_tab_array_new (2, FALSE);
-        pango_tab_array_set_tab (tabs, 0, PANGO_TAB_LEFT, 0);
-        pango_tab_array_set_tab (tabs, 1, PANGO_TAB_LEFT, amount_width);
-        pango_tab_array_set_tab (tabs, 2, PANGO_TAB_LEFT, (width / 2) * PANGO_SCALE);
-        pango_tab_array_set_tab (tabs, 3, PANGO_TAB_LEFT, (width / 2) * PANGO_SCALE + amount_width);
-        pango_layout_set_tabs (printer->bottom_layout, tabs);
-        pango_tab_array_free (tabs);
-
         for (j = 0; segs[j]; j++) {
-                attr = pango_attr_font_desc_new (title_font);
-                attr->start_index = s->len;
-
                 if (segs[j][0] != 0)
-                        g_string_append (s, g_dgettext (GETTEXT_PACKAGE "-data", segs[j]));
+                        gr_print_document_append_heading (doc, g_dgettext (GETTEXT_PACKAGE "-data", segs[j]));
                 else
-                        g_string_append (s, _("Ingredients"));
-
-                attr->end_index = s->len + 1;
-                pango_attr_list_insert (attrs, attr);
+                        gr_print_document_append_heading (doc, _("Ingredients"));
 
+                g_string_truncate (s, 0);
                 g_string_append (s, "\n");
 
                 ings = gr_ingredients_list_get_ingredients (ingredients, segs[j]);
@@ -293,62 +241,41 @@ begin_print (GtkPrintOperation *operation,
                         }
                 }
 
+                g_clear_pointer (&ings, g_strfreev);
+
                 g_string_append (s, "\n\n");
+                gr_print_document_append_text (doc, s->str);
         }
 
-        attr = pango_attr_font_desc_new (title_font);
-        attr->start_index = s->len;
-
-        g_string_append (s, _("Directions"));
-
-        attr->end_index = s->len + 1;
-        pango_attr_list_insert (attrs, attr);
-
-        instructions = process_instructions (gr_recipe_get_translated_instructions (printer->recipe));
-
-        g_string_append (s, "\n\n");
-        g_string_append (s, instructions);
-
-        pango_layout_set_text (printer->bottom_layout, s->str, s->len);
-        pango_layout_set_attributes (printer->bottom_layout, attrs);
-        pango_attr_list_unref (attrs);
+        gr_print_document_append_heading (doc, _("Directions"));
 
-        /* TODO: we assume only the bottom layout will break across pages */
+        instructions = process_instructions (gr_recipe_get_translated_instructions (recipe));
 
-        num_lines = pango_layout_get_line_count (printer->bottom_layout);
+        gr_print_document_append_text (doc, "\n\n");
+        gr_print_document_append_text (doc, instructions);
 
-        pango_layout_get_extents (printer->title_layout, NULL, &title_rect);
-        pango_layout_get_extents (printer->left_layout, NULL, &left_rect);
-
-        if (printer->image)
-                page_height = title_rect.height/1024.0 + MAX (left_rect.height/1024.0, gdk_pixbuf_get_height (printer->image) + 10);
-        else
-                page_height = title_rect.height/1024.0 + left_rect.height/1024.0;
-
-        page_breaks = NULL;
+        return doc;
+}
 
-        for (line = 0; line < num_lines; line++) {
-                PangoLayoutLine *layout_line;
-                PangoRectangle logical_rect;
-                double line_height;
+static void
+begin_print (GtkPrintOperation *operation,
+             GtkPrintContext   *context,
+             GrRecipePrinter   *printer)
+{
+        double width, height;
+        PangoContext *pango_context;
+        int n_pages;
 
-                layout_line = pango_layout_get_line (printer->bottom_layout, line);
-                pango_layout_line_get_extents (layout_line, NULL, &logical_rect);
-                line_height = logical_rect.height / 1024.0;
-                if (page_height + line_height > height) {
-                        page_breaks = g_list_prepend (page_breaks, GINT_TO_POINTER (line));
-                        page_height = 0;
-                }
+        width = gtk_print_context_get_width (context);
+        height = gtk_print_context_get_height (context);
 
-                page_height += line_height;
-        }
+        printer->doc = create_document (printer->recipe, width, height);
 
-        page_breaks = g_list_reverse (page_breaks);
-        gtk_print_operation_set_n_pages (operation, g_list_length (page_breaks) + 1);
-        printer->page_breaks = page_breaks;
+        pango_context = gtk_print_context_create_pango_context (context);
+        n_pages = gr_print_document_layout (printer->doc, pango_context, width, height);
+        g_object_unref (pango_context);
 
-        pango_font_description_free (title_font);
-        pango_font_description_free (body_font);
+        gtk_print_operation_set_n_pages (operation, n_pages);
 }
 
 static void
@@ -356,13 +283,8 @@ end_print (GtkPrintOperation *operation,
              GtkPrintContext *context,
              GrRecipePrinter *printer)
 {
-        g_clear_object (&printer->title_layout);
-        g_clear_object (&printer->left_layout);
-        g_clear_object (&printer->bottom_layout);
+        g_clear_pointer (&printer->doc, gr_print_document_free);
         g_clear_object (&printer->recipe);
-        g_clear_object (&printer->image);
-        g_list_free (printer->page_breaks);
-        printer->page_breaks = NULL;
 }
 
 static void
@@ -371,84 +293,10 @@ draw_page (GtkPrintOperation *operation,
            int                page_nr,
            GrRecipePrinter   *printer)
 {
-        cairo_t *cr;
-        PangoRectangle logical_rect;
-        int baseline;
-        int width;
-        int start, end, i;
-        PangoLayoutIter *iter;
-        double start_pos;
-        GList *pagebreak;
-
-        cr = gtk_print_context_get_cairo_context (context);
-
-        width = gtk_print_context_get_width (context);
-
-        if (page_nr == 0) {
-                cairo_set_source_rgb (cr, 0, 0, 0);
-
-                pango_layout_get_extents (printer->title_layout, NULL, &logical_rect);
-                baseline = pango_layout_get_baseline (printer->title_layout);
-
-                cairo_move_to (cr, logical_rect.x / 1024.0 + (width - logical_rect.width / 1024.0) / 2, baseline / 1024.0 - logical_rect.y / 1024.0);
-                pango_cairo_show_layout (cr, printer->title_layout);
-
-                start_pos = baseline / 1024.0 - logical_rect.y / 1024.0 + logical_rect.height / 1024.0;
-
-                if (printer->image) {
-                        gdk_cairo_set_source_pixbuf (cr, printer->image, width - gdk_pixbuf_get_width (printer->image), start_pos);
-                        cairo_paint (cr);
-                }
-
-                cairo_set_source_rgb (cr, 0, 0, 0);
-
-                pango_layout_get_extents (printer->left_layout, NULL, &logical_rect);
-                baseline = pango_layout_get_baseline (printer->left_layout);
-
-                cairo_move_to (cr, logical_rect.x / 1024.0, start_pos + baseline / 1024.0 - logical_rect.y / 1024.0);
-                pango_cairo_show_layout (cr, printer->left_layout);
-
-                if (printer->image)
-                        start_pos += MAX (gdk_pixbuf_get_height (printer->image) + 10, baseline / 1024.0 - logical_rect.y / 1024.0 + logical_rect.height / 1024.0);
-                else
-                        start_pos += baseline / 1024.0 - logical_rect.y / 1024.0 + logical_rect.height / 1024.0;
-
-                start = 0;
-        }
-        else {
-                pagebreak = g_list_nth (printer->page_breaks, page_nr - 1);
-                start = GPOINTER_TO_INT (pagebreak->data);
-                start_pos = 0;
-        }
-
-        pagebreak = g_list_nth (printer->page_breaks, page_nr);
-        if (pagebreak == NULL)
-                end = pango_layout_get_line_count (printer->bottom_layout);
-        else
-                end = GPOINTER_TO_INT (pagebreak->data);
-
-        i = 0;
-        iter = pango_layout_get_iter (printer->bottom_layout);
-        do {
-                PangoRectangle rect;
-                PangoLayoutLine *line;
-                int base;
-
-                if (i >= start) {
-                        line = pango_layout_iter_get_line (iter);
-                        pango_layout_iter_get_line_extents (iter, NULL, &rect);
-                        base = pango_layout_iter_get_baseline (iter);
-                        if (i == start)
-                                start_pos -= rect.y / 1024.0;
-
-                        cairo_move_to (cr, rect.x / 1024.0, base / 1024.0 + start_pos);
-                        pango_cairo_show_layout_line (cr, line);
-                }
-                i++;
-
-        } while (i < end && pango_layout_iter_next_line (iter));
-
-        pango_layout_iter_free (iter);
+        gr_print_document_draw_page (printer->doc,
+                                     gtk_print_context_get_cairo_context (context),
+                                     gtk_print_context_get_width (context),
+                                     page_nr);
 }
 
 static void
@@ -485,29 +333,141 @@ print_done (GtkPrintOperation       *operation,
         g_object_unref (operation);
 }
 
+/* Recipe names are not unique, so the files are named by id */
+static char *
+get_pdf_path (const char *dir,
+              GrRecipe   *recipe)
+{
+        g_autofree char *name = NULL;
+
+        name = g_strdup (gr_recipe_get_id (recipe));
+        g_strdelimit (name, "/", '_');
+
+        return g_strdup_printf ("%s/%s.pdf", dir, name);
+}
+
+typedef struct {
+        GPtrArray *docs;
+        GPtrArray *paths;
+} PdfJob;
+
+static void
+pdf_job_free (gpointer data)
+{
+        PdfJob *job = data;
+
+        g_ptr_array_unref (job->docs);
+        g_ptr_array_unref (job->paths);
+        g_free (job);
+}
+
+static void
+free_files (gpointer data)
+{
+        g_list_free_full (data, g_object_unref);
+}
+
+static void
+render_pdfs (GTask        *task,
+             gpointer      source_object,
+             gpointer      task_data,
+             GCancellable *cancellable)
+{
+        PdfJob *job = task_data;
+        g_autofree gboolean *written = NULL;
+        GList *files;
+        guint i;
+
+        written = g_new0 (gboolean, job->docs->len);
+        gr_print_export_pdfs ((GrPrintDocument **)job->docs->pdata,
+                              (const char **)job->paths->pdata,
+                              job->docs->len, 0, written);
+
+        /* Don't hand out files that cairo gave up on halfway */
+        files = NULL;
+        for (i = job->paths->len; i > 0; i--) {
+                const char *path = g_ptr_array_index (job->paths, i - 1);
+
+                if (written[i - 1])
+                        files = g_list_prepend (files, g_file_new_for_path (path));
+                else
+                        g_remove (path);
+        }
+
+        g_task_return_pointer (task, files, free_files);
+}
+
+/* Writes a PDF for each of @recipes into a new temporary directory,
+ * rendering them in parallel in a thread. Use
+ * gr_recipe_printer_get_pdfs_finish() to get the files that were
+ * written, in the same order as @recipes.
+ */
+void
+gr_recipe_printer_get_pdfs (GrRecipePrinter     *printer,
+                            GList               *recipes,
+                            GCancellable        *cancellable,
+                            GAsyncReadyCallback  callback,
+                            gpointer             data)
+{
+        g_autoptr(GTask) task = NULL;
+        g_autofree char *dir = NULL;
+        GError *error = NULL;
+        PdfJob *job;
+        double width, height;
+        GList *l;
+
+        task = g_task_new (printer, cancellable, callback, data);
+
+        dir = g_dir_make_tmp ("recipes-pdf-XXXXXX", &error);
+        if (dir == NULL) {
+                g_task_return_error (task, error);
+                return;
+        }
+
+        gr_print_get_page_size (&width, &height);
+
+        job = g_new (PdfJob, 1);
+        job->docs = g_ptr_array_new_with_free_func ((GDestroyNotify)gr_print_document_free);
+        job->paths = g_ptr_array_new_with_free_func (g_free);
+
+        /* Collecting the contents needs the store, rendering does not */
+        for (l = recipes; l; l = l->next) {
+                g_ptr_array_add (job->docs, create_document (GR_RECIPE (l->data), width, height));
+                g_ptr_array_add (job->paths, get_pdf_path (dir, GR_RECIPE (l->data)));
+        }
+
+        g_task_set_task_data (task, job, pdf_job_free);
+        g_task_run_in_thread (task, render_pdfs);
+}
+
+GList *
+gr_recipe_printer_get_pdfs_finish (GrRecipePrinter  *printer,
+                                   GAsyncResult     *result,
+                                   GError          **error)
+{
+        return g_task_propagate_pointer (G_TASK (result), error);
+}
+
 GFile *
 gr_recipe_printer_get_pdf (GrRecipePrinter *printer,
-                            GrRecipe        *recipe)
+                           GrRecipe        *recipe)
 {
-        GtkPrintOperation *operation = NULL;
+        g_autoptr(GrPrintDocument) doc = NULL;
+        g_autoptr(GError) error = NULL;
         g_autofree char *path = NULL;
-        g_autofree char *name = NULL;
+        double width, height;
 
-        name = g_strdup (gr_recipe_get_name (GR_RECIPE (recipe)));
-        g_strdelimit (name, "./", ' ');
-        path = g_strdup_printf ("%s/%s.pdf", get_user_data_dir (), name);
+        gr_print_get_page_size (&width, &height);
 
-        g_set_object (&printer->recipe, recipe);
-        operation = gtk_print_operation_new ();
+        doc = create_document (recipe, width, height);
+        path = get_pdf_path (get_user_data_dir (), recipe);
 
-        g_signal_connect (operation, "begin-print", G_CALLBACK (begin_print), printer);
-        g_signal_connect (operation, "end-print", G_CALLBACK (end_print), printer);
-        g_signal_connect (operation, "draw-page", G_CALLBACK (draw_page), printer);
-        g_signal_connect (operation, "done", G_CALLBACK (print_done), printer);
-        gtk_print_operation_set_allow_async (operation, TRUE);
-        gtk_print_operation_set_export_filename (operation, path);
+        if (!gr_print_document_export_pdf (doc, path, &error)) {
+                g_warning ("Failed to export PDF: %s", error->message);
+                g_remove (path);
+                return NULL;
+        }
 
-        gtk_print_operation_run (operation, GTK_PRINT_OPERATION_ACTION_EXPORT, NULL, NULL);
         return g_file_new_for_path (path);
 }
 
@@ -35,5 +35,13 @@ void             gr_recipe_printer_print (GrRecipePrinter *printer,
                                           GrRecipe        *recipe);
 GFile           *gr_recipe_printer_get_pdf (GrRecipePrinter *printer,
                                             GrRecipe        *recipe);
+void             gr_recipe_printer_get_pdfs (GrRecipePrinter     *printer,
+                                             GList               *recipes,
+                                             GCancellable        *cancellable,
+                                             GAsyncReadyCallback  callback,
+                                             gpointer             data);
+GList           *gr_recipe_printer_get_pdfs_finish (GrRecipePrinter  *printer,
+                                                    GAsyncResult     *result,
+                                                    GError          **error);
 
 G_END_DECLS
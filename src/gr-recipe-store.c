@@ -34,6 +34,9 @@
 #include "gr-ingredient.h"
 #include "gr-image.h"
 #include "gr-app.h"
+#include "gr-tar.h"
+#include "gr-translation-cache.h"
+#include "gr-data-update.h"
 
 
 /**
@@ -107,6 +110,10 @@
  * ---------------
  *
  * At runtime, we keep GrRecipe and GrChef objects in two separate hash tables.
+ * When new data is downloaded, the keyfiles are loaded again and compared
+ * with what we have; existing objects are kept and updated in place, and
+ * the differences are announced at once with the recipes-updated signal,
+ * and chefs-changed if needed.
  *
  * Ancillary data
  * --------------
@@ -150,8 +157,18 @@ struct _GrRecipeStore
         GDateTime *favorite_change;
         GDateTime *shopping_change;
 
+        int batch_depth;
+        GPtrArray *batch_added;
+        gboolean batch_recipes_dirty;
+        gboolean batch_chefs_dirty;
+
         SoupSession *session;
         SoupMessage *recipes_message;
+        GInputStream *recipes_input;
+        GConverter *recipes_decompressor;
+        GrTarReader *recipes_reader;
+
+        GList *searches;
 };
 
 
@@ -173,8 +190,13 @@ gr_recipe_store_finalize (GObject *object)
         g_variant_dict_unref (self->shopping_list);
         g_strfreev (self->featured_chefs);
         g_free (self->user);
+        g_clear_pointer (&self->batch_added, g_ptr_array_unref);
+        g_clear_object (&self->recipes_input);
+        g_clear_object (&self->recipes_decompressor);
+        g_clear_pointer (&self->recipes_reader, gr_tar_reader_free);
         g_clear_object (&self->recipes_message);
         g_clear_object (&self->session);
+        g_list_free (self->searches);
 
         G_OBJECT_CLASS (gr_recipe_store_parent_class)->finalize (object);
 }
@@ -205,32 +227,70 @@ parse_yield (const char  *text,
         return TRUE;
 }
 
+/* A recipe db goes through three stages when loading: the keyfile
+ * is read, its groups are turned into GrRecipe objects, and those
+ * are merged into the store. The first two don't touch the store,
+ * so they can run in threads; merging happens on the main thread.
+ */
+typedef struct {
+        char *path;
+        gboolean contributed;
+        const char *user;
+        SoupSession *session;
+        GKeyFile *keyfile;
+        char **groups;
+        gsize n_groups;
+        GrRecipe **recipes;
+} RecipeDb;
+
+static RecipeDb *
+recipe_db_new (GrRecipeStore *self,
+               const char    *dir,
+               gboolean       contributed)
+{
+        RecipeDb *db;
+
+        db = g_new0 (RecipeDb, 1);
+        db->path = g_build_filename (dir, "recipes.db", NULL);
+        db->contributed = contributed;
+        db->user = self->user;
+        db->session = self->session;
+
+        return db;
+}
+
+static void
+recipe_db_free (RecipeDb *db)
+{
+        gsize i;
+
+        for (i = 0; i < db->n_groups; i++)
+                g_clear_object (&db->recipes[i]);
+        g_free (db->recipes);
+        g_strfreev (db->groups);
+        g_clear_pointer (&db->keyfile, g_key_file_unref);
+        g_free (db->path);
+        g_free (db);
+}
+
 static gboolean
-load_recipes (GrRecipeStore *self,
-              const char    *dir,
-              gboolean       contributed)
+recipe_db_open (RecipeDb *db)
 {
         g_autoptr(GKeyFile) keyfile = NULL;
         g_autoptr(GError) error = NULL;
-        g_autofree char *path = NULL;
-        g_auto(GStrv) groups = NULL;
-        gsize length, length2;
-        int i, j;
         int version;
 
         keyfile = g_key_file_new ();
 
-        path = g_build_filename (dir, "recipes.db", NULL);
-
-        if (!g_key_file_load_from_file (keyfile, path, G_KEY_FILE_NONE, &error)) {
+        if (!g_key_file_load_from_file (keyfile, db->path, G_KEY_FILE_NONE, &error)) {
                 if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
                         g_error ("Failed to load recipe db: %s", error->message);
                 else
-                        g_info ("No recipe db at: %s", path);
+                        g_info ("No recipe db at: %s", db->path);
                 return FALSE;
         }
 
-        g_info ("Load recipe db: %s", path);
+        g_info ("Load recipe db: %s", db->path);
 
         version = g_key_file_get_integer (keyfile, "Metadata", "Version", &error);
         if (error) {
@@ -249,299 +309,377 @@ load_recipes (GrRecipeStore *self,
                 g_error ("Don't know how to handle recipe db version %d", version);
         }
 
-        groups = g_key_file_get_groups (keyfile, &length);
-        for (i = 0; i < length; i++) {
-                GrRecipe *recipe;
-                const char *id;
-                g_autofree char *name = NULL;
-                g_autofree char *author = NULL;
-                g_autofree char *description = NULL;
-                g_autofree char *cuisine = NULL;
-                g_autofree char *season = NULL;
-                g_autofree char *category = NULL;
-                g_autofree char *prep_time = NULL;
-                g_autofree char *cook_time = NULL;
-                g_autofree char *ingredients = NULL;
-                g_autofree char *instructions = NULL;
-                g_autofree char *notes = NULL;
-                g_autofree char *yield_str = NULL;
-                g_autofree char *yield_unit = NULL;
-                double yield;
-                g_auto(GStrv) paths = NULL;
-                int serves;
-                int spiciness;
-                int default_image = 0;
-                GrDiets diets;
-                g_autoptr(GPtrArray) images = NULL;
-                g_autoptr(GDateTime) ctime = NULL;
-                g_autoptr(GDateTime) mtime = NULL;
-                char *tmp;
+        db->groups = g_key_file_get_groups (keyfile, &db->n_groups);
+        db->recipes = g_new0 (GrRecipe *, db->n_groups);
+        db->keyfile = g_steal_pointer (&keyfile);
 
-                if (strcmp (groups[i], "Metadata") == 0)
-                        continue;
+        return TRUE;
+}
 
-                g_clear_error (&error);
+static GrRecipe *
+parse_recipe (RecipeDb   *db,
+              const char *group)
+{
+        g_autoptr(GError) error = NULL;
+        const char *id;
+        gboolean own;
+        gboolean readonly;
+        GrRecipe *recipe;
+        g_autofree char *name = NULL;
+        g_autofree char *author = NULL;
+        g_autofree char *description = NULL;
+        g_autofree char *cuisine = NULL;
+        g_autofree char *season = NULL;
+        g_autofree char *category = NULL;
+        g_autofree char *prep_time = NULL;
+        g_autofree char *cook_time = NULL;
+        g_autofree char *ingredients = NULL;
+        g_autofree char *instructions = NULL;
+        g_autofree char *notes = NULL;
+        g_autofree char *yield_str = NULL;
+        g_autofree char *yield_unit = NULL;
+        double yield;
+        g_auto(GStrv) paths = NULL;
+        int serves;
+        int spiciness;
+        int default_image = 0;
+        GrDiets diets;
+        g_autoptr(GPtrArray) images = NULL;
+        g_autoptr(GDateTime) ctime = NULL;
+        g_autoptr(GDateTime) mtime = NULL;
+        gsize length2;
+        int j;
 
-                id = groups[i];
-                name = g_key_file_get_string (keyfile, groups[i], "Name", &error);
-                if (error) {
-                        if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
-                                g_warning ("Failed to load recipe %s: %s", groups[i], error->message);
-                                continue;
-                        }
-                        name = g_strdup ("unknown");
-                        g_clear_error (&error);
-                }
-                author = g_key_file_get_string (keyfile, groups[i], "Author", &error);
-                if (error) {
-                        if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
-                                g_warning ("Failed to load recipe %s: %s", groups[i], error->message);
-                                continue;
-                        }
-                        author = g_strdup ("anonymous");
-                        g_clear_error (&error);
-                }
-                description = g_key_file_get_string (keyfile, groups[i], "Description", &error);
-                if (error) {
-                        if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
-                                g_warning ("Failed to load recipe %s: %s", groups[i], error->message);
-                                continue;
-                        }
-                        g_clear_error (&error);
+        id = group;
+        name = g_key_file_get_string (db->keyfile, group, "Name", &error);
+        if (error) {
+                if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
+                        g_warning ("Failed to load recipe %s: %s", group, error->message);
+                        return NULL;
                 }
-                cuisine = g_key_file_get_string (keyfile, groups[i], "Cuisine", &error);
-                if (error) {
-                        if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
-                                g_warning ("Failed to load recipe %s: %s", groups[i], error->message);
-                                continue;
-                        }
-                        g_clear_error (&error);
+                name = g_strdup ("unknown");
+                g_clear_error (&error);
+        }
+        author = g_key_file_get_string (db->keyfile, group, "Author", &error);
+        if (error) {
+                if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
+                        g_warning ("Failed to load recipe %s: %s", group, error->message);
+                        return NULL;
                 }
-                season = g_key_file_get_string (keyfile, groups[i], "Season", &error);
-                if (error) {
-                        if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
-                                g_warning ("Failed to load recipe %s: %s", groups[i], error->message);
-                                continue;
-                        }
-                        g_clear_error (&error);
+                author = g_strdup ("anonymous");
+                g_clear_error (&error);
+        }
+        description = g_key_file_get_string (db->keyfile, group, "Description", &error);
+        if (error) {
+                if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
+                        g_warning ("Failed to load recipe %s: %s", group, error->message);
+                        return NULL;
                 }
-                category = g_key_file_get_string (keyfile, groups[i], "Category", &error);
-                if (error) {
-                        if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
-                                g_warning ("Failed to load recipe %s: %s", groups[i], error->message);
-                                continue;
-                        }
-                        g_clear_error (&error);
+                g_clear_error (&error);
+        }
+        cuisine = g_key_file_get_string (db->keyfile, group, "Cuisine", &error);
+        if (error) {
+                if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
+                        g_warning ("Failed to load recipe %s: %s", group, error->message);
+                        return NULL;
                 }
-                prep_time = g_key_file_get_string (keyfile, groups[i], "PrepTime", &error);
-                if (error) {
-                        if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
-                                g_warning ("Failed to load recipe %s: %s", groups[i], error->message);
-                                continue;
-                        }
-                        g_clear_error (&error);
+                g_clear_error (&error);
+        }
+        season = g_key_file_get_string (db->keyfile, group, "Season", &error);
+        if (error) {
+                if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
+                        g_warning ("Failed to load recipe %s: %s", group, error->message);
+                        return NULL;
                 }
-                cook_time = g_key_file_get_string (keyfile, groups[i], "CookTime", &error);
-                if (error) {
-                        if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
-                                g_warning ("Failed to load recipe %s: %s", groups[i], error->message);
-                                continue;
-                        }
-                        g_clear_error (&error);
+                g_clear_error (&error);
+        }
+        category = g_key_file_get_string (db->keyfile, group, "Category", &error);
+        if (error) {
+                if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
+                        g_warning ("Failed to load recipe %s: %s", group, error->message);
+                        return NULL;
                 }
-                ingredients = g_key_file_get_string (keyfile, groups[i], "Ingredients", &error);
-                if (error) {
-                        if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
-                                g_warning ("Failed to load recipe %s: %s", groups[i], error->message);
-                                continue;
-                        }
-                        g_clear_error (&error);
+                g_clear_error (&error);
+        }
+        prep_time = g_key_file_get_string (db->keyfile, group, "PrepTime", &error);
+        if (error) {
+                if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
+                        g_warning ("Failed to load recipe %s: %s", group, error->message);
+                        return NULL;
                 }
-                instructions = g_key_file_get_string (keyfile, groups[i], "Instructions", &error);
-                if (error) {
-                        if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
-                                g_warning ("Failed to load recipe %s: %s", groups[i], error->message);
-                                continue;
-                        }
-                        g_clear_error (&error);
+                g_clear_error (&error);
+        }
+        cook_time = g_key_file_get_string (db->keyfile, group, "CookTime", &error);
+        if (error) {
+                if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
+                        g_warning ("Failed to load recipe %s: %s", group, error->message);
+                        return NULL;
                 }
-                notes = g_key_file_get_string (keyfile, groups[i], "Notes", &error);
-                if (error) {
-                        if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
-                                g_warning ("Failed to load recipe %s: %s", groups[i], error->message);
-                                continue;
-                        }
-                        g_clear_error (&error);
+                g_clear_error (&error);
+        }
+        ingredients = g_key_file_get_string (db->keyfile, group, "Ingredients", &error);
+        if (error) {
+                if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
+                        g_warning ("Failed to load recipe %s: %s", group, error->message);
+                        return NULL;
                 }
-                paths = g_key_file_get_string_list (keyfile, groups[i], "Images", &length2, &error);
-                if (error) {
-                        if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
-                                g_warning ("Failed to load recipe %s: %s", groups[i], error->message);
-                                continue;
-                        }
-                        g_clear_error (&error);
+                g_clear_error (&error);
+        }
+        instructions = g_key_file_get_string (db->keyfile, group, "Instructions", &error);
+        if (error) {
+                if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
+                        g_warning ("Failed to load recipe %s: %s", group, error->message);
+                        return NULL;
                 }
-                default_image = g_key_file_get_integer (keyfile, groups[i], "DefaultImage", &error);
-                if (error) {
-                        if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
-                                g_warning ("Failed to load recipe %s: %s", groups[i], error->message);
-                                continue;
-                        }
-                        g_clear_error (&error);
+                g_clear_error (&error);
+        }
+        notes = g_key_file_get_string (db->keyfile, group, "Notes", &error);
+        if (error) {
+                if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
+                        g_warning ("Failed to load recipe %s: %s", group, error->message);
+                        return NULL;
                 }
-                serves = g_key_file_get_integer (keyfile, groups[i], "Serves", &error);
-                if (error) {
-                        if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
-                                g_warning ("Failed to load recipe %s: %s", groups[i], error->message);
-                                continue;
-                        }
-                        g_clear_error (&error);
+                g_clear_error (&error);
+        }
+        paths = g_key_file_get_string_list (db->keyfile, group, "Images", &length2, &error);
+        if (error) {
+                if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
+                        g_warning ("Failed to load recipe %s: %s", group, error->message);
+                        return NULL;
                 }
-                yield_str = g_key_file_get_string (keyfile, groups[i], "Yield", &error);
-                if (error) {
-                        if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
-                                g_warning ("Failed to load recipe %s: %s", groups[i], error->message);
-                                continue;
-                        }
-                        g_clear_error (&error);
+                g_clear_error (&error);
+        }
+        default_image = g_key_file_get_integer (db->keyfile, group, "DefaultImage", &error);
+        if (error) {
+                if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
+                        g_warning ("Failed to load recipe %s: %s", group, error->message);
+                        return NULL;
                 }
-                if (!yield_str) {
-                        yield = (double)serves;
-                        yield_unit = g_strdup (_("servings"));
+                g_clear_error (&error);
+        }
+        serves = g_key_file_get_integer (db->keyfile, group, "Serves", &error);
+        if (error) {
+                if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
+                        g_warning ("Failed to load recipe %s: %s", group, error->message);
+                        return NULL;
                 }
-                else if (!parse_yield (yield_str, &yield, &yield_unit)) {
-                        g_warning ("Failed to load recipe %s: bad yield", groups[i]);
-                        continue;
+                g_clear_error (&error);
+        }
+        yield_str = g_key_file_get_string (db->keyfile, group, "Yield", &error);
+        if (error) {
+                if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
+                        g_warning ("Failed to load recipe %s: %s", group, error->message);
+                        return NULL;
                 }
+                g_clear_error (&error);
+        }
+        if (!yield_str) {
+                yield = (double)serves;
+                yield_unit = g_strdup (_("servings"));
+        }
+        else if (!parse_yield (yield_str, &yield, &yield_unit)) {
+                g_warning ("Failed to load recipe %s: bad yield", group);
+                return NULL;
+        }
 
-                spiciness = g_key_file_get_integer (keyfile, groups[i], "Spiciness", &error);
-                if (error) {
-                        if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
-                                g_warning ("Failed to load recipe %s: %s", groups[i], error->message);
-                                continue;
-                        }
-                        g_clear_error (&error);
+        spiciness = g_key_file_get_integer (db->keyfile, group, "Spiciness", &error);
+        if (error) {
+                if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
+                        g_warning ("Failed to load recipe %s: %s", group, error->message);
+                        return NULL;
                 }
-                diets = g_key_file_get_integer (keyfile, groups[i], "Diets", &error);
-                if (error) {
-                        if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
-                                g_warning ("Failed to load recipe %s: %s", groups[i], error->message);
-                                continue;
-                        }
-                        g_clear_error (&error);
+                g_clear_error (&error);
+        }
+        diets = g_key_file_get_integer (db->keyfile, group, "Diets", &error);
+        if (error) {
+                if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
+                        g_warning ("Failed to load recipe %s: %s", group, error->message);
+                        return NULL;
                 }
+                g_clear_error (&error);
+        }
 
-                images = gr_image_array_new ();
-                if (paths) {
-                        for (j = 0; paths[j]; j++) {
-                                GrImage *ri;
-                                ri = gr_image_new (gr_app_get_soup_session (GR_APP (g_application_get_default ())), id, paths[j]);
+        images = gr_image_array_new ();
+        if (paths) {
+                for (j = 0; paths[j]; j++) {
+                        GrImage *ri;
+                        ri = gr_image_new (db->session, id, paths[j]);
 
-                                g_ptr_array_add (images, ri);
-                        }
+                        g_ptr_array_add (images, ri);
                 }
+        }
 
-                tmp = g_key_file_get_string (keyfile, groups[i], "Created", &error);
-                if (error) {
-                        if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
-                                g_warning ("Failed to load recipe %s: %s", groups[i], error->message);
-                                continue;
-                        }
-                        g_clear_error (&error);
-                }
-                if (tmp) {
-                        ctime = date_time_from_string (tmp);
-                        g_free (tmp);
-                        if (!ctime) {
-                                g_warning ("Failed to load recipe %s: Couldn't parse Created key", groups[i]);
-                                continue;
-                        }
-                }
-                else {
-                        ctime = g_date_time_new_now_utc ();
-                }
+        if (!get_recipe_timestamps (db->keyfile, group, &ctime, &mtime, &error)) {
+                g_warning ("Failed to load recipe %s: %s", group, error->message);
+                return NULL;
+        }
 
-                tmp = g_key_file_get_string (keyfile, groups[i], "Modified", &error);
-                if (error) {
-                        if (!g_error_matches (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
-                                g_warning ("Failed to load recipe %s: %s", groups[i], error->message);
-                                continue;
-                        }
-                        g_clear_error (&error);
+        own = g_strcmp0 (author, db->user) == 0;
+        readonly = db->contributed && !own;
+
+        /* Only cache translations of text we ship */
+        gr_translation_cache_set_active (readonly);
+
+        recipe = g_object_new (GR_TYPE_RECIPE,
+                             "id", id,
+                             "name", name,
+                             "author", author,
+                             "description", description,
+                             "cuisine", cuisine,
+                             "season", season,
+                             "category", category,
+                             "prep-time", prep_time,
+                             "cook-time", cook_time,
+                             "ingredients", ingredients,
+                             "instructions", instructions,
+                             "notes", notes,
+                             "spiciness", spiciness,
+                             "diets", diets,
+                             "images", images,
+                             "default-image", default_image,
+                             "yield-unit", yield_unit,
+                             "yield", yield,
+                             "ctime", ctime,
+                             "mtime", mtime,
+                             "contributed", db->contributed,
+                             "readonly", readonly,
+                             NULL);
+
+        gr_translation_cache_set_active (FALSE);
+
+        return recipe;
+}
+
+static void
+recipe_db_parse (RecipeDb *db,
+                 gsize     start,
+                 gsize     end)
+{
+        gsize i;
+
+        for (i = start; i < end; i++) {
+                if (strcmp (db->groups[i], "Metadata") == 0)
+                        continue;
+
+                db->recipes[i] = parse_recipe (db, db->groups[i]);
+        }
+}
+
+/* Later dbs take precedence, except that only the notes can
+ * be changed for readonly recipes.
+ */
+static void
+recipe_db_merge (GrRecipeStore *self,
+                 RecipeDb      *db)
+{
+        gsize i;
+
+        for (i = 0; i < db->n_groups; i++) {
+                GrRecipe *recipe = db->recipes[i];
+                GrRecipe *old;
+
+                if (recipe == NULL)
+                        continue;
+
+                old = g_hash_table_lookup (self->recipes, gr_recipe_get_id (recipe));
+                if (old == NULL) {
+                        g_hash_table_insert (self->recipes,
+                                             g_strdup (gr_recipe_get_id (recipe)),
+                                             g_steal_pointer (&db->recipes[i]));
                 }
-                if (tmp) {
-                        mtime = date_time_from_string (tmp);
-                        g_free (tmp);
-                        if (!mtime) {
-                                g_warning ("Failed to load recipe %s: Couldn't parse Modified key", groups[i]);
-                                continue;
-                        }
+                else if (gr_recipe_is_readonly (old)) {
+                        g_object_set (old,
+                                      "notes", gr_recipe_get_notes (recipe),
+                                      NULL);
                 }
                 else {
-                        mtime = g_date_time_new_now_utc ();
+                        g_object_set (old,
+                                      "id", gr_recipe_get_id (recipe),
+                                      "name", gr_recipe_get_name (recipe),
+                                      "author", gr_recipe_get_author (recipe),
+                                      "description", gr_recipe_get_description (recipe),
+                                      "cuisine", gr_recipe_get_cuisine (recipe),
+                                      "season", gr_recipe_get_season (recipe),
+                                      "category", gr_recipe_get_category (recipe),
+                                      "prep-time", gr_recipe_get_prep_time (recipe),
+                                      "cook-time", gr_recipe_get_cook_time (recipe),
+                                      "ingredients", gr_recipe_get_ingredients (recipe),
+                                      "instructions", gr_recipe_get_instructions (recipe),
+                                      "spiciness", gr_recipe_get_spiciness (recipe),
+                                      "diets", gr_recipe_get_diets (recipe),
+                                      "images", gr_recipe_get_images (recipe),
+                                      "default-image", gr_recipe_get_default_image (recipe),
+                                      "yield-unit", gr_recipe_get_yield_unit (recipe),
+                                      "yield", gr_recipe_get_yield (recipe),
+                                      "mtime", gr_recipe_get_mtime (recipe),
+                                      NULL);
                 }
+        }
+}
 
-                recipe = g_hash_table_lookup (self->recipes, id);
-                if (recipe) {
-                        if (gr_recipe_is_readonly (recipe))
-                                g_object_set (recipe,
-                                              "notes", notes,
-                                              NULL);
-                        else
-                                g_object_set (recipe,
-                                              "id", id,
-                                              "name", name,
-                                              "author", author,
-                                              "description", description,
-                                              "cuisine", cuisine,
-                                              "season", season,
-                                              "category", category,
-                                              "prep-time", prep_time,
-                                              "cook-time", cook_time,
-                                              "ingredients", ingredients,
-                                              "instructions", instructions,
-                                              "spiciness", spiciness,
-                                              "diets", diets,
-                                              "images", images,
-                                              "default-image", default_image,
-                                              "yield-unit", yield_unit,
-                                              "yield", yield,
-                                              "mtime", mtime,
-                                              NULL);
-                }
-                else {
-                        gboolean own;
-
-                        own = g_strcmp0 (author, self->user) == 0;
-                        recipe = g_object_new (GR_TYPE_RECIPE,
-                                               "id", id,
-                                               "name", name,
-                                               "author", author,
-                                               "description", description,
-                                               "cuisine", cuisine,
-                                               "season", season,
-                                               "category", category,
-                                               "prep-time", prep_time,
-                                               "cook-time", cook_time,
-                                               "ingredients", ingredients,
-                                               "instructions", instructions,
-                                               "notes", notes,
-                                               "spiciness", spiciness,
-                                               "diets", diets,
-                                               "images", images,
-                                               "default-image", default_image,
-                                               "yield-unit", yield_unit,
-                                               "yield", yield,
-                                               "ctime", ctime,
-                                               "mtime", mtime,
-                                               "contributed", contributed,
-                                               "readonly", contributed && !own,
-                                               NULL);
-                        g_hash_table_insert (self->recipes, g_strdup (id), recipe);
-                }
+static gboolean
+load_recipes (GrRecipeStore *self,
+              const char    *dir,
+              gboolean       contributed)
+{
+        RecipeDb *db;
+        gboolean ret;
+
+        db = recipe_db_new (self, dir, contributed);
+
+        ret = recipe_db_open (db);
+        if (ret) {
+                recipe_db_parse (db, 0, db->n_groups);
+                recipe_db_merge (self, db);
         }
 
-        return TRUE;
+        recipe_db_free (db);
+
+        return ret;
+}
+
+/* Groups are handed to the thread pool in chunks, to keep
+ * the overhead per job low.
+ */
+#define PARSE_CHUNK_SIZE 32
+
+typedef struct {
+        RecipeDb *db;
+        gsize start;
+        gsize end;
+} ParseJob;
+
+static void
+parse_job (gpointer data,
+           gpointer user_data)
+{
+        ParseJob *job = data;
+
+        recipe_db_parse (job->db, job->start, job->end);
+        g_free (job);
+}
+
+static void
+queue_parse_jobs (GThreadPool *pool,
+                  RecipeDb    *db)
+{
+        gsize start;
+
+        for (start = 0; start < db->n_groups; start += PARSE_CHUNK_SIZE) {
+                ParseJob *job;
+
+                job = g_new (ParseJob, 1);
+                job->db = db;
+                job->start = start;
+                job->end = MIN (start + PARSE_CHUNK_SIZE, db->n_groups);
+                g_thread_pool_push (pool, job, NULL);
+        }
+}
+
+static gpointer
+open_db_thread (gpointer data)
+{
+        return GINT_TO_POINTER (recipe_db_open (data));
 }
 
 static void
@@ -881,6 +1019,7 @@ load_chefs (GrRecipeStore *self,
                         g_hash_table_insert (self->chefs, g_strdup (id), chef);
                 }
 
+                gr_translation_cache_set_active (readonly);
                 g_object_set (chef,
                               "id", id,
                               "name", name,
@@ -889,6 +1028,7 @@ load_chefs (GrRecipeStore *self,
                               "image-path", image_path,
                               "readonly", readonly,
                               NULL);
+                gr_translation_cache_set_active (FALSE);
         }
 
         return TRUE;
@@ -1032,106 +1172,456 @@ set_modified_request (SoupMessage *msg,
         }
 }
 
-static void
-update_file_timestamp (const char *path)
+static gboolean
+strv_equal (char **a,
+            char **b)
 {
-        g_autoptr(GFile) file = NULL;
-        g_autoptr(GDateTime) now = NULL;
-        guint64 mtime;
+        if (a == NULL || b == NULL)
+                return a == b;
 
-        now = g_date_time_new_now_utc ();
-        mtime = (guint64)g_date_time_to_unix (now);
+        return g_strv_equal ((const char * const *)a, (const char * const *)b);
+}
 
-        file = g_file_new_for_path (path);
-        g_file_set_attribute_uint64 (file, G_FILE_ATTRIBUTE_TIME_MODIFIED, mtime, 0, NULL, NULL);
-        g_debug ("updating timestamp for %s", path);
+/* Recipes carry their modification time, so comparing that is
+ * enough to tell if a recipe was updated. Notes are per-user and
+ * don't bump the mtime of readonly recipes.
+ */
+static gboolean
+recipe_differs (GrRecipe *a,
+                GrRecipe *b)
+{
+        return !g_date_time_equal (gr_recipe_get_mtime (a), gr_recipe_get_mtime (b)) ||
+               g_strcmp0 (gr_recipe_get_notes (a), gr_recipe_get_notes (b)) != 0 ||
+               gr_recipe_is_readonly (a) != gr_recipe_is_readonly (b) ||
+               gr_recipe_is_contributed (a) != gr_recipe_is_contributed (b);
 }
 
+static gboolean
+chef_differs (GrChef *a,
+              GrChef *b)
+{
+        return g_strcmp0 (gr_chef_get_name (a), gr_chef_get_name (b)) != 0 ||
+               g_strcmp0 (gr_chef_get_fullname (a), gr_chef_get_fullname (b)) != 0 ||
+               g_strcmp0 (gr_chef_get_description (a), gr_chef_get_description (b)) != 0 ||
+               g_strcmp0 (gr_chef_get_image (a), gr_chef_get_image (b)) != 0 ||
+               gr_chef_is_readonly (a) != gr_chef_is_readonly (b);
+}
+
+/* Compares the freshly loaded recipes with the ones we had before.
+ * Objects that are still present are kept, and updated in place if
+ * needed, so that pages holding on to them stay valid.
+ */
 static void
-empty_store (GrRecipeStore *self)
+merge_recipes (GrRecipeStore *self,
+               GHashTable    *old_recipes,
+               GPtrArray     *added,
+               GPtrArray     *changed,
+               GPtrArray     *removed)
 {
         GHashTableIter iter;
-        char *key;
+        const char *id;
         GrRecipe *recipe;
-        GrChef *chef;
+
+        g_hash_table_iter_init (&iter, old_recipes);
+        while (g_hash_table_iter_next (&iter, (gpointer *)&id, (gpointer *)&recipe)) {
+                if (!g_hash_table_contains (self->recipes, id))
+                        g_ptr_array_add (removed, g_object_ref (recipe));
+        }
 
         g_hash_table_iter_init (&iter, self->recipes);
-        while (g_hash_table_iter_next (&iter, (gpointer *)&key, (gpointer *)&recipe)) {
-                g_hash_table_iter_remove (&iter);
+        while (g_hash_table_iter_next (&iter, (gpointer *)&id, (gpointer *)&recipe)) {
+                GrRecipe *old;
+
+                old = g_hash_table_lookup (old_recipes, id);
+                if (old == NULL) {
+                        g_ptr_array_add (added, g_object_ref (recipe));
+                        continue;
+                }
+
+                if (recipe_differs (old, recipe)) {
+                        gr_recipe_update_from (old, recipe);
+                        g_ptr_array_add (changed, g_object_ref (old));
+                }
+
+                g_hash_table_iter_replace (&iter, g_object_ref (old));
+        }
+}
+
+static gboolean
+merge_chefs (GrRecipeStore *self,
+             GHashTable    *old_chefs)
+{
+        GHashTableIter iter;
+        const char *id;
+        GrChef *chef;
+        gboolean changed = FALSE;
+
+        g_hash_table_iter_init (&iter, old_chefs);
+        while (g_hash_table_iter_next (&iter, (gpointer *)&id, (gpointer *)&chef)) {
+                if (!g_hash_table_contains (self->chefs, id))
+                        changed = TRUE;
         }
 
         g_hash_table_iter_init (&iter, self->chefs);
-        while (g_hash_table_iter_next (&iter, (gpointer *)&key, (gpointer *)&chef)) {
-                g_hash_table_iter_remove (&iter);
+        while (g_hash_table_iter_next (&iter, (gpointer *)&id, (gpointer *)&chef)) {
+                GrChef *old;
+
+                old = g_hash_table_lookup (old_chefs, id);
+                if (old == NULL) {
+                        changed = TRUE;
+                        continue;
+                }
+
+                if (chef_differs (old, chef)) {
+                        g_object_set (old,
+                                      "name", gr_chef_get_name (chef),
+                                      "fullname", gr_chef_get_fullname (chef),
+                                      "description", gr_chef_get_description (chef),
+                                      "image-path", gr_chef_get_image (chef),
+                                      "readonly", gr_chef_is_readonly (chef),
+                                      NULL);
+                        changed = TRUE;
+                }
+
+                g_hash_table_iter_replace (&iter, g_object_ref (old));
         }
 
-        g_clear_pointer (&self->todays, g_strfreev);
-        g_clear_pointer (&self->picks, g_strfreev);
-        g_clear_pointer (&self->favorites, g_strfreev);
-        g_clear_pointer (&self->export_list, g_strfreev);
-        g_clear_pointer (&self->featured_chefs, g_strfreev);
-        g_clear_pointer (&self->shopping_list, g_variant_dict_unref);
+        return changed;
 }
 
+static void update_search (GrRecipeSearch *search,
+                           GPtrArray      *added,
+                           GPtrArray      *changed,
+                           GPtrArray      *removed);
+
+/* Favorites, the export list and the shopping list live in
+ * GSettings and are not affected by new data, so we only reload
+ * the keyfiles and tell about the differences.
+ *
+ * Searches walk self->recipes, so the table itself is kept and
+ * the differences are applied to it in place.
+ */
 static void
 reload_updates (GrRecipeStore *self)
 {
         g_autofree char *cache_dir = NULL;
+        g_autofree char *path = NULL;
         const char *user_dir;
+        GHashTable *recipes;
+        g_autoptr(GHashTable) new_recipes = NULL;
+        g_autoptr(GHashTable) old_chefs = NULL;
+        g_auto(GStrv) old_todays = NULL;
+        g_auto(GStrv) old_picks = NULL;
+        g_auto(GStrv) old_featured_chefs = NULL;
+        g_autoptr(GPtrArray) added = NULL;
+        g_autoptr(GPtrArray) changed = NULL;
+        g_autoptr(GPtrArray) removed = NULL;
+        gboolean chefs_changed;
+        gboolean picks_changed;
+        GList *searches, *l;
+        guint i;
 
         g_debug ("New data obtained, reloading!");
 
-        empty_store (self);
+        recipes = g_steal_pointer (&self->recipes);
+        old_chefs = g_steal_pointer (&self->chefs);
+        old_todays = g_steal_pointer (&self->todays);
+        old_picks = g_steal_pointer (&self->picks);
+        old_featured_chefs = g_steal_pointer (&self->featured_chefs);
+
+        self->recipes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+        self->chefs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
 
         cache_dir = get_data_cache_dir ();
         user_dir = get_user_data_dir ();
 
+        /* New data may come with new translations */
+        path = g_build_filename (cache_dir, "recipes.db", NULL);
+        gr_translation_cache_load (get_user_cache_dir (), path);
+
         load_recipes (self, cache_dir, TRUE);
         load_chefs (self, cache_dir, TRUE);
         load_picks (self, cache_dir);
 
         load_recipes (self, user_dir, FALSE);
         load_chefs (self, user_dir, FALSE);
-        load_favorites (self);
-        load_export_list (self);
-        load_shopping (self);
 
-        g_signal_emit_by_name (self, "reloaded", 0);
+        gr_translation_cache_save ();
+
+        added = g_ptr_array_new_with_free_func (g_object_unref);
+        changed = g_ptr_array_new_with_free_func (g_object_unref);
+        removed = g_ptr_array_new_with_free_func (g_object_unref);
+
+        merge_recipes (self, recipes, added, changed, removed);
+
+        new_recipes = g_steal_pointer (&self->recipes);
+        self->recipes = recipes;
+
+        for (i = 0; i < removed->len; i++) {
+                GrRecipe *recipe = g_ptr_array_index (removed, i);
+                g_hash_table_remove (self->recipes, gr_recipe_get_id (recipe));
+        }
+        for (i = 0; i < added->len; i++) {
+                GrRecipe *recipe = g_ptr_array_index (added, i);
+                g_hash_table_insert (self->recipes,
+                                     g_strdup (gr_recipe_get_id (recipe)),
+                                     g_object_ref (recipe));
+        }
+
+        chefs_changed = merge_chefs (self, old_chefs);
+        picks_changed = !strv_equal (old_todays, self->todays) ||
+                        !strv_equal (old_picks, self->picks) ||
+                        !strv_equal (old_featured_chefs, self->featured_chefs);
+
+        g_info ("Reloaded: %d recipes added, %d changed, %d removed",
+                added->len, changed->len, removed->len);
+
+        if (added->len > 0 || changed->len > 0 || removed->len > 0) {
+                /* Handlers may create or drop searches */
+                searches = g_list_copy_deep (self->searches, (GCopyFunc) g_object_ref, NULL);
+                for (l = searches; l; l = l->next)
+                        update_search (l->data, added, changed, removed);
+                g_list_free_full (searches, g_object_unref);
+
+                g_signal_emit_by_name (self, "recipes-updated", added, changed, removed);
+        }
+
+        if (chefs_changed)
+                g_signal_emit_by_name (self, "chefs-changed");
+
+        /* The landing page picks from these */
+        if (picks_changed)
+                g_signal_emit_by_name (self, "reloaded");
 }
 
 static void
-tar_done (GObject      *source,
-          GAsyncResult *result,
-          gpointer      data)
+finish_download (GrRecipeStore *self)
 {
-        GrRecipeStore *self = data;
+        g_clear_object (&self->recipes_input);
+        g_clear_object (&self->recipes_decompressor);
+        g_clear_pointer (&self->recipes_reader, gr_tar_reader_free);
+        g_clear_object (&self->recipes_message);
+}
+
+static void
+abort_download (GrRecipeStore *self)
+{
+        /* Some files may have been updated already. Make sure
+         * that we ask for all of the data again next time.
+         */
+        if (self->recipes_reader && gr_tar_reader_get_n_changed (self->recipes_reader) > 0) {
+                g_autofree char *path = NULL;
+                g_autoptr(GFile) file = NULL;
+
+                path = g_build_filename (get_user_cache_dir (), "data", "recipes.db", NULL);
+                file = g_file_new_for_path (path);
+                g_file_set_attribute_uint64 (file, G_FILE_ATTRIBUTE_TIME_MODIFIED, 0, 0, NULL, NULL);
+        }
+
+        finish_download (self);
+}
+
+static void
+extraction_done (GrRecipeStore *self)
+{
+        g_autofree char *path = NULL;
         g_autoptr(GError) error = NULL;
+        guint n_changed;
 
-        if (!g_subprocess_wait_finish (G_SUBPROCESS (source), result, &error)) {
-                g_warning ("Failed to run tar: %s", error->message);
+        if (!gr_tar_reader_finish (self->recipes_reader, &error)) {
+                g_warning ("Failed to extract data.tar.gz: %s", error->message);
+                abort_download (self);
                 return;
         }
 
+        n_changed = gr_tar_reader_get_n_changed (self->recipes_reader);
+        finish_download (self);
+
+        /* The timestamp of recipes.db is when we last got the data */
+        path = g_build_filename (get_user_cache_dir (), "data", "recipes.db", NULL);
+        update_file_timestamp (path);
+        g_clear_pointer (&path, g_free);
+
+        /* Older versions kept the downloaded archive around */
+        path = g_build_filename (get_user_cache_dir (), "data.tar.gz", NULL);
+        g_remove (path);
+
+        if (n_changed == 0) {
+                g_debug ("No files changed");
+                return;
+        }
+
+        g_debug ("%u files changed", n_changed);
         reload_updates (self);
 }
 
+#define DOWNLOAD_CHUNK_SIZE (64 * 1024)
+
+/* Each chunk of the download is decompressed and extracted in a
+ * thread, and the next one is only read when that is done. The
+ * decompressor and the reader are only ever used by one thread
+ * at a time.
+ */
+typedef struct {
+        GConverter *decompressor;
+        GrTarReader *reader;
+        GBytes *bytes;
+} ExtractJob;
+
 static void
-save_file (SoupSession *session,
-           SoupMessage *msg,
-           gpointer     data)
+extract_job_free (gpointer data)
+{
+        ExtractJob *job = data;
+
+        g_object_unref (job->decompressor);
+        g_bytes_unref (job->bytes);
+        g_free (job);
+}
+
+static gboolean
+extract_data (GConverter   *decompressor,
+              GrTarReader  *reader,
+              const char   *data,
+              gsize         length,
+              GError      **error)
+{
+        g_autofree char *buffer = NULL;
+        gboolean at_end = length == 0;
+
+        buffer = g_malloc (DOWNLOAD_CHUNK_SIZE);
+
+        while (TRUE) {
+                GConverterResult res;
+                gsize bytes_read;
+                gsize bytes_written;
+                GError *local_error = NULL;
+
+                res = g_converter_convert (decompressor,
+                                           data, length,
+                                           buffer, DOWNLOAD_CHUNK_SIZE,
+                                           at_end ? G_CONVERTER_INPUT_AT_END : G_CONVERTER_NO_FLAGS,
+                                           &bytes_read, &bytes_written,
+                                           &local_error);
+                if (res == G_CONVERTER_ERROR) {
+                        /* Everything we got so far has been used */
+                        if (!at_end && g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT)) {
+                                g_error_free (local_error);
+                                return TRUE;
+                        }
+
+                        g_propagate_error (error, local_error);
+                        return FALSE;
+                }
+
+                if (!gr_tar_reader_feed (reader, buffer, bytes_written, error))
+                        return FALSE;
+
+                data += bytes_read;
+                length -= bytes_read;
+
+                if (res == G_CONVERTER_FINISHED || (length == 0 && !at_end))
+                        return TRUE;
+        }
+}
+
+static void
+extract_chunk (GTask        *task,
+               gpointer      source,
+               gpointer      task_data,
+               GCancellable *cancellable)
+{
+        ExtractJob *job = task_data;
+        GError *error = NULL;
+        const char *data;
+        gsize length;
+
+        data = g_bytes_get_data (job->bytes, &length);
+        if (!extract_data (job->decompressor, job->reader, data, length, &error))
+                g_task_return_error (task, error);
+        else
+                g_task_return_boolean (task, TRUE);
+}
+
+static void data_read (GObject      *source,
+                       GAsyncResult *result,
+                       gpointer      data);
+
+static void
+data_extracted (GObject      *source,
+                GAsyncResult *result,
+                gpointer      data)
+{
+        GrRecipeStore *self = GR_RECIPE_STORE (source);
+        ExtractJob *job = g_task_get_task_data (G_TASK (result));
+        g_autoptr(GError) error = NULL;
+
+        if (!g_task_propagate_boolean (G_TASK (result), &error)) {
+                g_warning ("Failed to extract data.tar.gz: %s", error->message);
+                abort_download (self);
+                return;
+        }
+
+        if (g_bytes_get_size (job->bytes) == 0) {
+                extraction_done (self);
+                return;
+        }
+
+        g_input_stream_read_bytes_async (self->recipes_input,
+                                         DOWNLOAD_CHUNK_SIZE,
+                                         G_PRIORITY_LOW,
+                                         NULL,
+                                         data_read,
+                                         self);
+}
+
+static void
+data_read (GObject      *source,
+           GAsyncResult *result,
+           gpointer      data)
 {
         GrRecipeStore *self = data;
+        g_autoptr(GBytes) bytes = NULL;
+        g_autoptr(GTask) task = NULL;
+        g_autoptr(GError) error = NULL;
+        ExtractJob *job;
+
+        bytes = g_input_stream_read_bytes_finish (G_INPUT_STREAM (source), result, &error);
+        if (bytes == NULL) {
+                g_warning ("Failed to load data.tar.gz: %s", error->message);
+                abort_download (self);
+                return;
+        }
+
+        job = g_new (ExtractJob, 1);
+        job->decompressor = g_object_ref (self->recipes_decompressor);
+        job->reader = self->recipes_reader;
+        job->bytes = g_steal_pointer (&bytes);
+
+        task = g_task_new (self, NULL, data_extracted, NULL);
+        g_task_set_task_data (task, job, extract_job_free);
+        g_task_run_in_thread (task, extract_chunk);
+}
+
+static void
+data_sent (GObject      *source,
+           GAsyncResult *result,
+           gpointer      data)
+{
+        GrRecipeStore *self = data;
+        SoupMessage *msg = self->recipes_message;
         const char *cache_dir;
         g_autofree char *filename = NULL;
-        const char *argv[6];
-        g_autofree char *cmdline = NULL;
-        g_autoptr(GSubprocess) subprocess = NULL;
-        g_autoptr(GSubprocessLauncher) launcher = NULL;
+        g_autoptr(GInputStream) input = NULL;
         g_autoptr(GError) error = NULL;
 
-        if (msg->status_code == SOUP_STATUS_CANCELLED || self->session == NULL) {
-                g_debug ("Message cancelled");
-                goto out;
+        input = soup_session_send_finish (SOUP_SESSION (source), result, &error);
+        if (input == NULL) {
+                if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+                        g_debug ("Message cancelled");
+                else
+                        g_warning ("Failed to load data.tar.gz: %s", error->message);
+                finish_download (self);
+                return;
         }
 
         cache_dir = get_user_cache_dir ();
@@ -1143,39 +1633,29 @@ save_file (SoupSession *session,
                 g_debug ("File not modified");
                 f = g_build_filename (cache_dir, "data", "recipes.db", NULL);
                 update_file_timestamp (f);
+                finish_download (self);
+                return;
         }
-        else if (msg->status_code == SOUP_STATUS_OK) {
-                g_debug ("Saving file to %s", filename);
-                if (!g_file_set_contents (filename, msg->response_body->data, msg->response_body->length, NULL)) {
-                        g_debug ("Saving file to %s failed", filename);
-                        goto out;
-                }
-        }
-        else {
+        else if (msg->status_code != SOUP_STATUS_OK) {
                 g_warning ("Failed to load %s", filename);
-                goto out;
+                finish_download (self);
+                return;
         }
 
-        argv[0] = "tar";
-        argv[1] = "-xf";
-        argv[2] = "data.tar.gz";
-        argv[3] = "--overwrite";
-        argv[4] = "--touch";
-        argv[5] = NULL;
-
-        // FIXME use libarchive instead
-        g_debug ("Running %s", cmdline = g_strjoinv (" ", (char **)argv));
-        launcher = g_subprocess_launcher_new (0);
-        g_subprocess_launcher_set_cwd (launcher, cache_dir);
-        subprocess = g_subprocess_launcher_spawnv (launcher, argv, &error);
-        if (!subprocess) {
-                g_warning ("Failed to create command: %s", error->message);
-                goto out;
-        }
+        /* Extract the archive while it is arriving, only
+         * writing the files that actually changed.
+         */
+        g_debug ("Extracting data.tar.gz to %s", cache_dir);
+        self->recipes_input = g_steal_pointer (&input);
+        self->recipes_decompressor = G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP));
+        self->recipes_reader = gr_tar_reader_new (cache_dir);
 
-        g_subprocess_wait_async (subprocess, NULL, tar_done, self);
-out:
-        g_clear_object (&self->recipes_message);
+        g_input_stream_read_bytes_async (self->recipes_input,
+                                         DOWNLOAD_CHUNK_SIZE,
+                                         G_PRIORITY_LOW,
+                                         NULL,
+                                         data_read,
+                                         self);
 }
 
 #define BASE_URL "https://static.gnome.org/recipes/v1"
@@ -1186,6 +1666,59 @@ get_file_url (const char *basename)
         return g_strconcat (BASE_URL, "/", basename, NULL);
 }
 
+static void
+download_bundle (GrRecipeStore *self)
+{
+        g_autofree char *cache_dir = NULL;
+        g_autofree char *filename = NULL;
+        g_autofree char *url = NULL;
+        g_autoptr(SoupURI) base_uri = NULL;
+
+        cache_dir = get_data_cache_dir ();
+        filename = g_build_filename (cache_dir, "recipes.db", NULL);
+
+        url = get_file_url ("data.tar.gz");
+        base_uri = soup_uri_new (url);
+        self->recipes_message = soup_message_new_from_uri (SOUP_METHOD_GET, base_uri);
+        set_modified_request (self->recipes_message, filename);
+        g_debug ("Load file for data.tar.gz from %s", url);
+        soup_session_send_async (self->session, self->recipes_message, NULL, data_sent, self);
+}
+
+static void
+data_updated (GObject      *source,
+              GAsyncResult *result,
+              gpointer      data)
+{
+        GrRecipeStore *self = data;
+        g_autoptr(GError) error = NULL;
+        g_autofree char *cache_dir = NULL;
+        g_autofree char *path = NULL;
+        guint n_changed;
+
+        if (!gr_data_update_finish (result, &n_changed, &error)) {
+                if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED)) {
+                        g_debug ("No incremental update: %s", error->message);
+                        download_bundle (self);
+                }
+                else
+                        g_warning ("Failed to update data: %s", error->message);
+                return;
+        }
+
+        cache_dir = get_data_cache_dir ();
+        path = g_build_filename (cache_dir, "recipes.db", NULL);
+        update_file_timestamp (path);
+
+        if (n_changed == 0) {
+                g_debug ("No files changed");
+                return;
+        }
+
+        g_debug ("%u files changed", n_changed);
+        reload_updates (self);
+}
+
 static gboolean
 load_updates (gpointer data)
 {
@@ -1195,19 +1728,84 @@ load_updates (gpointer data)
 
         cache_dir = get_data_cache_dir ();
         filename = g_build_filename (cache_dir, "recipes.db", NULL);
-        if (should_try_load (filename)) {
-                g_autofree char *url;
-                g_autoptr(SoupURI) base_uri = NULL;
+        if (should_try_load (filename))
+                gr_data_update_async (self->session, BASE_URL "/data", cache_dir, NULL, data_updated, self);
+
+        g_timeout_add_seconds (24 * 60 * 60, load_updates, data);
+
+        return G_SOURCE_REMOVE;
+}
+
+/* Images of imported recipes are shared by their content hash, so
+ * remove_image() leaves them alone. Instead, we look for the ones
+ * that no recipe or chef refers to anymore, a while after startup.
+ * Files that were written recently are kept, since an import or an
+ * edit that has not been saved yet may refer to them.
+ */
+#define SWEEP_DELAY 60
+#define SWEEP_MIN_AGE (24 * 60 * 60)
+
+static void
+add_referenced_image (GHashTable *referenced,
+                      const char *path)
+{
+        if (path && is_content_addressed (path))
+                g_hash_table_add (referenced, g_path_get_basename (path));
+}
+
+static gboolean
+sweep_images (gpointer data)
+{
+        GrRecipeStore *self = data;
+        g_autoptr(GHashTable) referenced = NULL;
+        g_autoptr(GDir) dir = NULL;
+        g_autofree char *path = NULL;
+        GHashTableIter iter;
+        gpointer value;
+        const char *name;
+        gint64 now;
+        int n_removed = 0;
+
+        path = g_build_filename (get_user_data_dir (), "images", NULL);
+        dir = g_dir_open (path, 0, NULL);
+        if (dir == NULL)
+                return G_SOURCE_REMOVE;
 
-                url = get_file_url ("data.tar.gz");
-                base_uri = soup_uri_new (url);
-                self->recipes_message = soup_message_new_from_uri (SOUP_METHOD_GET, base_uri);
-                set_modified_request (self->recipes_message, filename);
-                g_debug ("Load file for data.tar.gz from %s", url);
-                soup_session_queue_message (self->session, g_object_ref (self->recipes_message), save_file, self);
+        referenced = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+        g_hash_table_iter_init (&iter, self->recipes);
+        while (g_hash_table_iter_next (&iter, NULL, &value)) {
+                GPtrArray *images = gr_recipe_get_images (GR_RECIPE (value));
+                int i;
+
+                for (i = 0; i < images->len; i++)
+                        add_referenced_image (referenced, gr_image_get_path (g_ptr_array_index (images, i)));
         }
 
-        g_timeout_add_seconds (24 * 60 * 60, load_updates, data);
+        g_hash_table_iter_init (&iter, self->chefs);
+        while (g_hash_table_iter_next (&iter, NULL, &value))
+                add_referenced_image (referenced, gr_chef_get_image (GR_CHEF (value)));
+
+        now = g_get_real_time () / G_USEC_PER_SEC;
+
+        while ((name = g_dir_read_name (dir)) != NULL) {
+                g_autofree char *filename = NULL;
+                GStatBuf buf;
+
+                if (!is_content_addressed (name) || g_hash_table_contains (referenced, name))
+                        continue;
+
+                filename = g_build_filename (path, name, NULL);
+                if (g_stat (filename, &buf) != 0 || now - buf.st_mtime < SWEEP_MIN_AGE)
+                        continue;
+
+                g_debug ("Removing unused image %s", filename);
+                if (g_remove (filename) == 0)
+                        n_removed++;
+        }
+
+        if (n_removed > 0)
+                g_info ("Removed %d unused images", n_removed);
 
         return G_SOURCE_REMOVE;
 }
@@ -1217,7 +1815,12 @@ gr_recipe_store_init (GrRecipeStore *self)
 {
         const char *data_dir;
         const char *user_dir;
+        const char *shipped_dir;
         g_autofree char *cache_dir = NULL;
+        RecipeDb *shipped_db;
+        RecipeDb *user_db;
+        GThread *thread;
+        GThreadPool *pool;
 
         self->recipes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
         self->chefs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
@@ -1231,35 +1834,65 @@ gr_recipe_store_init (GrRecipeStore *self)
 
         load_updates (self);
 
-        /* First load preinstalled data */
-        if (load_recipes (self, cache_dir, TRUE)) {
+        g_timeout_add_seconds (SWEEP_DELAY, sweep_images, self);
+
+        /* The recipe dbs are read and parsed in parallel, and merged
+         * afterwards in the same order as they would be loaded one
+         * after the other: preinstalled data first, then saved data.
+         */
+        user_db = recipe_db_new (self, user_dir, FALSE);
+        thread = g_thread_new ("load-recipes", open_db_thread, user_db);
+
+        shipped_db = recipe_db_new (self, cache_dir, TRUE);
+        if (recipe_db_open (shipped_db)) {
                 g_autofree char *locale = NULL;
 
+                /* Before parsing, since that translates the recipes */
                 locale = g_build_filename (cache_dir, "locale", NULL);
                 bindtextdomain (GETTEXT_PACKAGE "-data", locale);
-
-                load_chefs (self, cache_dir, TRUE);
-                load_picks (self, cache_dir);
+                shipped_dir = cache_dir;
         }
         else {
-                load_recipes (self, data_dir, TRUE);
-                load_chefs (self, data_dir, TRUE);
-                load_picks (self, data_dir);
+                recipe_db_free (shipped_db);
+                shipped_db = recipe_db_new (self, data_dir, TRUE);
+                recipe_db_open (shipped_db);
+                shipped_dir = data_dir;
         }
 
-        /* Now load saved data */
-        load_recipes (self, user_dir, FALSE);
+        g_thread_join (thread);
+
+        gr_translation_cache_load (get_user_cache_dir (), shipped_db->path);
+
+        pool = g_thread_pool_new (parse_job, NULL, g_get_num_processors (), FALSE, NULL);
+        queue_parse_jobs (pool, shipped_db);
+        queue_parse_jobs (pool, user_db);
+
+        /* The rest is small, load it while the recipes are parsed */
+        load_chefs (self, shipped_dir, TRUE);
+        load_picks (self, shipped_dir);
         load_favorites (self);
         load_export_list (self);
         load_shopping (self);
         load_chefs (self, user_dir, FALSE);
 
+        g_thread_pool_free (pool, FALSE, TRUE);
+
+        recipe_db_merge (self, shipped_db);
+        recipe_db_merge (self, user_db);
+
+        recipe_db_free (shipped_db);
+        recipe_db_free (user_db);
+
+        gr_translation_cache_save ();
+
         g_info ("%d recipes loaded", g_hash_table_size (self->recipes));
         g_info ("%d chefs loaded", g_hash_table_size (self->chefs));
 }
 
 static guint add_signal;
+static guint recipes_added_signal;
 static guint remove_signal;
+static guint updated_signal;
 static guint changed_signal;
 static guint chefs_changed_signal;
 static guint reloaded_signal;
@@ -1278,6 +1911,13 @@ gr_recipe_store_class_init (GrRecipeStoreClass *klass)
                                    NULL, NULL,
                                    NULL,
                                    G_TYPE_NONE, 1, GR_TYPE_RECIPE);
+        recipes_added_signal = g_signal_new ("recipes-added",
+                                             G_TYPE_FROM_CLASS (object_class),
+                                             G_SIGNAL_RUN_LAST,
+                                             0,
+                                             NULL, NULL,
+                                             NULL,
+                                             G_TYPE_NONE, 1, G_TYPE_PTR_ARRAY);
         remove_signal = g_signal_new ("recipe-removed",
                                       G_TYPE_FROM_CLASS (object_class),
                                       G_SIGNAL_RUN_LAST,
@@ -1285,6 +1925,16 @@ gr_recipe_store_class_init (GrRecipeStoreClass *klass)
                                       NULL, NULL,
                                       NULL,
                                       G_TYPE_NONE, 1, GR_TYPE_RECIPE);
+        updated_signal = g_signal_new ("recipes-updated",
+                                       G_TYPE_FROM_CLASS (object_class),
+                                       G_SIGNAL_RUN_LAST,
+                                       0,
+                                       NULL, NULL,
+                                       NULL,
+                                       G_TYPE_NONE, 3,
+                                       G_TYPE_PTR_ARRAY,
+                                       G_TYPE_PTR_ARRAY,
+                                       G_TYPE_PTR_ARRAY);
         changed_signal = g_signal_new ("recipe-changed",
                                        G_TYPE_FROM_CLASS (object_class),
                                        G_SIGNAL_RUN_LAST,
@@ -1314,6 +1964,25 @@ gr_recipe_store_new (void)
         return g_object_new (GR_TYPE_RECIPE_STORE, NULL);
 }
 
+static gboolean
+check_recipe_id (GrRecipeStore  *self,
+                 const char     *id,
+                 GError        **error)
+{
+        if (id == NULL || g_str_has_prefix (id, "_by_")) {
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                             _("You need to provide a name for the recipe"));
+                return FALSE;
+        }
+        if (g_hash_table_contains (self->recipes, id)) {
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                             _("A recipe with this name and author (%s) already exists.\nPlease choose a different name"), id);
+                return FALSE;
+        }
+
+        return TRUE;
+}
+
 gboolean
 gr_recipe_store_add_recipe (GrRecipeStore  *self,
                             GrRecipe       *recipe,
@@ -1325,27 +1994,121 @@ gr_recipe_store_add_recipe (GrRecipeStore  *self,
 
         id = gr_recipe_get_id (recipe);
 
-        if (id == NULL || g_str_has_prefix (id, "_by_")) {
-                g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
-                             _("You need to provide a name for the recipe"));
-                return FALSE;
-        }
-        if (g_hash_table_contains (self->recipes, id)) {
-                g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
-                             _("A recipe with this name and author (%s) already exists.\nPlease choose a different name"), id);
+        if (!check_recipe_id (self, id, error)) {
+                g_object_unref (recipe);
                 return FALSE;
         }
 
         g_hash_table_insert (self->recipes, g_strdup (id), g_object_ref (recipe));
-        g_signal_emit (self, add_signal, 0, recipe);
 
-        save_recipes (self);
+        if (self->batch_depth > 0) {
+                g_ptr_array_add (self->batch_added, g_object_ref (recipe));
+                self->batch_recipes_dirty = TRUE;
+        }
+        else {
+                g_signal_emit (self, add_signal, 0, recipe);
+                save_recipes (self);
+        }
 
         g_object_unref (recipe);
 
         return TRUE;
 }
 
+/* Adds all of @recipes at once, saving the db once and emitting
+ * a single recipes-added signal. If any of them can't be added,
+ * none are.
+ */
+gboolean
+gr_recipe_store_add_recipes (GrRecipeStore  *self,
+                             GPtrArray      *recipes,
+                             GError        **error)
+{
+        g_autoptr(GHashTable) ids = NULL;
+        guint i;
+
+        ids = g_hash_table_new (g_str_hash, g_str_equal);
+        for (i = 0; i < recipes->len; i++) {
+                const char *id = gr_recipe_get_id (g_ptr_array_index (recipes, i));
+
+                if (!check_recipe_id (self, id, error))
+                        return FALSE;
+
+                if (!g_hash_table_add (ids, (gpointer)id)) {
+                        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                                     _("A recipe with this name and author (%s) already exists.\nPlease choose a different name"), id);
+                        return FALSE;
+                }
+        }
+
+        if (recipes->len == 0)
+                return TRUE;
+
+        for (i = 0; i < recipes->len; i++) {
+                GrRecipe *recipe = g_ptr_array_index (recipes, i);
+
+                g_hash_table_insert (self->recipes,
+                                     g_strdup (gr_recipe_get_id (recipe)),
+                                     g_object_ref (recipe));
+
+                if (self->batch_depth > 0)
+                        g_ptr_array_add (self->batch_added, g_object_ref (recipe));
+        }
+
+        if (self->batch_depth > 0) {
+                self->batch_recipes_dirty = TRUE;
+        }
+        else {
+                save_recipes (self);
+                g_signal_emit (self, recipes_added_signal, 0, recipes);
+        }
+
+        return TRUE;
+}
+
+/* Batches make adding many recipes, e.g. when importing, cheap:
+ * between gr_recipe_store_begin_batch() and the matching
+ * gr_recipe_store_commit_batch(), added recipes and chefs are not
+ * saved and not announced individually. Committing saves the dbs
+ * once, and emits a single recipes-added signal with all the added
+ * recipes, and chefs-changed if chefs were added. Batches can nest.
+ */
+void
+gr_recipe_store_begin_batch (GrRecipeStore *self)
+{
+        if (self->batch_depth == 0)
+                self->batch_added = g_ptr_array_new_with_free_func (g_object_unref);
+
+        self->batch_depth++;
+}
+
+void
+gr_recipe_store_commit_batch (GrRecipeStore *self)
+{
+        g_autoptr(GPtrArray) added = NULL;
+
+        g_assert (self->batch_depth > 0);
+
+        self->batch_depth--;
+        if (self->batch_depth > 0)
+                return;
+
+        added = g_steal_pointer (&self->batch_added);
+
+        if (self->batch_recipes_dirty)
+                save_recipes (self);
+        if (self->batch_chefs_dirty)
+                save_chefs (self);
+
+        if (added->len > 0)
+                g_signal_emit (self, recipes_added_signal, 0, added);
+        if (self->batch_chefs_dirty)
+                g_signal_emit (self, chefs_changed_signal, 0);
+
+        self->batch_recipes_dirty = FALSE;
+        self->batch_chefs_dirty = FALSE;
+}
+
 gboolean
 gr_recipe_store_update_recipe (GrRecipeStore  *self,
                                GrRecipe       *recipe,
@@ -1509,7 +2272,8 @@ gr_recipe_store_get_all_cuisines (GrRecipeStore *self,
         GrRecipe *recipe;
         g_autoptr(GHashTable) cuisines = NULL;
 
-        cuisines = g_hash_table_new (g_str_hash, g_str_equal);
+        /* Recipe cuisines are interned */
+        cuisines = g_hash_table_new (NULL, NULL);
 
         g_hash_table_iter_init (&iter, self->recipes);
         while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &recipe)) {
@@ -1548,8 +2312,13 @@ gr_recipe_store_add_chef (GrRecipeStore  *self,
 
         g_hash_table_insert (self->chefs, g_strdup (id), g_object_ref (chef));
 
-        g_signal_emit (self, chefs_changed_signal, 0);
-        save_chefs (self);
+        if (self->batch_depth > 0) {
+                self->batch_chefs_dirty = TRUE;
+        }
+        else {
+                g_signal_emit (self, chefs_changed_signal, 0);
+                save_chefs (self);
+        }
 
         return TRUE;
 }
@@ -1643,7 +2412,7 @@ gr_recipe_store_get_all_ingredients (GrRecipeStore *self,
         GrRecipe *recipe;
         GHashTable *ingreds;
         char **result;
-        int i, j;
+        int i;
         const char **names;
         int len;
 
@@ -1656,24 +2425,17 @@ gr_recipe_store_get_all_ingredients (GrRecipeStore *self,
         g_hash_table_iter_init (&iter, self->recipes);
         while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&recipe)) {
                 const char *ingredients;
-                GrIngredientsList *list = NULL;
-                g_autofree char **segments = NULL;
+                GrIngredientsListIter ing_iter;
+                const char *name;
 
                 ingredients = gr_recipe_get_ingredients (recipe);
 
                 if (!ingredients || ingredients[0] == '\0')
                         continue;
 
-                list = gr_ingredients_list_new (ingredients);
-                segments = gr_ingredients_list_get_segments (list);
-                for (j = 0; segments[j]; j++) {
-                        g_autofree char **ret = NULL;
-                        ret = gr_ingredients_list_get_ingredients (list, segments[j]);
-                        for (i = 0; ret[i]; i++)
-                                g_hash_table_add (ingreds, ret[i]);
-                }
-
-                g_object_unref (list);
+                gr_ingredients_list_iter_init (&ing_iter, gr_recipe_get_ingredients_list (recipe), NULL);
+                while (gr_ingredients_list_iter_next (&ing_iter, NULL, &name, NULL, NULL))
+                        g_hash_table_add (ingreds, (char *)name);
         }
 
         result = (char **)g_hash_table_get_keys_as_array (ingreds, length);
@@ -1983,10 +2745,16 @@ gr_recipe_store_has_chef (GrRecipeStore *self,
 {
         GHashTableIter iter;
         GrRecipe *recipe;
+        const char *id;
+
+        /* Recipe authors are interned */
+        id = lookup_interned_string (gr_chef_get_id (chef));
+        if (id == NULL)
+                return FALSE;
 
         g_hash_table_iter_init (&iter, self->recipes);
         while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&recipe)) {
-                if (g_strcmp0 (gr_chef_get_id (chef), gr_recipe_get_author (recipe)) == 0)
+                if (gr_recipe_get_author (recipe) == id)
                         return TRUE;
         }
 
@@ -1999,10 +2767,16 @@ gr_recipe_store_has_cuisine (GrRecipeStore *self,
 {
         GHashTableIter iter;
         GrRecipe *recipe;
+        const char *atom;
+
+        /* Recipe cuisines are interned */
+        atom = lookup_interned_string (cuisine);
+        if (cuisine && atom == NULL)
+                return FALSE;
 
         g_hash_table_iter_init (&iter, self->recipes);
         while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&recipe)) {
-                if (g_strcmp0 (cuisine, gr_recipe_get_cuisine (recipe)) == 0)
+                if (gr_recipe_get_cuisine (recipe) == atom)
                         return TRUE;
         }
 
@@ -2011,6 +2785,12 @@ gr_recipe_store_has_cuisine (GrRecipeStore *self,
 
 /*** search implementation ***/
 
+/* Besides the signals, GrRecipeSearch exposes the current results as
+ * a GListModel, kept ordered by the sort function. New hits are put
+ * in place with a binary search, so every change to the result set
+ * is reported as a minimal ::items-changed range.
+ */
+
 struct _GrRecipeSearch
 {
         GObject parent_instance;
@@ -2018,13 +2798,17 @@ struct _GrRecipeSearch
         GrRecipeStore *store;
 
         char **query;
+        const char **resolved;
 
         GDateTime *timestamp;
 
         gulong idle;
         GHashTableIter iter;
+        gint64 match_time;
+
+        GPtrArray *results;
+        GCompareDataFunc sort_func;
 
-        GList *results;
         GList *pending;
         int n_pending;
 
@@ -2041,7 +2825,10 @@ enum {
 
 static guint search_signals[LAST_SEARCH_SIGNAL];
 
-G_DEFINE_TYPE (GrRecipeSearch, gr_recipe_search, G_TYPE_OBJECT)
+static void gr_recipe_search_list_model_init (GListModelInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (GrRecipeSearch, gr_recipe_search, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (G_TYPE_LIST_MODEL, gr_recipe_search_list_model_init))
 
 GrRecipeSearch *
 gr_recipe_search_new (void)
@@ -2051,14 +2838,46 @@ gr_recipe_search_new (void)
         search = GR_RECIPE_SEARCH (g_object_new (GR_TYPE_RECIPE_SEARCH, NULL));
 
         search->store = g_object_ref (gr_recipe_store_get ());
+        search->store->searches = g_list_prepend (search->store->searches, search);
 
         return search;
 }
 
+static guint
+find_result_position (GrRecipeSearch *search,
+                      GrRecipe       *recipe)
+{
+        guint low, high;
+
+        low = 0;
+        high = search->results->len;
+
+        if (search->sort_func == NULL)
+                return high;
+
+        while (low < high) {
+                guint mid = low + (high - low) / 2;
+                GrRecipe *other = g_ptr_array_index (search->results, mid);
+
+                if (search->sort_func (other, recipe, NULL) <= 0)
+                        low = mid + 1;
+                else
+                        high = mid;
+        }
+
+        return low;
+}
+
 static void
 add_pending (GrRecipeSearch *search,
              GrRecipe       *recipe)
 {
+        guint position;
+
+        position = find_result_position (search, recipe);
+        g_ptr_array_insert (search->results, position, g_object_ref (recipe));
+        g_list_model_items_changed (G_LIST_MODEL (search), position, 0, 1);
+
         search->pending = g_list_prepend (search->pending, recipe);
         search->n_pending++;
 }
@@ -2066,7 +2885,7 @@ add_pending (GrRecipeSearch *search,
 static void
 clear_pending (GrRecipeSearch *search)
 {
-        search->results = g_list_concat (search->results, search->pending);
+        g_list_free (search->pending);
         search->pending = NULL;
         search->n_pending = 0;
 }
@@ -2083,8 +2902,14 @@ send_pending (GrRecipeSearch *search)
 static void
 clear_results (GrRecipeSearch *search)
 {
-        g_list_free (search->results);
-        search->results = NULL;
+        guint n_items;
+
+        n_items = search->results->len;
+        if (n_items == 0)
+                return;
+
+        g_ptr_array_set_size (search->results, 0);
+        g_list_model_items_changed (G_LIST_MODEL (search), 0, n_items, 0);
 }
 
 static gboolean
@@ -2102,7 +2927,7 @@ recipe_matches (GrRecipeSearch *search,
         else if (g_str_has_prefix (search->query[0], "mt:"))
                 return g_date_time_compare (gr_recipe_get_mtime (recipe), search->timestamp) > 0;
         else
-                return gr_recipe_matches (recipe, (const char **)search->query);
+                return gr_recipe_matches (recipe, (const char **)search->query, search->resolved);
 }
 
 static gboolean
@@ -2125,6 +2950,7 @@ search_idle (gpointer data)
 
                 if (g_get_monotonic_time () >= start_time + 4000) {
                         send_pending (search);
+                        search->match_time += g_get_monotonic_time () - start_time;
                         search->idle = g_timeout_add (16, search_idle, search);
                         return G_SOURCE_REMOVE;
                 }
@@ -2132,6 +2958,11 @@ search_idle (gpointer data)
 
         send_pending (search);
 
+        search->match_time += g_get_monotonic_time () - start_time;
+        g_debug ("Matching %u recipes took %.2f ms",
+                 g_hash_table_size (search->store->recipes),
+                 (double)search->match_time / G_TIME_SPAN_MILLISECOND);
+
         search->idle = 0;
         g_signal_emit (search, search_signals[FINISHED], 0);
 
@@ -2155,6 +2986,7 @@ start_search (GrRecipeSearch *search)
 
         if (search->idle == 0) {
                 g_hash_table_iter_init (&search->iter, search->store->recipes);
+                search->match_time = 0;
                 clear_pending (search);
                 clear_results (search);
                 g_signal_emit (search, search_signals[STARTED], 0);
@@ -2174,29 +3006,50 @@ stop_search (GrRecipeSearch *search)
 }
 
 static void
-refilter_existing_results (GrRecipeSearch *search)
+remove_results (GrRecipeSearch *search,
+                guint           position,
+                guint           n_items)
 {
-        GList *l;
-        GList *rejected, *accepted;
+        if (n_items == 0)
+                return;
+
+        g_ptr_array_remove_range (search->results, position, n_items);
+        g_list_model_items_changed (G_LIST_MODEL (search), position, n_items, 0);
+}
 
-        /* FIXME: do this incrementally */
+static void
+refilter_existing_results (GrRecipeSearch *search)
+{
+        GList *rejected;
+        guint i, run;
 
         rejected = NULL;
-        accepted = NULL;
-        for (l = search->results; l; l = l->next) {
-                GrRecipe *recipe = l->data;
+        run = 0;
 
-                if (recipe_matches (search, recipe))
-                        accepted = g_list_append (accepted, recipe);
-                else
-                        rejected = g_list_append (rejected, recipe);
+        /* Walk backwards, so that removing a run of rejected
+         * results does not shift the ones we have yet to look at.
+         */
+        i = search->results->len;
+        while (i > 0) {
+                GrRecipe *recipe;
+
+                i--;
+                recipe = g_ptr_array_index (search->results, i);
+
+                if (recipe_matches (search, recipe)) {
+                        remove_results (search, i + 1, run);
+                        run = 0;
+                }
+                else {
+                        rejected = g_list_prepend (rejected, g_object_ref (recipe));
+                        run++;
+                }
         }
+        remove_results (search, 0, run);
 
-        g_list_free (search->results);
-        search->results = accepted;
         if (rejected) {
                 g_signal_emit (search, search_signals[HITS_REMOVED], 0, rejected);
-                g_list_free (rejected);
+                g_list_free_full (rejected, g_object_unref);
         }
 
         if (search->idle == 0) {
@@ -2204,6 +3057,94 @@ refilter_existing_results (GrRecipeSearch *search)
         }
 }
 
+/* Applies the differences found when reloading the data, so that
+ * the model only reports the recipes that actually came, went or
+ * moved. A search that is still running walks the recipes table,
+ * which was changed underneath it, so that one starts over.
+ */
+static void
+update_search (GrRecipeSearch *search,
+               GPtrArray      *added,
+               GPtrArray      *changed,
+               GPtrArray      *removed)
+{
+        GList *rejected;
+        guint i, position;
+
+        if (search->query == NULL)
+                return;
+
+        /* The new data may have brought new authors */
+        g_free (search->resolved);
+        search->resolved = gr_recipe_resolve_terms ((const char **)search->query);
+
+        if (search->idle != 0) {
+                stop_search (search);
+                start_search (search);
+                return;
+        }
+
+        rejected = NULL;
+
+        for (i = 0; i < removed->len; i++) {
+                GrRecipe *recipe = g_ptr_array_index (removed, i);
+
+                if (g_ptr_array_find (search->results, recipe, &position)) {
+                        rejected = g_list_prepend (rejected, g_object_ref (recipe));
+                        remove_results (search, position, 1);
+                }
+        }
+
+        for (i = 0; i < changed->len; i++) {
+                GrRecipe *recipe = g_ptr_array_index (changed, i);
+                gboolean matches;
+
+                matches = recipe_matches (search, recipe);
+
+                if (g_ptr_array_find (search->results, recipe, &position)) {
+                        guint new_position;
+
+                        if (!matches) {
+                                rejected = g_list_prepend (rejected, g_object_ref (recipe));
+                                remove_results (search, position, 1);
+                                continue;
+                        }
+
+                        /* Still a hit, but the sort key may have changed */
+                        g_ptr_array_remove_index (search->results, position);
+                        new_position = find_result_position (search, recipe);
+                        g_ptr_array_insert (search->results, new_position, g_object_ref (recipe));
+
+                        if (new_position == position) {
+                                g_list_model_items_changed (G_LIST_MODEL (search), position, 1, 1);
+                        }
+                        else {
+                                g_list_model_items_changed (G_LIST_MODEL (search), position, 1, 0);
+                                g_list_model_items_changed (G_LIST_MODEL (search), new_position, 0, 1);
+                        }
+                }
+                else if (matches) {
+                        add_pending (search, recipe);
+                }
+        }
+
+        for (i = 0; i < added->len; i++) {
+                GrRecipe *recipe = g_ptr_array_index (added, i);
+
+                if (recipe_matches (search, recipe))
+                        add_pending (search, recipe);
+        }
+
+        if (rejected) {
+                g_signal_emit (search, search_signals[HITS_REMOVED], 0, rejected);
+                g_list_free_full (rejected, g_object_unref);
+        }
+
+        send_pending (search);
+
+        g_signal_emit (search, search_signals[FINISHED], 0);
+}
+
 static gboolean
 query_is_narrowing (GrRecipeSearch  *search,
                     const char     **query)
@@ -2242,11 +3183,27 @@ query_is_narrowing (GrRecipeSearch  *search,
         return TRUE;
 }
 
+static void
+set_query (GrRecipeSearch  *search,
+           const char     **terms)
+{
+        char **query;
+
+        /* @terms may be our own query */
+        query = g_strdupv ((char **)terms);
+
+        g_strfreev (search->query);
+        g_free (search->resolved);
+
+        search->query = query;
+        search->resolved = query ? gr_recipe_resolve_terms ((const char **)query) : NULL;
+}
+
 void
 gr_recipe_search_stop (GrRecipeSearch *search)
 {
         stop_search (search);
-        g_clear_pointer (&search->query, g_strfreev);
+        set_query (search, NULL);
 }
 
 void
@@ -2269,14 +3226,13 @@ gr_recipe_search_set_terms (GrRecipeSearch  *search,
 
         if (terms == NULL || terms[0] == NULL) {
                 stop_search (search);
-                g_clear_pointer (&search->query, g_strfreev);
+                set_query (search, NULL);
                 return;
         }
 
         narrowing = query_is_narrowing (search, terms);
 
-        g_strfreev (search->query);
-        search->query = g_strdupv ((char **)terms);
+        set_query (search, terms);
 
         if (narrowing) {
                 refilter_existing_results (search);
@@ -2293,13 +3249,165 @@ gr_recipe_search_get_terms (GrRecipeSearch *search)
         return (const char **)search->query;
 }
 
+typedef struct {
+        GrRecipe *recipe;
+        guint old_position;
+} SortEntry;
+
+static int
+compare_entries (gconstpointer a,
+                 gconstpointer b,
+                 gpointer      data)
+{
+        GrRecipeSearch *search = data;
+
+        return search->sort_func (((SortEntry *)a)->recipe, ((SortEntry *)b)->recipe, NULL);
+}
+
+/* Puts the results in sort order with as few changes to the model as
+ * we can: the longest run of results that is already in the new order
+ * stays where it is, and only the others are removed and inserted
+ * again, in contiguous stretches where possible. Views then only need
+ * to update the rows that really moved.
+ */
+static void
+resort_results (GrRecipeSearch *search)
+{
+        GListModel *model = G_LIST_MODEL (search);
+        guint n = search->results->len;
+        g_autofree SortEntry *entries = NULL;
+        g_autofree guint *tails = NULL;
+        g_autofree guint *prev = NULL;
+        g_autofree gboolean *kept = NULL;
+        guint n_kept;
+        guint i, j;
+
+        entries = g_new (SortEntry, n);
+        for (i = 0; i < n; i++) {
+                entries[i].recipe = g_object_ref (g_ptr_array_index (search->results, i));
+                entries[i].old_position = i;
+        }
+
+        /* Stable, so equal results keep their order */
+        g_qsort_with_data (entries, n, sizeof (SortEntry), compare_entries, search);
+
+        /* Longest increasing run of old positions, in new order */
+        tails = g_new (guint, n);
+        prev = g_new (guint, n);
+        n_kept = 0;
+        for (i = 0; i < n; i++) {
+                guint lo = 0;
+                guint hi = n_kept;
+
+                while (lo < hi) {
+                        guint mid = (lo + hi) / 2;
+
+                        if (entries[tails[mid]].old_position < entries[i].old_position)
+                                lo = mid + 1;
+                        else
+                                hi = mid;
+                }
+
+                prev[i] = lo > 0 ? tails[lo - 1] : G_MAXUINT;
+                tails[lo] = i;
+                if (lo == n_kept)
+                        n_kept++;
+        }
+
+        kept = g_new0 (gboolean, n);
+        for (i = n_kept > 0 ? tails[n_kept - 1] : G_MAXUINT; i != G_MAXUINT; i = prev[i])
+                kept[entries[i].old_position] = TRUE;
+
+        /* Take out the ones that move, from the back */
+        for (i = n; i > 0; i = j) {
+                if (kept[i - 1]) {
+                        j = i - 1;
+                        continue;
+                }
+
+                for (j = i - 1; j > 0 && !kept[j - 1]; j--)
+                        ;
+
+                g_ptr_array_remove_range (search->results, j, i - j);
+                g_list_model_items_changed (model, j, i - j, 0);
+        }
+
+        /* And put them back at their new places */
+        for (i = 0; i < n; i = j) {
+                if (kept[entries[i].old_position]) {
+                        j = i + 1;
+                        continue;
+                }
+
+                for (j = i; j < n && !kept[entries[j].old_position]; j++)
+                        g_ptr_array_insert (search->results, j, g_object_ref (entries[j].recipe));
+
+                g_list_model_items_changed (model, i, 0, j - i);
+        }
+
+        for (i = 0; i < n; i++)
+                g_object_unref (entries[i].recipe);
+}
+
+void
+gr_recipe_search_set_sort_func (GrRecipeSearch   *search,
+                                GCompareDataFunc  sort_func)
+{
+        if (search->sort_func == sort_func)
+                return;
+
+        search->sort_func = sort_func;
+
+        if (sort_func == NULL || search->results->len < 2)
+                return;
+
+        resort_results (search);
+}
+
+static GType
+gr_recipe_search_get_item_type (GListModel *model)
+{
+        return GR_TYPE_RECIPE;
+}
+
+static guint
+gr_recipe_search_get_n_items (GListModel *model)
+{
+        GrRecipeSearch *search = GR_RECIPE_SEARCH (model);
+
+        return search->results->len;
+}
+
+static gpointer
+gr_recipe_search_get_item (GListModel *model,
+                           guint       position)
+{
+        GrRecipeSearch *search = GR_RECIPE_SEARCH (model);
+
+        if (position >= search->results->len)
+                return NULL;
+
+        return g_object_ref (g_ptr_array_index (search->results, position));
+}
+
+static void
+gr_recipe_search_list_model_init (GListModelInterface *iface)
+{
+        iface->get_item_type = gr_recipe_search_get_item_type;
+        iface->get_n_items = gr_recipe_search_get_n_items;
+        iface->get_item = gr_recipe_search_get_item;
+}
+
 static void
 gr_recipe_search_finalize (GObject *object)
 {
         GrRecipeSearch *search = (GrRecipeSearch *)object;
 
         stop_search (search);
+        g_ptr_array_unref (search->results);
         g_strfreev (search->query);
+        g_free (search->resolved);
+        search->store->searches = g_list_remove (search->store->searches, search);
         g_object_unref (search->store);
         g_clear_pointer (&search->timestamp, g_date_time_unref);
 
@@ -2380,6 +3488,8 @@ gr_recipe_search_class_init (GrRecipeSearchClass *klass)
 static void
 gr_recipe_search_init (GrRecipeSearch *self)
 {
+        self->results = g_ptr_array_new_with_free_func (g_object_unref);
+        self->sort_func = gr_recipe_compare_by_name;
 }
 
 GrRecipeStore *
@@ -37,6 +37,11 @@ GrRecipeStore  *gr_recipe_store_new                 (void);
 gboolean        gr_recipe_store_add_recipe          (GrRecipeStore  *self,
                                                      GrRecipe       *recipe,
                                                      GError        **error);
+gboolean        gr_recipe_store_add_recipes         (GrRecipeStore  *self,
+                                                     GPtrArray      *recipes,
+                                                     GError        **error);
+void            gr_recipe_store_begin_batch         (GrRecipeStore  *self);
+void            gr_recipe_store_commit_batch        (GrRecipeStore  *self);
 gboolean        gr_recipe_store_update_recipe       (GrRecipeStore  *self,
                                                      GrRecipe       *recipe,
                                                      const char     *old_id,
@@ -132,5 +137,7 @@ void            gr_recipe_search_set_terms (GrRecipeSearch  *search,
                                             const char     **query);
 const char    **gr_recipe_search_get_terms (GrRecipeSearch  *search);
 void            gr_recipe_search_stop      (GrRecipeSearch  *search);
+void            gr_recipe_search_set_sort_func (GrRecipeSearch   *search,
+                                                GCompareDataFunc  sort_func);
 
 G_END_DECLS
@@ -29,6 +29,7 @@
 #include "gr-window.h"
 #include "gr-utils.h"
 #include "gr-image.h"
+#include "gr-image-viewer.h"
 
 
 struct _GrRecipeTile
@@ -71,6 +72,84 @@ update_shared_icon (GrRecipeTile *tile)
         }
 }
 
+#define IMAGE_HEIGHT 200
+
+static int
+get_image_width (GrRecipeTile *tile)
+{
+        return tile->wide ? 538 : 258;
+}
+
+static void
+load_image (GrRecipeTile *tile)
+{
+        GPtrArray *images;
+        int index;
+        GrImage *ri;
+
+        g_cancellable_cancel (tile->cancellable);
+        g_clear_object (&tile->cancellable);
+
+        /* Keep the size while there is no image, or the previous
+         * recipe's image, so that tiles in a grid line up.
+         */
+        gtk_widget_set_size_request (tile->image, get_image_width (tile), IMAGE_HEIGHT);
+        gtk_image_clear (GTK_IMAGE (tile->image));
+
+        if (!tile->recipe)
+                return;
+
+        images = gr_recipe_get_images (tile->recipe);
+        if (images->len == 0)
+                return;
+
+        tile->cancellable = g_cancellable_new ();
+
+        index = gr_recipe_get_default_image (tile->recipe);
+        if (index < 0 || index >= images->len)
+                index = 0;
+
+        ri = g_ptr_array_index (images, index);
+
+        gr_image_load (ri,
+                       get_image_width (tile), IMAGE_HEIGHT, FALSE,
+                       tile->cancellable,
+                       gr_image_set_pixbuf,
+                       tile->image);
+}
+
+/* Warm the images that the details page is going to show
+ * when this recipe gets opened.
+ */
+static void
+prefetch_details_images (GrRecipeTile *tile,
+                         gboolean      urgent)
+{
+        GPtrArray *images;
+        int index;
+        GrImage *ri;
+
+        if (tile->recipe == NULL)
+                return;
+
+        images = gr_recipe_get_images (tile->recipe);
+        if (images->len == 0)
+                return;
+
+        index = gr_recipe_get_default_image (tile->recipe);
+        if (index < 0 || index >= images->len)
+                index = 0;
+
+        ri = g_ptr_array_index (images, index);
+
+        gr_image_prefetch (ri,
+                           GR_IMAGE_VIEWER_WIDTH, GR_IMAGE_VIEWER_HEIGHT, FALSE,
+                           urgent);
+        gr_image_prefetch (ri,
+                           GR_IMAGE_VIEWER_PREVIEW_WIDTH, GR_IMAGE_VIEWER_PREVIEW_HEIGHT, FALSE,
+                           urgent);
+}
+
 static void
 recipe_tile_set_recipe (GrRecipeTile *tile,
                         GrRecipe     *recipe)
@@ -79,9 +158,6 @@ recipe_tile_set_recipe (GrRecipeTile *tile,
 
         store = gr_recipe_store_get ();
 
-        g_cancellable_cancel (tile->cancellable);
-        g_clear_object (&tile->cancellable);
-
         g_set_object (&tile->recipe, recipe);
 
         if (tile->recipe) {
@@ -89,7 +165,6 @@ recipe_tile_set_recipe (GrRecipeTile *tile,
                 const char *author;
                 g_autoptr(GrChef) chef = NULL;
                 g_autofree char *tmp = NULL;
-                GPtrArray *images;
 
                 name = gr_recipe_get_translated_name (recipe);
                 author = gr_recipe_get_author (recipe);
@@ -98,27 +173,36 @@ recipe_tile_set_recipe (GrRecipeTile *tile,
                 gtk_label_set_label (GTK_LABEL (tile->label), name);
                 tmp = g_strdup_printf (_("by %s"), chef ? gr_chef_get_fullname (chef) : _("Anonymous"));
                 gtk_label_set_label (GTK_LABEL (tile->author), tmp);
+        }
+
+        update_shared_icon (tile);
+        load_image (tile);
+
+        /* A tile in a grid gets mapped once and then shows other recipes */
+        if (gtk_widget_get_mapped (GTK_WIDGET (tile)))
+                prefetch_details_images (tile, FALSE);
+}
 
-                images = gr_recipe_get_images (recipe);
-                if (images->len > 0) {
-                        int index;
-                        GrImage *ri;
+static void
+recipe_tile_map (GtkWidget *widget)
+{
+        GTK_WIDGET_CLASS (gr_recipe_tile_parent_class)->map (widget);
+
+        prefetch_details_images (GR_RECIPE_TILE (widget), FALSE);
+}
 
-                        tile->cancellable = g_cancellable_new ();
+static gboolean
+recipe_tile_enter_notify (GtkWidget        *widget,
+                          GdkEventCrossing *event)
+{
+        GtkWidgetClass *parent_class = GTK_WIDGET_CLASS (gr_recipe_tile_parent_class);
 
-                        index = gr_recipe_get_default_image (recipe);
-                        if (index < 0 || index >= images->len)
-                                index = 0;
+        prefetch_details_images (GR_RECIPE_TILE (widget), TRUE);
 
-                        ri = g_ptr_array_index (images, index);
+        if (parent_class->enter_notify_event)
+                return parent_class->enter_notify_event (widget, event);
 
-                        gr_image_load (ri,
-                                       tile->wide ? 538 : 258, 200, FALSE,
-                                       tile->cancellable,
-                                       gr_image_set_pixbuf,
-                                       tile->image);
-                }
-        }
+        return GDK_EVENT_PROPAGATE;
 }
 
 static void
@@ -149,6 +233,9 @@ gr_recipe_tile_class_init (GrRecipeTileClass *klass)
 
         object_class->finalize = recipe_tile_finalize;
 
+        widget_class->map = recipe_tile_map;
+        widget_class->enter_notify_event = recipe_tile_enter_notify;
+
         gtk_widget_class_set_template_from_resource (widget_class, "/org/gnome/Recipes/gr-recipe-tile.ui");
 
         gtk_widget_class_bind_template_child (widget_class, GrRecipeTile, label);
@@ -198,3 +285,14 @@ gr_recipe_tile_set_show_shared (GrRecipeTile *tile,
 
         update_shared_icon (tile);
 }
+
+/* Shows @recipe in @tile, for grids that reuse their tiles */
+void
+gr_recipe_tile_set_recipe (GrRecipeTile *tile,
+                           GrRecipe     *recipe)
+{
+        if (tile->recipe == recipe)
+                return;
+
+        recipe_tile_set_recipe (tile, recipe);
+}
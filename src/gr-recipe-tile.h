@@ -35,5 +35,7 @@ GtkWidget      *gr_recipe_tile_new_wide   (GrRecipe     *recipe);
 GrRecipe       *gr_recipe_tile_get_recipe (GrRecipeTile *tile);
 void            gr_recipe_tile_set_show_shared (GrRecipeTile *tile,
                                                 gboolean      show_shared);
+void            gr_recipe_tile_set_recipe (GrRecipeTile *tile,
+                                           GrRecipe     *recipe);
 
 G_END_DECLS
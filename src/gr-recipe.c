@@ -36,7 +36,7 @@
  *  If any fields are added to a recipe, there are several places
  *  that need to be kept in sync:
  *  - save_recipes() in gr-recipe-store.c
- *  - load_recipes() in gr-recipe-store.c
+ *  - parse_recipe() in gr-recipe-store.c
  *  - the GrRecipeExporter code
  *  - the GrRecipeImporter code
  */
@@ -47,20 +47,23 @@ struct _GrRecipe
 
         char *id;
         char *name;
-        char *author;
+        const char *author;
         char *description;
         GPtrArray *images;
         int default_image;
 
-        char *cuisine;
-        char *season;
-        char *category;
+        /* Interned, so they can be compared by pointer */
+        const char *cuisine;
+        const char *season;
+        const char *category;
         char *prep_time;
         char *cook_time;
         char *ingredients;
         char *instructions;
         char *notes;
         GrDiets diets;
+
+        GrIngredientsList *ingredients_list;
         GDateTime *ctime;
         GDateTime *mtime;
 
@@ -121,14 +124,11 @@ gr_recipe_finalize (GObject *object)
 
         g_free (self->id);
         g_free (self->name);
-        g_free (self->author);
         g_free (self->description);
-        g_free (self->cuisine);
-        g_free (self->season);
-        g_free (self->category);
         g_free (self->prep_time);
         g_free (self->cook_time);
         g_free (self->ingredients);
+        g_clear_object (&self->ingredients_list);
         g_free (self->instructions);
         g_free (self->notes);
         g_ptr_array_unref (self->images);
@@ -289,8 +289,7 @@ gr_recipe_set_property (GObject      *object,
                 break;
 
         case PROP_AUTHOR:
-                g_free (self->author);
-                self->author = g_value_dup_string (value);
+                self->author = g_intern_string (g_value_get_string (value));
                 break;
 
         case PROP_NAME:
@@ -300,7 +299,7 @@ gr_recipe_set_property (GObject      *object,
                 self->name = g_value_dup_string (value);
                 if (self->name) {
                         self->translated_name = translate_multiline_string (self->name);
-                        self->cf_name = g_utf8_casefold (self->translated_name, -1);
+                        self->cf_name = casefold_string (self->translated_name);
                 }
                 break;
 
@@ -311,7 +310,7 @@ gr_recipe_set_property (GObject      *object,
                 self->description = g_value_dup_string (value);
                 if (self->description) {
                         self->translated_description = translate_multiline_string (self->description);
-                        self->cf_description = g_utf8_casefold (self->translated_description, -1);
+                        self->cf_description = casefold_string (self->translated_description);
                 }
                 break;
 
@@ -326,18 +325,15 @@ gr_recipe_set_property (GObject      *object,
                 break;
 
         case PROP_CATEGORY:
-                g_free (self->category);
-                self->category = g_value_dup_string (value);
+                self->category = g_intern_string (g_value_get_string (value));
                 break;
 
         case PROP_CUISINE:
-                g_free (self->cuisine);
-                self->cuisine = g_value_dup_string (value);
+                self->cuisine = g_intern_string (g_value_get_string (value));
                 break;
 
         case PROP_SEASON:
-                g_free (self->season);
-                self->season = g_value_dup_string (value);
+                self->season = g_intern_string (g_value_get_string (value));
                 break;
 
         case PROP_PREP_TIME:
@@ -357,12 +353,13 @@ gr_recipe_set_property (GObject      *object,
         case PROP_INGREDIENTS:
                 g_clear_pointer (&self->ingredients, g_free);
                 g_clear_pointer (&self->cf_ingredients, g_free);
+                g_clear_object (&self->ingredients_list);
                 self->garlic = FALSE;
 
                 self->ingredients = g_value_dup_string (value);
                 if (self->ingredients) {
                         g_autofree char *cf_garlic = NULL;
-                        self->cf_ingredients = g_utf8_casefold (self->ingredients, -1);
+                        self->cf_ingredients = casefold_string (self->ingredients);
                         cf_garlic = g_utf8_casefold ("Garlic", -1);
                         self->garlic = (strstr (self->cf_ingredients, cf_garlic) != NULL);
                 }
@@ -558,6 +555,102 @@ gr_recipe_new (void)
         return g_object_new (GR_TYPE_RECIPE, NULL);
 }
 
+#define SWAP(a, b) G_STMT_START { \
+        gpointer tmp = (gpointer)(a); \
+        (a) = (gpointer)(b); \
+        (b) = tmp; \
+} G_STMT_END
+
+static gboolean
+images_equal (GPtrArray *a,
+              GPtrArray *b)
+{
+        int i;
+
+        if (a->len != b->len)
+                return FALSE;
+
+        for (i = 0; i < a->len; i++) {
+                if (g_strcmp0 (gr_image_get_path (g_ptr_array_index (a, i)),
+                               gr_image_get_path (g_ptr_array_index (b, i))) != 0)
+                        return FALSE;
+        }
+
+        return TRUE;
+}
+
+#define UPDATE_STRING(field, prop) G_STMT_START { \
+        if (g_strcmp0 (recipe->field, other->field) != 0) \
+                g_object_notify (G_OBJECT (recipe), prop); \
+        SWAP (recipe->field, other->field); \
+} G_STMT_END
+
+#define UPDATE_VALUE(field, prop) G_STMT_START { \
+        if (recipe->field != other->field) { \
+                recipe->field = other->field; \
+                g_object_notify (G_OBJECT (recipe), prop); \
+        } \
+} G_STMT_END
+
+/* Gives @recipe the contents of @other, while keeping its identity,
+ * so that everybody who holds on to @recipe sees the new data, and
+ * is notified about the properties that changed. This bypasses the
+ * readonly check, it is only meant for the store, when it reloads
+ * updated data.
+ */
+void
+gr_recipe_update_from (GrRecipe *recipe,
+                       GrRecipe *other)
+{
+        g_object_freeze_notify (G_OBJECT (recipe));
+
+        UPDATE_STRING (id, "id");
+        UPDATE_STRING (name, "name");
+        UPDATE_STRING (author, "author");
+        UPDATE_STRING (description, "description");
+        UPDATE_STRING (cuisine, "cuisine");
+        UPDATE_STRING (season, "season");
+        UPDATE_STRING (category, "category");
+        UPDATE_STRING (prep_time, "prep-time");
+        UPDATE_STRING (cook_time, "cook-time");
+        UPDATE_STRING (ingredients, "ingredients");
+        UPDATE_STRING (instructions, "instructions");
+        UPDATE_STRING (notes, "notes");
+        UPDATE_STRING (yield_unit, "yield-unit");
+
+        if (!images_equal (recipe->images, other->images))
+                g_object_notify (G_OBJECT (recipe), "images");
+        SWAP (recipe->images, other->images);
+
+        if (!g_date_time_equal (recipe->ctime, other->ctime))
+                g_object_notify (G_OBJECT (recipe), "ctime");
+        SWAP (recipe->ctime, other->ctime);
+
+        if (!g_date_time_equal (recipe->mtime, other->mtime))
+                g_object_notify (G_OBJECT (recipe), "mtime");
+        SWAP (recipe->mtime, other->mtime);
+
+        /* Derived data, no properties of their own */
+        SWAP (recipe->ingredients_list, other->ingredients_list);
+        SWAP (recipe->cf_name, other->cf_name);
+        SWAP (recipe->cf_description, other->cf_description);
+        SWAP (recipe->cf_ingredients, other->cf_ingredients);
+        SWAP (recipe->translated_name, other->translated_name);
+        SWAP (recipe->translated_description, other->translated_description);
+        SWAP (recipe->translated_instructions, other->translated_instructions);
+        SWAP (recipe->translated_notes, other->translated_notes);
+        recipe->garlic = other->garlic;
+
+        UPDATE_VALUE (default_image, "default-image");
+        UPDATE_VALUE (diets, "diets");
+        UPDATE_VALUE (spiciness, "spiciness");
+        UPDATE_VALUE (readonly, "readonly");
+        UPDATE_VALUE (contributed, "contributed");
+        UPDATE_VALUE (yield, "yield");
+
+        g_object_thaw_notify (G_OBJECT (recipe));
+}
+
 const char *
 gr_recipe_get_id (GrRecipe *recipe)
 {
@@ -642,6 +735,18 @@ gr_recipe_get_ingredients (GrRecipe *recipe)
         return recipe->ingredients;
 }
 
+/* Returns the parsed ingredients. They are parsed on first use and
+ * kept until the ingredients of the recipe change.
+ */
+GrIngredientsList *
+gr_recipe_get_ingredients_list (GrRecipe *recipe)
+{
+        if (recipe->ingredients_list == NULL)
+                recipe->ingredients_list = gr_ingredients_list_new (recipe->ingredients ? recipe->ingredients : "");
+
+        return recipe->ingredients_list;
+}
+
 const char *
 gr_recipe_get_instructions (GrRecipe *recipe)
 {
@@ -733,10 +838,32 @@ gr_recipe_get_yield_unit (GrRecipe *recipe)
         return recipe->yield_unit;
 }
 
-/* terms are assumed to be g_utf8_casefold'ed where appropriate */
+/* Looks up the interned strings that by: and se: terms are compared
+ * with, once for a query instead of once per recipe. The result has
+ * an entry for each of @terms, and is freed with g_free().
+ */
+const char **
+gr_recipe_resolve_terms (const char **terms)
+{
+        const char **resolved;
+        int i;
+
+        resolved = g_new0 (const char *, g_strv_length ((char **)terms) + 1);
+        for (i = 0; terms[i]; i++) {
+                if (g_str_has_prefix (terms[i], "by:") || g_str_has_prefix (terms[i], "se:"))
+                        resolved[i] = lookup_interned_string (terms[i] + 3);
+        }
+
+        return resolved;
+}
+
+/* terms are assumed to be g_utf8_casefold'ed where appropriate,
+ * and resolved to come from gr_recipe_resolve_terms() for them
+ */
 gboolean
 gr_recipe_matches (GrRecipe    *recipe,
-                   const char **terms)
+                   const char **terms,
+                   const char **resolved)
 {
         int i;
         g_autofree char *cf_fullname = NULL;
@@ -757,13 +884,13 @@ gr_recipe_matches (GrRecipe    *recipe,
                         continue;
                 }
                 else if (g_str_has_prefix (terms[i], "by:")) {
-                        if (!recipe->author || strcmp (recipe->author, terms[i] + 3) != 0) {
+                        if (!recipe->author || recipe->author != resolved[i]) {
                                 return FALSE;
                         }
                         continue;
                 }
                 else if (g_str_has_prefix (terms[i], "se:")) {
-                        if (!recipe->season || strcmp (recipe->season , terms[i] + 3) != 0) {
+                        if (!recipe->season || recipe->season != resolved[i]) {
                                 return FALSE;
                         }
                         continue;
@@ -841,3 +968,27 @@ gr_recipe_matches (GrRecipe    *recipe,
 
         return TRUE;
 }
+
+/* Sort functions for lists of recipes, usable as GCompareDataFunc */
+int
+gr_recipe_compare_by_name (gconstpointer a,
+                           gconstpointer b,
+                           gpointer      data)
+{
+        GrRecipe *recipe1 = (GrRecipe *)a;
+        GrRecipe *recipe2 = (GrRecipe *)b;
+
+        return g_strcmp0 (recipe1->name, recipe2->name);
+}
+
+/* most recently modified first */
+int
+gr_recipe_compare_by_mtime (gconstpointer a,
+                            gconstpointer b,
+                            gpointer      data)
+{
+        GrRecipe *recipe1 = (GrRecipe *)a;
+        GrRecipe *recipe2 = (GrRecipe *)b;
+
+        return g_date_time_compare (recipe2->mtime, recipe1->mtime);
+}
@@ -24,6 +24,7 @@
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include "gr-diet.h"
 #include "gr-number.h"
+#include "gr-ingredients-list.h"
 
 G_BEGIN_DECLS
 
@@ -32,6 +33,8 @@ G_BEGIN_DECLS
 G_DECLARE_FINAL_TYPE (GrRecipe, gr_recipe, GR, RECIPE, GObject)
 
 GrRecipe       *gr_recipe_new              (void);
+void            gr_recipe_update_from      (GrRecipe   *recipe,
+                                            GrRecipe   *other);
 
 const char     *gr_recipe_get_id           (GrRecipe   *recipe);
 const char     *gr_recipe_get_name         (GrRecipe   *recipe);
@@ -44,6 +47,7 @@ const char     *gr_recipe_get_prep_time    (GrRecipe   *recipe);
 const char     *gr_recipe_get_cook_time    (GrRecipe   *recipe);
 GrDiets         gr_recipe_get_diets        (GrRecipe   *recipe);
 const char     *gr_recipe_get_ingredients  (GrRecipe   *recipe);
+GrIngredientsList *gr_recipe_get_ingredients_list (GrRecipe *recipe);
 const char     *gr_recipe_get_instructions (GrRecipe   *recipe);
 const char     *gr_recipe_get_notes        (GrRecipe   *recipe);
 gboolean        gr_recipe_contains_garlic  (GrRecipe   *recipe);
@@ -64,7 +68,16 @@ const char     *gr_recipe_get_translated_description  (GrRecipe   *recipe);
 const char     *gr_recipe_get_translated_instructions (GrRecipe   *recipe);
 const char     *gr_recipe_get_translated_notes        (GrRecipe   *recipe);
 
+const char    **gr_recipe_resolve_terms    (const char **terms);
 gboolean        gr_recipe_matches          (GrRecipe    *recipe,
-                                            const char **terms);
+                                            const char **terms,
+                                            const char **resolved);
+
+int             gr_recipe_compare_by_name  (gconstpointer a,
+                                            gconstpointer b,
+                                            gpointer      data);
+int             gr_recipe_compare_by_mtime (gconstpointer a,
+                                            gconstpointer b,
+                                            gpointer      data);
 
 G_END_DECLS
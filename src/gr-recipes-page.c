@@ -397,6 +397,36 @@ repopulate_recipes (GrRecipesPage *self)
                 gr_recipes_page_refresh (self);
 }
 
+static gboolean
+any_in_shopping (GrRecipeStore *store,
+                 GPtrArray     *recipes)
+{
+        guint i;
+
+        for (i = 0; i < recipes->len; i++) {
+                if (gr_recipe_store_is_in_shopping (store, g_ptr_array_index (recipes, i)))
+                        return TRUE;
+        }
+
+        return FALSE;
+}
+
+/* Only the shopping tile shows recipes by name; the picks are
+ * taken care of by ::reloaded.
+ */
+static void
+recipes_updated (GrRecipeStore *store,
+                 GPtrArray     *added,
+                 GPtrArray     *changed,
+                 GPtrArray     *removed,
+                 GrRecipesPage *self)
+{
+        if (any_in_shopping (store, added) ||
+            any_in_shopping (store, changed) ||
+            any_in_shopping (store, removed))
+                gr_recipes_page_refresh (self);
+}
+
 static void
 populate_chefs_from_store (GrRecipesPage *self)
 {
@@ -471,8 +501,10 @@ connect_store_signals (GrRecipesPage *page)
         store = gr_recipe_store_get ();
 
         g_signal_connect_swapped (store, "recipe-added", G_CALLBACK (repopulate_recipes), page);
+        g_signal_connect_swapped (store, "recipes-added", G_CALLBACK (repopulate_recipes), page);
         g_signal_connect_swapped (store, "recipe-removed", G_CALLBACK (repopulate_recipes), page);
         g_signal_connect_swapped (store, "recipe-changed", G_CALLBACK (repopulate_recipes), page);
+        g_signal_connect (store, "recipes-updated", G_CALLBACK (recipes_updated), page);
         g_signal_connect_swapped (store, "chefs-changed", G_CALLBACK (refresh_chefs), page);
         g_signal_connect_swapped (store, "reloaded", G_CALLBACK (reloaded), page);
 }
@@ -26,7 +26,7 @@
 #include "gr-search-page.h"
 #include "gr-recipe-store.h"
 #include "gr-recipe.h"
-#include "gr-recipe-tile.h"
+#include "gr-recipe-grid.h"
 #include "gr-utils.h"
 #include "gr-list-page.h"
 #include "gr-settings.h"
@@ -38,6 +38,7 @@ struct _GrSearchPage
 
         GtkWidget *search_stack;
         GtkWidget *flow_box;
+        GCompareDataFunc sort_func;
         int count;
 
         GrRecipeSearch *search;
@@ -61,7 +62,6 @@ static void
 search_started (GrRecipeSearch *search,
                 GrSearchPage   *page)
 {
-        container_remove_all (GTK_CONTAINER (page->flow_box));
         page->count = 0;
 }
 
@@ -70,18 +70,7 @@ search_hits_added (GrRecipeSearch *search,
                    GList          *hits,
                    GrSearchPage   *page)
 {
-        GList *l;
-
-        for (l = hits; l; l = l->next) {
-                GrRecipe *recipe = l->data;
-                GtkWidget *tile;
-
-                tile = gr_recipe_tile_new (recipe);
-                gtk_widget_show (tile);
-                gtk_container_add (GTK_CONTAINER (page->flow_box), tile);
-
-                page->count++;
-        }
+        page->count += g_list_length (hits);
 }
 
 static void
@@ -89,21 +78,7 @@ search_hits_removed (GrRecipeSearch *search,
                      GList          *hits,
                      GrSearchPage   *page)
 {
-        GList *children, *l;
-
-        children = gtk_container_get_children (GTK_CONTAINER (page->flow_box));
-        for (l = children; l; l = l->next) {
-                GtkWidget *item = l->data;
-                GtkWidget *tile;
-                GrRecipe *recipe;
-
-                tile = gtk_bin_get_child (GTK_BIN (item));
-                recipe = gr_recipe_tile_get_recipe (GR_RECIPE_TILE (tile));
-                if (g_list_find (hits, recipe)) {
-                        gtk_container_remove (GTK_CONTAINER (page->flow_box), item);
-                        page->count--;
-                }
-        }
+        page->count -= g_list_length (hits);
 }
 
 static void
@@ -114,50 +89,33 @@ search_finished (GrRecipeSearch *search,
                                           page->count > 0 ? "list" : "empty");
 }
 
-static int
-name_sort_func (GtkFlowBoxChild *child1,
-                GtkFlowBoxChild *child2,
-                gpointer         data)
-{
-        GtkWidget *tile1 = gtk_bin_get_child (GTK_BIN (child1));
-        GtkWidget *tile2 = gtk_bin_get_child (GTK_BIN (child2));
-        GrRecipe *recipe1 = gr_recipe_tile_get_recipe (GR_RECIPE_TILE (tile1));
-        GrRecipe *recipe2 = gr_recipe_tile_get_recipe (GR_RECIPE_TILE (tile2));
-        const char *name1 = gr_recipe_get_name (recipe1);
-        const char *name2 = gr_recipe_get_name (recipe2);
-
-        return strcmp (name1, name2);
-}
-
-static int
-date_sort_func (GtkFlowBoxChild *child1,
-                GtkFlowBoxChild *child2,
-                gpointer         data)
-{
-        GtkWidget *tile1 = gtk_bin_get_child (GTK_BIN (child1));
-        GtkWidget *tile2 = gtk_bin_get_child (GTK_BIN (child2));
-        GrRecipe *recipe1 = gr_recipe_tile_get_recipe (GR_RECIPE_TILE (tile1));
-        GrRecipe *recipe2 = gr_recipe_tile_get_recipe (GR_RECIPE_TILE (tile2));
-        GDateTime *mtime1 = gr_recipe_get_mtime (recipe1);
-        GDateTime *mtime2 = gr_recipe_get_mtime (recipe2);
-
-        return g_date_time_compare (mtime2, mtime1);
-}
-
-static void
-gr_search_page_set_sort (GrSearchPage *page,
-                         GrSortKey   sort)
+static GCompareDataFunc
+get_sort_func (GrSortKey sort)
 {
         switch (sort) {
         case SORT_BY_NAME:
-                gtk_flow_box_set_sort_func (GTK_FLOW_BOX (page->flow_box), name_sort_func, page, NULL);
-                break;
+                return gr_recipe_compare_by_name;
         case SORT_BY_RECENCY:
-                gtk_flow_box_set_sort_func (GTK_FLOW_BOX (page->flow_box), date_sort_func, page, NULL);
-                break;
+                return gr_recipe_compare_by_mtime;
         default:
                 g_assert_not_reached ();
         }
+
+        return gr_recipe_compare_by_name;
+}
+
+static void
+gr_search_page_set_sort (GrSearchPage *page,
+                         GrSortKey     sort)
+{
+        GCompareDataFunc sort_func;
+
+        sort_func = get_sort_func (sort);
+        if (sort_func == page->sort_func)
+                return;
+
+        page->sort_func = sort_func;
+        gr_recipe_search_set_sort_func (page->search, page->sort_func);
 }
 
 static void
@@ -179,7 +137,11 @@ gr_search_page_init (GrSearchPage *page)
         gtk_widget_init_template (GTK_WIDGET (page));
         connect_store_signals (page);
 
+        page->sort_func = get_sort_func (g_settings_get_enum (gr_settings_get (), "sort-key"));
+
         page->search = gr_recipe_search_new ();
+        gr_recipe_search_set_sort_func (page->search, page->sort_func);
+        gr_recipe_grid_set_model (GR_RECIPE_GRID (page->flow_box), G_LIST_MODEL (page->search));
         g_signal_connect (page->search, "started", G_CALLBACK (search_started), page);
         g_signal_connect (page->search, "hits-added", G_CALLBACK (search_hits_added), page);
         g_signal_connect (page->search, "hits-removed", G_CALLBACK (search_hits_removed), page);
@@ -244,10 +206,6 @@ gr_search_page_update_search (GrSearchPage  *page,
 {
         gtk_stack_set_visible_child_name (GTK_STACK (page->search_stack), "list");
 
-        if (terms == NULL || terms[0] == NULL) {
-                container_remove_all (GTK_CONTAINER (page->flow_box));
-        }
-
         gr_recipe_search_set_terms (page->search, terms);
 }
 
@@ -266,6 +224,7 @@ connect_store_signals (GrSearchPage *page)
         store = gr_recipe_store_get ();
 
         g_signal_connect_swapped (store, "recipe-added", G_CALLBACK (search_page_reload), page);
+        g_signal_connect_swapped (store, "recipes-added", G_CALLBACK (search_page_reload), page);
         g_signal_connect_swapped (store, "recipe-removed", G_CALLBACK (search_page_reload), page);
         g_signal_connect_swapped (store, "recipe-changed", G_CALLBACK (search_page_reload), page);
 }
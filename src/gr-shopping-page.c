@@ -36,6 +36,7 @@
 #include "gr-mail.h"
 #include "gr-convert-units.h"
 #include "gr-shopping-list-exporter.h"
+#include "gr-shopping-totals.h"
 
 
 struct _GrShoppingPage
@@ -55,7 +56,8 @@ struct _GrShoppingPage
         GrShoppingListExporter *exporter;
 
         GtkSizeGroup *group;
-        GHashTable *ingredients;
+        GrShoppingTotals *totals;
+        GHashTable *rows;
 
         GrShoppingListPrinter *printer;
 
@@ -81,7 +83,8 @@ shopping_page_finalize (GObject *object)
 
         g_clear_object (&self->search);
         g_clear_object (&self->group);
-        g_clear_pointer (&self->ingredients, g_hash_table_unref);
+        g_clear_object (&self->totals);
+        g_clear_pointer (&self->rows, g_hash_table_unref);
         g_clear_object (&self->printer);
 
         g_free (self->title);
@@ -139,122 +142,7 @@ recount_recipes (GrShoppingPage *page)
         }
 }
 
-typedef struct {
-        double amount;
-        GrUnit unit;
-} Unit;
-
-typedef struct {
-        char *ingredient;
-        GArray *units;
-        gboolean removed;
-} Ingredient;
-
-static Ingredient *
-ingredient_new (const char *ingredient)
-{
-        Ingredient *ing;
-        GrRecipeStore *store;
-
-        store = gr_recipe_store_get ();
-
-        ing = g_new0 (Ingredient, 1);
-        ing->ingredient = g_strdup (ingredient);
-        ing->units = g_array_new (FALSE, TRUE, sizeof (Unit));
-
-        ing->removed = gr_recipe_store_not_shopping_ingredient (store, ingredient);
-
-        return ing;
-}
-
-static void
-ingredient_free (gpointer data)
-{
-        Ingredient *ing = data;
-
-        g_free (ing->ingredient);
-        g_array_free (ing->units, TRUE);
-        g_free (ing);
-}
-
-static void
-ingredient_clear (Ingredient *ing)
-{
-        g_array_set_size (ing->units, 0);
-}
-
-static void
-ingredient_add (Ingredient *ing,
-                double      amount,
-                GrUnit      unit)
-{
-        int i;
-        Unit nu;
-
-        for (i = 0; i < ing->units->len; i++) {
-                Unit *u = &g_array_index (ing->units, Unit, i);
-
-                if (u->unit == unit) {
-                        u->amount += amount;
-                        return;
-                }
-        }
-
-        nu.amount = amount;
-        nu.unit = unit;
-
-        g_array_append_val (ing->units, nu);
-}
-
-static char *
-ingredient_format_unit (Ingredient *ing)
-{
-        g_autoptr(GString) s = NULL;
-        int i;
-        GrPreferredUnit user_volume_unit = gr_convert_get_volume_unit();
-        GrPreferredUnit user_weight_unit = gr_convert_get_weight_unit();
-        GrUnit u1;
-        double a1;
-        GrDimension dimension;
-        s = g_string_new ("");
-
-        for (i = 0; i < ing->units->len; i++) {
-                Unit *unit = &g_array_index (ing->units, Unit, i);
-                double a = unit->amount;
-                GrUnit u = unit->unit;
-
-                dimension = gr_unit_get_dimension (u);
-
-                if (dimension == GR_DIMENSION_VOLUME) {
-                        gr_convert_volume (&a, &u, user_volume_unit);
-                }
-                else if (dimension == GR_DIMENSION_MASS) {
-                        gr_convert_weight (&a, &u, user_weight_unit);
-                }
-
-                if (i == 0) {
-                        u1 = u;
-                        a1 = a;
-                }
-                else if (u == u1) {
-                        a1 += a;
-                }
-                else {
-                        if (s->len > 0)
-                          g_string_append (s, ", ");
-                        gr_convert_format (s, a, u);
-                        g_warning ("conversion yielded different units (%s: %s vs %s)...why...", ing->ingredient, gr_unit_get_name (u), gr_unit_get_name (u1));
-                }
-        }
-
-        if (s->len > 0)
-          g_string_append (s, ", ");
-        gr_convert_format (s, a1, u1);
-
-        return g_strdup (s->str);
-}
-
-static void
+static GtkWidget *
 add_removed_row (GrShoppingPage *page,
                  const char *unit,
                  const char *ing)
@@ -287,6 +175,18 @@ add_removed_row (GrShoppingPage *page,
         g_object_set_data (G_OBJECT (row), "ing", ing_label);
 
         gtk_widget_show (page->add_button);
+
+        return row;
+}
+
+static void
+update_add_button (GrShoppingPage *page)
+{
+        GList *children;
+
+        children = gtk_container_get_children (GTK_CONTAINER (page->removed_list));
+        gtk_widget_set_visible (page->add_button, children != NULL);
+        g_list_free (children);
 }
 
 static void
@@ -294,9 +194,8 @@ remove_ingredient (GtkButton *button, GrShoppingPage *page)
 {
         GtkWidget *row;
         GtkWidget *label;
-        const char *name;
-        const char *unit;
-        Ingredient *ing;
+        g_autofree char *name = NULL;
+        g_autofree char *unit = NULL;
         GrRecipeStore *store;
 
         store = gr_recipe_store_get ();
@@ -304,24 +203,22 @@ remove_ingredient (GtkButton *button, GrShoppingPage *page)
         row = gtk_widget_get_ancestor (GTK_WIDGET (button), GTK_TYPE_LIST_BOX_ROW);
 
         label = GTK_WIDGET (g_object_get_data (G_OBJECT (row), "ing"));
-        name = gtk_label_get_label (GTK_LABEL (label));
+        name = g_strdup (gtk_label_get_label (GTK_LABEL (label)));
         label = GTK_WIDGET (g_object_get_data (G_OBJECT (row), "unit"));
-        unit = gtk_label_get_label (GTK_LABEL (label));
-
-        ing = (Ingredient *)g_hash_table_lookup (page->ingredients, name);
-        ing->removed = TRUE;
+        unit = g_strdup (gtk_label_get_label (GTK_LABEL (label)));
 
         gr_recipe_store_remove_shopping_ingredient (store, name);
 
-        add_removed_row (page, unit, name);
-
         page->active_row = NULL;
         gtk_widget_destroy (row);
 
+        row = add_removed_row (page, unit, name);
+        g_hash_table_insert (page->rows, g_strdup (name), row);
+
         recount_ingredients (page);
 }
 
-static void
+static GtkWidget *
 add_ingredient_row (GrShoppingPage *page,
                     const char *unit,
                     const char *ing)
@@ -377,6 +274,8 @@ add_ingredient_row (GrShoppingPage *page,
         g_object_set_data (G_OBJECT (row), "unit", unit_label);
         g_object_set_data (G_OBJECT (row), "ing", ing_label);
         g_object_set_data (G_OBJECT (row), "buttons-stack", stack);
+
+        return row;
 }
 
 static void
@@ -418,11 +317,10 @@ removed_row_activated (GtkListBox     *list,
 {
         GtkWidget *popover;
         GtkWidget *label;
-        const char *name;
-        const char *unit;
-        Ingredient *ing;
+        GtkWidget *new_row;
+        g_autofree char *name = NULL;
+        g_autofree char *unit = NULL;
         GrRecipeStore *store;
-        GList *children;
 
         store = gr_recipe_store_get ();
 
@@ -430,111 +328,64 @@ removed_row_activated (GtkListBox     *list,
         gtk_popover_popdown (GTK_POPOVER (popover));
 
         label = GTK_WIDGET (g_object_get_data (G_OBJECT (row), "ing"));
-        name = gtk_label_get_label (GTK_LABEL (label));
+        name = g_strdup (gtk_label_get_label (GTK_LABEL (label)));
         label = GTK_WIDGET (g_object_get_data (G_OBJECT (row), "unit"));
-        unit = gtk_label_get_label (GTK_LABEL (label));
-
-        ing = (Ingredient *)g_hash_table_lookup (page->ingredients, name);
-        ing->removed = FALSE;
+        unit = g_strdup (gtk_label_get_label (GTK_LABEL (label)));
 
         gr_recipe_store_readd_shopping_ingredient (store, name);
 
-        add_ingredient_row (page, unit, name);
-
         gtk_widget_destroy (GTK_WIDGET (row));
 
-        recount_ingredients (page);
+        new_row = add_ingredient_row (page, unit, name);
+        g_hash_table_insert (page->rows, g_strdup (name), new_row);
 
-        children = gtk_container_get_children (GTK_CONTAINER (page->removed_list));
-        if (children == NULL)
-                gtk_widget_hide (page->add_button);
-        g_list_free (children);
+        recount_ingredients (page);
+        update_add_button (page);
 }
 
+/* Only the row of an ingredient whose total changed is touched;
+ * rows are created and destroyed as ingredients come and go.
+ */
 static void
-add_ingredient (GrShoppingPage *page,
-                double      amount,
-                GrUnit      unit,
-                const char *ingredient)
+ingredient_changed (GrShoppingTotals *totals,
+                    const char       *ingredient,
+                    GrShoppingPage   *page)
 {
-        Ingredient *ing;
-
-        ing = g_hash_table_lookup (page->ingredients, ingredient);
-        if (ing == NULL) {
-                ing = ingredient_new (ingredient);
-                g_hash_table_insert (page->ingredients, g_strdup (ingredient), ing);
-        }
+        GtkWidget *row;
+        g_autofree char *unit = NULL;
 
-        ingredient_add (ing, amount, unit);
-}
+        row = g_hash_table_lookup (page->rows, ingredient);
 
-static void
-collect_ingredients_from_recipe (GrShoppingPage *page,
-                                 GrRecipe       *recipe,
-                                 double          yield)
-{
-        g_autoptr(GrIngredientsList) il = NULL;
-        g_autofree char **seg = NULL;
-        int i, j;
-
-        il = gr_ingredients_list_new (gr_recipe_get_ingredients (recipe));
-        seg = gr_ingredients_list_get_segments (il);
-        for (i = 0; seg[i]; i++) {
-                g_auto(GStrv) ing = NULL;
-                ing = gr_ingredients_list_get_ingredients (il, seg[i]);
-                for (j = 0; ing[j]; j++) {
-                        GrUnit unit;
-                        double amount;
-
-                        amount = gr_ingredients_list_get_amount (il, seg[i], ing[j]);
-                        amount = amount * yield / gr_recipe_get_yield (recipe);
-                        unit = gr_ingredients_list_get_unit (il, seg[i], ing[j]);
-                        add_ingredient (page, amount, unit, ing[j]);
+        if (!gr_shopping_totals_has_ingredient (totals, ingredient)) {
+                if (row) {
+                        if (page->active_row == row)
+                                page->active_row = NULL;
+                        gtk_widget_destroy (row);
+                        g_hash_table_remove (page->rows, ingredient);
+                        update_add_button (page);
                 }
-        }
-}
-
-static void
-collect_ingredients (GrShoppingPage *page)
-{
-        GList *children, *l;
-        GHashTableIter iter;
-        Ingredient *ing;
-
-        g_hash_table_iter_init (&iter, page->ingredients);
-        while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&ing)) {
-                ingredient_clear (ing);
+                return;
         }
 
-        children = gtk_container_get_children (GTK_CONTAINER (page->recipe_list));
+        unit = gr_shopping_totals_format_amount (totals, ingredient);
 
-        for (l = children; l; l = l->next) {
-                GtkWidget *tile = gtk_bin_get_child (GTK_BIN (l->data));
-                GrRecipe *recipe;
-                double yield;
+        if (row) {
+                GtkWidget *label;
 
-                recipe = gr_shopping_tile_get_recipe (GR_SHOPPING_TILE (tile));
-                yield = gr_shopping_tile_get_yield (GR_SHOPPING_TILE (tile));
-                collect_ingredients_from_recipe (page, recipe, yield);
+                label = GTK_WIDGET (g_object_get_data (G_OBJECT (row), "unit"));
+                gtk_label_set_label (GTK_LABEL (label), unit);
         }
-        g_list_free (children);
+        else {
+                GrRecipeStore *store;
 
-        g_hash_table_iter_init (&iter, page->ingredients);
-        while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&ing)) {
-                if (ing->units->len == 0)
-                        g_hash_table_iter_remove (&iter);
-        }
+                store = gr_recipe_store_get ();
 
-        container_remove_all (GTK_CONTAINER (page->ingredients_list));
-        container_remove_all (GTK_CONTAINER (page->removed_list));
-        g_hash_table_iter_init (&iter, page->ingredients);
-        while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&ing)) {
-                g_autofree char *unit = NULL;
-                unit = ingredient_format_unit (ing);
-                if (ing->removed)
-                        add_removed_row (page, unit, ing->ingredient);
+                if (gr_recipe_store_not_shopping_ingredient (store, ingredient))
+                        row = add_removed_row (page, unit, ingredient);
                 else
-                        add_ingredient_row (page, unit, ing->ingredient);
+                        row = add_ingredient_row (page, unit, ingredient);
+
+                g_hash_table_insert (page->rows, g_strdup (ingredient), row);
         }
 }
 
@@ -559,6 +410,7 @@ search_started (GrRecipeSearch *search,
                 GrShoppingPage *page)
 {
         container_remove_all (GTK_CONTAINER (page->recipe_list));
+        gr_shopping_totals_clear (page->totals);
         page->recipe_count = 0;
 }
 
@@ -581,6 +433,7 @@ search_hits_added (GrRecipeSearch *search,
                 tile = gr_shopping_tile_new (recipe, yield);
                 g_signal_connect (tile, "notify::yield", G_CALLBACK (yield_changed), page);
                 gtk_container_add (GTK_CONTAINER (page->recipe_list), tile);
+                gr_shopping_totals_set_recipe (page->totals, recipe, yield);
                 page->recipe_count++;
         }
 }
@@ -601,6 +454,7 @@ search_hits_removed (GrRecipeSearch *search,
                 tile = gtk_bin_get_child (GTK_BIN (item));
                 recipe = gr_shopping_tile_get_recipe (GR_SHOPPING_TILE (tile));
                 if (g_list_find (hits, recipe)) {
+                        gr_shopping_totals_remove_recipe (page->totals, recipe);
                         gtk_container_remove (GTK_CONTAINER (page->recipe_list), item);
                         page->recipe_count--;
                 }
@@ -611,7 +465,6 @@ static void
 search_finished (GrRecipeSearch *search,
                  GrShoppingPage *page)
 {
-        collect_ingredients (page);
         recount_ingredients (page);
         recount_recipes (page);
 }
@@ -624,13 +477,14 @@ clear_list (GrShoppingPage *page)
 
         store = gr_recipe_store_get ();
 
+        gr_shopping_totals_clear (page->totals);
+
         container_remove_all (GTK_CONTAINER (page->ingredients_list));
         container_remove_all (GTK_CONTAINER (page->removed_list));
         container_remove_all (GTK_CONTAINER (page->recipe_list));
 
         gr_recipe_store_clear_shopping_list (store);
 
-        g_hash_table_remove_all (page->ingredients);
         gtk_widget_hide (page->add_button);
 
         window = gtk_widget_get_ancestor (GTK_WIDGET (page), GTK_TYPE_APPLICATION_WINDOW);
@@ -738,7 +592,9 @@ gr_shopping_page_init (GrShoppingPage *page)
         g_signal_connect (page->search, "finished", G_CALLBACK (search_finished), page);
 
         page->group = gtk_size_group_new (GTK_SIZE_GROUP_HORIZONTAL);
-        page->ingredients = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, ingredient_free);
+        page->rows = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+        page->totals = gr_shopping_totals_new ();
+        g_signal_connect (page->totals, "ingredient-changed", G_CALLBACK (ingredient_changed), page);
 }
 
 static void
@@ -823,6 +679,7 @@ gr_shopping_page_new (void)
 void
 gr_shopping_page_populate (GrShoppingPage *self)
 {
+        gr_shopping_totals_clear (self->totals);
         container_remove_all (GTK_CONTAINER (self->ingredients_list));
         container_remove_all (GTK_CONTAINER (self->removed_list));
         container_remove_all (GTK_CONTAINER (self->recipe_list));
@@ -843,7 +700,7 @@ recipe_removed (GrShoppingPage *page,
                 if (recipe == gr_shopping_tile_get_recipe (GR_SHOPPING_TILE (tile))) {
                         gtk_widget_destroy (GTK_WIDGET (l->data));
 
-                        collect_ingredients (page);
+                        gr_shopping_totals_remove_recipe (page->totals, recipe);
                         recount_ingredients (page);
                         recount_recipes (page);
 
@@ -887,7 +744,7 @@ recipe_added (GrShoppingPage *page,
                 gtk_container_add (GTK_CONTAINER (page->recipe_list), tile);
         }
 
-        collect_ingredients (page);
+        gr_shopping_totals_set_recipe (page->totals, recipe, yield);
         recount_ingredients (page);
         recount_recipes (page);
 }
@@ -909,6 +766,21 @@ recipe_changed (GrShoppingPage *page,
                 recipe_removed (page, recipe);
 }
 
+static void
+recipes_updated (GrRecipeStore  *store,
+                 GPtrArray      *added,
+                 GPtrArray      *changed,
+                 GPtrArray      *removed,
+                 GrShoppingPage *page)
+{
+        int i;
+
+        for (i = 0; i < removed->len; i++)
+                recipe_removed (page, g_ptr_array_index (removed, i));
+        for (i = 0; i < changed->len; i++)
+                recipe_changed (page, g_ptr_array_index (changed, i));
+}
+
 static void
 connect_store_signals (GrShoppingPage *page)
 {
@@ -918,4 +790,5 @@ connect_store_signals (GrShoppingPage *page)
 
         g_signal_connect_swapped (store, "recipe-removed", G_CALLBACK (recipe_removed), page);
         g_signal_connect_swapped (store, "recipe-changed", G_CALLBACK (recipe_changed), page);
+        g_signal_connect (store, "recipes-updated", G_CALLBACK (recipes_updated), page);
 }
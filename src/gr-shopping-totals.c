@@ -0,0 +1,328 @@
+/* gr-shopping-totals.c:
+ *
+ * Copyright (C) 2017 Matthias Clasen <mclasen@redhat.com>
+ *
+ * Licensed under the GNU General Public License Version 3
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <glib/gi18n.h>
+
+#include "gr-shopping-totals.h"
+#include "gr-ingredients-list.h"
+#include "gr-convert-units.h"
+#include "gr-unit.h"
+
+/* GrShoppingTotals keeps the running totals of the ingredients
+ * needed for the recipes on the shopping list.
+ *
+ * For every recipe, we remember the parsed ingredients and the
+ * scale that were used to compute its contribution. Changing the
+ * yield of a recipe, or adding or removing one, subtracts the old
+ * contribution and adds the new one, and ::ingredient-changed is
+ * emitted once for each ingredient whose total changed.
+ *
+ * Amounts are accumulated in the base unit of their dimension
+ * (milliliters for volumes, grams for masses), so each ingredient
+ * has at most one total per dimension. Converting to the units the
+ * user prefers only happens when the total is formatted.
+ */
+
+typedef struct {
+        GrUnit unit; /* a base unit, see gr_convert_to_base_unit() */
+        double amount;
+        int count;
+} Total;
+
+typedef struct {
+        GrIngredientsList *ingredients;
+        double scale;
+} Contribution;
+
+struct _GrShoppingTotals
+{
+        GObject parent_instance;
+
+        GHashTable *items;
+        GHashTable *recipes;
+};
+
+G_DEFINE_TYPE (GrShoppingTotals, gr_shopping_totals, G_TYPE_OBJECT)
+
+enum {
+        INGREDIENT_CHANGED,
+        N_SIGNALS
+};
+
+static guint signals[N_SIGNALS];
+
+static void
+contribution_free (gpointer data)
+{
+        Contribution *c = data;
+
+        g_object_unref (c->ingredients);
+        g_free (c);
+}
+
+static void
+add_total (GrShoppingTotals *self,
+           const char       *name,
+           GrUnit            unit,
+           double            amount)
+{
+        GArray *totals;
+        Total t;
+        int i;
+
+        gr_convert_to_base_unit (&amount, &unit);
+
+        totals = g_hash_table_lookup (self->items, name);
+        if (totals == NULL) {
+                totals = g_array_new (FALSE, FALSE, sizeof (Total));
+                g_hash_table_insert (self->items, g_strdup (name), totals);
+        }
+
+        for (i = 0; i < totals->len; i++) {
+                Total *total = &g_array_index (totals, Total, i);
+
+                if (total->unit == unit) {
+                        total->amount += amount;
+                        total->count++;
+                        return;
+                }
+        }
+
+        t.unit = unit;
+        t.amount = amount;
+        t.count = 1;
+        g_array_append_val (totals, t);
+}
+
+static void
+subtract_total (GrShoppingTotals *self,
+                const char       *name,
+                GrUnit            unit,
+                double            amount)
+{
+        GArray *totals;
+        int i;
+
+        gr_convert_to_base_unit (&amount, &unit);
+
+        totals = g_hash_table_lookup (self->items, name);
+        if (totals == NULL)
+                return;
+
+        for (i = 0; i < totals->len; i++) {
+                Total *total = &g_array_index (totals, Total, i);
+
+                if (total->unit == unit) {
+                        total->amount -= amount;
+                        total->count--;
+
+                        /* Drop totals once nothing contributes, rather
+                         * than keeping rounding errors around.
+                         */
+                        if (total->count == 0)
+                                g_array_remove_index (totals, i);
+                        break;
+                }
+        }
+
+        if (totals->len == 0)
+                g_hash_table_remove (self->items, name);
+}
+
+static void
+apply_contribution (GrShoppingTotals *self,
+                    Contribution     *c,
+                    gboolean          add,
+                    GHashTable       *changed)
+{
+        GrIngredientsListIter iter;
+        const char *name;
+        double amount;
+        GrUnit unit;
+
+        gr_ingredients_list_iter_init (&iter, c->ingredients, NULL);
+        while (gr_ingredients_list_iter_next (&iter, NULL, &name, &amount, &unit)) {
+                if (add)
+                        add_total (self, name, unit, amount * c->scale);
+                else
+                        subtract_total (self, name, unit, amount * c->scale);
+
+                g_hash_table_add (changed, g_strdup (name));
+        }
+}
+
+static void
+emit_changed (GrShoppingTotals *self,
+              GHashTable       *changed)
+{
+        GHashTableIter iter;
+        const char *name;
+
+        g_hash_table_iter_init (&iter, changed);
+        while (g_hash_table_iter_next (&iter, (gpointer *)&name, NULL))
+                g_signal_emit (self, signals[INGREDIENT_CHANGED], 0, name);
+}
+
+static void
+shopping_totals_finalize (GObject *object)
+{
+        GrShoppingTotals *self = GR_SHOPPING_TOTALS (object);
+
+        g_hash_table_unref (self->items);
+        g_hash_table_unref (self->recipes);
+
+        G_OBJECT_CLASS (gr_shopping_totals_parent_class)->finalize (object);
+}
+
+static void
+gr_shopping_totals_init (GrShoppingTotals *self)
+{
+        self->items = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_array_unref);
+        self->recipes = g_hash_table_new_full (NULL, NULL, g_object_unref, contribution_free);
+}
+
+static void
+gr_shopping_totals_class_init (GrShoppingTotalsClass *klass)
+{
+        GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+        object_class->finalize = shopping_totals_finalize;
+
+        /**
+         * GrShoppingTotals::ingredient-changed:
+         *
+         * Gets emitted when the total amount of an ingredient changes,
+         * including when it is added or when the last recipe needing
+         * it is removed.
+         */
+        signals[INGREDIENT_CHANGED] =
+                g_signal_new ("ingredient-changed",
+                              G_TYPE_FROM_CLASS (klass),
+                              G_SIGNAL_RUN_LAST,
+                              0,
+                              NULL, NULL,
+                              NULL,
+                              G_TYPE_NONE, 1,
+                              G_TYPE_STRING);
+}
+
+GrShoppingTotals *
+gr_shopping_totals_new (void)
+{
+        return g_object_new (GR_TYPE_SHOPPING_TOTALS, NULL);
+}
+
+void
+gr_shopping_totals_set_recipe (GrShoppingTotals *self,
+                               GrRecipe         *recipe,
+                               double            yield)
+{
+        g_autoptr(GHashTable) changed = NULL;
+        Contribution *c;
+
+        changed = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+        c = g_hash_table_lookup (self->recipes, recipe);
+        if (c) {
+                apply_contribution (self, c, FALSE, changed);
+                g_hash_table_remove (self->recipes, recipe);
+        }
+
+        c = g_new (Contribution, 1);
+        c->ingredients = g_object_ref (gr_recipe_get_ingredients_list (recipe));
+        c->scale = yield / gr_recipe_get_yield (recipe);
+        g_hash_table_insert (self->recipes, g_object_ref (recipe), c);
+
+        apply_contribution (self, c, TRUE, changed);
+
+        emit_changed (self, changed);
+}
+
+void
+gr_shopping_totals_remove_recipe (GrShoppingTotals *self,
+                                  GrRecipe         *recipe)
+{
+        g_autoptr(GHashTable) changed = NULL;
+        Contribution *c;
+
+        c = g_hash_table_lookup (self->recipes, recipe);
+        if (c == NULL)
+                return;
+
+        changed = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+        apply_contribution (self, c, FALSE, changed);
+        g_hash_table_remove (self->recipes, recipe);
+
+        emit_changed (self, changed);
+}
+
+void
+gr_shopping_totals_clear (GrShoppingTotals *self)
+{
+        g_autoptr(GHashTable) changed = NULL;
+        GHashTableIter iter;
+        const char *name;
+
+        changed = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+        g_hash_table_iter_init (&iter, self->items);
+        while (g_hash_table_iter_next (&iter, (gpointer *)&name, NULL))
+                g_hash_table_add (changed, g_strdup (name));
+
+        g_hash_table_remove_all (self->items);
+        g_hash_table_remove_all (self->recipes);
+
+        emit_changed (self, changed);
+}
+
+gboolean
+gr_shopping_totals_has_ingredient (GrShoppingTotals *self,
+                                   const char       *ingredient)
+{
+        return g_hash_table_contains (self->items, ingredient);
+}
+
+char *
+gr_shopping_totals_format_amount (GrShoppingTotals *self,
+                                  const char       *ingredient)
+{
+        g_autoptr(GString) s = NULL;
+        GArray *totals;
+        int i;
+
+        totals = g_hash_table_lookup (self->items, ingredient);
+        if (totals == NULL)
+                return NULL;
+
+        s = g_string_new ("");
+
+        for (i = 0; i < totals->len; i++) {
+                Total *total = &g_array_index (totals, Total, i);
+
+                if (s->len > 0)
+                        g_string_append (s, ", ");
+                gr_convert_format (s, total->amount, total->unit);
+        }
+
+        return g_strdup (s->str);
+}
@@ -0,0 +1,47 @@
+/* gr-shopping-totals.h:
+ *
+ * Copyright (C) 2017 Matthias Clasen <mclasen@redhat.com>
+ *
+ * Licensed under the GNU General Public License Version 3
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <glib-object.h>
+
+#include "gr-recipe.h"
+
+G_BEGIN_DECLS
+
+#define GR_TYPE_SHOPPING_TOTALS (gr_shopping_totals_get_type ())
+
+G_DECLARE_FINAL_TYPE (GrShoppingTotals, gr_shopping_totals, GR, SHOPPING_TOTALS, GObject)
+
+GrShoppingTotals *gr_shopping_totals_new             (void);
+
+void              gr_shopping_totals_set_recipe      (GrShoppingTotals *totals,
+                                                      GrRecipe         *recipe,
+                                                      double            yield);
+void              gr_shopping_totals_remove_recipe   (GrShoppingTotals *totals,
+                                                      GrRecipe         *recipe);
+void              gr_shopping_totals_clear           (GrShoppingTotals *totals);
+
+gboolean          gr_shopping_totals_has_ingredient  (GrShoppingTotals *totals,
+                                                      const char       *ingredient);
+char             *gr_shopping_totals_format_amount   (GrShoppingTotals *totals,
+                                                      const char       *ingredient);
+
+G_END_DECLS
@@ -0,0 +1,741 @@
+/* gr-tar.c
+ *
+ * Copyright (C) 2017 Matthias Clasen <mclasen@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "gr-tar.h"
+#include "gr-utils.h"
+
+/* A minimal writer for ustar archives, which is all we need for
+ * exported recipes: regular files and directories, with short
+ * relative names. The archive is written to @out as it is built,
+ * so wrapping @out in a GZlibCompressor gives a .tar.gz without
+ * staging anything on disk.
+ */
+
+#define BLOCK_SIZE 512
+
+static gboolean
+write_header (GOutputStream  *out,
+              const char     *name,
+              char            type,
+              goffset         size,
+              gint64          mtime,
+              GCancellable   *cancellable,
+              GError        **error)
+{
+        char header[BLOCK_SIZE] = { 0, };
+        gsize length;
+        guint checksum;
+        int i;
+
+        length = strlen (name);
+        if (length > 100) {
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_FILENAME,
+                             _("Name too long for the archive: %s"), name);
+                return FALSE;
+        }
+
+        memcpy (header, name, length);
+        g_snprintf (header + 100, 8, "%07o", type == '5' ? 0755 : 0644);
+        g_snprintf (header + 108, 8, "%07o", 0);
+        g_snprintf (header + 116, 8, "%07o", 0);
+        g_snprintf (header + 124, 12, "%011" G_GINT64_MODIFIER "o", (gint64)size);
+        g_snprintf (header + 136, 12, "%011" G_GINT64_MODIFIER "o", mtime);
+        header[156] = type;
+        memcpy (header + 257, "ustar", 6);
+        memcpy (header + 263, "00", 2);
+
+        /* The checksum is computed with the checksum field set to spaces */
+        memset (header + 148, ' ', 8);
+        checksum = 0;
+        for (i = 0; i < BLOCK_SIZE; i++)
+                checksum += (guchar)header[i];
+        g_snprintf (header + 148, 7, "%06o", checksum);
+
+        return g_output_stream_write_all (out, header, BLOCK_SIZE, NULL, cancellable, error);
+}
+
+static gboolean
+write_padding (GOutputStream  *out,
+               goffset         size,
+               GCancellable   *cancellable,
+               GError        **error)
+{
+        static const char zeros[BLOCK_SIZE] = { 0, };
+        gsize padding;
+
+        padding = (BLOCK_SIZE - size % BLOCK_SIZE) % BLOCK_SIZE;
+        if (padding == 0)
+                return TRUE;
+
+        return g_output_stream_write_all (out, zeros, padding, NULL, cancellable, error);
+}
+
+gboolean
+gr_tar_write_directory (GOutputStream  *out,
+                        const char     *name,
+                        GCancellable   *cancellable,
+                        GError        **error)
+{
+        g_autofree char *dirname = NULL;
+
+        dirname = g_str_has_suffix (name, "/") ? g_strdup (name) : g_strconcat (name, "/", NULL);
+
+        return write_header (out, dirname, '5', 0, g_get_real_time () / G_USEC_PER_SEC, cancellable, error);
+}
+
+gboolean
+gr_tar_write_data (GOutputStream  *out,
+                   const char     *name,
+                   const char     *data,
+                   gsize           length,
+                   GCancellable   *cancellable,
+                   GError        **error)
+{
+        return write_header (out, name, '0', length, g_get_real_time () / G_USEC_PER_SEC, cancellable, error) &&
+               g_output_stream_write_all (out, data, length, NULL, cancellable, error) &&
+               write_padding (out, length, cancellable, error);
+}
+
+gboolean
+gr_tar_write_file (GOutputStream  *out,
+                   const char     *name,
+                   GFile          *file,
+                   GCancellable   *cancellable,
+                   GError        **error)
+{
+        g_autoptr(GFileInfo) info = NULL;
+        g_autoptr(GFileInputStream) in = NULL;
+        goffset size;
+        gssize written;
+
+        info = g_file_query_info (file,
+                                  G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+                                  G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                  G_FILE_QUERY_INFO_NONE,
+                                  cancellable,
+                                  error);
+        if (!info)
+                return FALSE;
+
+        in = g_file_read (file, cancellable, error);
+        if (!in)
+                return FALSE;
+
+        size = g_file_info_get_size (info);
+
+        if (!write_header (out, name, '0', size,
+                           g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED),
+                           cancellable, error))
+                return FALSE;
+
+        written = g_output_stream_splice (out, G_INPUT_STREAM (in),
+                                          G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE,
+                                          cancellable, error);
+        if (written < 0)
+                return FALSE;
+
+        /* The header already promised a size, we can't go back */
+        if (written != size) {
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                             _("File changed while being archived: %s"), name);
+                return FALSE;
+        }
+
+        return write_padding (out, size, cancellable, error);
+}
+
+gboolean
+gr_tar_write_end (GOutputStream  *out,
+                  GCancellable   *cancellable,
+                  GError        **error)
+{
+        static const char zeros[2 * BLOCK_SIZE] = { 0, };
+
+        return g_output_stream_write_all (out, zeros, sizeof (zeros), NULL, cancellable, error);
+}
+
+/* The reading side extracts an archive into a directory while it is
+ * being received: the caller feeds it data in chunks of any size, as
+ * they arrive. While a file has the same size as the one already on
+ * disk, its data is just compared with what is there. Only from the
+ * first difference on is it written to a temporary file next to its
+ * destination, which is moved into place at the end. So extracting
+ * the same archive again does not write or change anything.
+ * Entries that are larger than we would ever ship are rejected.
+ *
+ * Besides plain ustar, this understands the GNU and pax ways of
+ * storing long names. Links and other special entries are skipped.
+ * The long names are the only entries kept in memory.
+ */
+
+#define MAX_ENTRY_SIZE (256 * 1024 * 1024)
+#define MAX_HEADER_ENTRY_SIZE (64 * 1024)
+#define COMPARE_BUFFER_SIZE 8192
+
+struct _GrTarReader
+{
+        char *dir;
+
+        char header[BLOCK_SIZE];
+        gsize header_length;
+
+        gboolean in_entry;
+        char type;
+        char *name;
+        char *long_name;
+        guint64 remaining;
+        guint64 padding;
+        GByteArray *contents;
+
+        char *path;
+        char *tmp_path;
+        int fd;
+        int existing_fd;
+        guint64 size;
+
+        gboolean done;
+        guint n_changed;
+};
+
+GrTarReader *
+gr_tar_reader_new (const char *dir)
+{
+        GrTarReader *reader;
+
+        reader = g_new0 (GrTarReader, 1);
+        reader->dir = g_strdup (dir);
+        reader->contents = g_byte_array_new ();
+        reader->fd = -1;
+        reader->existing_fd = -1;
+
+        return reader;
+}
+
+static void
+discard_file (GrTarReader *reader)
+{
+        if (reader->fd != -1) {
+                close (reader->fd);
+                reader->fd = -1;
+        }
+        if (reader->existing_fd != -1) {
+                close (reader->existing_fd);
+                reader->existing_fd = -1;
+        }
+        if (reader->tmp_path)
+                g_unlink (reader->tmp_path);
+
+        g_clear_pointer (&reader->path, g_free);
+        g_clear_pointer (&reader->tmp_path, g_free);
+}
+
+void
+gr_tar_reader_free (GrTarReader *reader)
+{
+        discard_file (reader);
+        g_free (reader->dir);
+        g_free (reader->name);
+        g_free (reader->long_name);
+        g_byte_array_unref (reader->contents);
+        g_free (reader);
+}
+
+guint
+gr_tar_reader_get_n_changed (GrTarReader *reader)
+{
+        return reader->n_changed;
+}
+
+static gboolean
+parse_octal (const char *field,
+             gsize       length,
+             guint64    *value)
+{
+        guint64 v = 0;
+        gsize i = 0;
+
+        while (i < length && field[i] == ' ')
+                i++;
+
+        for (; i < length && field[i] >= '0' && field[i] <= '7'; i++)
+                v = v * 8 + (field[i] - '0');
+
+        if (i < length && field[i] != '\0' && field[i] != ' ')
+                return FALSE;
+
+        *value = v;
+
+        return TRUE;
+}
+
+static gboolean
+is_zero_block (const char *block)
+{
+        int i;
+
+        for (i = 0; i < BLOCK_SIZE; i++) {
+                if (block[i] != 0)
+                        return FALSE;
+        }
+
+        return TRUE;
+}
+
+static void
+set_extract_error (GrTarReader  *reader,
+                   int           errsv,
+                   GError      **error)
+{
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                     _("Failed to extract %s: %s"), reader->path, g_strerror (errsv));
+}
+
+static gboolean
+open_tmp_file (GrTarReader  *reader,
+               GError      **error)
+{
+        reader->tmp_path = g_strconcat (reader->path, ".XXXXXX", NULL);
+        reader->fd = g_mkstemp (reader->tmp_path);
+        if (reader->fd == -1) {
+                set_extract_error (reader, errno, error);
+                g_clear_pointer (&reader->tmp_path, g_free);
+                return FALSE;
+        }
+
+        return TRUE;
+}
+
+/* Decides where the data of a regular file entry goes. Entries we
+ * don't extract leave reader->path unset, and their data is skipped.
+ */
+static gboolean
+start_file (GrTarReader  *reader,
+            const char   *name,
+            char          type,
+            guint64       size,
+            GError      **error)
+{
+        g_autofree char *relative = NULL;
+        g_autofree char *path = NULL;
+        g_autofree char *dir = NULL;
+        GStatBuf buf;
+
+        relative = sanitize_relative_path (name);
+        if (relative == NULL) {
+                g_warning ("Not extracting %s from archive", name);
+                return TRUE;
+        }
+
+        path = g_build_filename (reader->dir, relative, NULL);
+
+        if (type == '5') {
+                g_mkdir_with_parents (path, 0755);
+                return TRUE;
+        }
+
+        if (type != '0' && type != '\0') {
+                g_debug ("Skipping %s (type %c) in archive", name, type);
+                return TRUE;
+        }
+
+        dir = g_path_get_dirname (path);
+        g_mkdir_with_parents (dir, 0755);
+
+        reader->path = g_steal_pointer (&path);
+        reader->size = 0;
+
+        /* Only a file of the same size can turn out to be unchanged */
+        if (g_stat (reader->path, &buf) == 0 &&
+            S_ISREG (buf.st_mode) && buf.st_size == size)
+                reader->existing_fd = g_open (reader->path, O_RDONLY, 0);
+
+        if (reader->existing_fd == -1 && !open_tmp_file (reader, error)) {
+                discard_file (reader);
+                return FALSE;
+        }
+
+        return TRUE;
+}
+
+static gboolean
+write_all (GrTarReader  *reader,
+           const char   *data,
+           gsize         length,
+           GError      **error)
+{
+        while (length > 0) {
+                gssize written;
+
+                written = write (reader->fd, data, length);
+                if (written < 0) {
+                        if (errno == EINTR)
+                                continue;
+
+                        set_extract_error (reader, errno, error);
+                        return FALSE;
+                }
+
+                data += written;
+                length -= written;
+        }
+
+        return TRUE;
+}
+
+static gboolean
+same_as_existing (GrTarReader *reader,
+                  const char  *data,
+                  gsize        length)
+{
+        char buffer[COMPARE_BUFFER_SIZE];
+
+        while (length > 0) {
+                gssize n;
+
+                n = read (reader->existing_fd, buffer, MIN (length, sizeof (buffer)));
+                if (n < 0 && errno == EINTR)
+                        continue;
+
+                if (n <= 0 || memcmp (buffer, data, n) != 0)
+                        return FALSE;
+
+                data += n;
+                length -= n;
+        }
+
+        return TRUE;
+}
+
+/* The data stopped matching the existing file, so start a temporary
+ * file with the part that did match, and write the rest there.
+ */
+static gboolean
+spill_file (GrTarReader  *reader,
+            GError      **error)
+{
+        char buffer[COMPARE_BUFFER_SIZE];
+        guint64 remaining;
+
+        if (!open_tmp_file (reader, error))
+                return FALSE;
+
+        if (lseek (reader->existing_fd, 0, SEEK_SET) == -1) {
+                set_extract_error (reader, errno, error);
+                return FALSE;
+        }
+
+        for (remaining = reader->size; remaining > 0; ) {
+                gssize n;
+
+                n = read (reader->existing_fd, buffer, MIN (remaining, sizeof (buffer)));
+                if (n < 0 && errno == EINTR)
+                        continue;
+
+                if (n < 0) {
+                        set_extract_error (reader, errno, error);
+                        return FALSE;
+                }
+
+                if (n == 0) {
+                        set_extract_error (reader, EIO, error);
+                        return FALSE;
+                }
+
+                if (!write_all (reader, buffer, n, error))
+                        return FALSE;
+
+                remaining -= n;
+        }
+
+        close (reader->existing_fd);
+        reader->existing_fd = -1;
+
+        return TRUE;
+}
+
+static gboolean
+write_file_data (GrTarReader  *reader,
+                 const char   *data,
+                 gsize         length,
+                 GError      **error)
+{
+        if (reader->existing_fd != -1) {
+                if (same_as_existing (reader, data, length)) {
+                        reader->size += length;
+                        return TRUE;
+                }
+
+                if (!spill_file (reader, error)) {
+                        discard_file (reader);
+                        return FALSE;
+                }
+        }
+
+        if (!write_all (reader, data, length, error)) {
+                discard_file (reader);
+                return FALSE;
+        }
+
+        reader->size += length;
+
+        return TRUE;
+}
+
+static gboolean
+finish_file (GrTarReader  *reader,
+             GError      **error)
+{
+        if (reader->path == NULL)
+                return TRUE;
+
+        /* Every byte matched the file we already have */
+        if (reader->fd == -1) {
+                g_debug ("%s is unchanged", reader->path);
+                discard_file (reader);
+                return TRUE;
+        }
+
+        if (close (reader->fd) != 0) {
+                reader->fd = -1;
+                set_extract_error (reader, errno, error);
+                discard_file (reader);
+                return FALSE;
+        }
+        reader->fd = -1;
+
+        g_debug ("Extracting %s", reader->path);
+
+        if (g_rename (reader->tmp_path, reader->path) != 0) {
+                set_extract_error (reader, errno, error);
+                discard_file (reader);
+                return FALSE;
+        }
+
+        g_clear_pointer (&reader->tmp_path, g_free);
+        discard_file (reader);
+
+        reader->n_changed++;
+
+        return TRUE;
+}
+
+static gboolean
+is_header_entry (char type)
+{
+        return type == 'L' || type == 'x' || type == 'g';
+}
+
+/* Extended headers consist of records like "30 path=some/long/name\n" */
+static char *
+parse_pax_path (const char *data,
+                gsize       length)
+{
+        const char *p = data;
+        const char *end = data + length;
+
+        while (p < end) {
+                const char *record = p;
+                const char *key;
+                const char *eq;
+                guint64 record_length = 0;
+
+                while (p < end && g_ascii_isdigit (*p))
+                        record_length = record_length * 10 + (*p++ - '0');
+
+                if (p >= end || *p != ' ' || record_length == 0 || record_length > end - record)
+                        return NULL;
+
+                key = p + 1;
+                p = record + record_length;
+
+                eq = memchr (key, '=', p - key);
+                if (eq == NULL)
+                        return NULL;
+
+                if (eq - key == 4 && strncmp (key, "path", 4) == 0)
+                        return g_strndup (eq + 1, p - eq - 2);
+        }
+
+        return NULL;
+}
+
+static gboolean
+finish_entry (GrTarReader  *reader,
+              GError      **error)
+{
+        const char *data = (const char *)reader->contents->data;
+        gsize length = reader->contents->len;
+        gboolean ret = TRUE;
+
+        reader->in_entry = FALSE;
+
+        switch (reader->type) {
+        case 'L': /* GNU long name for the next entry */
+                g_free (reader->long_name);
+                reader->long_name = g_strndup (data, length);
+                break;
+
+        case 'x': /* pax extended header for the next entry */
+                g_free (reader->long_name);
+                reader->long_name = parse_pax_path (data, length);
+                break;
+
+        case 'g': /* pax global header */
+                break;
+
+        default:
+                ret = finish_file (reader, error);
+                break;
+        }
+
+        g_clear_pointer (&reader->name, g_free);
+        g_byte_array_set_size (reader->contents, 0);
+
+        return ret;
+}
+
+static gboolean
+parse_header (GrTarReader  *reader,
+              GError      **error)
+{
+        const char *header = reader->header;
+        guint64 checksum;
+        guint64 size;
+        guint sum;
+        int i;
+
+        if (is_zero_block (header)) {
+                reader->done = TRUE;
+                return TRUE;
+        }
+
+        sum = 0;
+        for (i = 0; i < BLOCK_SIZE; i++)
+                sum += (i >= 148 && i < 156) ? ' ' : (guchar)header[i];
+
+        if (!parse_octal (header + 148, 8, &checksum) || checksum != sum ||
+            !parse_octal (header + 124, 12, &size)) {
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                             _("Invalid archive header"));
+                return FALSE;
+        }
+
+        reader->name = g_strndup (header, 100);
+        if (memcmp (header + 257, "ustar", 5) == 0 && header[345] != '\0') {
+                g_autofree char *prefix = g_strndup (header + 345, 155);
+                char *name = g_strconcat (prefix, "/", reader->name, NULL);
+
+                g_free (reader->name);
+                reader->name = name;
+        }
+
+        reader->type = header[156];
+
+        if (size > (is_header_entry (reader->type) ? MAX_HEADER_ENTRY_SIZE : MAX_ENTRY_SIZE)) {
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                             _("Archive entry %s is too large"), reader->name);
+                return FALSE;
+        }
+
+        reader->in_entry = TRUE;
+        reader->remaining = size;
+        reader->padding = (BLOCK_SIZE - size % BLOCK_SIZE) % BLOCK_SIZE;
+
+        if (!is_header_entry (reader->type)) {
+                gboolean ret;
+
+                ret = start_file (reader,
+                                  reader->long_name ? reader->long_name : reader->name,
+                                  reader->type, size, error);
+                g_clear_pointer (&reader->long_name, g_free);
+                if (!ret)
+                        return FALSE;
+        }
+
+        if (size == 0)
+                return finish_entry (reader, error);
+
+        return TRUE;
+}
+
+gboolean
+gr_tar_reader_feed (GrTarReader  *reader,
+                    const char   *data,
+                    gsize         length,
+                    GError      **error)
+{
+        while (length > 0 && !reader->done) {
+                gsize n;
+
+                if (reader->in_entry) {
+                        n = MIN (reader->remaining, length);
+                        if (is_header_entry (reader->type))
+                                g_byte_array_append (reader->contents, (const guint8 *)data, n);
+                        else if (reader->path != NULL && !write_file_data (reader, data, n, error))
+                                return FALSE;
+                        reader->remaining -= n;
+
+                        if (reader->remaining == 0 && !finish_entry (reader, error))
+                                return FALSE;
+                }
+                else if (reader->padding > 0) {
+                        n = MIN (reader->padding, length);
+                        reader->padding -= n;
+                }
+                else {
+                        n = MIN (BLOCK_SIZE - reader->header_length, length);
+                        memcpy (reader->header + reader->header_length, data, n);
+                        reader->header_length += n;
+
+                        if (reader->header_length == BLOCK_SIZE) {
+                                reader->header_length = 0;
+                                if (!parse_header (reader, error))
+                                        return FALSE;
+                        }
+                }
+
+                data += n;
+                length -= n;
+        }
+
+        return TRUE;
+}
+
+gboolean
+gr_tar_reader_finish (GrTarReader  *reader,
+                      GError      **error)
+{
+        if (reader->in_entry || reader->header_length > 0) {
+                g_set_error (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+                             _("The archive is truncated"));
+                return FALSE;
+        }
+
+        return TRUE;
+}
@@ -0,0 +1,58 @@
+/* gr-tar.h
+ *
+ * Copyright (C) 2017 Matthias Clasen <mclasen@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+gboolean gr_tar_write_directory (GOutputStream  *out,
+                                 const char     *name,
+                                 GCancellable   *cancellable,
+                                 GError        **error);
+gboolean gr_tar_write_data      (GOutputStream  *out,
+                                 const char     *name,
+                                 const char     *data,
+                                 gsize           length,
+                                 GCancellable   *cancellable,
+                                 GError        **error);
+gboolean gr_tar_write_file      (GOutputStream  *out,
+                                 const char     *name,
+                                 GFile          *file,
+                                 GCancellable   *cancellable,
+                                 GError        **error);
+gboolean gr_tar_write_end       (GOutputStream  *out,
+                                 GCancellable   *cancellable,
+                                 GError        **error);
+
+typedef struct _GrTarReader GrTarReader;
+
+GrTarReader *gr_tar_reader_new           (const char   *dir);
+void         gr_tar_reader_free          (GrTarReader  *reader);
+gboolean     gr_tar_reader_feed          (GrTarReader  *reader,
+                                          const char   *data,
+                                          gsize         length,
+                                          GError      **error);
+gboolean     gr_tar_reader_finish        (GrTarReader  *reader,
+                                          GError      **error);
+guint        gr_tar_reader_get_n_changed (GrTarReader  *reader);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GrTarReader, gr_tar_reader_free)
+
+G_END_DECLS
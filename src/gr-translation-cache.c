@@ -0,0 +1,245 @@
+/* gr-translation-cache.c
+ *
+ * Copyright (C) 2017 Matthias Clasen <mclasen@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "gr-translation-cache.h"
+
+/* Translating recipe text means a gettext lookup for every line,
+ * and searching needs the casefolded translation. For the shipped
+ * and downloaded data, the results are the same every time, so we
+ * keep them in a file per locale and reuse them on the next start.
+ *
+ * The file is a GVariant of type (sa{ss}a{ss}): a version string,
+ * then the maps from original to translated and from translated to
+ * casefolded strings. The version is made up of the application
+ * version (for the translation catalogs), the locale and a checksum
+ * of the recipe db contents, so new data starts over with an empty
+ * cache, while merely touching the file does not.
+ *
+ * Only text of readonly recipes and chefs belongs in the cache; the
+ * user's own text has no translations and should not be copied
+ * around. Callers mark the stretches where the cache applies with
+ * gr_translation_cache_set_active(), which is per thread, since
+ * lookups and inserts happen from the threads that parse the
+ * recipe dbs.
+ */
+
+#define CACHE_FORMAT "(sa{ss}a{ss})"
+
+static GMutex lock;
+static char *cache_path;
+static char *cache_version;
+static GHashTable *tables[2];
+static gboolean dirty;
+static GPrivate active;
+
+static char *
+get_data_version (const char *data_path,
+                  const char *locale)
+{
+        g_autoptr(GMappedFile) mapped = NULL;
+        g_autofree char *checksum = NULL;
+
+        mapped = g_mapped_file_new (data_path, FALSE, NULL);
+        if (!mapped)
+                return NULL;
+
+        checksum = g_compute_checksum_for_data (G_CHECKSUM_SHA256,
+                                                (const guchar *)g_mapped_file_get_contents (mapped),
+                                                g_mapped_file_get_length (mapped));
+
+        return g_strdup_printf ("%s %s %s", PACKAGE_VERSION, locale, checksum);
+}
+
+static void
+load_table (GHashTable *table,
+            GVariant   *dict)
+{
+        GVariantIter iter;
+        char *key;
+        char *value;
+
+        g_variant_iter_init (&iter, dict);
+        while (g_variant_iter_next (&iter, "{ss}", &key, &value))
+                g_hash_table_insert (table, key, value);
+}
+
+static void
+load_file (void)
+{
+        g_autoptr(GMappedFile) mapped = NULL;
+        g_autoptr(GBytes) bytes = NULL;
+        g_autoptr(GVariant) variant = NULL;
+        g_autoptr(GVariant) translated = NULL;
+        g_autoptr(GVariant) casefolded = NULL;
+        g_autoptr(GError) error = NULL;
+        const char *version;
+
+        mapped = g_mapped_file_new (cache_path, FALSE, &error);
+        if (!mapped) {
+                g_debug ("No translation cache: %s", error->message);
+                return;
+        }
+
+        bytes = g_mapped_file_get_bytes (mapped);
+        variant = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (CACHE_FORMAT), bytes, FALSE));
+
+        g_variant_get (variant, "(&s@a{ss}@a{ss})", &version, &translated, &casefolded);
+        if (strcmp (version, cache_version) != 0) {
+                g_debug ("Translation cache %s is outdated", cache_path);
+                return;
+        }
+
+        load_table (tables[GR_TRANSLATION_CACHE_TRANSLATED], translated);
+        load_table (tables[GR_TRANSLATION_CACHE_CASEFOLDED], casefolded);
+
+        g_debug ("Loaded %d translations from %s",
+                 g_hash_table_size (tables[GR_TRANSLATION_CACHE_TRANSLATED]), cache_path);
+}
+
+/* Starts using the cache for the recipe db at @data_path, replacing
+ * whatever was cached before. If there is no such db, nothing is
+ * cached.
+ */
+void
+gr_translation_cache_load (const char *cache_dir,
+                           const char *data_path)
+{
+        const char *locale;
+        g_autofree char *filename = NULL;
+        int i;
+
+        locale = g_get_language_names ()[0];
+        filename = g_strconcat ("translations-", locale, ".cache", NULL);
+
+        g_mutex_lock (&lock);
+
+        g_clear_pointer (&cache_path, g_free);
+        g_clear_pointer (&cache_version, g_free);
+        for (i = 0; i < G_N_ELEMENTS (tables); i++)
+                g_clear_pointer (&tables[i], g_hash_table_unref);
+        dirty = FALSE;
+
+        cache_version = get_data_version (data_path, locale);
+        if (cache_version) {
+                cache_path = g_build_filename (cache_dir, filename, NULL);
+                for (i = 0; i < G_N_ELEMENTS (tables); i++)
+                        tables[i] = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+                load_file ();
+        }
+
+        g_mutex_unlock (&lock);
+}
+
+static GVariant *
+build_table (GHashTable *table)
+{
+        GVariantBuilder builder;
+        GHashTableIter iter;
+        const char *key;
+        const char *value;
+
+        g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{ss}"));
+        g_hash_table_iter_init (&iter, table);
+        while (g_hash_table_iter_next (&iter, (gpointer *)&key, (gpointer *)&value))
+                g_variant_builder_add (&builder, "{ss}", key, value);
+
+        return g_variant_builder_end (&builder);
+}
+
+/* Writes the cache out, if anything was added since it was loaded. */
+void
+gr_translation_cache_save (void)
+{
+        g_autoptr(GVariant) variant = NULL;
+        g_autoptr(GError) error = NULL;
+
+        g_mutex_lock (&lock);
+
+        if (!dirty)
+                goto out;
+
+        variant = g_variant_ref_sink (g_variant_new ("(s@a{ss}@a{ss})",
+                                                     cache_version,
+                                                     build_table (tables[GR_TRANSLATION_CACHE_TRANSLATED]),
+                                                     build_table (tables[GR_TRANSLATION_CACHE_CASEFOLDED])));
+
+        if (!g_file_set_contents (cache_path,
+                                  g_variant_get_data (variant),
+                                  g_variant_get_size (variant),
+                                  &error)) {
+                g_warning ("Failed to save translation cache: %s", error->message);
+                goto out;
+        }
+
+        g_debug ("Saved %d translations to %s",
+                 g_hash_table_size (tables[GR_TRANSLATION_CACHE_TRANSLATED]), cache_path);
+        dirty = FALSE;
+
+out:
+        g_mutex_unlock (&lock);
+}
+
+/* Turns the cache on or off for the calling thread. It is off
+ * unless turned on.
+ */
+void
+gr_translation_cache_set_active (gboolean is_active)
+{
+        g_private_set (&active, GINT_TO_POINTER (is_active));
+}
+
+char *
+gr_translation_cache_lookup (GrTranslationCacheKind  kind,
+                             const char             *string)
+{
+        char *result = NULL;
+
+        if (!g_private_get (&active))
+                return NULL;
+
+        g_mutex_lock (&lock);
+
+        if (tables[kind])
+                result = g_strdup (g_hash_table_lookup (tables[kind], string));
+
+        g_mutex_unlock (&lock);
+
+        return result;
+}
+
+void
+gr_translation_cache_insert (GrTranslationCacheKind  kind,
+                             const char             *string,
+                             const char             *result)
+{
+        if (!g_private_get (&active))
+                return;
+
+        g_mutex_lock (&lock);
+
+        if (tables[kind] && !g_hash_table_contains (tables[kind], string)) {
+                g_hash_table_insert (tables[kind], g_strdup (string), g_strdup (result));
+                dirty = TRUE;
+        }
+
+        g_mutex_unlock (&lock);
+}
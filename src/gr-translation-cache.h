@@ -0,0 +1,41 @@
+/* gr-translation-cache.h
+ *
+ * Copyright (C) 2017 Matthias Clasen <mclasen@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum {
+        GR_TRANSLATION_CACHE_TRANSLATED,
+        GR_TRANSLATION_CACHE_CASEFOLDED
+} GrTranslationCacheKind;
+
+void     gr_translation_cache_load       (const char             *cache_dir,
+                                         const char             *data_path);
+void     gr_translation_cache_save       (void);
+void     gr_translation_cache_set_active (gboolean                is_active);
+
+char    *gr_translation_cache_lookup     (GrTranslationCacheKind  kind,
+                                         const char             *string);
+void     gr_translation_cache_insert     (GrTranslationCacheKind  kind,
+                                         const char             *string,
+                                         const char             *result);
+
+G_END_DECLS
@@ -39,6 +39,7 @@
          const char *plural;
  } GrUnitData;
  
+ /* Indexed by GrUnit */
  static GrUnitData units[] = {
          { GR_UNIT_UNKNOWN,     GR_DIMENSION_NONE,      "",        "",                                "",                       "" },
          { GR_UNIT_NONE,        GR_DIMENSION_NONE,      "",        "",                                "",                       "" },
@@ -46,12 +47,11 @@
          { GR_UNIT_GRAM,        GR_DIMENSION_MASS,     "g",       NC_("unit abbreviation", "g"),     NC_("unit name", "gram"), NC_("unit plural", "grams") },
          { GR_UNIT_KILOGRAM,    GR_DIMENSION_MASS,     "kg",      NC_("unit abbreviation", "kg"),    NC_("unit name", "kilogram"), NC_("unit plural", "kilograms") },
          { GR_UNIT_POUND,       GR_DIMENSION_MASS,     "lb",      NC_("unit abbreviation", "lb"),    NC_("unit name", "pound"), NC_("unit plural", "pounds") },
-         { GR_UNIT_OUNCE,       GR_DIMENSION_VOLUME,   "oz",      NC_("unit abbreviation", "oz"),    NC_("unit name", "ounce"), NC_("unit plural", "ounces") },
+         { GR_UNIT_OUNCE,       GR_DIMENSION_MASS,     "oz",      NC_("unit abbreviation", "oz"),    NC_("unit name", "ounce"), NC_("unit plural", "ounces") },
          { GR_UNIT_LITER,       GR_DIMENSION_VOLUME,   "l",       NC_("unit abbreviation", "l"),     NC_("unit name", "liter"), NC_("unit plural", "liters") },
          { GR_UNIT_DECILITER,   GR_DIMENSION_VOLUME,   "dl",      NC_("unit abbreviation", "dl"),    NC_("unit name", "deciliter"), NC_("unit plural", "deciliters") },
          { GR_UNIT_MILLILITER,  GR_DIMENSION_VOLUME,   "ml",      NC_("unit abbreviation", "ml"),    NC_("unit name", "milliliter"), NC_("unit plural", "milliliters") },
          { GR_UNIT_FLUID_OUNCE, GR_DIMENSION_VOLUME,   "fl oz",   NC_("unit abbreviation", "fl oz"), NC_("unit name", "fluid ounce"), NC_("unit plural", "fluid ounces") },
-         { GR_UNIT_FLUID_OUNCE, GR_DIMENSION_VOLUME,   "fl. oz.", NC_("unit abbreviation", "fl oz"), NC_("unit name", "fluid ounce"), NC_("unit plural", "fluid ounces") },
          { GR_UNIT_PINT,        GR_DIMENSION_VOLUME,   "pt",      NC_("unit abbreviation", "pt"),    NC_("unit name", "pint"), NC_("unit plural", "pints") },
          { GR_UNIT_QUART,       GR_DIMENSION_VOLUME,   "qt",      NC_("unit abbreviation", "qt"),    NC_("unit name", "quart"), NC_("unit plural", "quarts") },
          { GR_UNIT_GALLON,      GR_DIMENSION_VOLUME,   "gal",     NC_("unit abbreviation", "gal"),   NC_("unit name", "gallon"), NC_("unit plural", "gallons") },
@@ -69,6 +69,13 @@
          { GR_UNIT_BUNCH,       GR_DIMENSION_DISCRETE, "bunch",   NC_("unit abbreviation", "bunch"), NC_("unit name", "bunch"), NC_("unit plural", "bunches") },
  };
  
+ G_STATIC_ASSERT (G_N_ELEMENTS (units) == GR_LAST_UNIT + 1);
+ 
+ /* Alternative spellings that are only accepted when parsing */
+ static GrUnitData aliases[] = {
+         { GR_UNIT_FLUID_OUNCE, GR_DIMENSION_VOLUME,   "fl. oz.", NC_("unit abbreviation", "fl oz"), NC_("unit name", "fluid ounce"), NC_("unit plural", "fluid ounces") },
+ };
+ 
  const char **
  gr_unit_get_names (void)
  {
@@ -78,12 +85,10 @@
  static GrUnitData *
  find_unit (GrUnit unit)
  {
-         int i;
-         for (i = 0; i < G_N_ELEMENTS (units); i++) {
-                 if (units[i].unit == unit)
-                         return &(units[i]);
-         }
-         return NULL;
+         if (unit < 0 || unit > GR_LAST_UNIT)
+                 return NULL;
+ 
+         return &(units[unit]);
  }
  
  const char *
@@ -163,6 +168,14 @@
                  }
          }
  
+         for (i = 0; i < G_N_ELEMENTS (aliases); i++) {
+                 nu = aliases[i].name;
+                 if (g_str_has_prefix (*input, nu) && space_or_nul ((*input)[strlen (nu)])) {
+                         *input += strlen (nu);
+                         return aliases[i].unit;
+                 }
+         }
+ 
          g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
                       _("I don’t know this unit: %s"), *input);
  
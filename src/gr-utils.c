@@ -37,6 +37,7 @@
 #endif
 
 #include "gr-utils.h"
+#include "gr-translation-cache.h"
 
 /* load image to fit in width x height while preserving
  * aspect ratio, filling seams with transparency
@@ -221,6 +222,67 @@ date_time_from_string (const char *string)
         return NULL;
 }
 
+static gboolean
+get_key_file_date_time (GKeyFile    *keyfile,
+                        const char  *group,
+                        const char  *key,
+                        GDateTime  **dt,
+                        GError     **error)
+{
+        g_autofree char *tmp = NULL;
+        GError *local_error = NULL;
+
+        *dt = NULL;
+
+        tmp = g_key_file_get_string (keyfile, group, key, &local_error);
+        if (local_error) {
+                if (g_error_matches (local_error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND)) {
+                        g_error_free (local_error);
+                        return TRUE;
+                }
+                g_propagate_error (error, local_error);
+                return FALSE;
+        }
+
+        *dt = date_time_from_string (tmp);
+        if (*dt == NULL) {
+                g_set_error (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+                             "Couldn't parse %s key", key);
+                return FALSE;
+        }
+
+        return TRUE;
+}
+
+/* Missing timestamps get stable fallbacks rather than the current
+ * time, so that loading the same data twice gives equal results
+ * and reloads don't report untouched recipes as changed.
+ */
+gboolean
+get_recipe_timestamps (GKeyFile    *keyfile,
+                       const char  *group,
+                       GDateTime  **ctime,
+                       GDateTime  **mtime,
+                       GError     **error)
+{
+        g_autoptr(GDateTime) created = NULL;
+        g_autoptr(GDateTime) modified = NULL;
+
+        if (!get_key_file_date_time (keyfile, group, "Created", &created, error) ||
+            !get_key_file_date_time (keyfile, group, "Modified", &modified, error))
+                return FALSE;
+
+        if (modified == NULL)
+                modified = created ? g_date_time_ref (created) : g_date_time_new_from_unix_utc (0);
+        if (created == NULL)
+                created = g_date_time_ref (modified);
+
+        *ctime = g_steal_pointer (&created);
+        *mtime = g_steal_pointer (&modified);
+
+        return TRUE;
+}
+
 gboolean
 skip_whitespace (char **input)
 {
@@ -247,9 +309,15 @@ translate_multiline_string (const char *s)
         int i;
         GString *out;
 
+        char *result;
+
         if (s == NULL)
                 return NULL;
 
+        result = gr_translation_cache_lookup (GR_TRANSLATION_CACHE_TRANSLATED, s);
+        if (result)
+                return result;
+
         out = g_string_new ("");
 
         strv = g_strsplit (s, "\n", -1);
@@ -261,9 +329,26 @@ translate_multiline_string (const char *s)
                         g_string_append (out, g_dgettext (GETTEXT_PACKAGE "-data", strv[i]));
        }
 
+        gr_translation_cache_insert (GR_TRANSLATION_CACHE_TRANSLATED, s, out->str);
+
         return g_string_free (out, FALSE);
 }
 
+char *
+casefold_string (const char *s)
+{
+        char *result;
+
+        result = gr_translation_cache_lookup (GR_TRANSLATION_CACHE_CASEFOLDED, s);
+        if (result)
+                return result;
+
+        result = g_utf8_casefold (s, -1);
+        gr_translation_cache_insert (GR_TRANSLATION_CACHE_CASEFOLDED, s, result);
+
+        return result;
+}
+
 char *
 generate_id (const char *first_string, ...)
 {
@@ -297,6 +382,22 @@ generate_id (const char *first_string, ...)
         return g_string_free (str, FALSE);
 }
 
+/* Returns the interned copy of @string, or %NULL if @string
+ * has never been interned. Unlike g_intern_string(), this
+ * does not add @string to the table.
+ */
+const char *
+lookup_interned_string (const char *string)
+{
+        GQuark quark;
+
+        quark = g_quark_try_string (string);
+        if (quark == 0)
+                return NULL;
+
+        return g_quark_to_string (quark);
+}
+
 static gint64 start_time;
 
 void
@@ -629,9 +730,138 @@ rotate_image (const char *path,
         return g_strdup (imported);
 }
 
+/* Images from imported recipes are stored under the hash of their
+ * contents, so that importing the same image again, or the same
+ * image in several recipes, only stores it once. The file name is
+ * the hex SHA-256 of the contents, followed by the original extension.
+ */
+#define CONTENT_HASH_LENGTH 64
+
+gboolean
+is_content_addressed (const char *path)
+{
+        g_autofree char *basename = NULL;
+        int i;
+
+        basename = g_path_get_basename (path);
+
+        for (i = 0; i < CONTENT_HASH_LENGTH; i++) {
+                if (!g_ascii_isxdigit (basename[i]) || g_ascii_isupper (basename[i]))
+                        return FALSE;
+        }
+
+        return basename[i] == '\0' || basename[i] == '.';
+}
+
+/* Returns the SHA-256 of the contents of @path, in hex */
+char *
+get_file_checksum (const char  *path,
+                   GError     **error)
+{
+        g_autoptr(GFile) file = NULL;
+        g_autoptr(GFileInputStream) in = NULL;
+        g_autoptr(GChecksum) checksum = NULL;
+        guchar buffer[64 * 1024];
+        gssize size;
+
+        file = g_file_new_for_path (path);
+        in = g_file_read (file, NULL, error);
+        if (!in)
+                return NULL;
+
+        checksum = g_checksum_new (G_CHECKSUM_SHA256);
+        while ((size = g_input_stream_read (G_INPUT_STREAM (in), buffer, sizeof (buffer), NULL, error)) > 0)
+                g_checksum_update (checksum, buffer, size);
+
+        if (size < 0)
+                return NULL;
+
+        return g_strdup (g_checksum_get_string (checksum));
+}
+
+char *
+get_content_addressed_name (const char  *path,
+                            GError     **error)
+{
+        g_autofree char *checksum = NULL;
+        g_autofree char *basename = NULL;
+        const char *ext;
+
+        checksum = get_file_checksum (path, error);
+        if (!checksum)
+                return NULL;
+
+        basename = g_path_get_basename (path);
+        ext = strrchr (basename, '.');
+
+        return g_strconcat (checksum, ext, NULL);
+}
+
+void
+update_file_timestamp (const char *path)
+{
+        g_autoptr(GFile) file = NULL;
+        g_autoptr(GDateTime) now = NULL;
+        guint64 mtime;
+
+        now = g_date_time_new_now_utc ();
+        mtime = (guint64)g_date_time_to_unix (now);
+
+        file = g_file_new_for_path (path);
+        g_file_set_attribute_uint64 (file, G_FILE_ATTRIBUTE_TIME_MODIFIED, mtime, 0, NULL, NULL);
+        g_debug ("updating timestamp for %s", path);
+}
+
+/* Returns @path without empty and "." components, or NULL if it is
+ * absolute or contains "..". Used for paths that come from the
+ * network or from archives, before they are used relative to one
+ * of our directories.
+ */
+char *
+sanitize_relative_path (const char *path)
+{
+        g_auto(GStrv) parts = NULL;
+        GString *s;
+        int i;
+
+        if (g_path_is_absolute (path))
+                return NULL;
+
+        parts = g_strsplit (path, "/", -1);
+        s = g_string_new ("");
+        for (i = 0; parts[i]; i++) {
+                if (parts[i][0] == '\0' || strcmp (parts[i], ".") == 0)
+                        continue;
+
+                if (strcmp (parts[i], "..") == 0) {
+                        g_string_free (s, TRUE);
+                        return NULL;
+                }
+
+                if (s->len > 0)
+                        g_string_append_c (s, G_DIR_SEPARATOR);
+                g_string_append (s, parts[i]);
+        }
+
+        if (s->len == 0) {
+                g_string_free (s, TRUE);
+                return NULL;
+        }
+
+        return g_string_free (s, FALSE);
+}
+
 void
 remove_image (const char *path)
 {
+        /* Other recipes may use the same image, the recipe
+         * store removes it once nothing refers to it anymore
+         */
+        if (is_content_addressed (path)) {
+                g_debug ("Not removing shared image %s", path);
+                return;
+        }
+
         if (g_str_has_prefix (path, get_user_data_dir ())) {
                 g_debug ("Removing image %s", path);
                 g_remove (path);
@@ -46,13 +46,22 @@ char      * date_time_to_string   (GDateTime *dt);
 GDateTime * date_time_from_string (const char *string);
 char      * format_date_time_difference (GDateTime *end, GDateTime *start);
 
+gboolean get_recipe_timestamps (GKeyFile    *keyfile,
+                                const char  *group,
+                                GDateTime  **ctime,
+                                GDateTime  **mtime,
+                                GError     **error);
+
 gboolean skip_whitespace (char **input);
 gboolean space_or_nul    (char p);
 
 char *translate_multiline_string (const char *s);
+char *casefold_string            (const char *s);
 
 char *generate_id (const char *s, ...);
 
+const char *lookup_interned_string (const char *string);
+
 void start_recording (void);
 void stop_recording (void);
 void record_step (const char *blurb);
@@ -78,6 +87,16 @@ char *rotate_image (const char *path,
                     int         angle);
 void  remove_image (const char *path);
 
+gboolean is_content_addressed       (const char  *path);
+char    *get_file_checksum          (const char  *path,
+                                     GError     **error);
+char    *get_content_addressed_name (const char  *path,
+                                     GError     **error);
+
+char *sanitize_relative_path (const char *path);
+
+void update_file_timestamp (const char *path);
+
 void strv_remove (char       ***strv_in,
                   const char   *s);
 void strv_prepend (char       ***strv_in,
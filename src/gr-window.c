@@ -103,6 +103,9 @@ struct _GrWindow
         GtkWidget *export_done_revealer;
         guint export_done_timeout_id;
 
+        GtkWidget *export_progress_revealer;
+        GtkWidget *export_progress_bar;
+
         GObject *file_chooser;
         GrRecipeImporter *importer;
         GrRecipeExporter *exporter;
@@ -581,7 +584,11 @@ gr_window_finalize (GObject *object)
         g_queue_free_full (self->back_entry_stack, (GDestroyNotify)back_entry_free);
 
         g_clear_object (&self->importer);
-        g_clear_object (&self->exporter);
+        if (self->exporter) {
+                g_signal_handlers_disconnect_by_data (self->exporter, self);
+                gr_recipe_exporter_cancel (self->exporter);
+                g_clear_object (&self->exporter);
+        }
 
         g_clear_object (&self->undo_recipe);
         if (self->undo_timeout_id) {
@@ -895,6 +902,15 @@ close_export_done (GrWindow *window)
     gtk_revealer_set_reveal_child (GTK_REVEALER (window->export_done_revealer), FALSE);
 }
 
+static void
+cancel_export (GrWindow *window)
+{
+        if (window->exporter)
+                gr_recipe_exporter_cancel (window->exporter);
+
+        gtk_revealer_set_reveal_child (GTK_REVEALER (window->export_progress_revealer), FALSE);
+}
+
 static gboolean
 export_done_timeout (gpointer data)
 {
@@ -997,6 +1013,8 @@ gr_window_class_init (GrWindowClass *klass)
         gtk_widget_class_bind_template_child (widget_class, GrWindow, shopping_added_revealer);
         gtk_widget_class_bind_template_child (widget_class, GrWindow, shopping_done_revealer);
         gtk_widget_class_bind_template_child (widget_class, GrWindow, export_done_revealer);
+        gtk_widget_class_bind_template_child (widget_class, GrWindow, export_progress_revealer);
+        gtk_widget_class_bind_template_child (widget_class, GrWindow, export_progress_bar);
         gtk_widget_class_bind_template_child (widget_class, GrWindow, sort_by_label);
         gtk_widget_class_bind_template_child (widget_class, GrWindow, sort_by_name_button);
         gtk_widget_class_bind_template_child (widget_class, GrWindow, sort_by_recency_button);
@@ -1028,6 +1046,7 @@ gr_window_class_init (GrWindowClass *klass)
         gtk_widget_class_bind_template_callback (widget_class, make_save_sensitive);
         gtk_widget_class_bind_template_callback (widget_class, sort_clicked);
         gtk_widget_class_bind_template_callback (widget_class, close_export_done);
+        gtk_widget_class_bind_template_callback (widget_class, cancel_export);
 }
 
 static GtkClipboard *
@@ -1225,14 +1244,28 @@ gr_window_load_recipe (GrWindow *window,
         gtk_native_dialog_show (GTK_NATIVE_DIALOG (window->file_chooser));
 }
 
+static void
+export_progress (GrRecipeExporter *exporter,
+                 double            fraction,
+                 GrWindow         *window)
+{
+        gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (window->export_progress_bar), fraction);
+}
+
 static void
 export_done (GrRecipeExporter *exporter,
              GFile            *file,
-             GtkWidget        *window)
+             GrWindow         *window)
 {
         GtkWidget *dialog;
         g_autofree char *path = NULL;
 
+        gtk_revealer_set_reveal_child (GTK_REVEALER (window->export_progress_revealer), FALSE);
+
+        /* Failed or cancelled */
+        if (file == NULL)
+                return;
+
         path = g_file_get_path (file);
         dialog = gtk_message_dialog_new (GTK_WINDOW (window),
                                          GTK_DIALOG_MODAL|GTK_DIALOG_DESTROY_WITH_PARENT,
@@ -1250,8 +1283,12 @@ do_export (GrWindow *window,
         if (!window->exporter) {
                 window->exporter = gr_recipe_exporter_new (GTK_WINDOW (window));
                 g_signal_connect (window->exporter, "done", G_CALLBACK (export_done), window);
+                g_signal_connect (window->exporter, "progress", G_CALLBACK (export_progress), window);
         }
 
+        gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (window->export_progress_bar), 0.0);
+        gtk_revealer_set_reveal_child (GTK_REVEALER (window->export_progress_revealer), TRUE);
+
         gr_recipe_exporter_export_all (window->exporter, file);
 }
 
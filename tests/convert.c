@@ -0,0 +1,467 @@
+/* convert.c
+ *
+ * Copyright (C) 2017 Matthias Clasen <mclasen@redhat.com#}#>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more &details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include <locale.h>
+#include <math.h>
+#include <glib.h>
+#include "gr-unit.h"
+#include "gr-convert-units.h"
+#include "gr-convert-units.c"
+#include "gr-settings.c"
+
+/* The branch-based conversions that the tables in gr-convert-units.c
+ * replaced, kept here to check that the results did not change.
+ */
+
+static void
+reference_convert_volume (double *amount, GrUnit *unit, GrPreferredUnit user_volume_unit)
+{
+        double amount1 = *amount;
+        GrUnit unit1 = *unit;
+
+        if (user_volume_unit == GR_PREFERRED_UNIT_IMPERIAL) {
+                switch (unit1) {
+                case GR_UNIT_MILLILITER:
+                        amount1 = amount1 / 4.92892;
+                        unit1 = GR_UNIT_TEASPOON;
+                        break;
+
+                case GR_UNIT_DECILITER:
+                        amount1 = amount1 * 20.2884;
+                        unit1 = GR_UNIT_TEASPOON;
+                        break;
+
+                case GR_UNIT_LITER:
+                        amount1 = amount1 * 202.884;
+                        unit1 = GR_UNIT_TEASPOON;
+                        break;
+
+                case GR_UNIT_TEASPOON:
+                        amount1 = amount1;
+                        unit1 = GR_UNIT_TEASPOON;
+                        break;
+
+                case GR_UNIT_TABLESPOON:
+                        amount1 = amount1 * 3;
+                        unit1 = GR_UNIT_TEASPOON;
+                        break;
+
+                case GR_UNIT_CUP:
+                        amount1 = amount1 * 48;
+                        unit1 = GR_UNIT_TEASPOON;
+                        break;
+
+                case GR_UNIT_PINT:
+                        amount1 = amount1 * 96;
+                        unit1 = GR_UNIT_TEASPOON;
+                        break;
+
+                case GR_UNIT_QUART:
+                        amount1 = amount1 * 192;
+                        unit1 = GR_UNIT_TEASPOON;
+                        break;
+
+                case GR_UNIT_GALLON:
+                        amount1 = amount1 * 768;
+                        unit1 = GR_UNIT_TEASPOON;
+                        break;
+
+                case GR_UNIT_FLUID_OUNCE:
+                        amount1 = amount1 * 6;
+                        unit1 = GR_UNIT_TEASPOON;
+                        break;
+
+                default: ;
+                }
+        }
+        if (user_volume_unit == GR_PREFERRED_UNIT_METRIC) {
+                switch (unit1) {
+                case GR_UNIT_TEASPOON:
+                        amount1 = amount1 * 4.92892;
+                        unit1 = GR_UNIT_MILLILITER;
+                        break;
+
+                case GR_UNIT_TABLESPOON:
+                        amount1 = amount1 * 14.79;
+                        unit1 = GR_UNIT_MILLILITER;
+                        break;
+
+                case GR_UNIT_CUP:
+                        amount1 = amount1 * 236.59;
+                        unit1 = GR_UNIT_MILLILITER;
+                        break;
+
+                case GR_UNIT_PINT:
+                        amount1 = amount1 * 473.176;
+                        unit1 = GR_UNIT_MILLILITER;
+                        break;
+
+                case GR_UNIT_QUART:
+                        amount1 = amount1 * 946.353;
+                        unit1 = GR_UNIT_MILLILITER;
+                        break;
+
+                case GR_UNIT_GALLON:
+                        amount1 = amount1 * 3785.41;
+                        unit1 = GR_UNIT_MILLILITER;
+                        break;
+
+                case GR_UNIT_FLUID_OUNCE:
+                        amount1 = amount1 * 29.5735;
+                        unit1 = GR_UNIT_MILLILITER;
+                        break;
+
+                case GR_UNIT_MILLILITER:
+                        amount1 = amount1;
+                        unit1 = GR_UNIT_MILLILITER;
+                        break;
+
+                case GR_UNIT_DECILITER:
+                        amount1 = amount1 * 100;
+                        unit1 = GR_UNIT_MILLILITER;
+                        break;
+
+                case GR_UNIT_LITER:
+                        amount1 = amount1 * 1000;
+                        unit1 = GR_UNIT_MILLILITER;
+                        break;
+
+                default: ;
+                }
+        }
+
+        *amount = amount1;
+        *unit = unit1;
+}
+
+static void
+reference_convert_weight (double *amount, GrUnit *unit, GrPreferredUnit user_weight_unit)
+{
+        double amount1 = *amount;
+        GrUnit unit1 = *unit;
+
+        if (user_weight_unit == GR_PREFERRED_UNIT_IMPERIAL) {
+                switch (unit1) {
+                case GR_UNIT_GRAM:
+                        amount1 = amount1 * 0.035274;
+                        unit1 = GR_UNIT_OUNCE;
+                        break;
+
+                case GR_UNIT_KILOGRAM:
+                        amount1 = amount1 * 35.274;
+                        unit1 = GR_UNIT_OUNCE;
+                        break;
+
+                case GR_UNIT_OUNCE:
+                        amount1 = amount1;
+                        unit1 = GR_UNIT_OUNCE;
+                        break;
+
+                case GR_UNIT_POUND:
+                        amount1 = amount1 * 16;
+                        unit1 = GR_UNIT_OUNCE;
+                        break;
+
+                case GR_UNIT_STONE:
+                        amount1 = amount1 * 224;
+                        unit1 = GR_UNIT_OUNCE;
+                        break;
+
+                default: ;
+                }
+        }
+        if (user_weight_unit == GR_PREFERRED_UNIT_METRIC) {
+                switch (unit1) {
+                case GR_UNIT_OUNCE:
+                        amount1 = amount1 * 28.3495;
+                        unit1 = GR_UNIT_GRAM;
+                        break;
+
+                case GR_UNIT_POUND:
+                        amount1 = amount1 * 453.592;
+                        unit1 = GR_UNIT_GRAM;
+                        break;
+
+                case GR_UNIT_STONE:
+                        amount1 = amount1 * 6350.29;
+                        unit1 = GR_UNIT_GRAM;
+                        break;
+
+                case GR_UNIT_GRAM:
+                        amount1 = amount1;
+                        unit1 = GR_UNIT_GRAM;
+                        break;
+
+                case GR_UNIT_KILOGRAM:
+                        amount1 = amount1 * 1000;
+                        unit1 = GR_UNIT_GRAM;
+                        break;
+
+                default: ;
+                }
+         }
+
+         *amount = amount1;
+         *unit = unit1;
+}
+
+static void
+reference_convert_human_readable (double *amount, GrUnit *unit)
+{
+        double amount1 = *amount;
+        GrUnit unit1 = *unit;
+        gboolean unit_changed = TRUE;
+
+        while (unit_changed) {
+                switch (unit1) {
+                case GR_UNIT_GRAM:
+                        if (amount1 >= 1000) {
+                                amount1 = (amount1 / 1000);
+                                unit1 = GR_UNIT_KILOGRAM;
+                        }
+                        break;
+
+                case GR_UNIT_KILOGRAM:
+                        if (amount1 < 1) {
+                                amount1 = (amount1 * 1000);
+                                unit1 = GR_UNIT_GRAM;
+                        }
+                        break;
+
+                case GR_UNIT_POUND:
+                        if (amount1 < 1) {
+                                amount1 = (amount1 * 16);
+                                unit1 = GR_UNIT_OUNCE;
+                        }
+                        break;
+
+                case GR_UNIT_OUNCE:
+                        if (amount1 >= 16) {
+                                amount1 = (amount1 / 16);
+                                unit1 = GR_UNIT_POUND;
+                        }
+                        break;
+
+                case GR_UNIT_TEASPOON:
+                        if (amount1 >= 3) {
+                                amount1 = (amount1 / 3);
+                                unit1 = GR_UNIT_TABLESPOON;
+                        }
+                        break;
+
+                case GR_UNIT_TABLESPOON:
+                        if (amount1 >= 16) {
+                                amount1 = (amount1 / 16);
+                                unit1 = GR_UNIT_CUP;
+                        }
+                        else if ((amount1 < 1) && (amount1 > 0)) {
+                                amount1 = (amount1 * 3);
+                                unit1 = GR_UNIT_TEASPOON;
+                        }
+                        break;
+
+                case GR_UNIT_CUP:
+                        if (amount1 >= 4) {
+                                amount1 = (amount1 / 4);
+                                unit1 = GR_UNIT_QUART;
+                        }
+                        else if (amount1 < 1) {
+                                amount1 = amount1 / 16;
+                                unit1 = GR_UNIT_TABLESPOON;
+                        }
+                        break;
+
+                case GR_UNIT_MILLILITER:
+                        if (amount1 >= 1000) {
+                                amount1 = amount1 / 1000;
+                                unit1 = GR_UNIT_LITER;
+                        }
+                        break;
+
+                case GR_UNIT_DECILITER:
+                        if (amount1 < 1) {
+                                amount1 = amount1 * 100;
+                                unit1 = GR_UNIT_MILLILITER;
+                        }
+                        else if (amount1 >= 10) {
+                                amount1 = amount1 / 10;
+                                unit1 = GR_UNIT_LITER;
+                        }
+                        break;
+
+                case GR_UNIT_LITER:
+                        if (amount1 < 1) {
+                                amount1 = amount1 * 1000;
+                                unit1 = GR_UNIT_MILLILITER;
+                        }
+                        break;
+
+                default: ;
+                }
+
+                if (*unit == unit1) {
+                        unit_changed = FALSE;
+                }
+
+                *amount = amount1;
+                *unit = unit1;
+        }
+}
+
+static const double amounts[] = {
+        -2, -0.5, 0, 0.001, 0.25, 0.5, 0.999, 1, 1.5, 2.9999, 3, 4,
+        9.99, 10, 15.9, 16, 17, 100, 999, 1000, 1001, 12345.6
+};
+
+static void
+assert_same (double a1, GrUnit u1, double a2, GrUnit u2)
+{
+        g_assert_cmpint (u1, ==, u2);
+        g_assert_cmpfloat (fabs (a1 - a2), <=, 1e-9 * MAX (1, fabs (a2)));
+}
+
+static void
+test_volume (void)
+{
+        GrUnit u;
+        GrPreferredUnit p;
+        int i;
+
+        for (u = 0; u <= GR_LAST_UNIT; u++) {
+                for (p = GR_PREFERRED_UNIT_METRIC; p <= GR_PREFERRED_UNIT_LOCALE; p++) {
+                        for (i = 0; i < G_N_ELEMENTS (amounts); i++) {
+                                double a1 = amounts[i], a2 = amounts[i];
+                                GrUnit u1 = u, u2 = u;
+
+                                gr_convert_volume (&a1, &u1, p);
+                                reference_convert_volume (&a2, &u2, p);
+                                assert_same (a1, u1, a2, u2);
+                        }
+                }
+        }
+}
+
+static void
+test_weight (void)
+{
+        GrUnit u;
+        GrPreferredUnit p;
+        int i;
+
+        for (u = 0; u <= GR_LAST_UNIT; u++) {
+                for (p = GR_PREFERRED_UNIT_METRIC; p <= GR_PREFERRED_UNIT_LOCALE; p++) {
+                        for (i = 0; i < G_N_ELEMENTS (amounts); i++) {
+                                double a1 = amounts[i], a2 = amounts[i];
+                                GrUnit u1 = u, u2 = u;
+
+                                gr_convert_weight (&a1, &u1, p);
+                                reference_convert_weight (&a2, &u2, p);
+                                assert_same (a1, u1, a2, u2);
+                        }
+                }
+        }
+}
+
+static void
+test_human_readable (void)
+{
+        GrUnit u;
+        int i;
+
+        for (u = 0; u <= GR_LAST_UNIT; u++) {
+                for (i = 0; i < G_N_ELEMENTS (amounts); i++) {
+                        double a1 = amounts[i], a2 = amounts[i];
+                        GrUnit u1 = u, u2 = u;
+
+                        gr_convert_human_readable (&a1, &u1);
+                        reference_convert_human_readable (&a2, &u2);
+                        assert_same (a1, u1, a2, u2);
+                }
+        }
+}
+
+static void
+test_dimension (void)
+{
+        GrUnit u;
+
+        for (u = 0; u <= GR_LAST_UNIT; u++)
+                g_assert_nonnull (gr_unit_get_name (u));
+
+        g_assert_cmpint (gr_unit_get_dimension (GR_UNIT_OUNCE), ==, GR_DIMENSION_MASS);
+        g_assert_cmpint (gr_unit_get_dimension (GR_UNIT_CUP), ==, GR_DIMENSION_VOLUME);
+        g_assert_cmpint (gr_unit_get_dimension (GR_UNIT_BUNCH), ==, GR_DIMENSION_DISCRETE);
+        g_assert_cmpint (gr_unit_get_dimension (GR_LAST_UNIT + 1), ==, GR_DIMENSION_NONE);
+}
+
+static void
+test_perf (void)
+{
+        GrUnit u;
+        int i, round;
+        double reference, tables;
+
+        if (!g_test_perf ())
+                return;
+
+        g_test_timer_start ();
+        for (round = 0; round < 10000; round++)
+                for (u = 0; u <= GR_LAST_UNIT; u++)
+                        for (i = 0; i < G_N_ELEMENTS (amounts); i++) {
+                                double a = amounts[i];
+                                GrUnit v = u;
+
+                                reference_convert_volume (&a, &v, GR_PREFERRED_UNIT_METRIC);
+                                reference_convert_weight (&a, &v, GR_PREFERRED_UNIT_IMPERIAL);
+                                reference_convert_human_readable (&a, &v);
+                        }
+        reference = g_test_timer_elapsed ();
+
+        g_test_timer_start ();
+        for (round = 0; round < 10000; round++)
+                for (u = 0; u <= GR_LAST_UNIT; u++)
+                        for (i = 0; i < G_N_ELEMENTS (amounts); i++) {
+                                double a = amounts[i];
+                                GrUnit v = u;
+
+                                gr_convert_volume (&a, &v, GR_PREFERRED_UNIT_METRIC);
+                                gr_convert_weight (&a, &v, GR_PREFERRED_UNIT_IMPERIAL);
+                                gr_convert_human_readable (&a, &v);
+                        }
+        tables = g_test_timer_elapsed ();
+
+        g_test_message ("conversions: branches %f s, tables %f s", reference, tables);
+        g_test_minimized_result (tables, "table conversions: %f s", tables);
+}
+
+int main (int argc, char *argv[])
+{
+        g_setenv ("LC_ALL", "en_US.UTF-8", TRUE);
+        setlocale (LC_ALL, "");
+
+        g_test_init (&argc, &argv, NULL);
+
+        g_test_add_func ("/convert/volume", test_volume);
+        g_test_add_func ("/convert/weight", test_weight);
+        g_test_add_func ("/convert/human-readable", test_human_readable);
+        g_test_add_func ("/convert/dimension", test_dimension);
+        g_test_add_func ("/convert/perf", test_perf);
+
+        return g_test_run ();
+}
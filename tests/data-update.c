@@ -0,0 +1,460 @@
+/* data-update.c
+ *
+ * Copyright (C) 2017 Matthias Clasen <mclasen@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include <string.h>
+#include <time.h>
+#include <utime.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <libsoup/soup.h>
+#include "gr-data-update.h"
+
+/* A stand-in for the server: serves the files below a directory,
+ * honors If-Modified-Since, and counts the requests for each path.
+ */
+typedef struct {
+        SoupServer *server;
+        char *root;
+        char *base_url;
+        GHashTable *requests;
+} Server;
+
+static void
+handle_request (SoupServer        *soup_server,
+                SoupMessage       *msg,
+                const char        *path,
+                GHashTable        *query,
+                SoupClientContext *client,
+                gpointer           data)
+{
+        Server *server = data;
+        g_autofree char *filename = NULL;
+        const char *since;
+        char *contents;
+        gsize length;
+        GStatBuf buf;
+
+        g_hash_table_insert (server->requests, g_strdup (path),
+                             GUINT_TO_POINTER (GPOINTER_TO_UINT (g_hash_table_lookup (server->requests, path)) + 1));
+
+        filename = g_build_filename (server->root, path, NULL);
+        if (g_stat (filename, &buf) != 0 || !g_file_get_contents (filename, &contents, &length, NULL)) {
+                soup_message_set_status (msg, SOUP_STATUS_NOT_FOUND);
+                return;
+        }
+
+        since = soup_message_headers_get_one (msg->request_headers, "If-Modified-Since");
+        if (since) {
+                SoupDate *date = soup_date_new_from_string (since);
+                gboolean modified = buf.st_mtime > soup_date_to_time_t (date);
+
+                soup_date_free (date);
+                if (!modified) {
+                        g_free (contents);
+                        soup_message_set_status (msg, SOUP_STATUS_NOT_MODIFIED);
+                        return;
+                }
+        }
+
+        soup_message_set_status (msg, SOUP_STATUS_OK);
+        soup_message_set_response (msg, "application/octet-stream", SOUP_MEMORY_TAKE, contents, length);
+}
+
+static guint
+get_requests (Server     *server,
+              const char *path)
+{
+        return GPOINTER_TO_UINT (g_hash_table_lookup (server->requests, path));
+}
+
+static char *
+make_tmp_dir (void)
+{
+        g_autoptr(GError) error = NULL;
+        char *dir;
+
+        dir = g_dir_make_tmp ("recipes-update-XXXXXX", &error);
+        g_assert_no_error (error);
+
+        return dir;
+}
+
+static void
+remove_tree (const char *path)
+{
+        if (g_file_test (path, G_FILE_TEST_IS_DIR)) {
+                g_autoptr(GDir) dir = NULL;
+                const char *name;
+
+                dir = g_dir_open (path, 0, NULL);
+                while ((name = g_dir_read_name (dir)) != NULL) {
+                        g_autofree char *child = g_build_filename (path, name, NULL);
+                        remove_tree (child);
+                }
+                g_rmdir (path);
+        }
+        else {
+                g_unlink (path);
+        }
+}
+
+static Server *
+server_new (void)
+{
+        Server *server;
+        g_autoptr(GError) error = NULL;
+        GSList *uris;
+        char *url;
+
+        server = g_new0 (Server, 1);
+        server->root = make_tmp_dir ();
+        server->requests = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+        server->server = soup_server_new (NULL, NULL);
+        soup_server_add_handler (server->server, NULL, handle_request, server, NULL);
+        soup_server_listen_local (server->server, 0, 0, &error);
+        g_assert_no_error (error);
+
+        uris = soup_server_get_uris (server->server);
+        url = soup_uri_to_string (uris->data, FALSE);
+        if (g_str_has_suffix (url, "/"))
+                url[strlen (url) - 1] = '\0';
+        server->base_url = url;
+        g_slist_free_full (uris, (GDestroyNotify)soup_uri_free);
+
+        return server;
+}
+
+static void
+server_free (Server *server)
+{
+        soup_server_disconnect (server->server);
+        g_object_unref (server->server);
+        remove_tree (server->root);
+        g_free (server->root);
+        g_free (server->base_url);
+        g_hash_table_unref (server->requests);
+        g_free (server);
+}
+
+static void
+server_set_file (Server     *server,
+                 const char *name,
+                 const char *contents)
+{
+        g_autofree char *path = NULL;
+        g_autofree char *dir = NULL;
+
+        path = g_build_filename (server->root, name, NULL);
+        if (contents == NULL) {
+                g_unlink (path);
+                return;
+        }
+
+        dir = g_path_get_dirname (path);
+        g_mkdir_with_parents (dir, 0755);
+        g_assert_true (g_file_set_contents (path, contents, -1, NULL));
+}
+
+/* Lists the given files in the manifest, with their current
+ * contents on the server.
+ */
+static void
+server_write_manifest (Server     *server,
+                       const char *first,
+                       ...)
+{
+        g_autoptr(GKeyFile) manifest = NULL;
+        g_autofree char *data = NULL;
+        const char *name;
+        va_list args;
+
+        manifest = g_key_file_new ();
+        g_key_file_set_integer (manifest, "Manifest", "Version", 1);
+
+        va_start (args, first);
+        for (name = first; name; name = va_arg (args, const char *)) {
+                g_autofree char *file = NULL;
+                g_autofree char *contents = NULL;
+                g_autofree char *checksum = NULL;
+                gsize length;
+
+                file = g_build_filename (server->root, name, NULL);
+                g_assert_true (g_file_get_contents (file, &contents, &length, NULL));
+                checksum = g_compute_checksum_for_data (G_CHECKSUM_SHA256, (const guchar *)contents, length);
+
+                g_key_file_set_string (manifest, name, "Checksum", checksum);
+                g_key_file_set_uint64 (manifest, name, "Size", length);
+        }
+        va_end (args);
+
+        data = g_key_file_to_data (manifest, NULL, NULL);
+        server_set_file (server, "manifest", data);
+}
+
+typedef struct {
+        gboolean done;
+        gboolean result;
+        guint n_changed;
+        GError *error;
+} UpdateResult;
+
+static void
+update_done (GObject      *source,
+             GAsyncResult *result,
+             gpointer      data)
+{
+        UpdateResult *res = data;
+
+        res->result = gr_data_update_finish (result, &res->n_changed, &res->error);
+        res->done = TRUE;
+}
+
+static gboolean
+run_update (SoupSession  *session,
+            Server       *server,
+            const char   *dir,
+            guint        *n_changed,
+            GError      **error)
+{
+        UpdateResult res = { FALSE, FALSE, 0, NULL };
+
+        gr_data_update_async (session, server->base_url, dir, NULL, update_done, &res);
+        while (!res.done)
+                g_main_context_iteration (NULL, TRUE);
+
+        if (res.error)
+                g_propagate_error (error, res.error);
+
+        *n_changed = res.n_changed;
+
+        return res.result;
+}
+
+static void
+assert_file_contents (const char *dir,
+                      const char *name,
+                      const char *expected)
+{
+        g_autofree char *path = NULL;
+        g_autofree char *contents = NULL;
+
+        path = g_build_filename (dir, name, NULL);
+        if (expected == NULL) {
+                g_assert_false (g_file_test (path, G_FILE_TEST_EXISTS));
+                return;
+        }
+
+        g_assert_true (g_file_get_contents (path, &contents, NULL, NULL));
+        g_assert_cmpstr (contents, ==, expected);
+}
+
+/* Makes the next request not match If-Modified-Since */
+static void
+age_manifest (const char *dir)
+{
+        g_autofree char *path = NULL;
+        struct utimbuf times;
+
+        path = g_build_filename (dir, "manifest", NULL);
+        times.actime = times.modtime = time (NULL) - 60;
+        g_utime (path, &times);
+}
+
+static void
+test_delta (void)
+{
+        g_autoptr(SoupSession) session = NULL;
+        g_autoptr(GError) error = NULL;
+        g_autofree char *dir = NULL;
+        Server *server;
+        guint n_changed;
+
+        session = soup_session_new ();
+        server = server_new ();
+        dir = make_tmp_dir ();
+
+        server_set_file (server, "data/recipes.db", "[soup]\n");
+        server_set_file (server, "data/chefs.db", "[cook]\n");
+        server_set_file (server, "data/picks.db", "[Content]\n");
+        server_write_manifest (server, "data/recipes.db", "data/chefs.db", "data/picks.db", NULL);
+
+        /* The first update gets everything */
+        g_assert_true (run_update (session, server, dir, &n_changed, &error));
+        g_assert_no_error (error);
+        g_assert_cmpuint (n_changed, ==, 3);
+        assert_file_contents (dir, "data/recipes.db", "[soup]\n");
+        assert_file_contents (dir, "data/chefs.db", "[cook]\n");
+        assert_file_contents (dir, "data/picks.db", "[Content]\n");
+        g_assert_cmpuint (get_requests (server, "/manifest"), ==, 1);
+        g_assert_cmpuint (get_requests (server, "/data/recipes.db"), ==, 1);
+
+        /* Nothing changed on the server */
+        g_assert_true (run_update (session, server, dir, &n_changed, &error));
+        g_assert_no_error (error);
+        g_assert_cmpuint (n_changed, ==, 0);
+        g_assert_cmpuint (get_requests (server, "/manifest"), ==, 2);
+        g_assert_cmpuint (get_requests (server, "/data/recipes.db"), ==, 1);
+
+        /* One file changed, one is gone */
+        server_set_file (server, "data/recipes.db", "[stew]\n");
+        server_set_file (server, "data/picks.db", NULL);
+        server_write_manifest (server, "data/recipes.db", "data/chefs.db", NULL);
+        age_manifest (dir);
+
+        g_assert_true (run_update (session, server, dir, &n_changed, &error));
+        g_assert_no_error (error);
+        g_assert_cmpuint (n_changed, ==, 2);
+        assert_file_contents (dir, "data/recipes.db", "[stew]\n");
+        assert_file_contents (dir, "data/chefs.db", "[cook]\n");
+        assert_file_contents (dir, "data/picks.db", NULL);
+        g_assert_cmpuint (get_requests (server, "/data/recipes.db"), ==, 2);
+        g_assert_cmpuint (get_requests (server, "/data/chefs.db"), ==, 1);
+
+        server_free (server);
+        remove_tree (dir);
+}
+
+/* Files we already have are not fetched, even without a manifest,
+ * e.g. after the data came from the full bundle.
+ */
+static void
+test_existing_files (void)
+{
+        g_autoptr(SoupSession) session = NULL;
+        g_autoptr(GError) error = NULL;
+        g_autofree char *dir = NULL;
+        g_autofree char *path = NULL;
+        Server *server;
+        guint n_changed;
+
+        session = soup_session_new ();
+        server = server_new ();
+        dir = make_tmp_dir ();
+
+        server_set_file (server, "data/recipes.db", "[soup]\n");
+        server_set_file (server, "data/chefs.db", "[cook]\n");
+        server_write_manifest (server, "data/recipes.db", "data/chefs.db", NULL);
+
+        path = g_build_filename (dir, "data", NULL);
+        g_mkdir_with_parents (path, 0755);
+        g_clear_pointer (&path, g_free);
+        path = g_build_filename (dir, "data", "recipes.db", NULL);
+        g_assert_true (g_file_set_contents (path, "[soup]\n", -1, NULL));
+
+        g_assert_true (run_update (session, server, dir, &n_changed, &error));
+        g_assert_no_error (error);
+        g_assert_cmpuint (n_changed, ==, 1);
+        g_assert_cmpuint (get_requests (server, "/data/recipes.db"), ==, 0);
+        g_assert_cmpuint (get_requests (server, "/data/chefs.db"), ==, 1);
+
+        server_free (server);
+        remove_tree (dir);
+}
+
+static void
+test_errors (void)
+{
+        g_autoptr(SoupSession) session = NULL;
+        g_autoptr(GError) error = NULL;
+        g_autofree char *dir = NULL;
+        g_autofree char *manifest = NULL;
+        Server *server;
+        guint n_changed;
+
+        session = soup_session_new ();
+        server = server_new ();
+        dir = make_tmp_dir ();
+
+        /* No manifest, the caller falls back to the bundle */
+        g_assert_false (run_update (session, server, dir, &n_changed, &error));
+        g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED);
+        g_clear_error (&error);
+
+        /* Contents that don't match the manifest are not used */
+        server_set_file (server, "data/recipes.db", "[soup]\n");
+        server_write_manifest (server, "data/recipes.db", NULL);
+        server_set_file (server, "data/recipes.db", "[tampered]\n");
+
+        g_assert_false (run_update (session, server, dir, &n_changed, &error));
+        g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+        assert_file_contents (dir, "data/recipes.db", NULL);
+
+        /* and the manifest is not stored, so we try again next time */
+        manifest = g_build_filename (dir, "manifest", NULL);
+        g_assert_false (g_file_test (manifest, G_FILE_TEST_EXISTS));
+
+        server_free (server);
+        remove_tree (dir);
+}
+
+/* A failed update leaves the previous files alone, even those that
+ * did arrive intact.
+ */
+static void
+test_partial (void)
+{
+        g_autoptr(SoupSession) session = NULL;
+        g_autoptr(GError) error = NULL;
+        g_autofree char *dir = NULL;
+        g_autofree char *staging = NULL;
+        Server *server;
+        guint n_changed;
+
+        session = soup_session_new ();
+        server = server_new ();
+        dir = make_tmp_dir ();
+
+        server_set_file (server, "recipes.db", "[soup]\n");
+        server_set_file (server, "chefs.db", "[cook]\n");
+        server_write_manifest (server, "recipes.db", "chefs.db", NULL);
+
+        g_assert_true (run_update (session, server, dir, &n_changed, &error));
+        g_assert_no_error (error);
+        g_assert_cmpuint (n_changed, ==, 2);
+
+        server_set_file (server, "recipes.db", "[stew]\n");
+        server_set_file (server, "chefs.db", "[baker]\n");
+        server_write_manifest (server, "recipes.db", "chefs.db", NULL);
+        server_set_file (server, "chefs.db", "[tampered]\n");
+        age_manifest (dir);
+
+        g_assert_false (run_update (session, server, dir, &n_changed, &error));
+        g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+        assert_file_contents (dir, "recipes.db", "[soup]\n");
+        assert_file_contents (dir, "chefs.db", "[cook]\n");
+
+        staging = g_strconcat (dir, ".staging", NULL);
+        g_assert_false (g_file_test (staging, G_FILE_TEST_EXISTS));
+
+        server_free (server);
+        remove_tree (dir);
+}
+
+int
+main (int argc, char *argv[])
+{
+        g_test_init (&argc, &argv, NULL);
+
+        g_test_add_func ("/data-update/delta", test_delta);
+        g_test_add_func ("/data-update/existing-files", test_existing_files);
+        g_test_add_func ("/data-update/errors", test_errors);
+        g_test_add_func ("/data-update/partial", test_partial);
+
+        return g_test_run ();
+}
@@ -0,0 +1,105 @@
+/* images.c
+ *
+ * Copyright (C) 2017 Matthias Clasen <mclasen@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include <glib.h>
+#include <glib/gstdio.h>
+#include "gr-utils.h"
+
+#define ABC_HASH "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"
+
+static char *
+write_file (const char *dir,
+            const char *name,
+            const char *contents)
+{
+        char *path;
+
+        path = g_build_filename (dir, name, NULL);
+        g_assert_true (g_file_set_contents (path, contents, -1, NULL));
+
+        return path;
+}
+
+static void
+test_content_addressed_name (void)
+{
+        g_autoptr(GError) error = NULL;
+        g_autofree char *dir = NULL;
+        g_autofree char *path1 = NULL;
+        g_autofree char *path2 = NULL;
+        g_autofree char *path3 = NULL;
+        g_autofree char *name = NULL;
+
+        dir = g_dir_make_tmp ("recipes-images-XXXXXX", &error);
+        g_assert_no_error (error);
+
+        path1 = write_file (dir, "photo.jpg", "abc");
+        path2 = write_file (dir, "copy of photo.jpg", "abc");
+        path3 = write_file (dir, "photo", "abc");
+
+        /* The name only depends on the contents and the extension */
+        name = get_content_addressed_name (path1, &error);
+        g_assert_no_error (error);
+        g_assert_cmpstr (name, ==, ABC_HASH ".jpg");
+        g_clear_pointer (&name, g_free);
+
+        name = get_content_addressed_name (path2, &error);
+        g_assert_no_error (error);
+        g_assert_cmpstr (name, ==, ABC_HASH ".jpg");
+        g_clear_pointer (&name, g_free);
+
+        name = get_content_addressed_name (path3, &error);
+        g_assert_no_error (error);
+        g_assert_cmpstr (name, ==, ABC_HASH);
+        g_clear_pointer (&name, g_free);
+
+        g_unlink (path1);
+        g_unlink (path2);
+        g_unlink (path3);
+
+        name = get_content_addressed_name (path1, &error);
+        g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+        g_assert_null (name);
+
+        g_rmdir (dir);
+}
+
+static void
+test_is_content_addressed (void)
+{
+        g_assert_true (is_content_addressed (ABC_HASH));
+        g_assert_true (is_content_addressed (ABC_HASH ".jpg"));
+        g_assert_true (is_content_addressed ("/home/user/images/" ABC_HASH ".png"));
+        g_assert_false (is_content_addressed ("photo.jpg"));
+        g_assert_false (is_content_addressed ("ba7816bf.jpg"));
+        g_assert_false (is_content_addressed ("BA7816BF8F01CFEA414140DE5DAE2223B00361A396177A9CB410FF61F20015AD.jpg"));
+        g_assert_false (is_content_addressed (ABC_HASH "0.jpg"));
+        g_assert_false (is_content_addressed ("/" ABC_HASH "/photo.jpg"));
+}
+
+int
+main (int argc, char *argv[])
+{
+        g_test_init (&argc, &argv, NULL);
+
+        g_test_add_func ("/images/content-addressed-name", test_content_addressed_name);
+        g_test_add_func ("/images/is-content-addressed", test_is_content_addressed);
+
+        return g_test_run ();
+}
@@ -29,6 +29,8 @@
 #include "gr-unit.c"
 #include "gr-utils.h"
 #include "gr-utils.c"
+#include "gr-translation-cache.h"
+#include "gr-translation-cache.c"
 
 static GString *string;
 
@@ -49,14 +51,13 @@ test_file (const char *filename)
         }
         else {
                 g_autoptr(GrIngredientsList) ingredients = NULL;
-                GList *l;
+                guint i;
 
                 ingredients = gr_ingredients_list_new (contents);
-                for (l = ingredients->ingredients; l; l = l->next) {
-                        Ingredient *ing = (Ingredient *)l->data;
-                        g_string_append_printf (string, "AMOUNT %f\n", ing->amount);
-                        g_string_append_printf (string, "UNIT %s\n", gr_unit_get_name (ing->unit));
-                        g_string_append_printf (string, "NAME %s\n", ing->name);
+                for (i = 0; i < ingredients->n_items; i++) {
+                        g_string_append_printf (string, "AMOUNT %f\n", ingredients->amounts[i]);
+                        g_string_append_printf (string, "UNIT %s\n", gr_unit_get_name (ingredients->units[i]));
+                        g_string_append_printf (string, "NAME %s\n", ingredients->names[i]);
                         g_string_append_printf (string, "\n");
                 }
         }
@@ -108,6 +109,104 @@ test_parse (gconstpointer d)
         g_free (expected_file);
 }
 
+static const char *
+find_linear (const char *text)
+{
+        g_autofree char *cf_text = NULL;
+        int i;
+
+        cf_text = g_utf8_casefold (text, -1);
+
+        for (i = 0; names[i]; i++) {
+                g_autofree char *cf_name = g_utf8_casefold (names[i], -1);
+                g_autofree char *cf_en_name = g_utf8_casefold (names_[i], -1);
+
+                if (strcmp (cf_text, cf_name) == 0 ||
+                    strcmp (cf_text, cf_en_name) == 0)
+                        return names[i];
+        }
+
+        return NULL;
+}
+
+static void
+test_find (void)
+{
+        const char **all;
+        int length;
+        int i;
+
+        all = gr_ingredient_get_names (&length);
+        for (i = 0; i < length; i++) {
+                g_autofree char *upper = g_utf8_strup (all[i], -1);
+
+                g_assert_cmpstr (gr_ingredient_find (all[i]), ==, find_linear (all[i]));
+                g_assert_cmpstr (gr_ingredient_find (upper), ==, find_linear (upper));
+                g_assert_cmpstr (gr_ingredient_find (names_[i]), ==, find_linear (names_[i]));
+                g_assert_cmpstr (gr_ingredient_get_id (all[i]), ==, names_[i]);
+        }
+
+        g_assert_null (gr_ingredient_find ("No such ingredient"));
+        g_assert_null (gr_ingredient_get_id (""));
+}
+
+static void
+test_complete (void)
+{
+        const char **all;
+        int length;
+        int i, j;
+
+        all = gr_ingredient_get_names (&length);
+        for (i = 0; i < length; i++) {
+                g_autofree char *prefix = g_utf8_substring (all[i], 0, 2);
+                g_autofree char *cf_prefix = g_utf8_casefold (prefix, -1);
+                g_autofree const char **matches = NULL;
+                int n;
+
+                matches = gr_ingredient_complete (prefix);
+                g_assert_true (g_strv_contains (matches, all[i]));
+
+                n = 0;
+                for (j = 0; j < length; j++) {
+                        g_autofree char *cf_name = g_utf8_casefold (all[j], -1);
+
+                        if (g_str_has_prefix (cf_name, cf_prefix))
+                                n++;
+                }
+                g_assert_cmpint (g_strv_length ((char **)matches), ==, n);
+        }
+}
+
+static void
+test_find_perf (void)
+{
+        const char **all;
+        int length;
+        int i, round;
+        double linear, indexed;
+
+        if (!g_test_perf ())
+                return;
+
+        all = gr_ingredient_get_names (&length);
+
+        g_test_timer_start ();
+        for (round = 0; round < 100; round++)
+                for (i = 0; i < length; i++)
+                        find_linear (all[i]);
+        linear = g_test_timer_elapsed ();
+
+        g_test_timer_start ();
+        for (round = 0; round < 100; round++)
+                for (i = 0; i < length; i++)
+                        gr_ingredient_find (all[i]);
+        indexed = g_test_timer_elapsed ();
+
+        g_test_message ("%d lookups: linear %f s, indexed %f s", 100 * length, linear, indexed);
+        g_test_minimized_result (indexed, "indexed lookup: %f s", indexed);
+}
+
 int main (int argc, char *argv[])
 {
         GDir *dir;
@@ -144,5 +243,9 @@ int main (int argc, char *argv[])
         }
         g_dir_close (dir);
 
+        g_test_add_func ("/ingredients/find", test_find);
+        g_test_add_func ("/ingredients/complete", test_complete);
+        g_test_add_func ("/ingredients/find-perf", test_find_perf);
+
   return g_test_run ();
 }
@@ -155,6 +155,61 @@ test_parse (gconstpointer d)
         g_free (expected_file);
 }
 
+static void
+test_parse_perf (void)
+{
+        g_autofree char *path = NULL;
+        g_autoptr(GKeyFile) keyfile = NULL;
+        g_auto(GStrv) groups = NULL;
+        g_autoptr(GPtrArray) amounts = NULL;
+        g_autoptr(GError) error = NULL;
+        int i, round;
+        double elapsed;
+
+        if (!g_test_perf ())
+                return;
+
+        /* collect the amounts of all ingredients in the bundled recipes */
+        path = g_test_build_filename (G_TEST_DIST, "..", "data", "recipes.db", NULL);
+        keyfile = g_key_file_new ();
+        g_key_file_load_from_file (keyfile, path, G_KEY_FILE_NONE, &error);
+        g_assert_no_error (error);
+
+        amounts = g_ptr_array_new_with_free_func (g_free);
+        groups = g_key_file_get_groups (keyfile, NULL);
+        for (i = 0; groups[i]; i++) {
+                g_autofree char *ingredients = NULL;
+                g_auto(GStrv) lines = NULL;
+                int j;
+
+                ingredients = g_key_file_get_string (keyfile, groups[i], "Ingredients", NULL);
+                if (ingredients == NULL)
+                        continue;
+
+                lines = g_strsplit (ingredients, "\n", -1);
+                for (j = 0; lines[j]; j++) {
+                        char *tab = strchr (lines[j], '\t');
+
+                        if (tab)
+                                g_ptr_array_add (amounts, g_strndup (lines[j], tab - lines[j]));
+                }
+        }
+
+        g_test_timer_start ();
+        for (round = 0; round < 1000; round++) {
+                for (i = 0; i < amounts->len; i++) {
+                        char *input = g_ptr_array_index (amounts, i);
+                        double number;
+
+                        gr_number_parse (&number, &input, NULL);
+                }
+        }
+        elapsed = g_test_timer_elapsed ();
+
+        g_test_message ("parsed %u amounts in %f s", 1000 * amounts->len, elapsed);
+        g_test_maximized_result (1000 * amounts->len / elapsed, "%f amounts/s", 1000 * amounts->len / elapsed);
+}
+
 int main (int argc, char *argv[])
 {
         GDir *dir;
@@ -191,5 +246,7 @@ int main (int argc, char *argv[])
         }
         g_dir_close (dir);
 
+        g_test_add_func ("/number/parse-perf", test_parse_perf);
+
   return g_test_run ();
 }
@@ -0,0 +1,230 @@
+/* print.c
+ *
+ * Copyright (C) 2017 Matthias Clasen <mclasen@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include <locale.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include "gr-print-document.h"
+
+/* Something shaped like a printed recipe, without needing a
+ * recipe store. @n_steps controls the length of the body.
+ */
+static GrPrintDocument *
+create_document (int n, int n_steps)
+{
+        GrPrintDocument *doc;
+        g_autoptr(GString) s = NULL;
+        int i;
+
+        doc = gr_print_document_new ();
+
+        s = g_string_new ("");
+        g_string_append_printf (s, "Recipe %d\n\n", n);
+        gr_print_document_set_title (doc, s->str);
+
+        gr_print_document_set_summary (doc, "Author: Someone\nPreparation: 30 minutes\nCooking: 1 hour\nYield: 4 servings\n\n");
+        gr_print_document_set_amounts (doc, "1 ½ cup 200 g 2 tbsp 1 pinch ");
+
+        gr_print_document_append_text (doc, "A dish that is good for testing.\n\n");
+        gr_print_document_append_heading (doc, "Ingredients");
+
+        g_string_truncate (s, 0);
+        g_string_append (s, "\n");
+        for (i = 0; i < 6; i++)
+                g_string_append_printf (s, "\n%d g\tIngredient %d\t%d cup\tIngredient %d", 10 * i, i, i, i + 6);
+        g_string_append (s, "\n\n");
+        gr_print_document_append_text (doc, s->str);
+
+        gr_print_document_append_heading (doc, "Directions");
+        gr_print_document_append_text (doc, "\n\n");
+
+        g_string_truncate (s, 0);
+        for (i = 0; i < n_steps; i++)
+                g_string_append_printf (s, "Step %d: stir the pot until everything is well combined and smells nice.\n\n", i);
+        gr_print_document_append_text (doc, s->str);
+
+        return doc;
+}
+
+static void
+remove_dir (const char *dir)
+{
+        g_autoptr(GDir) d = NULL;
+        const char *name;
+
+        d = g_dir_open (dir, 0, NULL);
+        while ((name = g_dir_read_name (d)) != NULL) {
+                g_autofree char *path = g_build_filename (dir, name, NULL);
+                g_unlink (path);
+        }
+        g_rmdir (dir);
+}
+
+static void
+test_layout (void)
+{
+        g_autoptr(GrPrintDocument) doc = NULL;
+        PangoContext *context;
+        double width, height;
+
+        gr_print_get_page_size (&width, &height);
+        g_assert_cmpfloat (width, >, 0);
+        g_assert_cmpfloat (height, >, 0);
+
+        context = pango_font_map_create_context (pango_cairo_font_map_get_default ());
+
+        doc = create_document (0, 1);
+        g_assert_cmpint (gr_print_document_layout (doc, context, width, height), ==, 1);
+
+        gr_print_document_free (g_steal_pointer (&doc));
+
+        doc = create_document (0, 200);
+        g_assert_cmpint (gr_print_document_layout (doc, context, width, height), >, 1);
+
+        g_object_unref (context);
+}
+
+static void
+check_pdf (const char *path)
+{
+        g_autofree char *contents = NULL;
+        gsize length;
+
+        g_assert_true (g_file_get_contents (path, &contents, &length, NULL));
+        g_assert_cmpuint (length, >, 5);
+        g_assert_true (memcmp (contents, "%PDF-", 5) == 0);
+}
+
+static void
+test_export (void)
+{
+        g_autoptr(GrPrintDocument) doc = NULL;
+        g_autoptr(GError) error = NULL;
+        g_autofree char *dir = NULL;
+        g_autofree char *path = NULL;
+
+        dir = g_dir_make_tmp ("recipes-print-XXXXXX", &error);
+        g_assert_no_error (error);
+
+        path = g_build_filename (dir, "recipe.pdf", NULL);
+        doc = create_document (0, 50);
+
+        g_assert_true (gr_print_document_export_pdf (doc, path, &error));
+        g_assert_no_error (error);
+        check_pdf (path);
+
+        remove_dir (dir);
+}
+
+static void
+export_many (guint n_docs, guint max_threads, const char *dir)
+{
+        GrPrintDocument **docs;
+        char **paths;
+        guint i;
+
+        docs = g_new (GrPrintDocument *, n_docs);
+        paths = g_new0 (char *, n_docs + 1);
+        for (i = 0; i < n_docs; i++) {
+                g_autofree char *name = g_strdup_printf ("recipe-%u.pdf", i);
+
+                docs[i] = create_document (i, 5 + i % 20);
+                paths[i] = g_build_filename (dir, name, NULL);
+        }
+
+        g_assert_cmpuint (gr_print_export_pdfs (docs, (const char **)paths, n_docs, max_threads, NULL), ==, n_docs);
+
+        for (i = 0; i < n_docs; i++) {
+                check_pdf (paths[i]);
+                gr_print_document_free (docs[i]);
+        }
+
+        g_free (docs);
+        g_strfreev (paths);
+}
+
+static void
+test_export_parallel (void)
+{
+        g_autoptr(GError) error = NULL;
+        g_autofree char *dir = NULL;
+
+        dir = g_dir_make_tmp ("recipes-print-XXXXXX", &error);
+        g_assert_no_error (error);
+
+        export_many (20, 4, dir);
+
+        remove_dir (dir);
+}
+
+/* Wall-clock time for exporting 1000 recipes, with an
+ * increasing number of threads.
+ */
+static void
+test_perf (void)
+{
+        g_autoptr(GError) error = NULL;
+        g_autofree char *dir = NULL;
+        guint n_processors;
+        guint threads;
+        double serial = 0;
+
+        if (!g_test_perf ())
+                return;
+
+        dir = g_dir_make_tmp ("recipes-print-XXXXXX", &error);
+        g_assert_no_error (error);
+
+        n_processors = g_get_num_processors ();
+
+        for (threads = 1; ; threads = MIN (2 * threads, n_processors)) {
+                double elapsed;
+
+                g_test_timer_start ();
+                export_many (1000, threads, dir);
+                elapsed = g_test_timer_elapsed ();
+
+                if (threads == 1)
+                        serial = elapsed;
+
+                g_test_message ("1000 recipes, %u threads: %f s, speedup %.2f", threads, elapsed, serial / elapsed);
+
+                if (threads == n_processors) {
+                        g_test_minimized_result (elapsed, "1000 recipes, %u threads: %f s", threads, elapsed);
+                        break;
+                }
+        }
+
+        remove_dir (dir);
+}
+
+int
+main (int argc, char *argv[])
+{
+        setlocale (LC_ALL, "");
+
+        g_test_init (&argc, &argv, NULL);
+
+        g_test_add_func ("/print/layout", test_layout);
+        g_test_add_func ("/print/export", test_export);
+        g_test_add_func ("/print/export-parallel", test_export_parallel);
+        g_test_add_func ("/print/perf", test_perf);
+
+        return g_test_run ();
+}
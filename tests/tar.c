@@ -0,0 +1,448 @@
+/* tar.c
+ *
+ * Copyright (C) 2017 Matthias Clasen <mclasen@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include "gr-tar.h"
+
+static char *
+make_tmp_dir (void)
+{
+        g_autoptr(GError) error = NULL;
+        char *dir;
+
+        dir = g_dir_make_tmp ("recipes-tar-XXXXXX", &error);
+        g_assert_no_error (error);
+
+        return dir;
+}
+
+static void
+remove_tree (const char *path)
+{
+        if (g_file_test (path, G_FILE_TEST_IS_DIR)) {
+                g_autoptr(GDir) dir = NULL;
+                const char *name;
+
+                dir = g_dir_open (path, 0, NULL);
+                while ((name = g_dir_read_name (dir)) != NULL) {
+                        g_autofree char *child = g_build_filename (path, name, NULL);
+                        remove_tree (child);
+                }
+                g_rmdir (path);
+        }
+        else {
+                g_unlink (path);
+        }
+}
+
+static char *
+make_image_data (gsize length)
+{
+        char *data;
+        gsize i;
+
+        data = g_malloc (length);
+        for (i = 0; i < length; i++)
+                data[i] = (char)(i * 7 + i / 13);
+
+        return data;
+}
+
+/* Writes a compressed bundle like the one we download, with the
+ * given contents for recipes.db.
+ */
+static void
+write_bundle (const char *path,
+              const char *recipes)
+{
+        g_autoptr(GFile) file = NULL;
+        g_autoptr(GFileOutputStream) file_out = NULL;
+        g_autoptr(GConverter) compressor = NULL;
+        g_autoptr(GOutputStream) out = NULL;
+        g_autoptr(GError) error = NULL;
+        g_autofree char *image = NULL;
+        g_autofree char *long_name = NULL;
+
+        file = g_file_new_for_path (path);
+        file_out = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, &error);
+        g_assert_no_error (error);
+
+        compressor = G_CONVERTER (g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1));
+        out = g_converter_output_stream_new (G_OUTPUT_STREAM (file_out), compressor);
+
+        image = make_image_data (100000);
+
+        g_assert_true (gr_tar_write_directory (out, "data", NULL, &error));
+        g_assert_true (gr_tar_write_data (out, "data/recipes.db", recipes, strlen (recipes), NULL, &error));
+        g_assert_true (gr_tar_write_data (out, "data/chefs.db", "[chef]\n", 7, NULL, &error));
+        g_assert_true (gr_tar_write_data (out, "data/empty", "", 0, NULL, &error));
+        g_assert_true (gr_tar_write_directory (out, "data/images", NULL, &error));
+        g_assert_true (gr_tar_write_data (out, "data/images/photo.jpg", image, 100000, NULL, &error));
+        g_assert_true (gr_tar_write_end (out, NULL, &error));
+        g_assert_true (g_output_stream_close (out, NULL, &error));
+        g_assert_no_error (error);
+}
+
+/* Reads the bundle like the recipe store reads a download:
+ * decompressing on the fly, in small, odd-sized chunks.
+ */
+static guint
+extract_bundle (const char  *path,
+                const char  *dir,
+                GError     **error)
+{
+        g_autoptr(GFile) file = NULL;
+        g_autoptr(GFileInputStream) file_in = NULL;
+        g_autoptr(GConverter) decompressor = NULL;
+        g_autoptr(GInputStream) in = NULL;
+        g_autoptr(GrTarReader) reader = NULL;
+        char buffer[1000];
+        gssize size;
+
+        file = g_file_new_for_path (path);
+        file_in = g_file_read (file, NULL, error);
+        if (!file_in)
+                return G_MAXUINT;
+
+        decompressor = G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP));
+        in = g_converter_input_stream_new (G_INPUT_STREAM (file_in), decompressor);
+        reader = gr_tar_reader_new (dir);
+
+        while ((size = g_input_stream_read (in, buffer, sizeof (buffer), NULL, error)) > 0) {
+                if (!gr_tar_reader_feed (reader, buffer, size, error))
+                        return G_MAXUINT;
+        }
+
+        if (size < 0 || !gr_tar_reader_finish (reader, error))
+                return G_MAXUINT;
+
+        return gr_tar_reader_get_n_changed (reader);
+}
+
+static void
+assert_file_contents (const char *dir,
+                      const char *name,
+                      const char *expected,
+                      gsize       length)
+{
+        g_autofree char *path = NULL;
+        g_autofree char *contents = NULL;
+        gsize size;
+
+        path = g_build_filename (dir, name, NULL);
+        g_assert_true (g_file_get_contents (path, &contents, &size, NULL));
+        g_assert_cmpuint (size, ==, length);
+        g_assert_true (memcmp (contents, expected, length) == 0);
+}
+
+static void
+test_round_trip (void)
+{
+        g_autofree char *dir = NULL;
+        g_autofree char *bundle = NULL;
+        g_autofree char *out = NULL;
+        g_autofree char *image = NULL;
+        g_autoptr(GError) error = NULL;
+
+        dir = make_tmp_dir ();
+        bundle = g_build_filename (dir, "data.tar.gz", NULL);
+        out = g_build_filename (dir, "cache", NULL);
+
+        write_bundle (bundle, "[recipe]\nName=Soup\n");
+
+        g_assert_cmpuint (extract_bundle (bundle, out, &error), ==, 4);
+        g_assert_no_error (error);
+
+        image = make_image_data (100000);
+        assert_file_contents (out, "data/recipes.db", "[recipe]\nName=Soup\n", 19);
+        assert_file_contents (out, "data/chefs.db", "[chef]\n", 7);
+        assert_file_contents (out, "data/empty", "", 0);
+        assert_file_contents (out, "data/images/photo.jpg", image, 100000);
+
+        /* Nothing changed, nothing is written */
+        g_assert_cmpuint (extract_bundle (bundle, out, &error), ==, 0);
+        g_assert_no_error (error);
+
+        write_bundle (bundle, "[recipe]\nName=Stew\n");
+
+        g_assert_cmpuint (extract_bundle (bundle, out, &error), ==, 1);
+        g_assert_no_error (error);
+        assert_file_contents (out, "data/recipes.db", "[recipe]\nName=Stew\n", 19);
+
+        remove_tree (dir);
+}
+
+static guint
+extract_data (GOutputStream  *stream,
+              const char     *dir)
+{
+        g_autoptr(GrTarReader) reader = NULL;
+        g_autoptr(GError) error = NULL;
+        const char *data;
+        gsize size;
+        gsize n;
+
+        data = g_memory_output_stream_get_data (G_MEMORY_OUTPUT_STREAM (stream));
+        size = g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (stream));
+
+        reader = gr_tar_reader_new (dir);
+        for (; size > 0; data += n, size -= n) {
+                n = MIN (size, 3333);
+                g_assert_true (gr_tar_reader_feed (reader, data, n, &error));
+        }
+        g_assert_true (gr_tar_reader_finish (reader, &error));
+        g_assert_no_error (error);
+
+        return gr_tar_reader_get_n_changed (reader);
+}
+
+/* A file of the same size that only differs near the end must
+ * still come out complete, with the part that matched copied over.
+ */
+static void
+test_late_change (void)
+{
+        g_autofree char *dir = NULL;
+        g_autofree char *image = NULL;
+        g_autoptr(GOutputStream) stream = NULL;
+        g_autoptr(GError) error = NULL;
+
+        dir = make_tmp_dir ();
+        image = make_image_data (100000);
+
+        stream = g_memory_output_stream_new_resizable ();
+        g_assert_true (gr_tar_write_data (stream, "photo.jpg", image, 100000, NULL, &error));
+        g_assert_true (gr_tar_write_end (stream, NULL, &error));
+        g_assert_true (g_output_stream_close (stream, NULL, &error));
+        g_assert_cmpuint (extract_data (stream, dir), ==, 1);
+        g_clear_object (&stream);
+
+        image[90000] ^= 0xff;
+
+        stream = g_memory_output_stream_new_resizable ();
+        g_assert_true (gr_tar_write_data (stream, "photo.jpg", image, 100000, NULL, &error));
+        g_assert_true (gr_tar_write_end (stream, NULL, &error));
+        g_assert_true (g_output_stream_close (stream, NULL, &error));
+        g_assert_cmpuint (extract_data (stream, dir), ==, 1);
+        g_assert_no_error (error);
+
+        assert_file_contents (dir, "photo.jpg", image, 100000);
+
+        remove_tree (dir);
+}
+
+static void
+test_unsafe_names (void)
+{
+        g_autofree char *dir = NULL;
+        g_autofree char *out = NULL;
+        g_autofree char *escaped = NULL;
+        g_autoptr(GOutputStream) stream = NULL;
+        g_autoptr(GrTarReader) reader = NULL;
+        g_autoptr(GError) error = NULL;
+
+        dir = make_tmp_dir ();
+        out = g_build_filename (dir, "cache", NULL);
+        escaped = g_build_filename (dir, "escaped", NULL);
+
+        stream = g_memory_output_stream_new_resizable ();
+        g_assert_true (gr_tar_write_data (stream, "../escaped", "x", 1, NULL, &error));
+        g_assert_true (gr_tar_write_data (stream, "./data/../../escaped", "x", 1, NULL, &error));
+        g_assert_true (gr_tar_write_data (stream, "/tmp/escaped", "x", 1, NULL, &error));
+        g_assert_true (gr_tar_write_end (stream, NULL, &error));
+        g_assert_true (g_output_stream_close (stream, NULL, &error));
+
+        reader = gr_tar_reader_new (out);
+        g_test_expect_message (G_LOG_DOMAIN, G_LOG_LEVEL_WARNING, "Not extracting*");
+        g_test_expect_message (G_LOG_DOMAIN, G_LOG_LEVEL_WARNING, "Not extracting*");
+        g_test_expect_message (G_LOG_DOMAIN, G_LOG_LEVEL_WARNING, "Not extracting*");
+        g_assert_true (gr_tar_reader_feed (reader,
+                                           g_memory_output_stream_get_data (G_MEMORY_OUTPUT_STREAM (stream)),
+                                           g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (stream)),
+                                           &error));
+        g_test_assert_expected_messages ();
+        g_assert_true (gr_tar_reader_finish (reader, &error));
+        g_assert_no_error (error);
+
+        g_assert_cmpuint (gr_tar_reader_get_n_changed (reader), ==, 0);
+        g_assert_false (g_file_test (escaped, G_FILE_TEST_EXISTS));
+
+        remove_tree (dir);
+}
+
+static void
+test_truncated (void)
+{
+        g_autofree char *dir = NULL;
+        g_autoptr(GOutputStream) stream = NULL;
+        g_autoptr(GrTarReader) reader = NULL;
+        g_autoptr(GError) error = NULL;
+        const char *data;
+        gsize size;
+
+        dir = make_tmp_dir ();
+
+        stream = g_memory_output_stream_new_resizable ();
+        g_assert_true (gr_tar_write_data (stream, "file", "0123456789", 10, NULL, &error));
+        g_assert_true (g_output_stream_close (stream, NULL, &error));
+
+        data = g_memory_output_stream_get_data (G_MEMORY_OUTPUT_STREAM (stream));
+        size = g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (stream));
+
+        /* The header and half of the contents */
+        reader = gr_tar_reader_new (dir);
+        g_assert_true (gr_tar_reader_feed (reader, data, 517, &error));
+        g_assert_false (gr_tar_reader_finish (reader, &error));
+        g_assert_error (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT);
+        g_clear_error (&error);
+        g_clear_pointer (&reader, gr_tar_reader_free);
+
+        /* A corrupted header */
+        reader = gr_tar_reader_new (dir);
+        g_assert_false (gr_tar_reader_feed (reader, data + 1, size - 1, &error));
+        g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+
+        remove_tree (dir);
+}
+
+/* Entries that claim to be huge are rejected right away */
+static void
+test_too_large (void)
+{
+        g_autofree char *dir = NULL;
+        g_autoptr(GOutputStream) stream = NULL;
+        g_autoptr(GrTarReader) reader = NULL;
+        g_autoptr(GError) error = NULL;
+        char header[512];
+        guint checksum;
+        int i;
+
+        dir = make_tmp_dir ();
+
+        stream = g_memory_output_stream_new_resizable ();
+        g_assert_true (gr_tar_write_data (stream, "file", "0123456789", 10, NULL, &error));
+        g_assert_true (g_output_stream_close (stream, NULL, &error));
+
+        memcpy (header, g_memory_output_stream_get_data (G_MEMORY_OUTPUT_STREAM (stream)), sizeof (header));
+        g_snprintf (header + 124, 12, "%011o", 07777777777);
+        memset (header + 148, ' ', 8);
+        checksum = 0;
+        for (i = 0; i < sizeof (header); i++)
+                checksum += (guchar)header[i];
+        g_snprintf (header + 148, 7, "%06o", checksum);
+
+        reader = gr_tar_reader_new (dir);
+        g_assert_false (gr_tar_reader_feed (reader, header, sizeof (header), &error));
+        g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+
+        remove_tree (dir);
+}
+
+/* Archives made by tar use the GNU or pax extensions for long names */
+static void
+test_long_names (void)
+{
+        const char *formats[] = { "gnu", "pax", "ustar" };
+        g_autofree char *tar = NULL;
+        g_autofree char *dir = NULL;
+        g_autofree char *src = NULL;
+        g_autofree char *long_dir = NULL;
+        g_autofree char *long_name = NULL;
+        int i;
+
+        tar = g_find_program_in_path ("tar");
+        if (tar == NULL) {
+                g_test_skip ("tar not found");
+                return;
+        }
+
+        dir = make_tmp_dir ();
+        src = g_build_filename (dir, "src", NULL);
+
+        long_dir = g_build_filename ("data",
+                                     "a-directory-name-that-is-quite-long-and-makes-the-path-longer",
+                                     "another-directory-name-that-goes-past-one-hundred-characters",
+                                     NULL);
+        long_name = g_build_filename (long_dir, "and-a-file-name-that-is-long-as-well.jpg", NULL);
+
+        for (i = 0; i < G_N_ELEMENTS (formats); i++) {
+                g_autofree char *path = NULL;
+                g_autofree char *archive = NULL;
+                g_autofree char *format = NULL;
+                g_autofree char *out = NULL;
+                g_autoptr(GFile) file = NULL;
+                g_autoptr(GFileInputStream) in = NULL;
+                g_autoptr(GrTarReader) reader = NULL;
+                g_autoptr(GError) error = NULL;
+                const char *argv[] = { tar, "-C", src, NULL, "-cf", NULL, "data", NULL };
+                char buffer[777];
+                gssize size;
+                int status;
+
+                path = g_build_filename (src, long_dir, NULL);
+                g_mkdir_with_parents (path, 0755);
+                g_clear_pointer (&path, g_free);
+
+                path = g_build_filename (src, long_name, NULL);
+                g_assert_true (g_file_set_contents (path, "long", 4, NULL));
+
+                archive = g_strdup_printf ("%s/%s.tar", dir, formats[i]);
+                format = g_strdup_printf ("--format=%s", formats[i]);
+                argv[3] = format;
+                argv[5] = archive;
+
+                g_assert_true (g_spawn_sync (NULL, (char **)argv, NULL, 0, NULL, NULL, NULL, NULL, &status, &error));
+                g_assert_no_error (error);
+                g_assert_cmpint (status, ==, 0);
+
+                out = g_build_filename (dir, formats[i], NULL);
+                reader = gr_tar_reader_new (out);
+
+                file = g_file_new_for_path (archive);
+                in = g_file_read (file, NULL, &error);
+                g_assert_no_error (error);
+                while ((size = g_input_stream_read (G_INPUT_STREAM (in), buffer, sizeof (buffer), NULL, &error)) > 0)
+                        g_assert_true (gr_tar_reader_feed (reader, buffer, size, &error));
+                g_assert_no_error (error);
+                g_assert_true (gr_tar_reader_finish (reader, &error));
+
+                g_assert_cmpuint (gr_tar_reader_get_n_changed (reader), ==, 1);
+                assert_file_contents (out, long_name, "long", 4);
+        }
+
+        remove_tree (dir);
+}
+
+int
+main (int argc, char *argv[])
+{
+        g_test_init (&argc, &argv, NULL);
+
+        g_test_add_func ("/tar/round-trip", test_round_trip);
+        g_test_add_func ("/tar/late-change", test_late_change);
+        g_test_add_func ("/tar/unsafe-names", test_unsafe_names);
+        g_test_add_func ("/tar/truncated", test_truncated);
+        g_test_add_func ("/tar/too-large", test_too_large);
+        g_test_add_func ("/tar/long-names", test_long_names);
+
+        return g_test_run ();
+}
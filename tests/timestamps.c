@@ -0,0 +1,151 @@
+/* timestamps.c
+ *
+ * Copyright (C) 2017 Matthias Clasen <mclasen@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include <glib.h>
+#include "gr-utils.h"
+
+static const char *db =
+        "[both]\n"
+        "Created=2017-03-01 10:00:00\n"
+        "Modified=2017-03-02 11:00:00\n"
+        "[created]\n"
+        "Created=2017-03-01 10:00:00\n"
+        "[none]\n"
+        "Name=Soup\n"
+        "[broken]\n"
+        "Modified=yesterday\n";
+
+static GKeyFile *
+load_db (const char *data)
+{
+        GKeyFile *keyfile;
+        g_autoptr(GError) error = NULL;
+
+        keyfile = g_key_file_new ();
+        g_key_file_load_from_data (keyfile, data, -1, G_KEY_FILE_NONE, &error);
+        g_assert_no_error (error);
+
+        return keyfile;
+}
+
+static void
+test_timestamps_present (void)
+{
+        g_autoptr(GKeyFile) keyfile = NULL;
+        g_autoptr(GDateTime) ctime = NULL;
+        g_autoptr(GDateTime) mtime = NULL;
+        g_autoptr(GError) error = NULL;
+
+        keyfile = load_db (db);
+
+        g_assert_true (get_recipe_timestamps (keyfile, "both", &ctime, &mtime, &error));
+        g_assert_no_error (error);
+        g_assert_cmpint (g_date_time_get_day_of_month (ctime), ==, 1);
+        g_assert_cmpint (g_date_time_get_day_of_month (mtime), ==, 2);
+}
+
+static void
+test_timestamps_missing (void)
+{
+        g_autoptr(GKeyFile) keyfile = NULL;
+        g_autoptr(GDateTime) ctime = NULL;
+        g_autoptr(GDateTime) mtime = NULL;
+        g_autoptr(GError) error = NULL;
+
+        keyfile = load_db (db);
+
+        g_assert_true (get_recipe_timestamps (keyfile, "created", &ctime, &mtime, &error));
+        g_assert_no_error (error);
+        g_assert_true (g_date_time_equal (ctime, mtime));
+}
+
+/* Reloading the same data must not make a recipe look modified */
+static void
+test_timestamps_stable (void)
+{
+        const char *groups[] = { "both", "created", "none" };
+        int i;
+
+        for (i = 0; i < G_N_ELEMENTS (groups); i++) {
+                g_autoptr(GKeyFile) keyfile1 = NULL;
+                g_autoptr(GKeyFile) keyfile2 = NULL;
+                g_autoptr(GDateTime) ctime1 = NULL;
+                g_autoptr(GDateTime) mtime1 = NULL;
+                g_autoptr(GDateTime) ctime2 = NULL;
+                g_autoptr(GDateTime) mtime2 = NULL;
+
+                keyfile1 = load_db (db);
+                g_assert_true (get_recipe_timestamps (keyfile1, groups[i], &ctime1, &mtime1, NULL));
+
+                g_usleep (G_USEC_PER_SEC + 1);
+
+                keyfile2 = load_db (db);
+                g_assert_true (get_recipe_timestamps (keyfile2, groups[i], &ctime2, &mtime2, NULL));
+
+                g_assert_true (g_date_time_equal (ctime1, ctime2));
+                g_assert_true (g_date_time_equal (mtime1, mtime2));
+        }
+}
+
+static void
+test_timestamps_changed (void)
+{
+        g_autoptr(GKeyFile) keyfile = NULL;
+        g_autoptr(GDateTime) ctime1 = NULL;
+        g_autoptr(GDateTime) mtime1 = NULL;
+        g_autoptr(GDateTime) ctime2 = NULL;
+        g_autoptr(GDateTime) mtime2 = NULL;
+
+        keyfile = load_db (db);
+        g_assert_true (get_recipe_timestamps (keyfile, "created", &ctime1, &mtime1, NULL));
+
+        g_key_file_set_string (keyfile, "created", "Modified", "2017-04-01 09:30:00");
+        g_assert_true (get_recipe_timestamps (keyfile, "created", &ctime2, &mtime2, NULL));
+
+        g_assert_true (g_date_time_equal (ctime1, ctime2));
+        g_assert_false (g_date_time_equal (mtime1, mtime2));
+}
+
+static void
+test_timestamps_broken (void)
+{
+        g_autoptr(GKeyFile) keyfile = NULL;
+        g_autoptr(GDateTime) ctime = NULL;
+        g_autoptr(GDateTime) mtime = NULL;
+        g_autoptr(GError) error = NULL;
+
+        keyfile = load_db (db);
+
+        g_assert_false (get_recipe_timestamps (keyfile, "broken", &ctime, &mtime, &error));
+        g_assert_error (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE);
+}
+
+int
+main (int argc, char *argv[])
+{
+        g_test_init (&argc, &argv, NULL);
+
+        g_test_add_func ("/timestamps/present", test_timestamps_present);
+        g_test_add_func ("/timestamps/missing", test_timestamps_missing);
+        g_test_add_func ("/timestamps/stable", test_timestamps_stable);
+        g_test_add_func ("/timestamps/changed", test_timestamps_changed);
+        g_test_add_func ("/timestamps/broken", test_timestamps_broken);
+
+        return g_test_run ();
+}
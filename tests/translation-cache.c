@@ -0,0 +1,143 @@
+/* translation-cache.c
+ *
+ * Copyright (C) 2017 Matthias Clasen <mclasen@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include <glib.h>
+#include <glib/gstdio.h>
+#include "gr-translation-cache.h"
+#include "gr-utils.h"
+
+static char *
+get_cache_path (const char *dir)
+{
+        g_autofree char *filename = NULL;
+
+        filename = g_strconcat ("translations-", g_get_language_names ()[0], ".cache", NULL);
+
+        return g_build_filename (dir, filename, NULL);
+}
+
+static void
+test_cache (void)
+{
+        g_autoptr(GError) error = NULL;
+        g_autofree char *dir = NULL;
+        g_autofree char *data = NULL;
+        g_autofree char *cache = NULL;
+        g_autofree char *result = NULL;
+
+        dir = g_dir_make_tmp ("recipes-translations-XXXXXX", &error);
+        g_assert_no_error (error);
+
+        data = g_build_filename (dir, "recipes.db", NULL);
+        cache = get_cache_path (dir);
+        g_assert_true (g_file_set_contents (data, "[Metadata]\nVersion=1\n", -1, NULL));
+
+        gr_translation_cache_load (dir, data);
+        gr_translation_cache_set_active (TRUE);
+        g_assert_null (gr_translation_cache_lookup (GR_TRANSLATION_CACHE_TRANSLATED, "Apple pie\nwith cream"));
+
+        /* Text outside of readonly recipes is not recorded */
+        gr_translation_cache_set_active (FALSE);
+        result = casefold_string ("My Pie");
+        g_assert_cmpstr (result, ==, "my pie");
+        g_clear_pointer (&result, g_free);
+        gr_translation_cache_set_active (TRUE);
+        g_assert_null (gr_translation_cache_lookup (GR_TRANSLATION_CACHE_CASEFOLDED, "My Pie"));
+
+        /* Results are recorded as they are computed */
+        result = translate_multiline_string ("Apple pie\nwith cream");
+        g_assert_cmpstr (result, ==, "Apple pie\nwith cream");
+        g_clear_pointer (&result, g_free);
+        result = casefold_string ("Apple Pie");
+        g_assert_cmpstr (result, ==, "apple pie");
+        g_clear_pointer (&result, g_free);
+
+        gr_translation_cache_save ();
+        g_assert_true (g_file_test (cache, G_FILE_TEST_EXISTS));
+
+        /* and found again in the next session */
+        gr_translation_cache_load (dir, data);
+        result = gr_translation_cache_lookup (GR_TRANSLATION_CACHE_TRANSLATED, "Apple pie\nwith cream");
+        g_assert_cmpstr (result, ==, "Apple pie\nwith cream");
+        g_clear_pointer (&result, g_free);
+        result = gr_translation_cache_lookup (GR_TRANSLATION_CACHE_CASEFOLDED, "Apple Pie");
+        g_assert_cmpstr (result, ==, "apple pie");
+        g_clear_pointer (&result, g_free);
+
+        /* Touching the data keeps the cache */
+        g_assert_true (g_file_set_contents (data, "[Metadata]\nVersion=1\n", -1, NULL));
+        gr_translation_cache_load (dir, data);
+        result = gr_translation_cache_lookup (GR_TRANSLATION_CACHE_CASEFOLDED, "Apple Pie");
+        g_assert_cmpstr (result, ==, "apple pie");
+        g_clear_pointer (&result, g_free);
+
+        /* New data invalidates the cache */
+        g_assert_true (g_file_set_contents (data, "[Metadata]\nVersion=1\n\n[R_pie]\nName=Apple pie\n", -1, NULL));
+        gr_translation_cache_load (dir, data);
+        g_assert_null (gr_translation_cache_lookup (GR_TRANSLATION_CACHE_TRANSLATED, "Apple pie\nwith cream"));
+        g_assert_null (gr_translation_cache_lookup (GR_TRANSLATION_CACHE_CASEFOLDED, "Apple Pie"));
+
+        /* Without data, nothing is cached */
+        g_unlink (data);
+        g_unlink (cache);
+        gr_translation_cache_load (dir, data);
+        result = casefold_string ("Apple Pie");
+        g_assert_cmpstr (result, ==, "apple pie");
+        g_assert_null (gr_translation_cache_lookup (GR_TRANSLATION_CACHE_CASEFOLDED, "Apple Pie"));
+        gr_translation_cache_save ();
+        g_assert_false (g_file_test (cache, G_FILE_TEST_EXISTS));
+
+        gr_translation_cache_set_active (FALSE);
+        g_rmdir (dir);
+}
+
+static void
+test_corrupt (void)
+{
+        g_autoptr(GError) error = NULL;
+        g_autofree char *dir = NULL;
+        g_autofree char *data = NULL;
+        g_autofree char *cache = NULL;
+
+        dir = g_dir_make_tmp ("recipes-translations-XXXXXX", &error);
+        g_assert_no_error (error);
+
+        data = g_build_filename (dir, "recipes.db", NULL);
+        cache = get_cache_path (dir);
+        g_assert_true (g_file_set_contents (data, "[Metadata]\nVersion=1\n", -1, NULL));
+        g_assert_true (g_file_set_contents (cache, "not a cache at all", -1, NULL));
+
+        gr_translation_cache_load (dir, data);
+        g_assert_null (gr_translation_cache_lookup (GR_TRANSLATION_CACHE_TRANSLATED, "not"));
+
+        g_unlink (cache);
+        g_unlink (data);
+        g_rmdir (dir);
+}
+
+int
+main (int argc, char *argv[])
+{
+        g_test_init (&argc, &argv, NULL);
+
+        g_test_add_func ("/translation-cache/cache", test_cache);
+        g_test_add_func ("/translation-cache/corrupt", test_corrupt);
+
+        return g_test_run ();
+}